@@ -10,13 +10,23 @@ public class NNERuntimeRDGMLExtensionsForVulkan : ModuleRules
 	{
 		PCHUsage = ModuleRules.PCHUsageMode.UseExplicitOrSharedPCHs;
 
+		PublicDependencyModuleNames.AddRange
+			(
+			new string[] {
+				"Core",
+				"CoreUObject",
+				"DeveloperSettings",
+				// The public model interfaces extend NNE's.
+				"NNE"
+			}
+		);
+
 		PrivateDependencyModuleNames.AddRange
 			(
 			new string[] {
 				"Core",
 				"CoreUObject",
 				"Engine",
-				"NNE",
 				"Projects",
 				"RHI",
 				"RenderCore",
@@ -34,5 +44,11 @@ public class NNERuntimeRDGMLExtensionsForVulkan : ModuleRules
 		PrivateDependencyModuleNames.Add("AIMLSDKVGFLibrary");
 		// We need the third-party SPIRV-Tools module at runtime to run shape inference on models.
 		PrivateDependencyModuleNames.Add("SPIRVTools");
+
+		// Shape inference results are cached in the derived data cache when running in the editor.
+		if (Target.bBuildEditor)
+		{
+			PrivateDependencyModuleNames.Add("DerivedDataCache");
+		}
 	}
 }
@@ -3,15 +3,79 @@
 
 #include "NNERuntimeRDGMLExtensionsForVulkan.h"
 #include "NNERuntimeRDGMLExtensionsForVulkanModule.h"
+#include "NNE.h"
 #include "NNEModelData.h"
 #include "Serialization/MemoryWriter.h"
 #include "Misc/FileHelper.h"
+#include "HAL/PlatformFileManager.h"
+#include "Async/MappedFileHandle.h"
 #include "NNERuntimeRDGMLExtensionsForVulkanModel.h"
+#include "NNERuntimeRDGMLExtensionsForVulkanModelDataFiles.h"
+#include "NNERuntimeRDGMLExtensionsForVulkanModelFormat.h"
+#include "NNERuntimeRDGMLExtensionsForVulkanSettings.h"
+#include "Algo/Transform.h"
+#include "Hash/xxhash.h"
 
 using namespace UE::NNE;
 
 FGuid UNNERuntimeRDGMLExtensionsForVulkan::ModelDataGUID = FGuid((int32)'N', (int32)'A', (int32)'M', (int32)'V');
-int32 UNNERuntimeRDGMLExtensionsForVulkan::ModelDataVersion = 1;
+int32 UNNERuntimeRDGMLExtensionsForVulkan::ModelDataVersion = 5;
+const int32 UNNERuntimeRDGMLExtensionsForVulkan::ModelDataPayloadOffset =
+	Align(sizeof(ModelDataGUID) + sizeof(ModelDataVersion), FNNERuntimeRDGMLExtensionsForVulkanModelFormat::PAYLOAD_ALIGNMENT);
+const TCHAR* const UE::NNERuntimeRDGMLExtensionsForVulkan::PreShapedInputShapesFileName = TEXT("PreShapedInputShapes");
+const TCHAR* const UE::NNERuntimeRDGMLExtensionsForVulkan::InputShapeOverridesFileName = TEXT("InputShapeOverrides");
+
+FString UE::NNERuntimeRDGMLExtensionsForVulkan::FormatInputShapesFile(TConstArrayView<TArray<TArray<int32>>> InputShapeSets)
+{
+	return FString::JoinBy(InputShapeSets, TEXT("\n"), [](const TArray<TArray<int32>>& InputShapes) {
+		return FString::JoinBy(InputShapes, TEXT(";"), [](const TArray<int32>& Shape) {
+			return FString::JoinBy(Shape, TEXT(","), [](int32 Dim) { return FString::FromInt(Dim); });
+		});
+	});
+}
+
+namespace
+{
+
+	// Parses the contents of the PreShapedInputShapesFileName or InputShapeOverridesFileName file (see their descriptions for the format).
+	// Unspecified dimensions (-1) are only allowed if bAllowUnspecified.
+	bool ParseInputShapesFile(TConstArrayView64<uint8> FileData, const FString& FileName, bool bAllowUnspecified, TArray<TArray<TArray<int32>>>& OutInputShapeSets)
+	{
+		const FString Text(FUTF8ToTCHAR(reinterpret_cast<const ANSICHAR*>(FileData.GetData()), (int32)FileData.Num()));
+		TArray<FString> Lines;
+		Text.ParseIntoArrayLines(Lines);
+		for (const FString& Line : Lines)
+		{
+			if (Line.TrimStartAndEnd().IsEmpty())
+			{
+				continue;
+			}
+
+			TArray<TArray<int32>>& InputShapes = OutInputShapeSets.AddDefaulted_GetRef();
+			TArray<FString> ShapeTexts;
+			Line.ParseIntoArray(ShapeTexts, TEXT(";"), false);
+			for (const FString& ShapeText : ShapeTexts)
+			{
+				TArray<FString> Dims;
+				ShapeText.ParseIntoArray(Dims, TEXT(","));
+				TArray<int32>& Shape = InputShapes.AddDefaulted_GetRef();
+				for (const FString& Dim : Dims)
+				{
+					const FString TrimmedDim = Dim.TrimStartAndEnd();
+					const int64 Value = TrimmedDim.IsNumeric() && !TrimmedDim.Contains(TEXT(".")) ? FCString::Strtoi64(*TrimmedDim, nullptr, 10) : 0;
+					if (Value == 0 || Value < (bAllowUnspecified ? -1 : 1) || Value > MAX_int32)
+					{
+						UE_LOG(LogNNERuntimeRDGMLExtensionsForVulkan, Error, TEXT("Invalid dimension '%s' in %s."), *TrimmedDim, *FileName);
+						return false;
+					}
+					Shape.Add((int32)Value);
+				}
+			}
+		}
+		return true;
+	}
+
+} // namespace
 
 FString UNNERuntimeRDGMLExtensionsForVulkan::GetRuntimeName() const
 {
@@ -41,34 +105,106 @@ TSharedPtr<FSharedModelData> UNNERuntimeRDGMLExtensionsForVulkan::CreateModelDat
 		return TSharedPtr<FSharedModelData>();
 	}
 
-	TArray<uint8> VGFBuffer;
-
-	if (FileType.Equals("vgf", ESearchCase::IgnoreCase))
-	{
-		// Nothing to do, use VGF data as is.
-		VGFBuffer = FileData;
-	}
-	else
+	if (!FileType.Equals("vgf", ESearchCase::IgnoreCase))
 	{
 		// Shouldn't get here, but just in case.
 		UE_LOG(LogNNERuntimeRDGMLExtensionsForVulkan, Error, TEXT("Unsupported file type."));
 		return TSharedPtr<FSharedModelData>();
 	}
 
-	TArray<uint8> ModelData;
-	FMemoryWriter Writer(ModelData);
+	// This is the only copy of the model data that we make (Write appends the payload directly to it), as the VGF can be very large.
+	// TArray64 so that models over 2GB work.
+	TArray64<uint8> ModelData;
+	FMemoryWriter64 Writer(ModelData);
 	// Prepend GUID and version so that we can later detect corrupt or old versions.
 	Writer << ModelDataGUID;
 	Writer << ModelDataVersion;
-	Writer.Serialize(VGFBuffer.GetData(), VGFBuffer.Num());
+	ModelData.AddZeroed(ModelDataPayloadOffset - ModelData.Num());
 
-	return MakeShared<FSharedModelData>(MakeSharedBufferFromArray(MoveTemp(ModelData)), 0);
+	// Decode the VGF now rather than every time the model is created at runtime. This also means that invalid VGFs, or ones
+	// using features that we don't support, are reported when importing/cooking rather than on device.
+	// Shape inference is also run now for any shapes that the model is known to be used with, so that it doesn't need to be done on device.
+	TArray<TArray<FTensorShape>> PreShapeInputShapeSets;
+	if (const TConstArrayView64<uint8>* PreShapedInputShapesFileData = AdditionalFileData.Find(UE::NNERuntimeRDGMLExtensionsForVulkan::PreShapedInputShapesFileName))
+	{
+		TArray<TArray<TArray<int32>>> InputShapeSets;
+		if (!ParseInputShapesFile(*PreShapedInputShapesFileData, UE::NNERuntimeRDGMLExtensionsForVulkan::PreShapedInputShapesFileName, false, InputShapeSets))
+		{
+			// Error will have been logged by ParseInputShapesFile.
+			return TSharedPtr<FSharedModelData>();
+		}
+		for (const TArray<TArray<int32>>& InputShapes : InputShapeSets)
+		{
+			Algo::Transform(InputShapes, PreShapeInputShapeSets.AddDefaulted_GetRef(), [](const TArray<int32>& Shape) {
+				TArray<uint32> Dimensions;
+				Algo::Transform(Shape, Dimensions, [](int32 X) { return (uint32)X; });
+				return FTensorShape::Make(Dimensions);
+			});
+		}
+	}
+	// Any input dimensions that were pinned when the model was imported.
+	TArray<TArray<int32>> InputShapeOverrides;
+	if (const TConstArrayView64<uint8>* InputShapeOverridesFileData = AdditionalFileData.Find(UE::NNERuntimeRDGMLExtensionsForVulkan::InputShapeOverridesFileName))
+	{
+		TArray<TArray<TArray<int32>>> InputShapeSets;
+		if (!ParseInputShapesFile(*InputShapeOverridesFileData, UE::NNERuntimeRDGMLExtensionsForVulkan::InputShapeOverridesFileName, true, InputShapeSets))
+		{
+			// Error will have been logged by ParseInputShapesFile.
+			return TSharedPtr<FSharedModelData>();
+		}
+		if (InputShapeSets.Num() > 1)
+		{
+			UE_LOG(LogNNERuntimeRDGMLExtensionsForVulkan, Error, TEXT("%s must only contain one set of input shapes."), UE::NNERuntimeRDGMLExtensionsForVulkan::InputShapeOverridesFileName);
+			return TSharedPtr<FSharedModelData>();
+		}
+		if (InputShapeSets.Num() == 1)
+		{
+			InputShapeOverrides = MoveTemp(InputShapeSets[0]);
+		}
+	}
+	const UNNERuntimeRDGMLExtensionsForVulkanSettings* Settings = GetDefault<UNNERuntimeRDGMLExtensionsForVulkanSettings>();
+	const uint64 SharedConstantMinBytes = (uint64)FMath::Max(0, Settings->SharedConstantMinSizeKB) * 1024;
+	if (!FNNERuntimeRDGMLExtensionsForVulkanModelFormat::Write(FileData, InputShapeOverrides, PreShapeInputShapeSets, Settings->bCompressModelConstants,
+		SharedConstantMinBytes, Settings->bOptimizeModelCode, ModelData))
+	{
+		// Error will have been logged by Write.
+		return TSharedPtr<FSharedModelData>();
+	}
+
+	// The payload is used in-place, so the alignment needs to be preserved when the model data is loaded.
+	return MakeShared<FSharedModelData>(MakeSharedBufferFromArray(MoveTemp(ModelData)), FNNERuntimeRDGMLExtensionsForVulkanModelFormat::PAYLOAD_ALIGNMENT);
 }
 
 FString UNNERuntimeRDGMLExtensionsForVulkan::GetModelDataIdentifier(const FString& FileType, TConstArrayView64<uint8> FileData,
 	const TMap<FString, TConstArrayView64<uint8>>& AdditionalFileData, const FGuid& FileId, const ITargetPlatform* TargetPlatform) const
 {
-	return FileId.ToString(EGuidFormats::Digits) + "-" + ModelDataGUID.ToString(EGuidFormats::Digits) + "-" + FString::FromInt(UNNERuntimeRDGMLExtensionsForVulkan::ModelDataVersion);
+	FString Identifier = FileId.ToString(EGuidFormats::Digits) + "-" + ModelDataGUID.ToString(EGuidFormats::Digits) + "-" + FString::FromInt(UNNERuntimeRDGMLExtensionsForVulkan::ModelDataVersion);
+	// The pre-shaped input shapes and input shape overrides affect the model data, so changing them needs to invalidate any cached model data.
+	for (const TCHAR* FileName : { UE::NNERuntimeRDGMLExtensionsForVulkan::PreShapedInputShapesFileName, UE::NNERuntimeRDGMLExtensionsForVulkan::InputShapeOverridesFileName })
+	{
+		if (const TConstArrayView64<uint8>* AdditionalFile = AdditionalFileData.Find(FileName))
+		{
+			Identifier += FString::Printf(TEXT("-%016llx"), FXxHash64::HashBuffer(AdditionalFile->GetData(), AdditionalFile->Num()).Hash);
+		}
+		else
+		{
+			Identifier += TEXT("-");
+		}
+	}
+	const UNNERuntimeRDGMLExtensionsForVulkanSettings* Settings = GetDefault<UNNERuntimeRDGMLExtensionsForVulkanSettings>();
+	if (Settings->bCompressModelConstants)
+	{
+		Identifier += TEXT("-Compressed");
+	}
+	if (Settings->SharedConstantMinSizeKB > 0)
+	{
+		Identifier += FString::Printf(TEXT("-Shared%d"), Settings->SharedConstantMinSizeKB);
+	}
+	if (Settings->bOptimizeModelCode)
+	{
+		Identifier += TEXT("-Optimized");
+	}
+	return Identifier;
 }
 
 INNERuntimeRDG::ECanCreateModelRDGStatus UNNERuntimeRDGMLExtensionsForVulkan::CanCreateModelRDG(TObjectPtr<UNNEModelData> ModelData) const
@@ -89,42 +225,177 @@ INNERuntimeRDG::ECanCreateModelRDGStatus UNNERuntimeRDGMLExtensionsForVulkan::Ca
 		return ECanCreateModelRDGStatus::Fail;
 	}
 
-	TConstArrayView64<uint8> Data = ModelDataForThisRuntime->GetView();
-	if (Data.Num() <= sizeof(ModelDataGUID) + sizeof(ModelDataVersion))
+	return IsModelDataValid(ModelDataForThisRuntime->GetView()) ? ECanCreateModelRDGStatus::Ok : ECanCreateModelRDGStatus::Fail;
+}
+
+bool UNNERuntimeRDGMLExtensionsForVulkan::IsModelDataValid(TConstArrayView64<uint8> Data)
+{
+	if (Data.Num() <= ModelDataPayloadOffset)
 	{
-		UE_LOG(LogNNERuntimeRDGMLExtensionsForVulkan, Error, TEXT("UNNEModelData model data for this runtime is too small."))
-		return ECanCreateModelRDGStatus::Fail;
+		UE_LOG(LogNNERuntimeRDGMLExtensionsForVulkan, Error, TEXT("Model data for this runtime is too small."))
+		return false;
 	}
 
 	// Validate the GUID which should be the first thing in the data
 	if (FGenericPlatformMemory::Memcmp(&Data[0], &ModelDataGUID, sizeof(ModelDataGUID)) != 0)
 	{
-		UE_LOG(LogNNERuntimeRDGMLExtensionsForVulkan, Error, TEXT("UNNEModelData model data for this runtime has incorrect GUID."))
-		return ECanCreateModelRDGStatus::Fail;
+		UE_LOG(LogNNERuntimeRDGMLExtensionsForVulkan, Error, TEXT("Model data for this runtime has incorrect GUID."))
+		return false;
 	}
 
 	// Validate the version number which should be immediately after the GUID
 	if (FGenericPlatformMemory::Memcmp(&Data[sizeof(ModelDataGUID)], &ModelDataVersion, sizeof(ModelDataVersion)) != 0)
 	{
-		UE_LOG(LogNNERuntimeRDGMLExtensionsForVulkan, Error, TEXT("UNNEModelData model data for this runtime has incorrect version."))
-		return ECanCreateModelRDGStatus::Fail;
+		UE_LOG(LogNNERuntimeRDGMLExtensionsForVulkan, Error, TEXT("Model data for this runtime has incorrect version."))
+		return false;
 	}
 
-	return ECanCreateModelRDGStatus::Ok;
+	return true;
 }
 
 TSharedPtr<IModelRDG> UNNERuntimeRDGMLExtensionsForVulkan::CreateModelRDG(TObjectPtr<UNNEModelData> ModelData)
+{
+	return CreateModelRDGAsync(ModelData).Get();
+}
+
+TFuture<TSharedPtr<INNERuntimeRDGMLExtensionsForVulkanModel>> UNNERuntimeRDGMLExtensionsForVulkan::CreateModelRDGAsync(TObjectPtr<UNNEModelData> ModelData)
 {
 	check(ModelData != nullptr);
 
 	if (CanCreateModelRDG(ModelData) != ECanCreateModelRDGStatus::Ok)
 	{
 		// Error will have been logged by CanCreateModelRDG
-		return TSharedPtr<IModelRDG>();
+		return MakeFulfilledPromise<TSharedPtr<INNERuntimeRDGMLExtensionsForVulkanModel>>().GetFuture();
 	}
 
+	// GetModelData accesses the UObject, so this part stays on the calling thread.
 	const TSharedPtr<FSharedModelData> ModelDataForThisRuntime = ModelData->GetModelData(GetRuntimeName());
 	check(ModelData != nullptr); // Already validated by CanCreateModelRDG
 
-	return FNNERuntimeRDGMLExtensionsForVulkanModelUnshaped::Create(ModelDataForThisRuntime);
+	// Look up any shapes that the project settings say this model should be prepared for. Again this accesses UObjects so is done here.
+	const UNNERuntimeRDGMLExtensionsForVulkanSettings* Settings = GetDefault<UNNERuntimeRDGMLExtensionsForVulkanSettings>();
+	TArray<TArray<UE::NNE::FTensorShape>> PrewarmShapeSets;
+	const FSoftObjectPath ModelDataPath(ModelData.Get());
+	for (const FNNERuntimeRDGMLExtensionsForVulkanModelPrewarm& Prewarm : Settings->PrewarmShapes)
+	{
+		if (Prewarm.ModelData.ToSoftObjectPath() != ModelDataPath)
+		{
+			continue;
+		}
+		for (const FNNERuntimeRDGMLExtensionsForVulkanInputShapes& ShapeSet : Prewarm.ShapeSets)
+		{
+			TArray<UE::NNE::FTensorShape>& InputShapes = PrewarmShapeSets.AddDefaulted_GetRef();
+			for (const FNNERuntimeRDGMLExtensionsForVulkanTensorShape& Shape : ShapeSet.InputShapes)
+			{
+				TArray<uint32> Dimensions;
+				Algo::Transform(Shape.Dimensions, Dimensions, [](int32 X) { return (uint32)X; });
+				InputShapes.Add(UE::NNE::FTensorShape::Make(Dimensions));
+			}
+		}
+	}
+
+	return CreateModelRDGAsyncInternal(ModelDataForThisRuntime, MoveTemp(PrewarmShapeSets), Settings->bPrewarmDispatch);
+}
+
+TFuture<TSharedPtr<INNERuntimeRDGMLExtensionsForVulkanModel>> UNNERuntimeRDGMLExtensionsForVulkan::CreateModelRDGFromFileAsync(const FString& Filename)
+{
+	if (!SupportsInference)
+	{
+		UE_LOG(LogNNERuntimeRDGMLExtensionsForVulkan, Error, TEXT("Missing support for inference - see earlier log messages from NNERuntimeRDGMLExtensionsForVulkan."))
+		return MakeFulfilledPromise<TSharedPtr<INNERuntimeRDGMLExtensionsForVulkanModel>>().GetFuture();
+	}
+
+	TSharedPtr<FSharedModelData> ModelData;
+	IPlatformFile& PlatformFile = FPlatformFileManager::Get().GetPlatformFile();
+	TUniquePtr<IMappedFileHandle> MappedFileHandle(PlatformFile.OpenMapped(*Filename));
+	TUniquePtr<IMappedFileRegion> MappedFileRegion(MappedFileHandle.IsValid() ? MappedFileHandle->MapRegion(0, MappedFileHandle->GetFileSize()) : nullptr);
+	if (MappedFileRegion.IsValid())
+	{
+		// The buffer owns the mapping, so the file stays mapped until the model (and anything else using the model data) is destroyed.
+		const uint8* MappedPtr = MappedFileRegion->GetMappedPtr();
+		const int64 MappedSize = MappedFileRegion->GetMappedSize();
+		FSharedBuffer Buffer = FSharedBuffer::TakeOwnership(MappedPtr, MappedSize,
+			[Handle = MappedFileHandle.Release(), Region = MappedFileRegion.Release()](const void*) { delete Region; delete Handle; });
+		// Mappings are page-aligned, which is more than the payload needs, so this never copies the file.
+		ModelData = MakeShared<FSharedModelData>(MoveTemp(Buffer), FNNERuntimeRDGMLExtensionsForVulkanModelFormat::PAYLOAD_ALIGNMENT);
+	}
+	else
+	{
+		// Not all platforms (or files, e.g. in a pak) can be mapped, in which case we just load the whole thing.
+		TArray64<uint8> FileData;
+		if (!FFileHelper::LoadFileToArray(FileData, *Filename))
+		{
+			UE_LOG(LogNNERuntimeRDGMLExtensionsForVulkan, Error, TEXT("Failed to load model data from '%s'."), *Filename);
+			return MakeFulfilledPromise<TSharedPtr<INNERuntimeRDGMLExtensionsForVulkanModel>>().GetFuture();
+		}
+		ModelData = MakeShared<FSharedModelData>(MakeSharedBufferFromArray(MoveTemp(FileData)), FNNERuntimeRDGMLExtensionsForVulkanModelFormat::PAYLOAD_ALIGNMENT);
+	}
+
+	if (!IsModelDataValid(ModelData->GetView()))
+	{
+		// Error will have been logged by IsModelDataValid.
+		return MakeFulfilledPromise<TSharedPtr<INNERuntimeRDGMLExtensionsForVulkanModel>>().GetFuture();
+	}
+
+	// There's no asset to look up prewarm settings for, but static models still get their shaped model prepared.
+	return CreateModelRDGAsyncInternal(ModelData, {}, false);
+}
+
+TFuture<TSharedPtr<INNERuntimeRDGMLExtensionsForVulkanModel>> UNNERuntimeRDGMLExtensionsForVulkan::CreateModelRDGAsyncInternal(const TSharedPtr<FSharedModelData>& ModelData,
+	TArray<TArray<UE::NNE::FTensorShape>> PrewarmShapeSets, bool bPrewarmDispatch)
+{
+	return FNNERuntimeRDGMLExtensionsForVulkanModelUnshaped::CreateAsync(ModelData).Then(
+		[PrewarmShapeSets = MoveTemp(PrewarmShapeSets), bPrewarmDispatch](TFuture<TSharedPtr<FNNERuntimeRDGMLExtensionsForVulkanModelUnshaped>> ModelFuture) mutable {
+			TSharedPtr<FNNERuntimeRDGMLExtensionsForVulkanModelUnshaped> Model = ModelFuture.Get();
+			// A static model only ever has one shaped model, so that is always prepared (and kept) as soon as the model is created.
+			TArray<UE::NNE::FTensorShape> StaticInputShapes;
+			if (Model.IsValid() && Model->GetStaticInputShapes(StaticInputShapes) && !PrewarmShapeSets.Contains(StaticInputShapes))
+			{
+				PrewarmShapeSets.Add(MoveTemp(StaticInputShapes));
+			}
+			if (Model.IsValid() && !PrewarmShapeSets.IsEmpty())
+			{
+				// Don't wait for this, the model can be used straight away (it just won't be as quick to give shapes to until this has finished).
+				Model->PrewarmShapesAsync(MoveTemp(PrewarmShapeSets), bPrewarmDispatch);
+			}
+			return TSharedPtr<INNERuntimeRDGMLExtensionsForVulkanModel>(Model);
+		});
+}
+
+namespace UE::NNERuntimeRDGMLExtensionsForVulkan
+{
+	namespace
+	{
+		UNNERuntimeRDGMLExtensionsForVulkan* FindRuntime()
+		{
+			// The runtime is registered with NNE by the module, so look it up there rather than reaching into the module.
+			TWeakInterfacePtr<INNERuntimeRDG> Runtime = UE::NNE::GetRuntime<INNERuntimeRDG>(TEXT("NNERuntimeRDGMLExtensionsForVulkan"));
+			UNNERuntimeRDGMLExtensionsForVulkan* Result = Runtime.IsValid() ? Cast<UNNERuntimeRDGMLExtensionsForVulkan>(Runtime.GetObject()) : nullptr;
+			if (Result == nullptr)
+			{
+				UE_LOG(LogNNERuntimeRDGMLExtensionsForVulkan, Error, TEXT("The ML Extensions for Vulkan NNE runtime is not registered."));
+			}
+			return Result;
+		}
+	}
+
+	TFuture<TSharedPtr<INNERuntimeRDGMLExtensionsForVulkanModel>> CreateModelAsync(TObjectPtr<UNNEModelData> ModelData)
+	{
+		UNNERuntimeRDGMLExtensionsForVulkan* Runtime = FindRuntime();
+		if (Runtime == nullptr || ModelData == nullptr)
+		{
+			return MakeFulfilledPromise<TSharedPtr<INNERuntimeRDGMLExtensionsForVulkanModel>>().GetFuture();
+		}
+		return Runtime->CreateModelRDGAsync(ModelData);
+	}
+
+	TFuture<TSharedPtr<INNERuntimeRDGMLExtensionsForVulkanModel>> CreateModelFromFileAsync(const FString& Filename)
+	{
+		UNNERuntimeRDGMLExtensionsForVulkan* Runtime = FindRuntime();
+		if (Runtime == nullptr)
+		{
+			return MakeFulfilledPromise<TSharedPtr<INNERuntimeRDGMLExtensionsForVulkanModel>>().GetFuture();
+		}
+		return Runtime->CreateModelRDGFromFileAsync(Filename);
+	}
 }
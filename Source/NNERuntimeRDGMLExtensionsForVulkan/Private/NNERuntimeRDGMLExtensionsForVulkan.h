@@ -5,6 +5,8 @@
 
 #include "NNERuntime.h"
 #include "NNERuntimeRDG.h"
+#include "Async/Future.h"
+#include "NNERuntimeRDGMLExtensionsForVulkanModelInterface.h"
 
 #include "NNERuntimeRDGMLExtensionsForVulkan.generated.h"
 
@@ -18,6 +20,8 @@ public:
 	// ID and version to identify the compiled model data.
 	static FGuid ModelDataGUID;
 	static int32 ModelDataVersion;
+	// Where the FNNERuntimeRDGMLExtensionsForVulkanModelFormat payload starts in the model data (after the GUID and version).
+	static const int32 ModelDataPayloadOffset;
 
 	bool SupportsInference;
 
@@ -39,4 +43,24 @@ public:
 
 	virtual INNERuntimeRDG::ECanCreateModelRDGStatus CanCreateModelRDG(TObjectPtr<UNNEModelData> ModelData) const override;
 	virtual TSharedPtr<UE::NNE::IModelRDG> CreateModelRDG(TObjectPtr<UNNEModelData> ModelData) override;
+
+	/// Asynchronous version of CreateModelRDG. The model data is read and the Vulkan objects are created on a task graph worker thread,
+	/// so this can be used to stream in models without blocking the calling thread. The future is fulfilled with nullptr on failure.
+	/// Outside of this module, use UE::NNERuntimeRDGMLExtensionsForVulkan::CreateModelAsync.
+	TFuture<TSharedPtr<INNERuntimeRDGMLExtensionsForVulkanModel>> CreateModelRDGAsync(TObjectPtr<UNNEModelData> ModelData);
+
+	/// Creates a model from a file containing this runtime's model data (i.e. the data that CreateModelData returned, saved as a separate
+	/// file and staged outside of any pak). The file is memory-mapped rather than loaded, so for large models only the parts of the VGF
+	/// that are actually used need to be paged in, which reduces both load time and resident memory. If the file can't be mapped then
+	/// it's loaded instead. The future is fulfilled with nullptr on failure.
+	/// Outside of this module, use UE::NNERuntimeRDGMLExtensionsForVulkan::CreateModelFromFileAsync.
+	TFuture<TSharedPtr<INNERuntimeRDGMLExtensionsForVulkanModel>> CreateModelRDGFromFileAsync(const FString& Filename);
+
+private:
+	// Checks the GUID and version at the start of the model data. Returns false (having logged an error) if they're not what we expect.
+	static bool IsModelDataValid(TConstArrayView64<uint8> Data);
+
+	// Shared by CreateModelRDGAsync and CreateModelRDGFromFileAsync, once the model data has been validated.
+	TFuture<TSharedPtr<INNERuntimeRDGMLExtensionsForVulkanModel>> CreateModelRDGAsyncInternal(const TSharedPtr<UE::NNE::FSharedModelData>& ModelData,
+		TArray<TArray<UE::NNE::FTensorShape>> PrewarmShapeSets, bool bPrewarmDispatch);
 };
@@ -0,0 +1,107 @@
+// SPDX-FileCopyrightText: Copyright 2025 Arm Limited and/or its affiliates <open-source-office@arm.com>
+// SPDX-License-Identifier: MIT
+
+#include "NNERuntimeRDGMLExtensionsForVulkanDeferredDeletion.h"
+#include "IVulkanDynamicRHI.h"
+#include "Misc/CoreDelegates.h"
+#include "Misc/ScopeLock.h"
+#include "RenderingThread.h"
+
+FNNERuntimeRDGMLExtensionsForVulkanDeferredDeletionQueue& FNNERuntimeRDGMLExtensionsForVulkanDeferredDeletionQueue::Get()
+{
+	static FNNERuntimeRDGMLExtensionsForVulkanDeferredDeletionQueue Queue;
+	return Queue;
+}
+
+void FNNERuntimeRDGMLExtensionsForVulkanDeferredDeletionQueue::Initialize()
+{
+	OnEndFrameHandle = FCoreDelegates::OnEndFrameRT.AddLambda([this]() {
+		ProcessRetired_RenderThread(FRHICommandListExecutor::GetImmediateCommandList(), false);
+	});
+}
+
+void FNNERuntimeRDGMLExtensionsForVulkanDeferredDeletionQueue::Shutdown()
+{
+	FCoreDelegates::OnEndFrameRT.Remove(OnEndFrameHandle);
+	OnEndFrameHandle.Reset();
+
+	if (GDynamicRHI == nullptr)
+	{
+		// Nothing can have been queued if there's no RHI.
+		return;
+	}
+
+	// Wait for the GPU to finish with everything, then destroy it all. Destroying an entry can release the last reference to a model,
+	// which queues up more entries, so keep going until the queue stays empty. Those new entries can't have been used by the GPU since
+	// it went idle, so they don't need waiting for either.
+	ENQUEUE_RENDER_COMMAND(NNERuntimeRDGMLExtensionsForVulkan_FlushDeferredDeletionQueue)([this](FRHICommandListImmediate& RHICmdList) {
+		RHICmdList.BlockUntilGPUIdle();
+		while (true)
+		{
+			ProcessRetired_RenderThread(RHICmdList, true);
+			RHICmdList.ImmediateFlush(EImmediateFlushType::FlushRHIThread);
+
+			FScopeLock Lock(&EntriesCriticalSection);
+			if (Entries.IsEmpty())
+			{
+				break;
+			}
+		}
+	});
+	FlushRenderingCommands();
+}
+
+void FNNERuntimeRDGMLExtensionsForVulkanDeferredDeletionQueue::Enqueue(FDeleteFunction&& DeleteFunction, FGPUFenceRHIRef LastUseFence)
+{
+	FScopeLock Lock(&EntriesCriticalSection);
+	Entries.Add(FEntry{ MoveTemp(DeleteFunction), MoveTemp(LastUseFence) });
+}
+
+void FNNERuntimeRDGMLExtensionsForVulkanDeferredDeletionQueue::ProcessRetired_RenderThread(FRHICommandListImmediate& RHICmdList, bool bForce)
+{
+	check(IsInRenderingThread());
+
+	TArray<FDeleteFunction> Retired;
+	{
+		FScopeLock Lock(&EntriesCriticalSection);
+		for (int32 I = 0; I < Entries.Num(); )
+		{
+			FEntry& Entry = Entries[I];
+			if (Entry.FrameNumber == MAX_uint64)
+			{
+				Entry.FrameNumber = GFrameCounterRenderThread;
+			}
+
+			const bool bFenceSignalled = !Entry.LastUseFence.IsValid() || Entry.LastUseFence->Poll();
+			const bool bOldEnough = Entry.LastUseFence.IsValid() || GFrameCounterRenderThread >= Entry.FrameNumber + NUM_FRAMES_TO_DEFER;
+			if (bForce || (bFenceSignalled && bOldEnough))
+			{
+				Retired.Add(MoveTemp(Entry.DeleteFunction));
+				Entries.RemoveAtSwap(I);
+			}
+			else
+			{
+				++I;
+			}
+		}
+	}
+
+	if (Retired.IsEmpty())
+	{
+		return;
+	}
+
+	// Destroy on the RHI thread, so that this is ordered correctly with respect to other Vulkan work that the model instances
+	// have queued up there (e.g. freeing descriptor sets). Note that this runs outside of the lock, as destroying these
+	// objects can release the last reference to a model, which will then queue up its own objects for deletion.
+	RHICmdList.EnqueueLambda([Retired = MoveTemp(Retired)](FRHICommandListImmediate& RHICmdList) mutable {
+		VkDevice Device = GetIVulkanDynamicRHI()->RHIGetVkDevice();
+		const VkAllocationCallbacks* Allocator = GetIVulkanDynamicRHI()->RHIGetVkAllocationCallbacks();
+
+		for (FDeleteFunction& DeleteFunction : Retired)
+		{
+			DeleteFunction(Device, Allocator);
+		}
+		Retired.Empty();
+	});
+}
@@ -0,0 +1,54 @@
+// SPDX-FileCopyrightText: Copyright 2025 Arm Limited and/or its affiliates <open-source-office@arm.com>
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include "Containers/Array.h"
+#include "HAL/CriticalSection.h"
+#include "RHIResources.h"
+#include "Templates/Function.h"
+#include "VulkanThirdParty.h"
+
+// Queue of Vulkan objects (pipelines, shader modules, layouts, descriptor pools, sessions, tensors, views etc.) which are no longer
+// referenced by the CPU but which the GPU might still be using. Rather than the owner waiting for the GPU to finish with them,
+// they are handed off to this queue along with the fence of their last use and destroyed lazily once that fence has signalled.
+// This means that dropping a model or model instance never blocks the calling thread.
+class FNNERuntimeRDGMLExtensionsForVulkanDeferredDeletionQueue
+{
+public:
+	// Destroys the objects which were captured by the function. Always called on the RHI thread.
+	using FDeleteFunction = TUniqueFunction<void(VkDevice Device, const VkAllocationCallbacks* Allocator)>;
+
+	static FNNERuntimeRDGMLExtensionsForVulkanDeferredDeletionQueue& Get();
+
+	// Starts processing the queue at the end of each frame. Only needed if we support running inferences.
+	void Initialize();
+	// Destroys everything that is left in the queue, waiting for the GPU if necessary.
+	void Shutdown();
+
+	// Queues up the given function to be called once the GPU has finished with the objects it destroys. This can be called from any thread.
+	// If LastUseFence is null (e.g. the objects were never used by the GPU or their users have already been retired through this queue),
+	// the objects are destroyed after NUM_FRAMES_TO_DEFER frames have been rendered.
+	void Enqueue(FDeleteFunction&& DeleteFunction, FGPUFenceRHIRef LastUseFence = nullptr);
+
+private:
+	// Destroys all entries whose fences have signalled and have been in the queue for long enough.
+	// If bForce is true, everything in the queue is destroyed regardless (only used on shutdown, after waiting for the GPU).
+	void ProcessRetired_RenderThread(FRHICommandListImmediate& RHICmdList, bool bForce);
+
+	static const uint64 NUM_FRAMES_TO_DEFER = 3;
+
+	struct FEntry
+	{
+		FDeleteFunction DeleteFunction;
+		FGPUFenceRHIRef LastUseFence;
+		// The rendering thread frame that this entry was first seen in. We don't know this when Enqueue is called
+		// from another thread, so it is filled in when the rendering thread first processes the entry.
+		uint64 FrameNumber = MAX_uint64;
+	};
+
+	FCriticalSection EntriesCriticalSection;
+	TArray<FEntry> Entries;
+
+	FDelegateHandle OnEndFrameHandle;
+};
@@ -0,0 +1,11 @@
+// SPDX-FileCopyrightText: Copyright 2025 Arm Limited and/or its affiliates <open-source-office@arm.com>
+// SPDX-License-Identifier: MIT
+
+// The plugin's log category, separate from the module header so that code which doesn't need the engine's Vulkan headers (such as
+// shape inference, which Tools/VGFBenchmark also builds) can log without including them.
+
+#pragma once
+
+#include "Logging/LogMacros.h"
+
+DECLARE_LOG_CATEGORY_EXTERN(LogNNERuntimeRDGMLExtensionsForVulkan, Log, All);
@@ -4,19 +4,40 @@
 #include "NNERuntimeRDGMLExtensionsForVulkanModel.h"
 #include "NNERuntimeRDGMLExtensionsForVulkanModule.h"
 #include "NNERuntimeRDGMLExtensionsForVulkanShapeInference.h"
+#include "NNERuntimeRDGMLExtensionsForVulkanShapeInferenceCache.h"
+#include "NNERuntimeRDGMLExtensionsForVulkanDeferredDeletion.h"
+#include "NNERuntimeRDGMLExtensionsForVulkanModelFormat.h"
+#include "NNERuntimeRDGMLExtensionsForVulkanPipelineCache.h"
 #include "RenderGraphBuilder.h"
+#include "RenderGraphUtils.h"
 #include "NNERuntimeRDGMLExtensionsForVulkan.h"
+#include "NNERuntimeRDGMLExtensionsForVulkanSettings.h"
 #include "Algo/Accumulate.h"
+#include "Algo/AnyOf.h"
+#include "Algo/Compare.h"
 #include "Algo/Transform.h"
+#include "Algo/TransformAccumulate.h"
+#include "Async/Async.h"
+#include "Async/ParallelFor.h"
+#include "Tasks/Task.h"
+#include "Misc/ScopeExit.h"
+#include "Misc/ScopeLock.h"
+#include "Misc/ScopeRWLock.h"
 
 class FVulkanDevice; // Forward declaration needed for VulkanUtil.h
 #include "VulkanUtil.h"
 
-#include "vgf/decoder.h" // The VGF parser from the ML SDK for Vulkan
 
 // The max number of executions that can be queued up (on the GPU) for each model instance.
 const uint32_t MAX_CONCURRENT_EXECUTIONS_PER_INSTANCE = 10;
 
+// Cached tensor objects which haven't been used by any of this many of the most recent executions of a model instance are retired.
+// This allows for RDG handing out a different one of a few pooled buffers for the same tensor from one frame to the next.
+const uint64 TENSOR_OBJECT_CACHE_MAX_UNUSED_EXECUTIONS = 8;
+
+// The number of InferOutputTensorShapes results that each model remembers (see InferredOutputShapes).
+const int32 MAX_INFERRED_OUTPUT_SHAPES = 64;
+
 uint32 GetTypeHash(const UE::NNE::FTensorShape& Shape)
 {
 	return GetArrayHash(Shape.GetData().GetData(), Shape.GetData().Num());
@@ -35,10 +56,9 @@ uint32 GetTypeHash(const TArray<UE::NNE::FTensorShape>& ArrayOfShapes)
 namespace Private
 {
 
-ENNETensorDataType VKFormatToNNETensorDataType(mlsdk_vk_format VKFormat)
+ENNETensorDataType VKFormatToNNETensorDataType(VkFormat VKFormat)
 {
-	// The VGF format enum is just the regular Vulkan VkFormat.
-	switch ((VkFormat)VKFormat)
+	switch (VKFormat)
 	{
 	case VK_FORMAT_R32_SFLOAT:
 		return ENNETensorDataType::Float;
@@ -49,10 +69,9 @@ ENNETensorDataType VKFormatToNNETensorDataType(mlsdk_vk_format VKFormat)
 	}
 }
 
-size_t GetNumBytesPerElement(mlsdk_vk_format VKFormat)
+size_t GetNumBytesPerElement(VkFormat VKFormat)
 {
-	// The VGF format enum is just the regular Vulkan VkFormat.
-	switch ((VkFormat)VKFormat)
+	switch (VKFormat)
 	{
 	case VK_FORMAT_R32_SFLOAT:
 		return 4;
@@ -67,752 +86,1558 @@ size_t GetNumBytesPerElement(mlsdk_vk_format VKFormat)
 
 TSharedPtr<FNNERuntimeRDGMLExtensionsForVulkanModelUnshaped> FNNERuntimeRDGMLExtensionsForVulkanModelUnshaped::Create(const TSharedPtr<UE::NNE::FSharedModelData>& InModelData)
 {
-	TSharedPtr<FNNERuntimeRDGMLExtensionsForVulkanModelUnshaped> Result(new FNNERuntimeRDGMLExtensionsForVulkanModelUnshaped());
-	Result->SharedModelData = InModelData; // Keep a reference to this alive, as we'll use it when creating shaped models later.
+	return CreateAsync(InModelData).Get();
+}
 
-	// Skip past the GUID and version (which have already been validated by UNNERuntimeRDGMLExtensionsForVulkan::CreateModelRDG) to get to the raw VGF data.
-	TConstArrayView<uint8> VgfBuffer =
-		InModelData->GetView().RightChop(sizeof(UNNERuntimeRDGMLExtensionsForVulkan::ModelDataGUID) + sizeof(UNNERuntimeRDGMLExtensionsForVulkan::ModelDataVersion));
+TFuture<TSharedPtr<FNNERuntimeRDGMLExtensionsForVulkanModelUnshaped>> FNNERuntimeRDGMLExtensionsForVulkanModelUnshaped::CreateAsync(const TSharedPtr<UE::NNE::FSharedModelData>& InModelData)
+{
+	return Async(EAsyncExecution::TaskGraph, [InModelData]() { return FindOrCreateInternal(InModelData); });
+}
 
-	// Parse VGF header which contains details of other sections in the file.
-	TArray<uint8_t> HeaderDecoderMemory;
-	HeaderDecoderMemory.AddUninitialized(mlsdk_decoder_header_decoder_mem_reqs());
-	mlsdk_decoder_header_decoder* HeaderDecoder = mlsdk_decoder_create_header_decoder(VgfBuffer.GetData(), HeaderDecoderMemory.GetData());
-	if (!mlsdk_decoder_is_header_valid(HeaderDecoder))
+namespace Private
+{
+
+// All the unshaped models that are currently alive, keyed by the hash of their model data. There can be more than one model per hash
+// in the (unlikely) event of a hash collision, as we compare the actual data before sharing a model. Weak pointers are used so that
+// the models are still freed once nothing is using them.
+struct FModelRegistry
+{
+	FCriticalSection CriticalSection;
+	TMap<uint64, TArray<TWeakPtr<FNNERuntimeRDGMLExtensionsForVulkanModelUnshaped>>> Models;
+	// Incremented whenever a model is added, so that a search made without the lock held can tell whether it's still up to date.
+	uint64 NumModelsAdded = 0;
+};
+
+FModelRegistry& GetModelRegistry()
+{
+	static FModelRegistry ModelRegistry;
+	return ModelRegistry;
+}
+
+}
+
+TSharedPtr<FNNERuntimeRDGMLExtensionsForVulkanModelUnshaped> FNNERuntimeRDGMLExtensionsForVulkanModelUnshaped::FindOrCreateInternal(const TSharedPtr<UE::NNE::FSharedModelData>& InModelData)
+{
+	const TConstArrayView64<uint8> ModelDataView = InModelData->GetView();
+	Private::FModelRegistry& ModelRegistry = Private::GetModelRegistry();
+
+	// A model that was created from this very model data (e.g. the same asset being used again) is found without hashing or
+	// comparing the data. There are only ever a handful of models, so it's fine to look through all of them.
 	{
-		UE_LOG(LogNNERuntimeRDGMLExtensionsForVulkan, Error, TEXT("Invalid VGF header."));
+		FScopeLock Lock(&ModelRegistry.CriticalSection);
+		for (const TPair<uint64, TArray<TWeakPtr<FNNERuntimeRDGMLExtensionsForVulkanModelUnshaped>>>& Entry : ModelRegistry.Models)
+		{
+			for (const TWeakPtr<FNNERuntimeRDGMLExtensionsForVulkanModelUnshaped>& Candidate : Entry.Value)
+			{
+				TSharedPtr<FNNERuntimeRDGMLExtensionsForVulkanModelUnshaped> Model = Candidate.Pin();
+				// Frozen models can't be shared, as they can't be given new shapes (and no longer have their model data).
+				if (Model.IsValid() && Model->SharedModelData.IsValid() && (Model->SharedModelData == InModelData ||
+					(Model->SharedModelData->GetView().GetData() == ModelDataView.GetData() && Model->SharedModelData->GetView().Num() == ModelDataView.Num())))
+				{
+					UE_LOG(LogNNERuntimeRDGMLExtensionsForVulkan, Verbose, TEXT("Reusing existing model for the same model data."));
+					return Model;
+				}
+			}
+		}
+	}
+
+	const FXxHash64 Hash = FXxHash64::HashBuffer(ModelDataView.GetData(), ModelDataView.Num());
+
+	// Returns an existing model with the same model data, if there is one, along with the registry's NumModelsAdded at the point it
+	// looked. The registry lock is only held to look the hash up, not to compare the data, as that can take a while (and reads in
+	// the whole file for memory-mapped model data) and would hold up every other model being created in the meantime.
+	auto FindExisting = [&](uint64& OutNumModelsAdded) -> TSharedPtr<FNNERuntimeRDGMLExtensionsForVulkanModelUnshaped> {
+		// The candidates' model data is referenced here, so that it stays alive whilst we compare it even if the model is frozen.
+		TArray<TPair<TSharedPtr<FNNERuntimeRDGMLExtensionsForVulkanModelUnshaped>, TSharedPtr<UE::NNE::FSharedModelData>>> Candidates;
+		{
+			FScopeLock Lock(&ModelRegistry.CriticalSection);
+			OutNumModelsAdded = ModelRegistry.NumModelsAdded;
+			TArray<TWeakPtr<FNNERuntimeRDGMLExtensionsForVulkanModelUnshaped>>* Registered = ModelRegistry.Models.Find(Hash.Hash);
+			if (Registered == nullptr)
+			{
+				return nullptr;
+			}
+			// Drop any models which have since been freed, so that entries don't build up.
+			Registered->RemoveAllSwap([](const TWeakPtr<FNNERuntimeRDGMLExtensionsForVulkanModelUnshaped>& Candidate) { return !Candidate.IsValid(); });
+			for (const TWeakPtr<FNNERuntimeRDGMLExtensionsForVulkanModelUnshaped>& Candidate : *Registered)
+			{
+				TSharedPtr<FNNERuntimeRDGMLExtensionsForVulkanModelUnshaped> Model = Candidate.Pin();
+				if (Model.IsValid() && Model->SharedModelData.IsValid())
+				{
+					Candidates.Emplace(Model, Model->SharedModelData);
+				}
+			}
+			if (Registered->IsEmpty())
+			{
+				ModelRegistry.Models.Remove(Hash.Hash);
+			}
+		}
+
+		for (const TPair<TSharedPtr<FNNERuntimeRDGMLExtensionsForVulkanModelUnshaped>, TSharedPtr<UE::NNE::FSharedModelData>>& Candidate : Candidates)
+		{
+			const TConstArrayView64<uint8> CandidateView = Candidate.Value->GetView();
+			if (CandidateView.Num() != ModelDataView.Num() ||
+				(CandidateView.GetData() != ModelDataView.GetData() && FMemory::Memcmp(CandidateView.GetData(), ModelDataView.GetData(), ModelDataView.Num()) != 0))
+			{
+				continue;
+			}
+			// It might have been frozen whilst we were comparing, in which case it can no longer be shared.
+			FScopeLock Lock(&ModelRegistry.CriticalSection);
+			if (Candidate.Key->SharedModelData.IsValid())
+			{
+				return Candidate.Key;
+			}
+		}
 		return nullptr;
+	};
+
+	uint64 NumModelsAdded = 0;
+	if (TSharedPtr<FNNERuntimeRDGMLExtensionsForVulkanModelUnshaped> Existing = FindExisting(NumModelsAdded))
+	{
+		UE_LOG(LogNNERuntimeRDGMLExtensionsForVulkan, Verbose, TEXT("Reusing existing model for identical model data."));
+		return Existing;
 	}
-	if (!mlsdk_decoder_is_header_compatible(HeaderDecoder))
+
+	// Create the model without holding the lock, as this can take a while and other models can be created in parallel.
+	TSharedPtr<FNNERuntimeRDGMLExtensionsForVulkanModelUnshaped> Model = CreateInternal(InModelData, Hash);
+	if (!Model.IsValid())
 	{
-		UE_LOG(LogNNERuntimeRDGMLExtensionsForVulkan, Error, TEXT("Incompatible VGF header."));
 		return nullptr;
 	}
 
-	// Create decoder objects for each section in the VGF that we care about:
-	//		Module Table: 
-	//			Each module is either a compute shader or a data graph.
-	//			The order of these is arbitrary and there is a further information in the VGF that describes how to run these.
-	//		Model Resource Table:
-	//			This is a list of tensor descriptions (data formats, size etc.) which is indexed
-	//			into by other fields in the VGF.
-	//		Model Sequence:
-	//			This defines the order that the modules should be executed in as well as their inputs and outputs.
-	//		Constant table:
-	//			Contains the raw constant data for all constant tensors used in the model.
-	mlsdk_decoder_vgf_section_info SectionInfos[4];
-	for (mlsdk_decoder_section SectionType = mlsdk_decoder_section_modules; SectionType <= mlsdk_decoder_section_constants;
-		SectionType = mlsdk_decoder_section(SectionType + 1))
-	{
-		mlsdk_decoder_get_header_section_info(HeaderDecoder, SectionType, &SectionInfos[SectionType]);
-		if (SectionInfos[SectionType].offset + SectionInfos[SectionType].size > VgfBuffer.Num())
+	// Another thread might have created a model for the same data in the meantime, in which case we use that one so that there
+	// is still only one of them (ours is thrown away). Ours is only added if no other model has been added since we last looked.
+	while (true)
+	{
+		if (TSharedPtr<FNNERuntimeRDGMLExtensionsForVulkanModelUnshaped> Existing = FindExisting(NumModelsAdded))
 		{
-			UE_LOG(LogNNERuntimeRDGMLExtensionsForVulkan, Error, TEXT("Corrupt VGF header (section out of bounds)."));
-			return nullptr;
+			return Existing;
+		}
+		FScopeLock Lock(&ModelRegistry.CriticalSection);
+		if (ModelRegistry.NumModelsAdded == NumModelsAdded)
+		{
+			ModelRegistry.Models.FindOrAdd(Hash.Hash).Add(Model);
+			++ModelRegistry.NumModelsAdded;
+			return Model;
 		}
 	}
-	TArray<uint8_t> ModuleTableDecoderMemory;
-	TArray<uint8_t> ModelResourceTableDecoderMemory;
-	TArray<uint8_t> ModelSequenceDecoderMemory;
-	TArray<uint8_t> ConstantTableDecoderMemory;
-	ModuleTableDecoderMemory.AddUninitialized(mlsdk_decoder_module_table_decoder_mem_reqs());
-	ModelResourceTableDecoderMemory.AddUninitialized(mlsdk_decoder_model_resource_table_decoder_mem_reqs());
-	ModelSequenceDecoderMemory.AddUninitialized(mlsdk_decoder_model_sequence_decoder_mem_reqs());
-	ConstantTableDecoderMemory.AddUninitialized(mlsdk_decoder_constant_table_decoder_mem_reqs());
-	mlsdk_decoder_module_table_decoder* ModuleTableDecoder =
-		mlsdk_decoder_create_module_table_decoder(VgfBuffer.GetData() + SectionInfos[mlsdk_decoder_section_modules].offset, ModuleTableDecoderMemory.GetData());
-	mlsdk_decoder_model_resource_table_decoder* ModelResourceTableDecoder =
-		mlsdk_decoder_create_model_resource_table_decoder(VgfBuffer.GetData() + SectionInfos[mlsdk_decoder_section_resources].offset, ModelResourceTableDecoderMemory.GetData());
-	mlsdk_decoder_model_sequence_decoder* ModelSequenceDecoder =
-		mlsdk_decoder_create_model_sequence_decoder(VgfBuffer.GetData() + SectionInfos[mlsdk_decoder_section_model_sequence].offset, ModelSequenceDecoderMemory.GetData());
-	mlsdk_decoder_constant_table_decoder* ConstantTableDecoder =
-		mlsdk_decoder_create_constant_table_decoder(VgfBuffer.GetData() + SectionInfos[mlsdk_decoder_section_constants].offset, ConstantTableDecoderMemory.GetData());
-
-	// Create FTensorShapes, VkTensorDescriptionARM etc. for each resource in the model resource table. We will look these up later.
-	// Note that some data in this struct might be missing, depending on the resource. For example not all tensors will have a concrete shape.
-	struct FResourceDesc
-	{
-		ENNETensorDataType NNEDataType = ENNETensorDataType::None;
+}
+
+TSharedPtr<FNNERuntimeRDGMLExtensionsForVulkanModelUnshaped> FNNERuntimeRDGMLExtensionsForVulkanModelUnshaped::CreateInternal(const TSharedPtr<UE::NNE::FSharedModelData>& InModelData,
+	const FXxHash64& InModelDataHash)
+{
+	// Vulkan object creation is externally synchronized per object, so we can create the objects for this model directly on
+	// this thread rather than waiting for a round trip through the rendering and RHI threads.
+	VkDevice Device = GetIVulkanDynamicRHI()->RHIGetVkDevice();
+	const VkAllocationCallbacks* Allocator = GetIVulkanDynamicRHI()->RHIGetVkAllocationCallbacks();
+
+	TSharedPtr<FNNERuntimeRDGMLExtensionsForVulkanModelUnshaped> Result(new FNNERuntimeRDGMLExtensionsForVulkanModelUnshaped());
+	Result->SharedModelData = InModelData; // Keep a reference to this alive, as we'll use it when creating shaped models later.
+	Result->ModelDataHash = InModelDataHash;
+
+	const UNNERuntimeRDGMLExtensionsForVulkanSettings* Settings = GetDefault<UNNERuntimeRDGMLExtensionsForVulkanSettings>();
+	Result->MaxRecentlyUsedShapedModels = FMath::Max(0, Settings->MaxRetainedShapedModels);
+	Result->RecentlyUsedShapedModelsMemoryBudget = (uint64)FMath::Max(0, Settings->RetainedShapedModelsMemoryBudgetMB) * 1024 * 1024;
+
+	// Skip past the GUID and version (which have already been validated by UNNERuntimeRDGMLExtensionsForVulkan::CreateModelRDG) to get to the
+	// payload, which is the VGF already decoded into tables (see FNNERuntimeRDGMLExtensionsForVulkanModelFormat) when the model was imported/cooked.
+	using FModelFormat = FNNERuntimeRDGMLExtensionsForVulkanModelFormat;
+	const FModelFormat::FHeader* Header = FModelFormat::Validate(InModelData->GetView().RightChop(UNNERuntimeRDGMLExtensionsForVulkan::ModelDataPayloadOffset));
+	if (Header == nullptr)
+	{
+		return nullptr; // Error already logged by Validate.
+	}
+	Result->ModelFormatHeader = Header;
+	const TConstArrayView64<uint8> Vgf = FModelFormat::GetVgf(Header);
+
+	// If the constants are compressed, decompress them on worker threads while we get on with creating the Vulkan objects below.
+	// The buffer is allocated up-front, so we already know where the constants will be.
+	const uint8* ConstantData = Vgf.GetData();
+	UE::Tasks::TTask<bool> DecompressConstantsTask = UE::Tasks::MakeCompletedTask<bool>(true);
+	if (Header->ConstantChunks.Num > 0)
+	{
+		const uint64 DecompressedConstantsSize = FModelFormat::GetDecompressedConstantsSize(Header);
+		FUniqueBuffer DecompressedConstantsBuffer = FUniqueBuffer::TakeOwnership(FMemory::Malloc(DecompressedConstantsSize, FModelFormat::CONSTANT_ALIGNMENT),
+			DecompressedConstantsSize, [](void* Data) { FMemory::Free(Data); });
+		uint8* DecompressedConstants = static_cast<uint8*>(DecompressedConstantsBuffer.GetData());
+		ConstantData = DecompressedConstants;
+		// Shared, as the upload of the shared constants (see below) can outlive Freeze.
+		Result->DecompressedConstants = DecompressedConstantsBuffer.MoveToShared();
+		DecompressConstantsTask = UE::Tasks::Launch(UE_SOURCE_LOCATION, [Header, DecompressedConstants]() {
+			const int32 NumChunks = (int32)Header->ConstantChunks.Num;
+			TAtomic<bool> bSucceeded = true;
+			ParallelFor(NumChunks, [&](int32 ChunkIdx) {
+				if (!FModelFormat::DecompressConstantChunk(Header, ChunkIdx, DecompressedConstants))
+				{
+					bSucceeded = false;
+				}
+			});
+			return (bool)bSucceeded;
+		});
+	}
+
+	const TConstArrayView<int64> Dimensions = FModelFormat::GetTable<int64>(Header, Header->Dimensions);
+	auto GetDimensions = [&Dimensions](uint32 FirstDimension, uint32 NumDimensions) { return Dimensions.Slice(FirstDimension, NumDimensions); };
+	auto MakeTensorDescription = [](int32 Format, uint32 NumDimensions) {
 		VkTensorDescriptionARM TensorDescription = {};
-		TArray<int64_t> TensorShapeRawS64; // Storage for the pointer in VkTensorDescriptionARM.
-		UE::NNE::FSymbolicTensorShape SymbolicTensorShape;
-		// Lookup from the index in the VGF model resource table to our renumbered IDs.
-		// Not all resources have a TensorId though, so this can be -1 (e.g. for constants).
-		int32 TensorId = -1;
+		TensorDescription.sType = VK_STRUCTURE_TYPE_TENSOR_DESCRIPTION_ARM;
+		TensorDescription.tiling = VK_TENSOR_TILING_LINEAR_ARM;
+		TensorDescription.usage = VK_TENSOR_USAGE_DATA_GRAPH_BIT_ARM;
+		TensorDescription.format = static_cast<VkFormat>(Format);
+		TensorDescription.dimensionCount = NumDimensions;
+		return TensorDescription;
 	};
-	const size_t NumModelResourceTableEntries = mlsdk_decoder_get_model_resource_table_num_entries(ModelResourceTableDecoder);
-	TArray<FResourceDesc> ResourceDescs;
-	ResourceDescs.Reserve(NumModelResourceTableEntries);
-	for (int ResourceIdx = 0; ResourceIdx < NumModelResourceTableEntries; ++ResourceIdx)
+
+	// Input, output and intermediate tensors, which we need to store info about outside of this creation function,
+	// so that we can allocate intermediates and match up inputs/outputs at inference time.
+	const TConstArrayView<FModelFormat::FTensor> Tensors = FModelFormat::GetTable<FModelFormat::FTensor>(Header, Header->Tensors);
+	Result->TensorInfosUnshaped.Reserve(Tensors.Num());
+	for (const FModelFormat::FTensor& Tensor : Tensors)
 	{
-		FResourceDesc ResourceDesc = {};
+		FTensorInfoUnshaped& Info = Result->TensorInfosUnshaped.AddDefaulted_GetRef();
+		Info.ModelInputIdx = Tensor.ModelInputIdx;
+		Info.ModelOutputIdx = Tensor.ModelOutputIdx;
+		// As the shape may have unspecified dimensions (e.g. -1) at this point, we don't store it (pDimensions is null). It will be inferred through shape inference later.
+		Info.VulkanDesc = MakeTensorDescription(Tensor.Format, Tensor.NumDimensions);
+		if (Tensor.SharedConstantIdx != -1)
+		{
+			Info.bSharedConstant = true;
+			Algo::Transform(GetDimensions(Tensor.FirstDimension, Tensor.NumDimensions), Info.SharedConstantShape, [](int64 X) { return (int64_t)X; });
+		}
+	}
 
-		mlsdk_vk_format VKFormat = mlsdk_decoder_get_vk_format(ModelResourceTableDecoder, ResourceIdx);
-		ResourceDesc.NNEDataType = Private::VKFormatToNNETensorDataType(VKFormat);
+	// Model inputs and outputs.
+	auto ProcessModelEndpoints = [&](const char* NamePrefix, TConstArrayView<uint32> TensorIds, TArray<UE::NNE::FTensorDesc>& OutTensorDescs)
+		{
+			for (int Idx = 0; Idx < TensorIds.Num(); ++Idx)
+			{
+				const FModelFormat::FTensor& Tensor = Tensors[TensorIds[Idx]];
+				TArray<int32> DimsS32;
+				Algo::Transform(GetDimensions(Tensor.FirstDimension, Tensor.NumDimensions), DimsS32, [](int64 X) { return (int32)X; });
+				const UE::NNE::FSymbolicTensorShape SymbolicShape = UE::NNE::FSymbolicTensorShape::Make(DimsS32);
+				OutTensorDescs.Add(UE::NNE::FTensorDesc::Make(NamePrefix + FString::FromInt(Idx), SymbolicShape, Private::VKFormatToNNETensorDataType(static_cast<VkFormat>(Tensor.Format))));
+			}
+		};
+	ProcessModelEndpoints("Input", FModelFormat::GetTable<uint32>(Header, Header->ModelInputs), Result->InputSymbolicTensors);
+	ProcessModelEndpoints("Output", FModelFormat::GetTable<uint32>(Header, Header->ModelOutputs), Result->OutputSymbolicTensors);
+
+	// Loop over the segments (the VGF's model sequence table), which describe which modules to run in what order
+	// and what inputs/outputs they should have. This order handles any dependencies between modules.
+	// Create and store the Vulkan pipelines etc. that will be needed to run each segment (but only ones that can be shared between instances)
+	const TConstArrayView<FModelFormat::FBinding> Bindings = FModelFormat::GetTable<FModelFormat::FBinding>(Header, Header->Bindings);
+	const TConstArrayView<FModelFormat::FConstant> Constants = FModelFormat::GetTable<FModelFormat::FConstant>(Header, Header->Constants);
+	for (const FModelFormat::FSegment& SegmentDesc : FModelFormat::GetTable<FModelFormat::FSegment>(Header, Header->Segments))
+	{
+		FSegmentUnshaped Segment = {};
 
-		ResourceDesc.TensorDescription.sType = VK_STRUCTURE_TYPE_TENSOR_DESCRIPTION_ARM;
-		ResourceDesc.TensorDescription.tiling = VK_TENSOR_TILING_LINEAR_ARM;
-		ResourceDesc.TensorDescription.usage = VK_TENSOR_USAGE_DATA_GRAPH_BIT_ARM;
-		ResourceDesc.TensorDescription.format = static_cast<VkFormat>(VKFormat);
+		Segment.Name = reinterpret_cast<const char*>(Vgf.GetData() + SegmentDesc.NameOffset);
+		UE_LOG(LogNNERuntimeRDGMLExtensionsForVulkan, Verbose, TEXT("Creating segment %s"), *Segment.Name);
 
-		mlsdk_decoder_tensor_dimensions DimsRaw;
-		mlsdk_decoder_model_resource_table_get_tensor_shape(ModelResourceTableDecoder, ResourceIdx, &DimsRaw);
+		Segment.ModuleIndex = SegmentDesc.ModuleIndex;
+
+		// Graph pipeline bindings for inputs and outputs of this segment.
+		TArray<VkDescriptorSetLayoutBinding> DescriptorSetLayoutBindings;
+		DescriptorSetLayoutBindings.Reserve(SegmentDesc.NumBindings);
+		Segment.Bindings.Reserve(SegmentDesc.NumBindings);
+		for (const FModelFormat::FBinding& BindingDesc : Bindings.Slice(SegmentDesc.FirstBinding, SegmentDesc.NumBindings))
+		{
+			VkDescriptorSetLayoutBinding LayoutBinding = {};
+			LayoutBinding.binding = BindingDesc.VulkanBindingIdx;
+			LayoutBinding.descriptorCount = 1;
+			LayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_TENSOR_ARM;
+			LayoutBinding.stageFlags = VK_SHADER_STAGE_ALL;
+			DescriptorSetLayoutBindings.Add(LayoutBinding);
+
+			FSegmentUnshaped::FBinding OurBinding = {};
+			OurBinding.BindingKind = BindingDesc.bIsOutput ? FSegmentUnshaped::FBinding::EBindingKind::Output : FSegmentUnshaped::FBinding::EBindingKind::Input;
+			OurBinding.VulkanBindingIdx = BindingDesc.VulkanBindingIdx;
+			OurBinding.TensorId = BindingDesc.TensorId;
+			Segment.Bindings.Add(OurBinding);
+		}
 
-		ResourceDesc.TensorShapeRawS64.Reserve(DimsRaw.size);
-		TArray<int32_t> DimsS32;
-		DimsS32.Reserve(DimsRaw.size);
-		for (int I = 0; I < DimsRaw.size; ++I)
+		// Constants for this segment.
+		const TConstArrayView<FModelFormat::FConstant> SegmentConstants = Constants.Slice(SegmentDesc.FirstConstant, SegmentDesc.NumConstants);
+		Segment.ConstantInfos.Reserve(SegmentConstants.Num());
+		Segment.ConstantIndexes.Reserve(SegmentConstants.Num());
+		for (int ConstantIdxWithinSegment = 0; ConstantIdxWithinSegment < SegmentConstants.Num(); ++ConstantIdxWithinSegment)
 		{
-			int64_t x = DimsRaw.data[I];
-			if (x <= 0)
+			const FModelFormat::FConstant& ConstantDesc = SegmentConstants[ConstantIdxWithinSegment];
+
+			Segment.ConstantIndexes.Add(ConstantDesc.ConstantIndex);
+			if (ConstantDesc.SharedTensorId != -1)
 			{
-				// Negative values indicate that this dimension isn't specified in the model, and will need to determined
-				// by shape inference which can be done once the user calls SetInputTensorShapes to set concrete shapes.
-				x = -1; // Normalize any unspecified dimension to -1, for consistency with NNE tensor shape types.
+				continue; // Bound as an input instead (see SharedConstantsPooledBuffer).
 			}
-			ResourceDesc.TensorShapeRawS64.Push(x);
-			DimsS32.Push(int32_t(x));
+			FSegmentUnshaped::FConstantInfo& ConstantInfo = Segment.ConstantInfos.AddZeroed_GetRef();
+
+			ConstantInfo.TensorDescription = MakeTensorDescription(ConstantDesc.Format, ConstantDesc.NumDimensions);
+			Algo::Transform(GetDimensions(ConstantDesc.FirstDimension, ConstantDesc.NumDimensions), ConstantInfo.TensorDimensions, [](int64 X) { return (int64_t)X; });
+			// Important to update the pointer in TensorDescription.pDimensions to a copy of the data which will live alongside it.
+			ConstantInfo.TensorDescription.pDimensions = ConstantInfo.TensorDimensions.GetData();
+
+			ConstantInfo.DataGraphPipelineConstant.sType = VK_STRUCTURE_TYPE_DATA_GRAPH_PIPELINE_CONSTANT_ARM;
+			ConstantInfo.DataGraphPipelineConstant.id = ConstantIdxWithinSegment;
+			ConstantInfo.DataGraphPipelineConstant.pNext = &ConstantInfo.TensorDescription;
+			ConstantInfo.DataGraphPipelineConstant.pConstantData = ConstantData + ConstantDesc.DataOffset;
 		}
 
-		ResourceDesc.SymbolicTensorShape = UE::NNE::FSymbolicTensorShape::Make(DimsS32);
+		Segment.SPIRVCode = FModelFormat::GetSegmentCode(Header, SegmentDesc);
+		Segment.SPIRVEntryPoint = reinterpret_cast<const char*>(Vgf.GetData() + SegmentDesc.EntryPointOffset);
+
+		// Descriptor set layout.
+		VkDescriptorSetLayoutCreateInfo GraphDescriptorSetLayoutCreateInfo = {};
+		GraphDescriptorSetLayoutCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+		GraphDescriptorSetLayoutCreateInfo.bindingCount = DescriptorSetLayoutBindings.Num();
+		GraphDescriptorSetLayoutCreateInfo.pBindings = DescriptorSetLayoutBindings.GetData();
+		VERIFYVULKANRESULT(vkCreateDescriptorSetLayout_p(Device, &GraphDescriptorSetLayoutCreateInfo, Allocator, &Segment.DescriptorSetLayout));
 
-		ResourceDesc.TensorDescription.dimensionCount = DimsRaw.size;
-		ResourceDesc.TensorDescription.pDimensions = ResourceDesc.TensorShapeRawS64.GetData();
+		// Graph pipeline layout.
+		VkPipelineLayoutCreateInfo PipelineLayoutCreateInfo = {};
+		PipelineLayoutCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+		PipelineLayoutCreateInfo.setLayoutCount = 1;
+		PipelineLayoutCreateInfo.pSetLayouts = &Segment.DescriptorSetLayout;
+		VERIFYVULKANRESULT(vkCreatePipelineLayout_p(Device, &PipelineLayoutCreateInfo, Allocator, &Segment.PipelineLayout));
 
-		mlsdk_decoder_tensor_dimensions StridesRaw;
-		mlsdk_decoder_model_resource_table_get_tensor_strides(ModelResourceTableDecoder, ResourceIdx, &StridesRaw);
-		if (StridesRaw.size > 0)
+		Result->SegmentsUnshaped.Add(MoveTemp(Segment));
+	}
+
+	if (!DecompressConstantsTask.GetResult())
+	{
+		UE_LOG(LogNNERuntimeRDGMLExtensionsForVulkan, Error, TEXT("Failed to decompress model constants (corrupt model data)."));
+		return nullptr;
+	}
+
+	// Lay out the constants which were turned into inputs in a single buffer, meeting the memory requirements of the tensors which
+	// each inference binds to them.
+	struct FSharedConstantUpload
+	{
+		const uint8* Data;
+		uint64 Size;
+		uint64 Offset;
+	};
+	TArray<FSharedConstantUpload> SharedConstantUploads;
+	uint64 SharedConstantsSize = 0;
+	for (int32 TensorId = 0; TensorId < Tensors.Num(); ++TensorId)
+	{
+		FTensorInfoUnshaped& Info = Result->TensorInfosUnshaped[TensorId];
+		if (!Info.bSharedConstant)
 		{
-			UE_LOG(LogNNERuntimeRDGMLExtensionsForVulkan, Error, TEXT("Strides not supported."));
-			return nullptr;
+			continue;
 		}
 
-		mlsdk_decoder_mrt_category Category = mlsdk_decoder_model_resource_table_get_category(ModelResourceTableDecoder, ResourceIdx);
-		if (Category == mlsdk_decoder_mrt_category::mlsdk_decoder_mrt_category_input ||
-			Category == mlsdk_decoder_mrt_category::mlsdk_decoder_mrt_category_output ||
-			Category == mlsdk_decoder_mrt_category::mlsdk_decoder_mrt_category_intermediate)
+		VkTensorDescriptionARM TensorDescription = Info.VulkanDesc;
+		TensorDescription.pDimensions = Info.SharedConstantShape.GetData();
+		VkTensorCreateInfoARM TensorCreateInfo = {};
+		TensorCreateInfo.sType = VK_STRUCTURE_TYPE_TENSOR_CREATE_INFO_ARM;
+		TensorCreateInfo.pDescription = &TensorDescription;
+		VkTensorARM Tensor;
+		VERIFYVULKANRESULT(vkCreateTensorARM_p(Device, &TensorCreateInfo, Allocator, &Tensor));
+		VkTensorMemoryRequirementsInfoARM MemoryRequirementsInfo = {};
+		MemoryRequirementsInfo.sType = VK_STRUCTURE_TYPE_TENSOR_MEMORY_REQUIREMENTS_INFO_ARM;
+		MemoryRequirementsInfo.tensor = Tensor;
+		VkMemoryRequirements2 MemoryRequirements = {};
+		MemoryRequirements.sType = VK_STRUCTURE_TYPE_MEMORY_REQUIREMENTS_2;
+		vkGetTensorMemoryRequirementsARM_p(Device, &MemoryRequirementsInfo, &MemoryRequirements);
+		vkDestroyTensorARM_p(Device, Tensor, Allocator);
+
+		const FModelFormat::FConstant& Constant = Constants[Tensors[TensorId].SharedConstantIdx];
+		Info.SharedConstantOffset = Align(SharedConstantsSize, FMath::Max<uint64>(MemoryRequirements.memoryRequirements.alignment, 1));
+		SharedConstantsSize = Info.SharedConstantOffset + FMath::Max<uint64>(MemoryRequirements.memoryRequirements.size, Constant.DataSize);
+		SharedConstantUploads.Add({ ConstantData + Constant.DataOffset, Constant.DataSize, Info.SharedConstantOffset });
+	}
+	// RHI buffers are sized with 32 bits, so check that the shared constants fit before the size is narrowed below.
+	if (SharedConstantsSize > MAX_uint32)
+	{
+		UE_LOG(LogNNERuntimeRDGMLExtensionsForVulkan, Error, TEXT("Model's shared constants need %llu bytes, which is more than the largest supported buffer (%u bytes). Cook the model with a higher SharedConstantMinSizeKB."),
+			SharedConstantsSize, MAX_uint32);
+		return nullptr;
+	}
+
+	// The buffer has to be created through the RHI on the rendering thread. Nothing can use this model until after we return, so this
+	// command is always executed before any inferences are enqueued. It holds its own references to the constant data, so that it's
+	// still valid even if the model is frozen (see Freeze) before the command runs.
+	if (SharedConstantsSize > 0)
+	{
+		ENQUEUE_RENDER_COMMAND(NNERuntimeRDGMLExtensionsForVulkanModel_UploadSharedConstants)([Result, InModelData, DecompressedConstants = Result->DecompressedConstants,
+			SharedConstantUploads = MoveTemp(SharedConstantUploads), SharedConstantsSize](FRHICommandListImmediate& RHICmdList) {
+			const FRHIBufferDesc BufferDesc = FRHIBufferDesc((uint32)SharedConstantsSize, 0, EBufferUsageFlags::Static | EBufferUsageFlags::ShaderResource | EBufferUsageFlags::ByteAddressBuffer);
+			FRHIResourceCreateInfo CreateInfo(TEXT("FNNERuntimeRDGMLExtensionsForVulkanModelUnshaped_SharedConstants"));
+			FBufferRHIRef Buffer = GetIVulkanDynamicRHI()->RHICreateBuffer(RHICmdList, BufferDesc, ERHIAccess::SRVCompute, CreateInfo);
+			uint8* BufferData = static_cast<uint8*>(RHICmdList.LockBuffer(Buffer, 0, (uint32)SharedConstantsSize, RLM_WriteOnly));
+			for (const FSharedConstantUpload& Upload : SharedConstantUploads)
+			{
+				FMemory::Memcpy(BufferData + Upload.Offset, Upload.Data, Upload.Size);
+			}
+			RHICmdList.UnlockBuffer(Buffer);
+
+			Result->SharedConstantsPooledBuffer = new FRDGPooledBuffer(Buffer, FRDGBufferDesc::CreateByteAddressDesc((uint32)SharedConstantsSize), 0,
+				TEXT("FNNERuntimeRDGMLExtensionsForVulkanModelUnshaped_SharedConstants"));
+		});
+	}
+
+	return Result;
+}
+
+FNNERuntimeRDGMLExtensionsForVulkanModelUnshaped::FNNERuntimeRDGMLExtensionsForVulkanModelUnshaped()
+{
+	// All initialisation logic is in the static Create function (above).
+}
+
+FNNERuntimeRDGMLExtensionsForVulkanModelUnshaped::~FNNERuntimeRDGMLExtensionsForVulkanModelUnshaped()
+{
+	// By the time the last reference to the unshaped model is dropped, all shaped models and instances using these objects
+	// have been retired, so there is no fence to wait for.
+	TArray<VkPipelineLayout> PipelineLayouts;
+	TArray<VkDescriptorSetLayout> DescriptorSetLayouts;
+	for (FSegmentUnshaped& S : SegmentsUnshaped)
+	{
+		PipelineLayouts.Add(S.PipelineLayout);
+		DescriptorSetLayouts.Add(S.DescriptorSetLayout);
+	}
+	if (PipelineLayouts.IsEmpty())
+	{
+		return; // The model was never fully created (e.g. it failed, or it was made by a test), so there's nothing to destroy.
+	}
+
+	FNNERuntimeRDGMLExtensionsForVulkanDeferredDeletionQueue::Get().Enqueue([PipelineLayouts = MoveTemp(PipelineLayouts), DescriptorSetLayouts = MoveTemp(DescriptorSetLayouts)](VkDevice Device, const VkAllocationCallbacks* Allocator) {
+		for (VkPipelineLayout PipelineLayout : PipelineLayouts)
+		{
+			vkDestroyPipelineLayout_p(Device, PipelineLayout, Allocator);
+		}
+		for (VkDescriptorSetLayout DescriptorSetLayout : DescriptorSetLayouts)
 		{
-			// We need to store info about these types of buffers outside of this creation function,
-			// so that we can allocate intermediates and match up inputs/outputs at inference time.
-			FTensorInfoUnshaped Info = {};
-			Info.VulkanDesc = ResourceDesc.TensorDescription;
-			Info.VulkanDesc.pDimensions = nullptr; // As the shape may have unspecified dimensions (e.g. -1) at this point, don't bother to store it. It will be inferred through shape inference later.
-			// The ModelInput/OutputIdx fields will be filled in later.
-
-			// Assign this tensor the next (consecutive) ID.
-			uint32 TensorId = Result->TensorInfosUnshaped.Num();
-			Result->TensorInfosUnshaped.Add(MoveTemp(Info)); // Move is important here, so that the pDimensions pointer remains valid.
-			ResourceDesc.TensorId = TensorId; // So that we can lookup from resource idx to TensorId later.
+			vkDestroyDescriptorSetLayout_p(Device, DescriptorSetLayout, Allocator);
 		}
+	});
+}
+
+TSharedPtr<UE::NNE::IModelInstanceRDG> FNNERuntimeRDGMLExtensionsForVulkanModelUnshaped::CreateModelInstanceRDG()
+{
+	return CreateModelInstanceRDGAsync().Get();
+}
+
+TFuture<TSharedPtr<INNERuntimeRDGMLExtensionsForVulkanModelInstance>> FNNERuntimeRDGMLExtensionsForVulkanModelUnshaped::CreateModelInstanceRDGAsync()
+{
+	return Async(EAsyncExecution::TaskGraph, [This = this->AsShared()]() -> TSharedPtr<INNERuntimeRDGMLExtensionsForVulkanModelInstance> { return This->CreateModelInstance(); });
+}
 
-		ResourceDescs.Add(MoveTemp(ResourceDesc)); // Move is important here, so that the pDimensions pointer remains valid.
+TSharedPtr<FNNERuntimeRDGMLExtensionsForVulkanModelInstance> FNNERuntimeRDGMLExtensionsForVulkanModelUnshaped::CreateModelInstance()
+{
+	// We can't initialize very much of the model instance yet, because we don't know the concrete tensor shapes 
+	// until SetInputTensorShapes is called.
+	TSharedPtr<FNNERuntimeRDGMLExtensionsForVulkanModelInstance> Result(new FNNERuntimeRDGMLExtensionsForVulkanModelInstance());
+	Result->ParentModelUnshaped = this->AsShared();
+
+	// Create vulkan resources for this instance, using the common resources from the parent model.
+	VkDevice Device = GetIVulkanDynamicRHI()->RHIGetVkDevice();
+	const VkAllocationCallbacks* Allocator = GetIVulkanDynamicRHI()->RHIGetVkAllocationCallbacks();
+
+	uint32 NumDescriptors = 0;
+	for (FSegmentUnshaped& Segment : SegmentsUnshaped)
+	{
+		// Sum up the total number of descriptors that we will need for all segments.
+		NumDescriptors += Segment.Bindings.Num();
 	}
 
-	// Check which tensors are model inputs/output and update the TensorInfos for these.
-	auto ProcessModelEndpoints = [&](const char* NamePrefix, mlsdk_decoder_binding_slots_handle Bindings,
-		TArray<UE::NNE::FTensorDesc>& OutTensorDescs, int32 FTensorInfoUnshaped::* PointerToTensorInfoInputOrOutputIdx)
+	// Create descriptor pool to use for this instance. We could create one of these in the parent model, but then we wouldn't know
+	// how big the pool should be as we don't know how many instances will be created.
+	VkDescriptorPoolCreateInfo DescriptorPoolCreateInfo = {};
+	DescriptorPoolCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	DescriptorPoolCreateInfo.maxSets = SegmentsUnshaped.Num() * MAX_CONCURRENT_EXECUTIONS_PER_INSTANCE;
+	DescriptorPoolCreateInfo.poolSizeCount = 1;
+	DescriptorPoolCreateInfo.flags = VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT;
+	VkDescriptorPoolSize PoolSize = {};
+	PoolSize.type = VK_DESCRIPTOR_TYPE_TENSOR_ARM;
+	PoolSize.descriptorCount = NumDescriptors * MAX_CONCURRENT_EXECUTIONS_PER_INSTANCE;
+	DescriptorPoolCreateInfo.pPoolSizes = &PoolSize;
+	VERIFYVULKANRESULT(vkCreateDescriptorPool_p(Device, &DescriptorPoolCreateInfo, Allocator, &Result->DescriptorPool));
+
+	return Result;
+}
+
+TFuture<bool> FNNERuntimeRDGMLExtensionsForVulkanModelUnshaped::PrewarmShapesAsync(TArray<TArray<UE::NNE::FTensorShape>> InputShapeSets, bool bWarmUpDispatch)
+{
+	// One task per set of shapes, so that shape inference (and the pipeline compilation that this kicks off) for all of them runs in parallel.
+	TSharedRef<TArray<TSharedPtr<FNNERuntimeRDGMLExtensionsForVulkanModelShaped>>> ShapedModels = MakeShared<TArray<TSharedPtr<FNNERuntimeRDGMLExtensionsForVulkanModelShaped>>>();
+	ShapedModels->AddDefaulted(InputShapeSets.Num());
+	TArray<UE::Tasks::FTask> Tasks;
+	for (int32 I = 0; I < InputShapeSets.Num(); ++I)
+	{
+		Tasks.Add(UE::Tasks::Launch(UE_SOURCE_LOCATION, [This = this->AsShared(), ShapedModels, InputShapes = MoveTemp(InputShapeSets[I]), I]() {
+			(*ShapedModels)[I] = This->FindOrCreateShapedModel(InputShapes);
+		}));
+	}
+
+	TSharedRef<TPromise<bool>> Promise = MakeShared<TPromise<bool>>();
+	TFuture<bool> Result = Promise->GetFuture();
+	UE::Tasks::Launch(UE_SOURCE_LOCATION, [This = this->AsShared(), ShapedModels, Promise, bWarmUpDispatch]() {
+		bool bSuccess = true;
+		for (const TSharedPtr<FNNERuntimeRDGMLExtensionsForVulkanModelShaped>& ShapedModel : *ShapedModels)
 		{
-			const size_t NumBindings = mlsdk_decoder_binding_slot_size(ModelSequenceDecoder, Bindings);
-			OutTensorDescs.AddZeroed(NumBindings);
-			for (int Idx = 0; Idx < NumBindings; ++Idx)
+			if (!ShapedModel.IsValid())
 			{
-				uint32_t ResourceIndex = mlsdk_decoder_binding_slot_mrt_index(ModelSequenceDecoder, Bindings, Idx);
-				if (ResourceIndex >= NumModelResourceTableEntries)
-				{
-					UE_LOG(LogNNERuntimeRDGMLExtensionsForVulkan, Error, TEXT("Corrupt VGF (resource index out of bounds)."));
-					return false;
-				}
+				// Error will already have been logged.
+				bSuccess = false;
+				continue;
+			}
 
-				// Which model input/output this is (presumably the order of inputs/outputs in the VGF is not guaranteed to match the model input/output order)
-				uint32 ModelIdx = Idx;
+			{
+				FScopeLock Lock(&This->ShapedModelsCriticalSection);
+				This->PrewarmedShapedModels.AddUnique(ShapedModel);
+			}
 
-				const UE::NNE::FSymbolicTensorShape SymbolicShape = ResourceDescs[ResourceIndex].SymbolicTensorShape;
-				const UE::NNE::FTensorDesc TensorDesc = UE::NNE::FTensorDesc::Make(NamePrefix + FString::FromInt(Idx), SymbolicShape, ResourceDescs[ResourceIndex].NNEDataType);
+			if (bWarmUpDispatch)
+			{
+				// A throwaway model instance, which is destroyed once its dispatch has been enqueued.
+				TSharedPtr<FNNERuntimeRDGMLExtensionsForVulkanModelInstance> Instance = This->CreateModelInstance();
+				Instance->SetInputTensorShapesAsync(ShapedModel->InputTensorShapes).Then([Instance](TFuture<FNNERuntimeRDGMLExtensionsForVulkanModelInstance::EShapesRequestStatus> Status) {
+					if (Status.Get() == FNNERuntimeRDGMLExtensionsForVulkanModelInstance::EShapesRequestStatus::Applied)
+					{
+						ENQUEUE_RENDER_COMMAND(NNERuntimeRDGMLExtensionsForVulkanModel_WarmUpDispatch)([Instance](FRHICommandListImmediate& RHICmdList) {
+							Instance->EnqueueWarmUpDispatch_RenderThread(RHICmdList);
+						});
+					}
+				});
+			}
+		}
+		Promise->SetValue(bSuccess);
+	}, UE::Tasks::Prerequisites(Tasks));
 
-				OutTensorDescs[ModelIdx] = TensorDesc;
+	return Result;
+}
 
-				int32 TensorId = ResourceDescs[ResourceIndex].TensorId;
-				if (TensorId == -1)
-				{
-					UE_LOG(LogNNERuntimeRDGMLExtensionsForVulkan, Error, TEXT("Invalid VGF (model input or output has incorrect resource type)."));
-					return false;
-				}
-				Result->TensorInfosUnshaped[TensorId].*PointerToTensorInfoInputOrOutputIdx = ModelIdx;
+void FNNERuntimeRDGMLExtensionsForVulkanModelUnshaped::Freeze()
+{
+	// Stop any new shaped models being started, and wait for the ones that are already being created (and then for any optimized
+	// pipelines that they or earlier shaped models are still compiling), as these all read from the model data.
+	TArray<TFuture<TSharedPtr<FNNERuntimeRDGMLExtensionsForVulkanModelShaped>>> PendingFutures;
+	{
+		FScopeLock Lock(&ShapedModelsCriticalSection);
+		if (bFrozen)
+		{
+			return;
+		}
+		bFrozen = true;
+		for (TPair<TArray<UE::NNE::FTensorShape>, TArray<TPromise<TSharedPtr<FNNERuntimeRDGMLExtensionsForVulkanModelShaped>>>>& Pending : PendingShapedModels)
+		{
+			PendingFutures.Add(Pending.Value.AddDefaulted_GetRef().GetFuture());
+		}
+	}
+	for (TFuture<TSharedPtr<FNNERuntimeRDGMLExtensionsForVulkanModelShaped>>& PendingFuture : PendingFutures)
+	{
+		PendingFuture.Wait();
+	}
+
+	TArray<UE::Tasks::FTask> TasksToWaitFor;
+	{
+		FScopeLock Lock(&ShapedModelsCriticalSection);
+		TasksToWaitFor = MoveTemp(OptimizedPipelineTasks);
+
+		// The shaped models that exist now are the only ones there will ever be, so keep them all.
+		for (const TPair<TArray<UE::NNE::FTensorShape>, TWeakPtr<FNNERuntimeRDGMLExtensionsForVulkanModelShaped>>& Entry : ShapedModels)
+		{
+			if (TSharedPtr<FNNERuntimeRDGMLExtensionsForVulkanModelShaped> ShapedModel = Entry.Value.Pin())
+			{
+				PrewarmedShapedModels.AddUnique(MoveTemp(ShapedModel));
 			}
+		}
+	}
+	UE::Tasks::Wait(TasksToWaitFor);
 
-			return true;
-		};
+	// Nothing new reads these any more, but InferOutputTensorShapes might still be part way through shape inference, so wait for that.
+	// The model registry's lock is held so that FindOrCreateInternal doesn't look at our model data whilst it's being released.
+	FWriteScopeLock ModelDataWriteLock(ModelDataLock);
+	for (FSegmentUnshaped& Segment : SegmentsUnshaped)
+	{
+		Segment.SPIRVCode = TConstArrayView<uint32_t>();
+		Segment.SPIRVEntryPoint = nullptr;
+		for (FSegmentUnshaped::FConstantInfo& ConstantInfo : Segment.ConstantInfos)
+		{
+			ConstantInfo.DataGraphPipelineConstant.pConstantData = nullptr;
+		}
+	}
+	ModelFormatHeader = nullptr;
+	DecompressedConstants.Reset();
+	FScopeLock Lock(&Private::GetModelRegistry().CriticalSection);
+	SharedModelData.Reset();
+}
 
-	// Inputs
-	if (!ProcessModelEndpoints("Input", mlsdk_decoder_model_sequence_get_input_binding_slot(ModelSequenceDecoder),
-		Result->InputSymbolicTensors, &FTensorInfoUnshaped::ModelInputIdx))
+TFuture<TSharedPtr<FNNERuntimeRDGMLExtensionsForVulkanModelShaped>> FNNERuntimeRDGMLExtensionsForVulkanModelUnshaped::FindOrCreateShapedModelAsync(TConstArrayView<UE::NNE::FTensorShape> ModelInputShapes)
+{
+	TArray<UE::NNE::FTensorShape> Key(ModelInputShapes);
+	bool bShouldCreate = false;
+	TFuture<TSharedPtr<FNNERuntimeRDGMLExtensionsForVulkanModelShaped>> Existing = FindOrBeginCreatingShapedModel(Key, bShouldCreate);
+	if (!bShouldCreate)
 	{
-		return nullptr; // Error already logged by ProcessModelEndpoints.
+		return Existing;
 	}
-	// Outputs
-	if (!ProcessModelEndpoints("Output", mlsdk_decoder_model_sequence_get_output_binding_slot(ModelSequenceDecoder),
-		Result->OutputSymbolicTensors, &FTensorInfoUnshaped::ModelOutputIdx))
+
+	// No cache hit and nobody else is creating it - create from scratch on a worker thread.
+	return Async(EAsyncExecution::TaskGraph, [This = this->AsShared(), Key = MoveTemp(Key)]() { return This->CreateAndPublishShapedModel(Key); });
+}
+
+TSharedPtr<FNNERuntimeRDGMLExtensionsForVulkanModelShaped> FNNERuntimeRDGMLExtensionsForVulkanModelUnshaped::FindOrCreateShapedModel(TConstArrayView<UE::NNE::FTensorShape> ModelInputShapes)
+{
+	TArray<UE::NNE::FTensorShape> Key(ModelInputShapes);
+	bool bShouldCreate = false;
+	TFuture<TSharedPtr<FNNERuntimeRDGMLExtensionsForVulkanModelShaped>> Existing = FindOrBeginCreatingShapedModel(Key, bShouldCreate);
+	if (!bShouldCreate)
 	{
-		return nullptr; // Error already logged by ProcessModelEndpoints.
+		// Note this might block if another thread is creating the shaped model.
+		return Existing.Get();
 	}
+	return CreateAndPublishShapedModel(Key);
+}
 
-	// Loop over model sequence table, which is a list of 'segments' describing which modules (see above) to run in what order
-	// and what inputs/outputs they should have. This order handles any dependencies between modules.
-	// Create and store the Vulkan pipelines etc. that will be needed to run each segment (but only ones that can be shared between instances)
-	const size_t NumModelSequenceTableEntries = mlsdk_decoder_get_model_sequence_table_size(ModelSequenceDecoder);
-	for (int ModelSequenceTableIdx = 0; ModelSequenceTableIdx < NumModelSequenceTableEntries; ++ModelSequenceTableIdx)
+TFuture<TSharedPtr<FNNERuntimeRDGMLExtensionsForVulkanModelShaped>> FNNERuntimeRDGMLExtensionsForVulkanModelUnshaped::FindOrBeginCreatingShapedModel(
+	const TArray<UE::NNE::FTensorShape>& Key, bool& bOutShouldCreate)
+{
+	FScopeLock Lock(&ShapedModelsCriticalSection);
+
+	// Check cache
+	TWeakPtr<FNNERuntimeRDGMLExtensionsForVulkanModelShaped>* CacheHit = ShapedModels.Find(Key);
+	TSharedPtr<FNNERuntimeRDGMLExtensionsForVulkanModelShaped> ShapedModel = CacheHit != nullptr ? CacheHit->Pin() : nullptr; // Note we also need to check that the weak pointer is still alive.
+	if (ShapedModel.IsValid())
 	{
-		FSegmentUnshaped Segment = {};
+		MarkShapedModelRecentlyUsed(ShapedModel);
+		bOutShouldCreate = false;
+		return MakeFulfilledPromise<TSharedPtr<FNNERuntimeRDGMLExtensionsForVulkanModelShaped>>(MoveTemp(ShapedModel)).GetFuture();
+	}
 
-		const char* SegmentNameRaw = mlsdk_decoder_model_sequence_get_segment_name(ModelSequenceDecoder, ModelSequenceTableIdx);
-		Segment.Name = SegmentNameRaw;
-		UE_LOG(LogNNERuntimeRDGMLExtensionsForVulkan, Verbose, TEXT("Parsing segment %s"), *Segment.Name);
+	// Once frozen, the model data needed to create new shaped models is gone.
+	if (bFrozen)
+	{
+		UE_LOG(LogNNERuntimeRDGMLExtensionsForVulkan, Error, TEXT("Can't use new input shapes with a model that has been frozen."));
+		bOutShouldCreate = false;
+		return MakeFulfilledPromise<TSharedPtr<FNNERuntimeRDGMLExtensionsForVulkanModelShaped>>(nullptr).GetFuture();
+	}
 
-		int32_t ModuleIndex = mlsdk_decoder_model_sequence_get_segment_module_index(ModelSequenceDecoder, ModelSequenceTableIdx);
+	// Another thread might already be creating this shaped model, in which case we wait for that rather than doing it all again.
+	if (TArray<TPromise<TSharedPtr<FNNERuntimeRDGMLExtensionsForVulkanModelShaped>>>* Waiters = PendingShapedModels.Find(Key))
+	{
+		bOutShouldCreate = false;
+		return Waiters->AddDefaulted_GetRef().GetFuture();
+	}
+
+	// The caller is responsible for creating it. Other threads asking for the same shapes in the meantime are added to the waiters.
+	PendingShapedModels.Add(Key);
+	bOutShouldCreate = true;
+	return TFuture<TSharedPtr<FNNERuntimeRDGMLExtensionsForVulkanModelShaped>>();
+}
+
+TSharedPtr<FNNERuntimeRDGMLExtensionsForVulkanModelShaped> FNNERuntimeRDGMLExtensionsForVulkanModelUnshaped::CreateAndPublishShapedModel(const TArray<UE::NNE::FTensorShape>& Key)
+{
+	// This adds the shaped model to the cache (if successful) before we remove the pending entry below, so there's no point at which
+	// another thread would find neither and start creating it again.
+	TSharedPtr<FNNERuntimeRDGMLExtensionsForVulkanModelShaped> ShapedModel = CreateShapedModel(Key);
+	PublishShapedModel(Key, ShapedModel);
+	return ShapedModel;
+}
+
+void FNNERuntimeRDGMLExtensionsForVulkanModelUnshaped::PublishShapedModel(const TArray<UE::NNE::FTensorShape>& Key,
+	const TSharedPtr<FNNERuntimeRDGMLExtensionsForVulkanModelShaped>& ShapedModel)
+{
+	TArray<TPromise<TSharedPtr<FNNERuntimeRDGMLExtensionsForVulkanModelShaped>>> Waiters;
+	{
+		FScopeLock Lock(&ShapedModelsCriticalSection);
+		PendingShapedModels.RemoveAndCopyValue(Key, Waiters);
+	}
+
+	// Fulfil the promises outside of the lock, as this can run continuations.
+	for (TPromise<TSharedPtr<FNNERuntimeRDGMLExtensionsForVulkanModelShaped>>& Waiter : Waiters)
+	{
+		Waiter.SetValue(ShapedModel);
+	}
+}
+
+TSharedPtr<FNNERuntimeRDGMLExtensionsForVulkanModelShaped> FNNERuntimeRDGMLExtensionsForVulkanModelUnshaped::CreateShapedModel(TConstArrayView<UE::NNE::FTensorShape> ModelInputShapes)
+{
+	// Freeze already waits for pending shaped models, but this keeps the model data alive regardless.
+	FReadScopeLock ModelDataReadLock(ModelDataLock);
+	check(ModelFormatHeader != nullptr);
+
+	VkDevice Device = GetIVulkanDynamicRHI()->RHIGetVkDevice();
+	const VkAllocationCallbacks* Allocator = GetIVulkanDynamicRHI()->RHIGetVkAllocationCallbacks();
 
-		mlsdk_decoder_module_type SegmentType = mlsdk_decoder_model_sequence_get_segment_type(ModelSequenceDecoder, ModelSequenceTableIdx);
-		if (SegmentType != mlsdk_decoder_module_type::mlsdk_decoder_module_type_graph)
+	TSharedPtr<FNNERuntimeRDGMLExtensionsForVulkanModelShaped> ShapedModel(new FNNERuntimeRDGMLExtensionsForVulkanModelShaped());
+	ShapedModel->ParentModelUnshaped = this->AsShared();
+
+	// Run shape inference over the whole VGF, starting from the inputs and working our way through the graph to the outputs.
+	ShapedModel->InputTensorShapes = ModelInputShapes;
+	ShapedModel->SegmentsShaped.Reserve(SegmentsUnshaped.Num());
+	ShapedModel->TensorInfosShaped.Reserve(TensorInfosUnshaped.Num());
+	// Start off with copying all the unshaped tensor infos as-is. We will replace the contents with concrete shapes
+	// as we go.
+	for (const FTensorInfoUnshaped& UnshapedTensorInfo : TensorInfosUnshaped)
+	{
+		FNNERuntimeRDGMLExtensionsForVulkanModelShaped::FTensorInfoShaped ShapedTensorInfo;
+		ShapedTensorInfo.VulkanDesc = UnshapedTensorInfo.VulkanDesc;
+		if (UnshapedTensorInfo.ModelInputIdx != -1)
 		{
-			UE_LOG(LogNNERuntimeRDGMLExtensionsForVulkan, Error, TEXT("Non-graph segments not supported."));
-			return nullptr;
+			// This is a model input, so the concrete shape is provided directly (no shape inference necessary).
+			ShapedTensorInfo.ShapeRawS64 = ModelInputShapes[UnshapedTensorInfo.ModelInputIdx].GetData();
+		}
+		else if (UnshapedTensorInfo.bSharedConstant)
+		{
+			ShapedTensorInfo.ShapeRawS64 = UnshapedTensorInfo.SharedConstantShape;
 		}
+		ShapedTensorInfo.VulkanDesc.pDimensions = ShapedTensorInfo.ShapeRawS64.GetData(); // Important to update the VkTensorDescription as the array data may have changed!
+		// .NumBytes is filled in later, once we know all the tensor shapes.
+		ShapedModel->TensorInfosShaped.Add(MoveTemp(ShapedTensorInfo));
+	}
 
-		mlsdk_decoder_binding_slots_handle SegmentInputBindings = mlsdk_decoder_model_sequence_get_segment_input_binding_slot(ModelSequenceDecoder, ModelSequenceTableIdx);
-		const size_t NumSegmentInputBindings = mlsdk_decoder_binding_slot_size(ModelSequenceDecoder, SegmentInputBindings);
 
-		mlsdk_decoder_binding_slots_handle SegmentOutputBindings = mlsdk_decoder_model_sequence_get_segment_output_binding_slot(ModelSequenceDecoder, ModelSequenceTableIdx);
-		const size_t NumSegmentOutputBindings = mlsdk_decoder_binding_slot_size(ModelSequenceDecoder, SegmentOutputBindings);
 
-		TArray<VkDescriptorSetLayoutBinding> DescriptorSetLayoutBindings;
-		DescriptorSetLayoutBindings.Reserve(NumSegmentInputBindings + NumSegmentOutputBindings);
+	// Each segment's pipeline is compiled in the background (see CreateDataGraphPipelineAsync) whilst we carry on with shape inference
+	// for the next segment. The create infos that these read from are in the segments, so we need to wait for the compilation to finish
+	// before potentially dropping the last reference to a segment, which also applies if we return early, hence the ON_SCOPE_EXIT.
+	TArray<UE::Tasks::TTask<VkResult>> PipelineCreationTasks;
+	// Segments which were created by this call (rather than found in the cache), so we're responsible for their optimized pipelines.
+	TArray<TSharedPtr<FNNERuntimeRDGMLExtensionsForVulkanSegmentShaped>> CreatedSegments;
+	ON_SCOPE_EXIT
+	{
+		UE::Tasks::Wait(PipelineCreationTasks);
+	};
+
+	for (int S = 0; S < SegmentsUnshaped.Num(); ++S)
+	{
+		const FSegmentUnshaped& SegmentUnshaped = SegmentsUnshaped[S];
 
-		// Gather graph pipeline bindings for inputs and outputs of this segment.
-		auto ProcessSegmentEndpoints = [&](mlsdk_decoder_binding_slots_handle Bindings, size_t NumBindings, FSegmentUnshaped::FBinding::EBindingKind BindingKind) {
-			for (int I = 0; I < NumBindings; ++I)
+		// The input shapes of this segment are all known by now, as they are either model inputs or outputs of earlier segments.
+		TArray<TArray<int64_t>> BindingShapes;
+		FSegmentShapedKey SegmentKey;
+		SegmentKey.ModuleIndex = SegmentUnshaped.ModuleIndex;
+		SegmentKey.ConstantIndexes = SegmentUnshaped.ConstantIndexes;
+		for (const FSegmentUnshaped::FBinding& Binding : SegmentUnshaped.Bindings)
+		{
+			const FNNERuntimeRDGMLExtensionsForVulkanModelShaped::FTensorInfoShaped& TensorInfoShaped = ShapedModel->TensorInfosShaped[Binding.TensorId];
+			SegmentKey.Bindings.Add(Binding.VulkanBindingIdx);
+			SegmentKey.Bindings.Add(TensorInfoShaped.VulkanDesc.format);
+			if (Binding.BindingKind == FSegmentUnshaped::FBinding::EBindingKind::Input)
 			{
-				uint32_t ResourceIndex = mlsdk_decoder_binding_slot_mrt_index(ModelSequenceDecoder, Bindings, I);
-				if (ResourceIndex >= NumModelResourceTableEntries)
-				{
-					UE_LOG(LogNNERuntimeRDGMLExtensionsForVulkan, Error, TEXT("Corrupt VGF (resource index out of bounds)."));
-					return false;
-				}
+				SegmentKey.Bindings.Append(TensorInfoShaped.ShapeRawS64);
+				BindingShapes.Add(TensorInfoShaped.ShapeRawS64);
+			}
+			else
+			{
+				BindingShapes.AddDefaulted(); // Filled in by shape inference.
+			}
+		}
 
-				VkDescriptorSetLayoutBinding LayoutBinding = {};
-				LayoutBinding.binding = mlsdk_decoder_binding_slot_binding_id(ModelSequenceDecoder, Bindings, I);
-				LayoutBinding.descriptorCount = 1;
-				LayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_TENSOR_ARM;
-				LayoutBinding.stageFlags = VK_SHADER_STAGE_ALL;
-				DescriptorSetLayoutBindings.Add(LayoutBinding);
-
-				FSegmentUnshaped::FBinding OurBinding = {};
-				OurBinding.BindingKind = BindingKind;
-				OurBinding.VulkanBindingIdx = LayoutBinding.binding;
-				int32 TensorId = ResourceDescs[ResourceIndex].TensorId;
-				if (TensorId == -1)
+		// Check whether another shaped model has already done (or is in the middle of doing) this segment. If not, add it to the cache
+		// straight away, so that anyone else who needs it waits for us rather than doing it again.
+		TSharedPtr<FNNERuntimeRDGMLExtensionsForVulkanSegmentShaped> Segment;
+		bool bCreateSegment = false;
+		{
+			FScopeLock Lock(&SegmentsShapedCacheCriticalSection);
+			TWeakPtr<FNNERuntimeRDGMLExtensionsForVulkanSegmentShaped>* CacheHit = SegmentsShapedCache.Find(SegmentKey);
+			Segment = CacheHit != nullptr ? CacheHit->Pin() : nullptr;
+			if (!Segment.IsValid())
+			{
+				// Remove entries for segments which have since been freed, so the cache doesn't grow forever as shapes change.
+				for (auto It = SegmentsShapedCache.CreateIterator(); It; ++It)
 				{
-					UE_LOG(LogNNERuntimeRDGMLExtensionsForVulkan, Error, TEXT("Invalid VGF (segment input or output has incorrect resource type)."));
-					return false;
+					if (!It->Value.IsValid())
+					{
+						It.RemoveCurrent();
+					}
 				}
-				OurBinding.TensorId = TensorId;
 
-				Segment.Bindings.Add(OurBinding);
+				Segment = MakeShared<FNNERuntimeRDGMLExtensionsForVulkanSegmentShaped>();
+				Segment->BindingShapes = MoveTemp(BindingShapes);
+				SegmentsShapedCache.Add(MoveTemp(SegmentKey), Segment);
+				bCreateSegment = true;
 			}
-			return true;
-			};
+		}
 
-		// Inputs for this segment.
-		if (!ProcessSegmentEndpoints(SegmentInputBindings, NumSegmentInputBindings, FSegmentUnshaped::FBinding::EBindingKind::Input))
+		if (bCreateSegment)
 		{
-			return nullptr; // Error already logged by ProcessSegmentEndpoints.
+			CreateSegmentShaped(S, *Segment);
+			CreatedSegments.Add(Segment);
 		}
-		// Outputs for this segment.
-		if (!ProcessSegmentEndpoints(SegmentOutputBindings, NumSegmentOutputBindings, FSegmentUnshaped::FBinding::EBindingKind::Output))
+		else
 		{
-			return nullptr; // Error already logged by ProcessSegmentEndpoints.
+			Segment->ShapeInferenceDone.Wait();
 		}
 
-		const size_t NumDescriptorSets = mlsdk_decoder_model_sequence_get_segment_descriptorset_info_size(ModelSequenceDecoder, ModelSequenceTableIdx);
-		if (NumDescriptorSets != 1)
+		if (!Segment->bShapeInferenceSucceeded)
 		{
-			// These are probably only needed for compute segments (which we don't support yet), and for graph segments we have all the info we need
-			// in the segment input/output bindings, so we just do a basic sanity check on this.
-			UE_LOG(LogNNERuntimeRDGMLExtensionsForVulkan, Error, TEXT("Descriptor sets count unexpected."));
+			UE_LOG(LogNNERuntimeRDGMLExtensionsForVulkan, Error, TEXT("Shape inference failed"));
 			return nullptr;
 		}
+		PipelineCreationTasks.Add(Segment->PipelineTask);
 
-		mlsdk_decoder_push_constant_ranges_handle PushConstantsRanges = mlsdk_decoder_model_sequence_get_segment_push_constant_range(ModelSequenceDecoder, ModelSequenceTableIdx);
-		const size_t NumPushConstantRanges = mlsdk_decoder_get_push_constant_ranges_size(ModelSequenceDecoder, PushConstantsRanges);
-		if (NumPushConstantRanges != 0)
+		// Fill in the output shapes, which the later segments depend on.
+		for (int B = 0; B < SegmentUnshaped.Bindings.Num(); ++B)
 		{
-			// These are probably intended to be used for compute segments, but we don't support these yet.
-			UE_LOG(LogNNERuntimeRDGMLExtensionsForVulkan, Error, TEXT("Push constants not supported."));
-			return nullptr;
+			if (SegmentUnshaped.Bindings[B].BindingKind == FSegmentUnshaped::FBinding::EBindingKind::Output)
+			{
+				FNNERuntimeRDGMLExtensionsForVulkanModelShaped::FTensorInfoShaped& TensorInfoShaped = ShapedModel->TensorInfosShaped[SegmentUnshaped.Bindings[B].TensorId];
+				TensorInfoShaped.ShapeRawS64 = Segment->BindingShapes[B];
+				TensorInfoShaped.VulkanDesc.pDimensions = TensorInfoShaped.ShapeRawS64.GetData(); // Important to update the VkTensorDescription as the array data will have changed!
+			}
 		}
 
-		// Constants for this segment.
-		const size_t NumModelConstants = mlsdk_decoder_get_constant_table_num_entries(ConstantTableDecoder);
-		mlsdk_decoder_constant_indexes ConstantIndexes;
-		mlsdk_decoder_model_sequence_get_segment_constant_indexes(ModelSequenceDecoder, ModelSequenceTableIdx, &ConstantIndexes);
-		Segment.ConstantInfos.Reserve(ConstantIndexes.size);
-		for (int ConstantIdxWithinSegment = 0; ConstantIdxWithinSegment < ConstantIndexes.size; ++ConstantIdxWithinSegment)
+		ShapedModel->EstimatedMemoryBytes += Segment->EstimatedMemoryBytes;
+		ShapedModel->SegmentsShaped.Add(MoveTemp(Segment));
+	}
+
+	// Wait for all the pipelines to finish compiling.
+	UE::Tasks::Wait(PipelineCreationTasks);
+	for (const UE::Tasks::TTask<VkResult>& PipelineCreationTask : PipelineCreationTasks)
+	{
+		VERIFYVULKANRESULT(PipelineCreationTask.GetResult());
+	}
+
+	// Start compiling the optimized pipelines for any segments that we created unoptimized ones for. The shaped model can be used
+	// straight away with the unoptimized pipelines, and each optimized one is swapped in as soon as it's ready.
+	// Model instances pick this up the next time they are enqueued (see RecreatePipelineSessionsIfNeeded_RenderThread).
+	for (const TSharedPtr<FNNERuntimeRDGMLExtensionsForVulkanSegmentShaped>& Segment : CreatedSegments)
+	{
+		if (!Segment->bNeedsOptimizedPipeline)
 		{
-			int ModelConstantIdx = ConstantIndexes.data[ConstantIdxWithinSegment];
-			if (ModelConstantIdx > NumModelConstants)
+			continue;
+		}
+
+		UE::Tasks::TTask<VkResult> OptimizedPipelineTask = FNNERuntimeRDGMLExtensionsForVulkanPipelineCache::Get().CreateDataGraphPipelineAsync(Device,
+			Segment->DataGraphPipelineCreateInfo, Segment->PipelineKey, Allocator, &Segment->OptimizedPipeline,
+			FNNERuntimeRDGMLExtensionsForVulkanPipelineCache::EOptimization::Full, UE::Tasks::ETaskPriority::BackgroundNormal);
+
+		// The segment (which the create info points into) needs to stay alive until the compilation has finished, as does this
+		// unshaped model as the constants that the pipeline is created from are in its model data.
+		UE::Tasks::FTask SwapTask = UE::Tasks::Launch(UE_SOURCE_LOCATION, [This = this->AsShared(), Segment, OptimizedPipelineTask]() {
+			if (OptimizedPipelineTask.GetResult() != VK_SUCCESS)
 			{
-				UE_LOG(LogNNERuntimeRDGMLExtensionsForVulkan, Error, TEXT("Corrupt VGF (segment constant idx out of bounds)."));
-				return nullptr;
+				// Not fatal, as we can carry on using the unoptimized pipeline.
+				UE_LOG(LogNNERuntimeRDGMLExtensionsForVulkan, Warning, TEXT("Failed to create optimized pipeline (%d)."), OptimizedPipelineTask.GetResult());
+				return;
 			}
-
-			uint32_t ResourceIndex = mlsdk_decoder_constant_table_get_mrt_index(ConstantTableDecoder, ModelConstantIdx);
-			if (ResourceIndex >= NumModelResourceTableEntries)
+			VkPipeline ReplacedPipeline;
 			{
-				UE_LOG(LogNNERuntimeRDGMLExtensionsForVulkan, Error, TEXT("Corrupt VGF (constant resource idx out of bounds)."));
-				return nullptr;
+				FScopeLock Lock(&Segment->PipelinesCriticalSection);
+				ReplacedPipeline = Segment->Pipeline;
+				Segment->Pipeline = Segment->OptimizedPipeline;
+				++Segment->PipelinesVersion;
 			}
 
-			mlsdk_decoder_constant_data ConstantData;
-			mlsdk_decoder_constant_table_get_data(ConstantTableDecoder, ModelConstantIdx, &ConstantData);
-
-			FSegmentUnshaped::FConstantInfo& ConstantInfo = Segment.ConstantInfos.AddZeroed_GetRef();
+			// Model instances switch to the new pipeline before their next execution (see RecreatePipelineSessionsIfNeeded_RenderThread),
+			// so the old one is only used by executions that have already been enqueued, which the queue's frame delay covers.
+			FNNERuntimeRDGMLExtensionsForVulkanDeferredDeletionQueue::Get().Enqueue([ReplacedPipeline](VkDevice Device, const VkAllocationCallbacks* Allocator) {
+				vkDestroyPipeline_p(Device, ReplacedPipeline, Allocator);
+			});
+		}, UE::Tasks::Prerequisites(OptimizedPipelineTask), UE::Tasks::ETaskPriority::BackgroundNormal);
 
-			ConstantInfo.TensorDescription = ResourceDescs[ResourceIndex].TensorDescription;
-			ConstantInfo.TensorDimensions = ResourceDescs[ResourceIndex].TensorShapeRawS64;
-			// Important to update the pointer in TensorDescription.pDimensions to a copy of the data which will live alongside it.
-			ConstantInfo.TensorDescription.pDimensions = ConstantInfo.TensorDimensions.GetData();
+		// Freeze needs to wait for these, as they use the model data.
+		FScopeLock Lock(&ShapedModelsCriticalSection);
+		OptimizedPipelineTasks.RemoveAllSwap([](const UE::Tasks::FTask& Task) { return Task.IsCompleted(); });
+		OptimizedPipelineTasks.Add(SwapTask);
+	}
 
-			ConstantInfo.DataGraphPipelineConstant.sType = VK_STRUCTURE_TYPE_DATA_GRAPH_PIPELINE_CONSTANT_ARM;
-			ConstantInfo.DataGraphPipelineConstant.id = ConstantIdxWithinSegment;
-			ConstantInfo.DataGraphPipelineConstant.pNext = &ConstantInfo.TensorDescription;
-			ConstantInfo.DataGraphPipelineConstant.pConstantData = ConstantData.data;
+	// Fill in model output tensor shapes.
+	ShapedModel->OutputTensorShapes.AddDefaulted(OutputSymbolicTensors.Num());
+	for (int T = 0; T < TensorInfosUnshaped.Num(); ++T)
+	{
+		if (TensorInfosUnshaped[T].ModelOutputIdx != -1)
+		{
+			TArray<uint32_t> TensorShapeU32;
+			Algo::Transform(ShapedModel->TensorInfosShaped[T].ShapeRawS64, TensorShapeU32, [](uint64_t x) { return x; });
+			ShapedModel->OutputTensorShapes[TensorInfosUnshaped[T].ModelOutputIdx] = UE::NNE::FTensorShape::Make(TensorShapeU32);
 		}
+	}
 
-		mlsdk_decoder_module_type ModuleType = mlsdk_decoder_get_module_type(ModuleTableDecoder, ModuleIndex);
-		if (ModuleType != mlsdk_decoder_module_type_graph)
+	// Calculate NumBytes for each FTensorInfoShaped. Shared constants aren't allocated for each inference, so don't need this.
+	for (int T = 0; T < TensorInfosUnshaped.Num(); ++T)
+	{
+		if (TensorInfosUnshaped[T].bSharedConstant)
 		{
-			UE_LOG(LogNNERuntimeRDGMLExtensionsForVulkan, Error, TEXT("Non-graph modules not supported."));
-			return nullptr;
+			continue;
 		}
-
-		mlsdk_decoder_spirv_code SPIRVCode;
-		mlsdk_decoder_get_module_code(ModuleTableDecoder, ModuleIndex, &SPIRVCode);
-		if (SPIRVCode.code == nullptr || SPIRVCode.words == 0)
+		FNNERuntimeRDGMLExtensionsForVulkanModelShaped::FTensorInfoShaped& TensorInfoShaped = ShapedModel->TensorInfosShaped[T];
+		size_t NumBytesPerElement = Private::GetNumBytesPerElement(TensorInfoShaped.VulkanDesc.format);
+		if (NumBytesPerElement == 0)
 		{
-			UE_LOG(LogNNERuntimeRDGMLExtensionsForVulkan, Error, TEXT("Missing SPIRV code for module."));
+			UE_LOG(LogNNERuntimeRDGMLExtensionsForVulkan, Error, TEXT("Unsupported input/output/intermediate data type: %u"), TensorInfoShaped.VulkanDesc.format);
 			return nullptr;
 		}
-		Segment.SPIRVCode = TConstArrayView<uint32_t>(SPIRVCode.code, SPIRVCode.words);
+		TensorInfoShaped.NumBytes = NumBytesPerElement * Algo::Accumulate(TensorInfoShaped.ShapeRawS64, 1, [](uint64_t Acc, uint64_t X) { return Acc * X; });
+	}
 
-		Segment.SPIRVEntryPoint = mlsdk_decoder_get_module_entry_point(ModuleTableDecoder, ModuleIndex);
+	// Save in cache for future reuse.
+	FScopeLock Lock(&ShapedModelsCriticalSection);
+	ShapedModels.Add(TArray<UE::NNE::FTensorShape>(ModelInputShapes), ShapedModel);
+	MarkShapedModelRecentlyUsed(ShapedModel);
+	return ShapedModel;
+}
 
-		// Run the Vulkan resource creation functions on the RHI thread and wait for them to complete.
-		FEvent* RenderThreadDoneEvent = FGenericPlatformProcess::GetSynchEventFromPool(true);
-		ENQUEUE_RENDER_COMMAND(NNERuntimeRDGMLExtensionsForVulkanModel_CreateSegment)([&](FRHICommandListImmediate& RHICmdList) {
-			RHICmdList.EnqueueLambda([&](FRHICommandListImmediate& RHICmdList) {
-				VkDevice Device = GetIVulkanDynamicRHI()->RHIGetVkDevice();
-				const VkAllocationCallbacks* Allocator = GetIVulkanDynamicRHI()->RHIGetVkAllocationCallbacks();
-
-				// Descriptor set layout.
-				VkDescriptorSetLayoutCreateInfo GraphDescriptorSetLayoutCreateInfo = {};
-				GraphDescriptorSetLayoutCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
-				GraphDescriptorSetLayoutCreateInfo.bindingCount = DescriptorSetLayoutBindings.Num();
-				GraphDescriptorSetLayoutCreateInfo.pBindings = DescriptorSetLayoutBindings.GetData();
-				VERIFYVULKANRESULT(vkCreateDescriptorSetLayout_p(Device, &GraphDescriptorSetLayoutCreateInfo, Allocator, &Segment.DescriptorSetLayout));
-
-				// Graph pipeline layout.
-				VkPipelineLayoutCreateInfo PipelineLayoutCreateInfo = {};
-				PipelineLayoutCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-				PipelineLayoutCreateInfo.setLayoutCount = 1;
-				PipelineLayoutCreateInfo.pSetLayouts = &Segment.DescriptorSetLayout;
-				VERIFYVULKANRESULT(vkCreatePipelineLayout_p(Device, &PipelineLayoutCreateInfo, Allocator, &Segment.PipelineLayout));
-			});
-			RHICmdList.ImmediateFlush(EImmediateFlushType::FlushRHIThread);
-			RenderThreadDoneEvent->Trigger();
-		});
+void FNNERuntimeRDGMLExtensionsForVulkanModelUnshaped::CreateSegmentShaped(int32 SegmentIdx, FNNERuntimeRDGMLExtensionsForVulkanSegmentShaped& Segment)
+{
+	// Other threads waiting for this segment need to be woken up however we leave this function.
+	ON_SCOPE_EXIT
+	{
+		Segment.ShapeInferenceDone.Trigger();
+	};
 
-		RenderThreadDoneEvent->Wait();
-		FGenericPlatformProcess::ReturnSynchEventToPool(RenderThreadDoneEvent);
+	VkDevice Device = GetIVulkanDynamicRHI()->RHIGetVkDevice();
+	const VkAllocationCallbacks* Allocator = GetIVulkanDynamicRHI()->RHIGetVkAllocationCallbacks();
 
-		Result->SegmentsUnshaped.Add(MoveTemp(Segment));
+	const FSegmentUnshaped& SegmentUnshaped = SegmentsUnshaped[SegmentIdx];
+
+	// For now we only support shape inference for SPIR-V segments (not compute segments)
+	// Map of input shapes for this segment.
+	TMap<TPair<uint32_t, uint32_t>, TArray<int64_t>> SegmentInputShapes;
+	for (int B = 0; B < SegmentUnshaped.Bindings.Num(); ++B)
+	{
+		if (SegmentUnshaped.Bindings[B].BindingKind == FSegmentUnshaped::FBinding::EBindingKind::Input)
+		{
+			uint32_t DescriptorSet = 0; // We assume all bindings are in a single descriptor set.
+			uint32_t VulkanBindingIdx = SegmentUnshaped.Bindings[B].VulkanBindingIdx;
+			SegmentInputShapes.Add({ DescriptorSet , VulkanBindingIdx }, Segment.BindingShapes[B]);
+		}
 	}
 
-	return Result;
-}
+	// Run shape inference using SPIRV-Tools, unless it was already run for these shapes when the model was cooked, or the results
+	// are already cached from a previous run.
+	ShapeInferenceResults ShapeInferenceResults{ false };
+	if (!FindPreShapedSegment(SegmentIdx, Segment.BindingShapes, ShapeInferenceResults))
+	{
+		ShapeInferenceResults = FNNERuntimeRDGMLExtensionsForVulkanShapeInferenceCache::Get().RunShapeInference(SegmentUnshaped.SPIRVCode, SegmentInputShapes);
+	}
 
-FNNERuntimeRDGMLExtensionsForVulkanModelUnshaped::FNNERuntimeRDGMLExtensionsForVulkanModelUnshaped()
-{
-	// All initialisation logic is in the static Create function (above).
-}
+	if (!ShapeInferenceResults.Success)
+	{
+		return; // Error logged by CreateShapedModel.
+	}
 
-FNNERuntimeRDGMLExtensionsForVulkanModelUnshaped::~FNNERuntimeRDGMLExtensionsForVulkanModelUnshaped()
-{
-	// Destroy Vulkan resources on the RHI thread and wait for that to finish.
-	FEvent* RenderThreadDoneEvent = FGenericPlatformProcess::GetSynchEventFromPool(true);
-	ENQUEUE_RENDER_COMMAND(NNERuntimeRDGMLExtensionsForVulkanModel_DestroySegments)([&](FRHICommandListImmediate& RHICmdList) {
-		RHICmdList.EnqueueLambda([&](FRHICommandListImmediate& RHICmdList) {
-			VkDevice Device = GetIVulkanDynamicRHI()->RHIGetVkDevice();
-			const VkAllocationCallbacks* Allocator = GetIVulkanDynamicRHI()->RHIGetVkAllocationCallbacks();
+	for (int B = 0; B < SegmentUnshaped.Bindings.Num(); ++B)
+	{
+		if (SegmentUnshaped.Bindings[B].BindingKind == FSegmentUnshaped::FBinding::EBindingKind::Output)
+		{
+			uint32_t DescriptorSet = 0; // We assume all bindings are in a single descriptor set.
+			uint32_t VulkanBindingIdx = SegmentUnshaped.Bindings[B].VulkanBindingIdx;
+			Segment.BindingShapes[B] = *ShapeInferenceResults.OutputShapes.Find(TPair<uint32_t, uint32_t>{ DescriptorSet, VulkanBindingIdx });
+		}
+	}
 
-			for (FSegmentUnshaped& S : SegmentsUnshaped)
-			{
-				vkDestroyPipelineLayout_p(Device, S.PipelineLayout, Allocator);
-				vkDestroyDescriptorSetLayout_p(Device, S.DescriptorSetLayout, Allocator);
-			}
+	// Now that we have the concrete tensor shapes for this segment, we can create the Vulkan pipeline etc.
+	Algo::Transform(SegmentUnshaped.ConstantInfos, Segment.DataGraphPipelineConstants, [](const auto& x) { return x.DataGraphPipelineConstant; });
 
-		});
-		RHICmdList.ImmediateFlush(EImmediateFlushType::FlushRHIThread);
-		RenderThreadDoneEvent->Trigger();
-	});
+	// Both arrays are fully sized up-front, as the resource infos point into the tensor descriptions.
+	Segment.BindingTensorDescriptions.Reserve(SegmentUnshaped.Bindings.Num());
+	Segment.DataGraphPipelineResourcesInfos.Reserve(SegmentUnshaped.Bindings.Num());
+	for (int B = 0; B < SegmentUnshaped.Bindings.Num(); ++B)
+	{
+		const FSegmentUnshaped::FBinding& Binding = SegmentUnshaped.Bindings[B];
 
-	RenderThreadDoneEvent->Wait();
-	FGenericPlatformProcess::ReturnSynchEventToPool(RenderThreadDoneEvent);
-}
+		VkTensorDescriptionARM& TensorDescription = Segment.BindingTensorDescriptions.Add_GetRef(TensorInfosUnshaped[Binding.TensorId].VulkanDesc);
+		TensorDescription.pDimensions = Segment.BindingShapes[B].GetData();
 
-TSharedPtr<UE::NNE::IModelInstanceRDG> FNNERuntimeRDGMLExtensionsForVulkanModelUnshaped::CreateModelInstanceRDG()
-{
-	// We can't initialize very much of the model instance yet, because we don't know the concrete tensor shapes 
-	// until SetInputTensorShapes is called.
-	TSharedPtr<FNNERuntimeRDGMLExtensionsForVulkanModelInstance> Result(new FNNERuntimeRDGMLExtensionsForVulkanModelInstance());
-	Result->ParentModelUnshaped = this->AsShared();
+		VkDataGraphPipelineResourceInfoARM ResourceInfo = {};
+		ResourceInfo.sType = VK_STRUCTURE_TYPE_DATA_GRAPH_PIPELINE_RESOURCE_INFO_ARM;
+		ResourceInfo.descriptorSet = 0; // We assume that all bindings are in a single descriptor set.
+		ResourceInfo.binding = Binding.VulkanBindingIdx;
+		ResourceInfo.pNext = &TensorDescription;
+		Segment.DataGraphPipelineResourcesInfos.Add(ResourceInfo);
+	}
 
-	// Create vulkan resources for this instance, using the common resources from the parent model.
-	// Run the Vulkan resource creation functions on the RHI thread and wait for them to complete.
-	FEvent* RenderThreadDoneEvent = FGenericPlatformProcess::GetSynchEventFromPool(true);
-	ENQUEUE_RENDER_COMMAND(NNERuntimeRDGMLExtensionsForVulkanModel_DestroySegments)([&](FRHICommandListImmediate& RHICmdList) {
-		RHICmdList.EnqueueLambda([&](FRHICommandListImmediate& RHICmdList) {
-			VkDevice Device = GetIVulkanDynamicRHI()->RHIGetVkDevice();
-			const VkAllocationCallbacks* Allocator = GetIVulkanDynamicRHI()->RHIGetVkAllocationCallbacks();
+	// Shader module
+	VkShaderModuleCreateInfo GraphShaderModuleCreateInfo = {};
+	GraphShaderModuleCreateInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+	GraphShaderModuleCreateInfo.codeSize = ShapeInferenceResults.NewCode.Num() * sizeof(ShapeInferenceResults.NewCode[0]);
+	GraphShaderModuleCreateInfo.pCode = ShapeInferenceResults.NewCode.GetData();
+	VERIFYVULKANRESULT(vkCreateShaderModule_p(Device, &GraphShaderModuleCreateInfo, Allocator, &Segment.ShaderModule));
+
+	// Data graph pipeline
+	VkDataGraphPipelineShaderModuleCreateInfoARM& DataGraphPipelineShaderModuleCreateInfo = Segment.DataGraphPipelineShaderModuleCreateInfo;
+	DataGraphPipelineShaderModuleCreateInfo.sType = VK_STRUCTURE_TYPE_DATA_GRAPH_PIPELINE_SHADER_MODULE_CREATE_INFO_ARM;
+	DataGraphPipelineShaderModuleCreateInfo.module = Segment.ShaderModule;
+	DataGraphPipelineShaderModuleCreateInfo.pName = SegmentUnshaped.SPIRVEntryPoint;
+	DataGraphPipelineShaderModuleCreateInfo.constantCount = Segment.DataGraphPipelineConstants.Num();
+	DataGraphPipelineShaderModuleCreateInfo.pConstants = Segment.DataGraphPipelineConstants.GetData();
+
+	// Segments sharing this one have identically defined pipeline layouts (as the bindings are part of the cache key), so the
+	// pipeline is compatible with all of them.
+	VkDataGraphPipelineCreateInfoARM& DataGraphPipelineCreateInfo = Segment.DataGraphPipelineCreateInfo;
+	DataGraphPipelineCreateInfo.sType = VK_STRUCTURE_TYPE_DATA_GRAPH_PIPELINE_CREATE_INFO_ARM;
+	DataGraphPipelineCreateInfo.layout = SegmentUnshaped.PipelineLayout;
+	DataGraphPipelineCreateInfo.resourceInfoCount = Segment.DataGraphPipelineResourcesInfos.Num();
+	DataGraphPipelineCreateInfo.pResourceInfos = Segment.DataGraphPipelineResourcesInfos.GetData();
+	DataGraphPipelineCreateInfo.pNext = &DataGraphPipelineShaderModuleCreateInfo;
+
+	// The shaped SPIR-V code has all the tensor shapes baked into it, and everything else comes from the model data (the constants
+	// from the constant table entries), so this is enough to uniquely identify the pipeline.
+	FXxHash64Builder PipelineKeyBuilder;
+	PipelineKeyBuilder.Update(&ModelDataHash.Hash, sizeof(ModelDataHash.Hash));
+	PipelineKeyBuilder.Update(&SegmentUnshaped.ModuleIndex, sizeof(SegmentUnshaped.ModuleIndex));
+	PipelineKeyBuilder.Update(SegmentUnshaped.ConstantIndexes.GetData(), SegmentUnshaped.ConstantIndexes.Num() * sizeof(SegmentUnshaped.ConstantIndexes[0]));
+	PipelineKeyBuilder.Update(ShapeInferenceResults.NewCode.GetData(), ShapeInferenceResults.NewCode.Num() * sizeof(ShapeInferenceResults.NewCode[0]));
+	Segment.PipelineKey = PipelineKeyBuilder.Finalize();
+
+	Segment.EstimatedMemoryBytes += GraphShaderModuleCreateInfo.codeSize;
+	for (const FSegmentUnshaped::FConstantInfo& ConstantInfo : SegmentUnshaped.ConstantInfos)
+	{
+		Segment.EstimatedMemoryBytes += Private::GetNumBytesPerElement(ConstantInfo.TensorDescription.format) *
+			Algo::Accumulate(ConstantInfo.TensorDimensions, (uint64)1, [](uint64 Acc, int64_t X) { return Acc * X; });
+	}
 
-			uint32 NumDescriptors = 0;
-			for (FSegmentUnshaped& Segment : SegmentsUnshaped)
-			{
-				// Sum up the total number of descriptors that we will need for all segments.
-				NumDescriptors += Segment.Bindings.Num();
-			}
+	FNNERuntimeRDGMLExtensionsForVulkanPipelineCache& PipelineCache = FNNERuntimeRDGMLExtensionsForVulkanPipelineCache::Get();
+	VkResult CachedResult = PipelineCache.TryCreateDataGraphPipelineWithoutCompiling(Device, DataGraphPipelineCreateInfo, Segment.PipelineKey,
+		Allocator, &Segment.Pipeline);
+	if (CachedResult == VK_PIPELINE_COMPILE_REQUIRED)
+	{
+		const bool bTieredPipelineCompilation = GetDefault<UNNERuntimeRDGMLExtensionsForVulkanSettings>()->bTieredPipelineCompilation;
+		Segment.bNeedsOptimizedPipeline = bTieredPipelineCompilation;
+		Segment.PipelineTask = PipelineCache.CreateDataGraphPipelineAsync(Device, DataGraphPipelineCreateInfo, Segment.PipelineKey, Allocator,
+			&Segment.Pipeline, bTieredPipelineCompilation ? FNNERuntimeRDGMLExtensionsForVulkanPipelineCache::EOptimization::Disabled
+			: FNNERuntimeRDGMLExtensionsForVulkanPipelineCache::EOptimization::Full);
+	}
+	else
+	{
+		Segment.PipelineTask = UE::Tasks::MakeCompletedTask<VkResult>(CachedResult);
+	}
 
-			// Create descriptor pool to use for this instance. We could create one of these in the parent model, but then we wouldn't know
-			// how big the pool should be as we don't know how many instances will be created.
-			VkDescriptorPoolCreateInfo DescriptorPoolCreateInfo = {};
-			DescriptorPoolCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
-			DescriptorPoolCreateInfo.maxSets = SegmentsUnshaped.Num() * MAX_CONCURRENT_EXECUTIONS_PER_INSTANCE;
-			DescriptorPoolCreateInfo.poolSizeCount = 1;
-			DescriptorPoolCreateInfo.flags = VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT;
-			VkDescriptorPoolSize PoolSize = {};
-			PoolSize.type = VK_DESCRIPTOR_TYPE_TENSOR_ARM;
-			PoolSize.descriptorCount = NumDescriptors * MAX_CONCURRENT_EXECUTIONS_PER_INSTANCE;
-			DescriptorPoolCreateInfo.pPoolSizes = &PoolSize;
-			VERIFYVULKANRESULT(vkCreateDescriptorPool_p(Device, &DescriptorPoolCreateInfo, Allocator, &Result->DescriptorPool));
-		});
+	Segment.bShapeInferenceSucceeded = true;
+}
+
+void FNNERuntimeRDGMLExtensionsForVulkanModelUnshaped::MarkShapedModelRecentlyUsed(const TSharedPtr<FNNERuntimeRDGMLExtensionsForVulkanModelShaped>& ShapedModel)
+{
+	// This is only ever a handful of entries, so a linear search is fine.
+	RecentlyUsedShapedModels.Remove(ShapedModel);
+	RecentlyUsedShapedModels.Add(ShapedModel);
 
-		RHICmdList.ImmediateFlush(EImmediateFlushType::FlushRHIThread);
-		RenderThreadDoneEvent->Trigger();
-	});
+	uint64 TotalMemoryBytes = Algo::TransformAccumulate(RecentlyUsedShapedModels,
+		[](const TSharedPtr<FNNERuntimeRDGMLExtensionsForVulkanModelShaped>& S) { return S->EstimatedMemoryBytes; }, (uint64)0);
 
-	RenderThreadDoneEvent->Wait();
-	FGenericPlatformProcess::ReturnSynchEventToPool(RenderThreadDoneEvent);
+	// Always keep the one that has just been used, even if it's over budget on its own.
+	while (RecentlyUsedShapedModels.Num() > 1 && (RecentlyUsedShapedModels.Num() > MaxRecentlyUsedShapedModels || TotalMemoryBytes > RecentlyUsedShapedModelsMemoryBudget))
+	{
+		// Note this doesn't necessarily destroy the shaped model, as model instances may still be using it.
+		TotalMemoryBytes -= RecentlyUsedShapedModels[0]->EstimatedMemoryBytes;
+		RecentlyUsedShapedModels.RemoveAt(0);
+		++NumShapedModelEvictions;
+		UE_LOG(LogNNERuntimeRDGMLExtensionsForVulkan, Verbose, TEXT("Evicted shaped model from recently used list (%u evictions so far)."), (uint32)NumShapedModelEvictions);
+	}
 
-	return Result;
+	// A limit of zero means that nothing should be retained.
+	if (MaxRecentlyUsedShapedModels == 0)
+	{
+		RecentlyUsedShapedModels.Empty();
+	}
 }
 
-TSharedPtr<FNNERuntimeRDGMLExtensionsForVulkanModelShaped> FNNERuntimeRDGMLExtensionsForVulkanModelUnshaped::FindOrCreateShapedModel(TConstArrayView<UE::NNE::FTensorShape> ModelInputShapes)
+bool FNNERuntimeRDGMLExtensionsForVulkanModelUnshaped::GetStaticInputShapes(TArray<UE::NNE::FTensorShape>& OutInputShapes) const
 {
-	// Check cache
-	TWeakPtr<FNNERuntimeRDGMLExtensionsForVulkanModelShaped>* CacheHit = ShapedModels.Find(TArray<UE::NNE::FTensorShape>(ModelInputShapes));
-	if (CacheHit != nullptr && CacheHit->IsValid()) // Note we also need to check that the weak pointer is still alive.
+	OutInputShapes.Reset();
+	for (const UE::NNE::FTensorDesc& InputDesc : InputSymbolicTensors)
 	{
-		return CacheHit->Pin();
+		if (!InputDesc.GetShape().IsConcrete())
+		{
+			OutInputShapes.Reset();
+			return false;
+		}
+		OutInputShapes.Add(UE::NNE::FTensorShape::MakeFromSymbolic(InputDesc.GetShape()));
 	}
+	return true;
+}
 
-	// No cache hit - create from scratch and insert into cache.
-	TSharedPtr<FNNERuntimeRDGMLExtensionsForVulkanModelShaped> ShapedModel(new FNNERuntimeRDGMLExtensionsForVulkanModelShaped());
-	ShapedModel->ParentModelUnshaped = this->AsShared();
-
-	// Run shape inference over the whole VGF, starting from the inputs and working our way through the graph to the outputs.
-	ShapedModel->InputTensorShapes = ModelInputShapes;
-	ShapedModel->SegmentsShaped.Reserve(SegmentsUnshaped.Num());
-	ShapedModel->TensorInfosShaped.Reserve(TensorInfosUnshaped.Num());
-	// Start off with copying all the unshaped tensor infos as-is. We will replace the contents with concrete shapes
-	// as we go.
-	for (const FTensorInfoUnshaped& UnshapedTensorInfo : TensorInfosUnshaped)
+bool FNNERuntimeRDGMLExtensionsForVulkanModelUnshaped::FindPreShapedSegment(int32 SegmentIdx, TConstArrayView<TArray<int64_t>> BindingShapes, ShapeInferenceResults& OutResults) const
+{
+	using FModelFormat = FNNERuntimeRDGMLExtensionsForVulkanModelFormat;
+	const FSegmentUnshaped& SegmentUnshaped = SegmentsUnshaped[SegmentIdx];
+	const TConstArrayView<int64> Dimensions = FModelFormat::GetTable<int64>(ModelFormatHeader, ModelFormatHeader->Dimensions);
+	const TConstArrayView<FModelFormat::FShape> TensorShapes = FModelFormat::GetTable<FModelFormat::FShape>(ModelFormatHeader, ModelFormatHeader->PreShapedTensorShapes);
+
+	// There are only ever a handful of these, so just check each in turn. Only the shapes of this segment's inputs need to match,
+	// so this also finds segments which are shared with a pre-shaped model even if the shapes elsewhere in the model are different.
+	for (const FModelFormat::FPreShapedModel& PreShapedModel : FModelFormat::GetTable<FModelFormat::FPreShapedModel>(ModelFormatHeader, ModelFormatHeader->PreShapedModels))
 	{
-		FNNERuntimeRDGMLExtensionsForVulkanModelShaped::FTensorInfoShaped ShapedTensorInfo;
-		ShapedTensorInfo.VulkanDesc = UnshapedTensorInfo.VulkanDesc;
-		if (UnshapedTensorInfo.ModelInputIdx != -1)
+		auto GetShape = [&](uint32 TensorId) {
+			const FModelFormat::FShape& Shape = TensorShapes[PreShapedModel.FirstTensorShape + TensorId];
+			return Dimensions.Slice(Shape.FirstDimension, Shape.NumDimensions);
+		};
+
+		bool bMatches = true;
+		for (int B = 0; bMatches && B < SegmentUnshaped.Bindings.Num(); ++B)
 		{
-			// This is a model input, so the concrete shape is provided directly (no shape inference necessary).
-			ShapedTensorInfo.ShapeRawS64 = ModelInputShapes[UnshapedTensorInfo.ModelInputIdx].GetData();
+			if (SegmentUnshaped.Bindings[B].BindingKind == FSegmentUnshaped::FBinding::EBindingKind::Input)
+			{
+				const TConstArrayView<int64> Shape = GetShape(SegmentUnshaped.Bindings[B].TensorId);
+				bMatches = Shape.Num() == BindingShapes[B].Num();
+				for (int32 DimIdx = 0; bMatches && DimIdx < Shape.Num(); ++DimIdx)
+				{
+					bMatches = Shape[DimIdx] == BindingShapes[B][DimIdx];
+				}
+			}
+		}
+		if (!bMatches)
+		{
+			continue;
 		}
-		ShapedTensorInfo.VulkanDesc.pDimensions = ShapedTensorInfo.ShapeRawS64.GetData(); // Important to update the VkTensorDescription as the array data may have changed!
-		// .NumBytes is filled in later, once we know all the tensor shapes.
-		ShapedModel->TensorInfosShaped.Add(MoveTemp(ShapedTensorInfo));
-	}
 
+		OutResults.Success = true;
+		for (const FSegmentUnshaped::FBinding& Binding : SegmentUnshaped.Bindings)
+		{
+			if (Binding.BindingKind == FSegmentUnshaped::FBinding::EBindingKind::Output)
+			{
+				uint32_t DescriptorSet = 0; // We assume all bindings are in a single descriptor set.
+				Algo::Transform(GetShape(Binding.TensorId), OutResults.OutputShapes.Add({ DescriptorSet, Binding.VulkanBindingIdx }), [](int64 X) { return (int64_t)X; });
+			}
+		}
+		const FModelFormat::FPreShapedSegment& PreShapedSegment =
+			FModelFormat::GetTable<FModelFormat::FPreShapedSegment>(ModelFormatHeader, ModelFormatHeader->PreShapedSegments)[PreShapedModel.FirstSegment + SegmentIdx];
+		const TConstArrayView<uint32> Code = FModelFormat::GetTable<uint32>(ModelFormatHeader, ModelFormatHeader->PreShapedCode)
+			.Slice((int32)PreShapedSegment.CodeOffset, (int32)PreShapedSegment.CodeNumWords);
+		OutResults.NewCode.Append(Code.GetData(), Code.Num());
+		return true;
+	}
+	return false;
+}
 
+bool FNNERuntimeRDGMLExtensionsForVulkanModelUnshaped::InferTensorShapes(TConstArrayView<UE::NNE::FTensorShape> ModelInputShapes, TArray<TArray<int64_t>>& OutTensorShapes) const
+{
+	OutTensorShapes.Reset();
+	OutTensorShapes.SetNum(TensorInfosUnshaped.Num());
+	for (int T = 0; T < TensorInfosUnshaped.Num(); ++T)
+	{
+		if (TensorInfosUnshaped[T].ModelInputIdx != -1)
+		{
+			Algo::Transform(ModelInputShapes[TensorInfosUnshaped[T].ModelInputIdx].GetData(), OutTensorShapes[T], [](uint32 X) { return (int64_t)X; });
+		}
+		else if (TensorInfosUnshaped[T].bSharedConstant)
+		{
+			OutTensorShapes[T] = TensorInfosUnshaped[T].SharedConstantShape;
+		}
+	}
 
+	// Same as CreateShapedModel, but only the shapes are needed.
 	for (int S = 0; S < SegmentsUnshaped.Num(); ++S)
 	{
 		const FSegmentUnshaped& SegmentUnshaped = SegmentsUnshaped[S];
 
-		FNNERuntimeRDGMLExtensionsForVulkanModelShaped::FSegmentShaped SegmentShaped;
-		// For now we only support shape inference for SPIR-V segments (not compute segments)
-		// Map of input shapes for this segment.
-		TMap<TPair<uint32_t, uint32_t>, TArray<int64_t>> SegmentInputShapes;
-		for (int B = 0; B < SegmentUnshaped.Bindings.Num(); ++B)
+		TArray<TArray<int64_t>> BindingShapes;
+		FDescriptorSetBindingToShapeMap SegmentInputShapes;
+		for (const FSegmentUnshaped::FBinding& Binding : SegmentUnshaped.Bindings)
 		{
-			if (SegmentUnshaped.Bindings[B].BindingKind == FSegmentUnshaped::FBinding::EBindingKind::Input)
+			if (Binding.BindingKind == FSegmentUnshaped::FBinding::EBindingKind::Input)
 			{
 				uint32_t DescriptorSet = 0; // We assume all bindings are in a single descriptor set.
-				uint32_t VulkanBindingIdx = SegmentUnshaped.Bindings[B].VulkanBindingIdx;
-				SegmentInputShapes.Add({ DescriptorSet , VulkanBindingIdx }, ShapedModel->TensorInfosShaped[SegmentUnshaped.Bindings[B].TensorId].ShapeRawS64);
+				SegmentInputShapes.Add({ DescriptorSet, Binding.VulkanBindingIdx }, OutTensorShapes[Binding.TensorId]);
+				BindingShapes.Add(OutTensorShapes[Binding.TensorId]);
+			}
+			else
+			{
+				BindingShapes.AddDefaulted();
 			}
 		}
 
-		// Run shape inference using SPIRV-Tools.
-		ShapeInferenceResults ShapeInferenceResults = RunShapeInference(SegmentUnshaped.SPIRVCode, SegmentInputShapes);
-
+		ShapeInferenceResults ShapeInferenceResults{ false };
+		if (!FindPreShapedSegment(S, BindingShapes, ShapeInferenceResults))
+		{
+			ShapeInferenceResults = FNNERuntimeRDGMLExtensionsForVulkanShapeInferenceCache::Get().RunShapeInference(SegmentUnshaped.SPIRVCode, SegmentInputShapes);
+		}
 		if (!ShapeInferenceResults.Success)
 		{
 			UE_LOG(LogNNERuntimeRDGMLExtensionsForVulkan, Error, TEXT("Shape inference failed"));
-			return nullptr;
+			return false;
 		}
 
-		for (int B = 0; B < SegmentUnshaped.Bindings.Num(); ++B)
+		for (const FSegmentUnshaped::FBinding& Binding : SegmentUnshaped.Bindings)
 		{
-			if (SegmentUnshaped.Bindings[B].BindingKind == FSegmentUnshaped::FBinding::EBindingKind::Output)
+			if (Binding.BindingKind == FSegmentUnshaped::FBinding::EBindingKind::Output)
 			{
 				uint32_t DescriptorSet = 0; // We assume all bindings are in a single descriptor set.
-				uint32_t VulkanBindingIdx = SegmentUnshaped.Bindings[B].VulkanBindingIdx;
-				FNNERuntimeRDGMLExtensionsForVulkanModelShaped::FTensorInfoShaped& TensorInfoShaped = ShapedModel->TensorInfosShaped[SegmentUnshaped.Bindings[B].TensorId];
-				TensorInfoShaped.ShapeRawS64 = *ShapeInferenceResults.OutputShapes.Find(TPair<uint32_t, uint32_t>{ DescriptorSet, VulkanBindingIdx });
-				TensorInfoShaped.VulkanDesc.pDimensions = TensorInfoShaped.ShapeRawS64.GetData(); // Important to update the VkTensorDescription as the array data will have changed!
+				const TArray<int64_t>* OutputShape = ShapeInferenceResults.OutputShapes.Find({ DescriptorSet, Binding.VulkanBindingIdx });
+				if (OutputShape == nullptr)
+				{
+					UE_LOG(LogNNERuntimeRDGMLExtensionsForVulkan, Error, TEXT("Shape inference didn't give a shape for output binding %u of segment %s."), Binding.VulkanBindingIdx, *SegmentUnshaped.Name);
+					return false;
+				}
+				OutTensorShapes[Binding.TensorId] = *OutputShape;
 			}
 		}
+	}
+	return true;
+}
 
-		// Now that we have the concrete tensor shapes for this segment, we can create the Vulkan pipeline etc.
-		TArray<VkDataGraphPipelineConstantARM> DataGraphPipelineConstants;
-		Algo::Transform(SegmentUnshaped.ConstantInfos, DataGraphPipelineConstants, [](const auto& x) { return x.DataGraphPipelineConstant; });
-
-		TArray<VkDataGraphPipelineResourceInfoARM> DataGraphPipelineResourcesInfos;
-		DataGraphPipelineResourcesInfos.Reserve(SegmentUnshaped.Bindings.Num());
-		for (int B = 0; B < SegmentUnshaped.Bindings.Num(); ++B)
+bool FNNERuntimeRDGMLExtensionsForVulkanModelUnshaped::InferOutputTensorShapes(TConstArrayView<UE::NNE::FTensorShape> ModelInputShapes, TArray<UE::NNE::FTensorShape>& OutOutputShapes)
+{
+	OutOutputShapes.Reset();
+	if (ModelInputShapes.Num() != InputSymbolicTensors.Num())
+	{
+		UE_LOG(LogNNERuntimeRDGMLExtensionsForVulkan, Error, TEXT("Expected %d input shapes but got %d."), InputSymbolicTensors.Num(), ModelInputShapes.Num());
+		return false;
+	}
+	for (int32 InputIdx = 0; InputIdx < ModelInputShapes.Num(); ++InputIdx)
+	{
+		if (!ModelInputShapes[InputIdx].IsCompatibleWith(InputSymbolicTensors[InputIdx].GetShape()))
 		{
-			const FSegmentUnshaped::FBinding& Binding = SegmentUnshaped.Bindings[B];
-
-			VkDataGraphPipelineResourceInfoARM ResourceInfo = {};
-			ResourceInfo.sType = VK_STRUCTURE_TYPE_DATA_GRAPH_PIPELINE_RESOURCE_INFO_ARM;
-			ResourceInfo.descriptorSet = 0; // We assume that all bindings are in a single descriptor set.
-			ResourceInfo.binding = Binding.VulkanBindingIdx;
-			ResourceInfo.pNext = &ShapedModel->TensorInfosShaped[Binding.TensorId].VulkanDesc;
-			DataGraphPipelineResourcesInfos.Add(ResourceInfo);
+			UE_LOG(LogNNERuntimeRDGMLExtensionsForVulkan, Error, TEXT("Shape of input %d is not compatible with the model."), InputIdx);
+			return false;
 		}
+	}
 
-		// Run the Vulkan resource creation functions on the RHI thread and wait for them to complete.
-		FEvent* RenderThreadDoneEvent = FGenericPlatformProcess::GetSynchEventFromPool(true);
-		ENQUEUE_RENDER_COMMAND(NNERuntimeRDGMLExtensionsForVulkanModel_CreateSegment)([&](FRHICommandListImmediate& RHICmdList) {
-			RHICmdList.EnqueueLambda([&](FRHICommandListImmediate& RHICmdList) {
-				VkDevice Device = GetIVulkanDynamicRHI()->RHIGetVkDevice();
-				const VkAllocationCallbacks* Allocator = GetIVulkanDynamicRHI()->RHIGetVkAllocationCallbacks();
-
-				// Shader module
-				VkShaderModuleCreateInfo GraphShaderModuleCreateInfo = {};
-				GraphShaderModuleCreateInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-				GraphShaderModuleCreateInfo.codeSize = ShapeInferenceResults.NewCode.Num() * sizeof(ShapeInferenceResults.NewCode[0]);
-				GraphShaderModuleCreateInfo.pCode = ShapeInferenceResults.NewCode.GetData();
-				VERIFYVULKANRESULT(vkCreateShaderModule_p(Device, &GraphShaderModuleCreateInfo, Allocator, &SegmentShaped.ShaderModule));
-
-				// Data graph pipeline
-				VkDataGraphPipelineShaderModuleCreateInfoARM DataGraphPipelineShaderModuleCreateInfo = {};
-				DataGraphPipelineShaderModuleCreateInfo.sType = VK_STRUCTURE_TYPE_DATA_GRAPH_PIPELINE_SHADER_MODULE_CREATE_INFO_ARM;
-				DataGraphPipelineShaderModuleCreateInfo.module = SegmentShaped.ShaderModule;
-				DataGraphPipelineShaderModuleCreateInfo.pName = SegmentUnshaped.SPIRVEntryPoint;
-				DataGraphPipelineShaderModuleCreateInfo.constantCount = DataGraphPipelineConstants.Num();
-				DataGraphPipelineShaderModuleCreateInfo.pConstants = DataGraphPipelineConstants.GetData();
-
-				VkDataGraphPipelineCreateInfoARM DataGraphPipelineCreateInfo = {};
-				DataGraphPipelineCreateInfo.sType = VK_STRUCTURE_TYPE_DATA_GRAPH_PIPELINE_CREATE_INFO_ARM;
-				DataGraphPipelineCreateInfo.layout = SegmentUnshaped.PipelineLayout;
-				DataGraphPipelineCreateInfo.resourceInfoCount = DataGraphPipelineResourcesInfos.Num();
-				DataGraphPipelineCreateInfo.pResourceInfos = DataGraphPipelineResourcesInfos.GetData();
-				DataGraphPipelineCreateInfo.pNext = &DataGraphPipelineShaderModuleCreateInfo;
-
-				VERIFYVULKANRESULT(vkCreateDataGraphPipelinesARM_p(Device, VK_NULL_HANDLE, VK_NULL_HANDLE, 1, &DataGraphPipelineCreateInfo, Allocator, &SegmentShaped.Pipeline));
-				});
-			RHICmdList.ImmediateFlush(EImmediateFlushType::FlushRHIThread);
-			RenderThreadDoneEvent->Trigger();
-			});
-		RenderThreadDoneEvent->Wait();
-		FGenericPlatformProcess::ReturnSynchEventToPool(RenderThreadDoneEvent);
+	// Shape inference reads the model data, so hold this for the rest of the function so that Freeze can't release the data under us.
+	// If the model hasn't been frozen by the time we have the lock, Freeze waits for us before releasing anything.
+	FReadScopeLock ModelDataReadLock(ModelDataLock);
 
-		ShapedModel->SegmentsShaped.Add(MoveTemp(SegmentShaped));
+	// A shaped model might already exist for these shapes. Once the model has been frozen, that and the results remembered below are
+	// the only options, as shape inference needs the model data.
+	bool bIsFrozen = false;
+	{
+		FScopeLock Lock(&ShapedModelsCriticalSection);
+		const TWeakPtr<FNNERuntimeRDGMLExtensionsForVulkanModelShaped>* CacheHit = ShapedModels.Find(TArray<UE::NNE::FTensorShape>(ModelInputShapes));
+		if (TSharedPtr<FNNERuntimeRDGMLExtensionsForVulkanModelShaped> ShapedModel = CacheHit != nullptr ? CacheHit->Pin() : nullptr)
+		{
+			OutOutputShapes = ShapedModel->OutputTensorShapes;
+			return true;
+		}
+		bIsFrozen = bFrozen;
 	}
 
-	// Fill in model output tensor shapes.
-	ShapedModel->OutputTensorShapes.AddDefaulted(OutputSymbolicTensors.Num());
-	for (int T = 0; T < TensorInfosUnshaped.Num(); ++T)
+	// Results are remembered, so that asking again (even after Freeze) doesn't redo the shape inference.
+	const TArray<UE::NNE::FTensorShape> Key(ModelInputShapes);
 	{
-		if (TensorInfosUnshaped[T].ModelOutputIdx != -1)
+		FScopeLock Lock(&InferredOutputShapesCriticalSection);
+		if (const TArray<UE::NNE::FTensorShape>* Inferred = InferredOutputShapes.Find(Key))
 		{
-			TArray<uint32_t> TensorShapeU32;
-			Algo::Transform(ShapedModel->TensorInfosShaped[T].ShapeRawS64, TensorShapeU32, [](uint64_t x) { return x; });
-			ShapedModel->OutputTensorShapes[TensorInfosUnshaped[T].ModelOutputIdx] = UE::NNE::FTensorShape::Make(TensorShapeU32);
+			OutOutputShapes = *Inferred;
+			return true;
 		}
 	}
 
-	// Calculate NumBytes for each FTensorInfoShaped.
-	for (FNNERuntimeRDGMLExtensionsForVulkanModelShaped::FTensorInfoShaped& TensorInfoShaped : ShapedModel->TensorInfosShaped)
+	if (bIsFrozen)
 	{
-		size_t NumBytesPerElement = Private::GetNumBytesPerElement(TensorInfoShaped.VulkanDesc.format);
-		if (NumBytesPerElement == 0)
+		UE_LOG(LogNNERuntimeRDGMLExtensionsForVulkan, Error, TEXT("Can't use new input shapes with a model that has been frozen."));
+		return false;
+	}
+	TArray<TArray<int64_t>> TensorShapes;
+	if (!InferTensorShapes(ModelInputShapes, TensorShapes))
+	{
+		return false;
+	}
+	OutOutputShapes.SetNum(OutputSymbolicTensors.Num());
+	for (int T = 0; T < TensorInfosUnshaped.Num(); ++T)
+	{
+		if (TensorInfosUnshaped[T].ModelOutputIdx != -1)
 		{
-			UE_LOG(LogNNERuntimeRDGMLExtensionsForVulkan, Error, TEXT("Unsupported input/output/intermediate data type: %u"), TensorInfoShaped.VulkanDesc.format);
-			return nullptr;
+			TArray<uint32> Dims;
+			Algo::Transform(TensorShapes[T], Dims, [](int64_t X) { return (uint32)X; });
+			OutOutputShapes[TensorInfosUnshaped[T].ModelOutputIdx] = UE::NNE::FTensorShape::Make(Dims);
 		}
-		TensorInfoShaped.NumBytes = NumBytesPerElement * Algo::Accumulate(TensorInfoShaped.ShapeRawS64, 1, [](uint64_t Acc, uint64_t X) { return Acc * X; });
 	}
 
-	// Save in cache for future reuse.
-	ShapedModels.Add(TArray<UE::NNE::FTensorShape>(ModelInputShapes), ShapedModel);
-	return ShapedModel;
+	FScopeLock Lock(&InferredOutputShapesCriticalSection);
+	if (InferredOutputShapes.Num() >= MAX_INFERRED_OUTPUT_SHAPES)
+	{
+		// Later entries reuse the slots of removed ones, so the first entry is only roughly the oldest, which is good enough here.
+		InferredOutputShapes.CreateIterator().RemoveCurrent();
+	}
+	InferredOutputShapes.Add(Key, OutOutputShapes);
+	return true;
 }
 
-FNNERuntimeRDGMLExtensionsForVulkanModelShaped::~FNNERuntimeRDGMLExtensionsForVulkanModelShaped()
+FNNERuntimeRDGMLExtensionsForVulkanSegmentShaped::~FNNERuntimeRDGMLExtensionsForVulkanSegmentShaped()
 {
-	// Destroy Vulkan resources on the RHI thread and wait for that to finish.
-	FEvent* RenderThreadDoneEvent = FGenericPlatformProcess::GetSynchEventFromPool(true);
-	ENQUEUE_RENDER_COMMAND(NNERuntimeRDGMLExtensionsForVulkanModel_DestroySegments)([&](FRHICommandListImmediate& RHICmdList) {
-		RHICmdList.EnqueueLambda([&](FRHICommandListImmediate& RHICmdList) {
-			VkDevice Device = GetIVulkanDynamicRHI()->RHIGetVkDevice();
-			const VkAllocationCallbacks* Allocator = GetIVulkanDynamicRHI()->RHIGetVkAllocationCallbacks();
+	// Segments are only freed along with the last shaped model using them, and model instances only release their reference to the
+	// shaped model once their executions have retired (see UnsetInputTensorShapes_RenderThread), so there is no fence to wait for.
+	FNNERuntimeRDGMLExtensionsForVulkanDeferredDeletionQueue::Get().Enqueue([Pipeline = Pipeline, ShaderModule = ShaderModule](VkDevice Device, const VkAllocationCallbacks* Allocator) {
+		vkDestroyPipeline_p(Device, Pipeline, Allocator);
+		vkDestroyShaderModule_p(Device, ShaderModule, Allocator);
+	});
+}
 
-			for (FSegmentShaped& S : SegmentsShaped)
-			{
-				vkDestroyPipeline_p(Device, S.Pipeline, Allocator);
-				vkDestroyShaderModule_p(Device, S.ShaderModule, Allocator);
-			}
+void FNNERuntimeRDGMLExtensionsForVulkanModelInstance::EnqueueWarmUpDispatch_RenderThread(FRHICommandListImmediate& RHICmdList)
+{
+	check(IsInRenderingThread());
 
-		});
-		RHICmdList.ImmediateFlush(EImmediateFlushType::FlushRHIThread);
-		RenderThreadDoneEvent->Trigger();
-	});
+	FRDGBuilder RDGBuilder(RHICmdList, RDG_EVENT_NAME("FNNERuntimeRDGMLExtensionsForVulkanModelInstance_WarmUpDispatch"));
+
+	TArray<UE::NNE::FTensorBindingRDG> Inputs;
+	TArray<UE::NNE::FTensorBindingRDG> Outputs;
+	Inputs.AddDefaulted(ParentModelShaped->InputTensorShapes.Num());
+	Outputs.AddDefaulted(ParentModelShaped->OutputTensorShapes.Num());
+	for (int T = 0; T < ParentModelUnshaped->TensorInfosUnshaped.Num(); ++T)
+	{
+		const FNNERuntimeRDGMLExtensionsForVulkanModelUnshaped::FTensorInfoUnshaped& TensorInfoUnshaped = ParentModelUnshaped->TensorInfosUnshaped[T];
+		if (TensorInfoUnshaped.IsIntermediate() || TensorInfoUnshaped.bSharedConstant)
+		{
+			continue;
+		}
+
+		FRDGBufferDesc BufferDesc = FRDGBufferDesc::CreateByteAddressDesc(ParentModelShaped->TensorInfosShaped[T].NumBytes);
+		FRDGBufferRef Buffer = RDGBuilder.CreateBuffer(BufferDesc, TEXT("FNNERuntimeRDGMLExtensionsForVulkanModelInstance_WarmUp"));
+		if (TensorInfoUnshaped.ModelInputIdx >= 0)
+		{
+			// The contents don't matter, but RDG doesn't allow reading a buffer that has never been written.
+			AddClearUAVPass(RDGBuilder, RDGBuilder.CreateUAV(Buffer), 0u);
+			Inputs[TensorInfoUnshaped.ModelInputIdx].Buffer = Buffer;
+		}
+		else
+		{
+			Outputs[TensorInfoUnshaped.ModelOutputIdx].Buffer = Buffer;
+		}
+	}
 
-	RenderThreadDoneEvent->Wait();
-	FGenericPlatformProcess::ReturnSynchEventToPool(RenderThreadDoneEvent);
+	EnqueueRDG(RDGBuilder, Inputs, Outputs);
+	RDGBuilder.Execute();
 }
 
+uint32 FNNERuntimeRDGMLExtensionsForVulkanModelShaped::GetPipelines(TArray<VkPipeline>& OutPipelines) const
+{
+	// Each segment's version only ever goes up, so the sum changes whenever any of them do.
+	uint32 Version = 0;
+	OutPipelines.Reset(SegmentsShaped.Num());
+	for (const TSharedPtr<FNNERuntimeRDGMLExtensionsForVulkanSegmentShaped>& S : SegmentsShaped)
+	{
+		FScopeLock Lock(&S->PipelinesCriticalSection);
+		OutPipelines.Add(S->Pipeline);
+		Version += S->PipelinesVersion;
+	}
+	return Version;
+}
 
 FNNERuntimeRDGMLExtensionsForVulkanModelInstance::~FNNERuntimeRDGMLExtensionsForVulkanModelInstance()
 {
-	UnsetInputTensorShapes();
-
-	// Destroy Vulkan resources on the RHI thread, and wait for that to finish.
-	FEvent* RenderThreadDoneEvent = FGenericPlatformProcess::GetSynchEventFromPool(true);
-	ENQUEUE_RENDER_COMMAND(NNERuntimeRDGMLExtensionsForVulkanModel_DestroySegments)([&](FRHICommandListImmediate& RHICmdList) {
-		check(InFlightExecutions.IsEmpty());
-		// Destroy resources
-		RHICmdList.EnqueueLambda([&](FRHICommandListImmediate& RHICmdList) {
-			VkDevice Device = GetIVulkanDynamicRHI()->RHIGetVkDevice();
-			const VkAllocationCallbacks* Allocator = GetIVulkanDynamicRHI()->RHIGetVkAllocationCallbacks();
+	// The RDG passes and render commands that use this instance all hold a reference to it, so by the time we get here nothing
+	// else can be touching the members below, but the GPU might still be running the most recent executions.
+	// Hand everything off to the deferred deletion queue, along with the parent models so that they outlive these objects.
+	FNNERuntimeRDGMLExtensionsForVulkanDeferredDeletionQueue::Get().Enqueue([TensorObjectCache = TensorObjectCache, SegmentInstances = MoveTemp(SegmentInstances),
+		DescriptorPool = DescriptorPool, ParentModelShaped = MoveTemp(ParentModelShaped), ParentModelUnshaped = MoveTemp(ParentModelUnshaped)](VkDevice Device, const VkAllocationCallbacks* Allocator) mutable {
+		// This includes the tensors and views used by the in-flight executions.
+		TensorObjectCache->DestroyAllEntries(Device, Allocator);
+		for (FSegmentInstance& S : SegmentInstances)
+		{
+			vkDestroyDataGraphPipelineSessionARM_p(Device, S.DataGraphPipelineSession, Allocator);
+		}
+		// This also frees any descriptor sets that are still allocated from it.
+		vkDestroyDescriptorPool_p(Device, DescriptorPool, Allocator);
 
-			vkDestroyDescriptorPool_p(Device, DescriptorPool, Allocator);
-			DescriptorPool = VK_NULL_HANDLE;
-		});
+		SegmentInstances.Empty();
+		ParentModelShaped.Reset();
+		ParentModelUnshaped.Reset();
+	}, GetLastUseFence());
+}
 
-		RHICmdList.ImmediateFlush(EImmediateFlushType::FlushRHIThread);
-		RenderThreadDoneEvent->Trigger();
-	});
+FNNERuntimeRDGMLExtensionsForVulkanModelInstance::ESetInputTensorShapesStatus FNNERuntimeRDGMLExtensionsForVulkanModelInstance::SetInputTensorShapes(TConstArrayView<UE::NNE::FTensorShape> InInputShapes)
+{
+	// A superseded request means that another thread set different shapes at the same time, which is as if the calls had been made
+	// one after the other (in which case we'd have returned Ok before the other call replaced our shapes).
+	if (!IsInRenderingThread())
+	{
+		return SetInputTensorShapesAsync(InInputShapes).Get() == EShapesRequestStatus::Failed ? ESetInputTensorShapesStatus::Fail : ESetInputTensorShapesStatus::Ok;
+	}
+
+	// The asynchronous version finishes on the rendering thread, so waiting for it here would never return. Instead do all the work
+	// inline, which blocks the rendering thread while any shape inference and pipeline compilation is done (as the caller asked for).
+	uint64 RequestId;
+	if (!BeginShapesRequest(InInputShapes, RequestId))
+	{
+		return ESetInputTensorShapesStatus::Ok;
+	}
+
+	TSharedPtr<FNNERuntimeRDGMLExtensionsForVulkanModelShaped> NewParentModelShaped = ParentModelUnshaped->FindOrCreateShapedModel(InInputShapes);
+	if (NewParentModelShaped == nullptr)
+	{
+		// There might have been an error doing shape inference, e.g. an invalid shape provided.
+		UE_LOG(LogNNERuntimeRDGMLExtensionsForVulkan, Error, TEXT("Failed to infer shapes."));
+	}
+
+	TArray<VkPipeline> Pipelines;
+	const uint32 NewPipelinesVersion = NewParentModelShaped ? NewParentModelShaped->GetPipelines(Pipelines) : 0;
+	TArray<FSegmentInstance> NewSegmentInstances;
+	TArray<VkMemoryRequirements> PipelineSessionMemoryRequirements; // One per segment
+	CreatePipelineSessions(Pipelines, NewSegmentInstances, PipelineSessionMemoryRequirements);
 
-	RenderThreadDoneEvent->Wait();
-	FGenericPlatformProcess::ReturnSynchEventToPool(RenderThreadDoneEvent);
+	const EShapesRequestStatus Status = ApplyShapesRequest_RenderThread(FRHICommandListExecutor::GetImmediateCommandList(), RequestId,
+		MoveTemp(NewParentModelShaped), NewPipelinesVersion, MoveTemp(NewSegmentInstances), PipelineSessionMemoryRequirements);
+	return Status == EShapesRequestStatus::Failed ? ESetInputTensorShapesStatus::Fail : ESetInputTensorShapesStatus::Ok;
 }
 
-FNNERuntimeRDGMLExtensionsForVulkanModelInstance::ESetInputTensorShapesStatus FNNERuntimeRDGMLExtensionsForVulkanModelInstance::SetInputTensorShapes(TConstArrayView<UE::NNE::FTensorShape> InInputShapes)
+bool FNNERuntimeRDGMLExtensionsForVulkanModelInstance::BeginShapesRequest(TConstArrayView<UE::NNE::FTensorShape> InInputShapes, uint64& OutRequestId)
+{
+	FScopeLock Lock(&ShapesRequestCriticalSection);
+
+	// If these are the same shapes that we already have (and there isn't a different request on its way) then there's nothing to do.
+	// Note that this is a cheap compare, so callers can set the shapes every frame without worrying.
+	if (NumPendingShapesRequests == 0 && ParentModelShaped.IsValid() && Algo::Compare(AppliedInputShapes, InInputShapes))
+	{
+		return false;
+	}
+	OutRequestId = ++LastShapesRequestId;
+	++NumPendingShapesRequests;
+	return true;
+}
+
+TFuture<FNNERuntimeRDGMLExtensionsForVulkanModelInstance::EShapesRequestStatus> FNNERuntimeRDGMLExtensionsForVulkanModelInstance::SetInputTensorShapesAsync(TConstArrayView<UE::NNE::FTensorShape> InInputShapes)
 {
-	// This instance might already have been given a shape! In which case we might need to destroy the old set of things and recreate them.
-	UnsetInputTensorShapes();
-	
+	uint64 RequestId;
+	if (!BeginShapesRequest(InInputShapes, RequestId))
+	{
+		return MakeFulfilledPromise<EShapesRequestStatus>(EShapesRequestStatus::Applied).GetFuture();
+	}
+
+	TSharedRef<TPromise<EShapesRequestStatus>> Promise = MakeShared<TPromise<EShapesRequestStatus>>();
+	TFuture<EShapesRequestStatus> Result = Promise->GetFuture();
+
 	// This is the first time that we could know the concrete shapes for all tensors, so we now need to run shape inference
 	// through all the segments to determine all tensor shapes. This has to be done before we can create data graph pipelines etc.
 	// We may already have performed shape inference on this model with the exact same input shapes, in which case we avoid doing it
 	// again and instead share the same Shaped Model.
-	ParentModelShaped = ParentModelUnshaped->FindOrCreateShapedModel(InInputShapes);
-	if (ParentModelShaped == nullptr)
-	{
-		// There might have been an error doing shape inference, e.g. an invalid shape provided.
-		UE_LOG(LogNNERuntimeRDGMLExtensionsForVulkan, Error, TEXT("Failed to infer shapes."));
-		return ESetInputTensorShapesStatus::Fail;
-	}
+	ParentModelUnshaped->FindOrCreateShapedModelAsync(InInputShapes).Then([This = this->AsShared(), Promise, RequestId](TFuture<TSharedPtr<FNNERuntimeRDGMLExtensionsForVulkanModelShaped>> ShapedModelFuture) {
+		TSharedPtr<FNNERuntimeRDGMLExtensionsForVulkanModelShaped> NewParentModelShaped = ShapedModelFuture.Get();
+		if (NewParentModelShaped == nullptr)
+		{
+			// There might have been an error doing shape inference, e.g. an invalid shape provided.
+			UE_LOG(LogNNERuntimeRDGMLExtensionsForVulkan, Error, TEXT("Failed to infer shapes."));
+		}
 
-	// Now we can allocate inference-specific vulkan objects.
-	TArray<FBufferRHIRef> PipelineSessionMemoryBuffers; // One per segment, stored temporarily until we can put them into FRDGPooledBuffers
+		// Now we can allocate inference-specific vulkan objects. The pipeline sessions can be created here on the worker thread, 
+		// but the memory for them has to be allocated through the RHI on the rendering thread.
+		TArray<VkPipeline> Pipelines;
+		const uint32 NewPipelinesVersion = NewParentModelShaped ? NewParentModelShaped->GetPipelines(Pipelines) : 0;
+		TArray<FSegmentInstance> NewSegmentInstances;
+		TArray<VkMemoryRequirements> PipelineSessionMemoryRequirements; // One per segment
+		CreatePipelineSessions(Pipelines, NewSegmentInstances, PipelineSessionMemoryRequirements);
+
+		ENQUEUE_RENDER_COMMAND(NNERuntimeRDGMLExtensionsForVulkanModel_SetInputTensorShapes)([This, Promise, RequestId, NewParentModelShaped, NewPipelinesVersion,
+			NewSegmentInstances = MoveTemp(NewSegmentInstances), PipelineSessionMemoryRequirements = MoveTemp(PipelineSessionMemoryRequirements)](FRHICommandListImmediate& RHICmdList) mutable {
+			Promise->SetValue(This->ApplyShapesRequest_RenderThread(RHICmdList, RequestId, MoveTemp(NewParentModelShaped), NewPipelinesVersion,
+				MoveTemp(NewSegmentInstances), PipelineSessionMemoryRequirements));
+		});
+	});
 
-	// Create vulkan resources for this instance, using the common resources from the parent model.
-	// Run the Vulkan resource creation functions on the RHI thread and wait for them to complete.
-	FEvent* RenderThreadDoneEvent = FGenericPlatformProcess::GetSynchEventFromPool(true);
-	ENQUEUE_RENDER_COMMAND(NNERuntimeRDGMLExtensionsForVulkanModel_DestroySegments)([&](FRHICommandListImmediate& RHICmdList) {
-		RHICmdList.EnqueueLambda([&](FRHICommandListImmediate& RHICmdList) {
-			VkDevice Device = GetIVulkanDynamicRHI()->RHIGetVkDevice();
-			const VkAllocationCallbacks* Allocator = GetIVulkanDynamicRHI()->RHIGetVkAllocationCallbacks();
+	return Result;
+}
+
+FNNERuntimeRDGMLExtensionsForVulkanModelInstance::EShapesRequestStatus FNNERuntimeRDGMLExtensionsForVulkanModelInstance::ApplyShapesRequest_RenderThread(
+	FRHICommandListImmediate& RHICmdList, uint64 RequestId, TSharedPtr<FNNERuntimeRDGMLExtensionsForVulkanModelShaped> NewParentModelShaped,
+	uint32 NewPipelinesVersion, TArray<FSegmentInstance> NewSegmentInstances, TConstArrayView<VkMemoryRequirements> PipelineSessionMemoryRequirements)
+{
+	check(IsInRenderingThread());
+	BindPipelineSessionMemory_RenderThread(RHICmdList, NewSegmentInstances, PipelineSessionMemoryRequirements);
 
-			uint32 NumDescriptors = 0;
-			for (int S = 0; S < ParentModelUnshaped->SegmentsUnshaped.Num(); ++S)
+	FScopeLock Lock(&ShapesRequestCriticalSection);
+	--NumPendingShapesRequests;
+	if (RequestId < AppliedShapesRequestId)
+	{
+		// A later call to SetInputTensorShapes has already been applied (or has failed, which clears the shapes), so these shapes are
+		// out of date. The new sessions have never been used by the GPU so can be destroyed straight away (well, after a few frames,
+		// via the queue). The shaped model is kept alive until then too, as the sessions reference its pipelines.
+		const EShapesRequestStatus Status = NewParentModelShaped ? EShapesRequestStatus::Superseded : EShapesRequestStatus::Failed;
+		FNNERuntimeRDGMLExtensionsForVulkanDeferredDeletionQueue::Get().Enqueue([NewSegmentInstances = MoveTemp(NewSegmentInstances),
+			NewParentModelShaped = MoveTemp(NewParentModelShaped)](VkDevice Device, const VkAllocationCallbacks* Allocator) mutable {
+			for (FSegmentInstance& S : NewSegmentInstances)
 			{
-				const FNNERuntimeRDGMLExtensionsForVulkanModelUnshaped::FSegmentUnshaped& SegmentUnshaped = ParentModelUnshaped->SegmentsUnshaped[S];
-				const FNNERuntimeRDGMLExtensionsForVulkanModelShaped::FSegmentShaped& SegmentShaped = ParentModelShaped->SegmentsShaped[S];
-				FNNERuntimeRDGMLExtensionsForVulkanModelInstance::FSegmentInstance SegmentInstance;
-
-				// Data graph pipeline session.
-				VkDataGraphPipelineSessionCreateInfoARM DataGraphPipelineSessionCreateInfo = {};
-				DataGraphPipelineSessionCreateInfo.sType = VK_STRUCTURE_TYPE_DATA_GRAPH_PIPELINE_SESSION_CREATE_INFO_ARM;
-				DataGraphPipelineSessionCreateInfo.dataGraphPipeline = SegmentShaped.Pipeline;
-				VERIFYVULKANRESULT(vkCreateDataGraphPipelineSessionARM_p(Device, &DataGraphPipelineSessionCreateInfo, Allocator, &SegmentInstance.DataGraphPipelineSession));
-
-				// Find how much memory we need to allocate for the pipeline session.
-				VkDataGraphPipelineSessionMemoryRequirementsInfoARM DataGraphPipelineSessionMemoryRequirementsInfo = {};
-				DataGraphPipelineSessionMemoryRequirementsInfo.sType = VK_STRUCTURE_TYPE_DATA_GRAPH_PIPELINE_SESSION_MEMORY_REQUIREMENTS_INFO_ARM;
-				DataGraphPipelineSessionMemoryRequirementsInfo.session = SegmentInstance.DataGraphPipelineSession;
-
-				VkMemoryRequirements2 DataGraphPipelineSessionMemoryRequirements = {};
-				DataGraphPipelineSessionMemoryRequirements.sType = VK_STRUCTURE_TYPE_MEMORY_REQUIREMENTS_2;
-				vkGetDataGraphPipelineSessionMemoryRequirementsARM_p(Device, &DataGraphPipelineSessionMemoryRequirementsInfo, &DataGraphPipelineSessionMemoryRequirements);
-
-				// There doesn't seem to be a publicly exposed way to allocate Vulkan memory,
-				// so we allocate a buffer and then get its backing memory to use as our own.
-				const FRHIBufferDesc BufferDesc = FRHIBufferDesc(DataGraphPipelineSessionMemoryRequirements.memoryRequirements.size, 0, EBufferUsageFlags::UnorderedAccess | EBufferUsageFlags::ByteAddressBuffer);
-				FRHIResourceCreateInfo CreateInfo(TEXT("FNNERuntimeRDGMLExtensionsForVulkanModelInstance_PipelineSessionMemory"));
-				FBufferRHIRef PipelineSessionMemoryBuffer = GetIVulkanDynamicRHI()->RHICreateBuffer(RHICmdList, BufferDesc, ERHIAccess::SRVCompute, CreateInfo);
-				FVulkanRHIAllocationInfo AllocInfo = GetIVulkanDynamicRHI()->RHIGetAllocationInfo(PipelineSessionMemoryBuffer);
-				PipelineSessionMemoryBuffers.Push(PipelineSessionMemoryBuffer);
-
-
-				VkBindDataGraphPipelineSessionMemoryInfoARM BindDataGraphPipelineSessionMemoryInfo = {};
-				BindDataGraphPipelineSessionMemoryInfo.sType = VK_STRUCTURE_TYPE_BIND_DATA_GRAPH_PIPELINE_SESSION_MEMORY_INFO_ARM;
-				BindDataGraphPipelineSessionMemoryInfo.memory = AllocInfo.Handle;
-				BindDataGraphPipelineSessionMemoryInfo.memoryOffset = AllocInfo.Offset;
-				BindDataGraphPipelineSessionMemoryInfo.session = SegmentInstance.DataGraphPipelineSession;
-				VERIFYVULKANRESULT(vkBindDataGraphPipelineSessionMemoryARM_p(Device, 1, &BindDataGraphPipelineSessionMemoryInfo));
-
-				SegmentInstances.Add(SegmentInstance);
-
-				// Sum up the total number of descriptors that we will need for all segments.
-				NumDescriptors += SegmentUnshaped.Bindings.Num();
+				vkDestroyDataGraphPipelineSessionARM_p(Device, S.DataGraphPipelineSession, Allocator);
 			}
+			NewSegmentInstances.Empty();
+			NewParentModelShaped.Reset();
 		});
+		return Status;
+	}
+
+	// This instance might already have been given a shape! In which case the old set of things is retired (without waiting
+	// for the executions that are still using them). If the new shapes failed, the instance is left without any shapes (so EnqueueRDG
+	// fails until it's given some). Otherwise the new ones are swapped in, so the next EnqueueRDG uses the new shapes.
+	UnsetInputTensorShapes_RenderThread();
+	AppliedShapesRequestId = RequestId;
+	if (NewParentModelShaped == nullptr)
+	{
+		AppliedInputShapes.Reset();
+		return EShapesRequestStatus::Failed;
+	}
+	SegmentInstances = MoveTemp(NewSegmentInstances);
+	ParentModelShaped = MoveTemp(NewParentModelShaped);
+	PipelinesVersion = NewPipelinesVersion;
+	AppliedInputShapes = ParentModelShaped->InputTensorShapes;
+	return EShapesRequestStatus::Applied;
+}
+
+void FNNERuntimeRDGMLExtensionsForVulkanModelInstance::CreatePipelineSessions(TConstArrayView<VkPipeline> Pipelines, TArray<FSegmentInstance>& OutSegmentInstances,
+	TArray<VkMemoryRequirements>& OutMemoryRequirements)
+{
+	VkDevice Device = GetIVulkanDynamicRHI()->RHIGetVkDevice();
+	const VkAllocationCallbacks* Allocator = GetIVulkanDynamicRHI()->RHIGetVkAllocationCallbacks();
+
+	for (VkPipeline Pipeline : Pipelines)
+	{
+		FSegmentInstance& SegmentInstance = OutSegmentInstances.AddDefaulted_GetRef();
+		SegmentInstance.Pipeline = Pipeline;
+
+		// Data graph pipeline session.
+		VkDataGraphPipelineSessionCreateInfoARM DataGraphPipelineSessionCreateInfo = {};
+		DataGraphPipelineSessionCreateInfo.sType = VK_STRUCTURE_TYPE_DATA_GRAPH_PIPELINE_SESSION_CREATE_INFO_ARM;
+		DataGraphPipelineSessionCreateInfo.dataGraphPipeline = Pipeline;
+		VERIFYVULKANRESULT(vkCreateDataGraphPipelineSessionARM_p(Device, &DataGraphPipelineSessionCreateInfo, Allocator, &SegmentInstance.DataGraphPipelineSession));
+
+		// Find how much memory we need to allocate for the pipeline session.
+		VkDataGraphPipelineSessionMemoryRequirementsInfoARM DataGraphPipelineSessionMemoryRequirementsInfo = {};
+		DataGraphPipelineSessionMemoryRequirementsInfo.sType = VK_STRUCTURE_TYPE_DATA_GRAPH_PIPELINE_SESSION_MEMORY_REQUIREMENTS_INFO_ARM;
+		DataGraphPipelineSessionMemoryRequirementsInfo.session = SegmentInstance.DataGraphPipelineSession;
+
+		VkMemoryRequirements2 DataGraphPipelineSessionMemoryRequirements = {};
+		DataGraphPipelineSessionMemoryRequirements.sType = VK_STRUCTURE_TYPE_MEMORY_REQUIREMENTS_2;
+		vkGetDataGraphPipelineSessionMemoryRequirementsARM_p(Device, &DataGraphPipelineSessionMemoryRequirementsInfo, &DataGraphPipelineSessionMemoryRequirements);
+		OutMemoryRequirements.Add(DataGraphPipelineSessionMemoryRequirements.memoryRequirements);
+	}
+}
+
+void FNNERuntimeRDGMLExtensionsForVulkanModelInstance::BindPipelineSessionMemory_RenderThread(FRHICommandListImmediate& RHICmdList, TArray<FSegmentInstance>& InOutSegmentInstances,
+	TConstArrayView<VkMemoryRequirements> MemoryRequirements)
+{
+	check(IsInRenderingThread());
+	VkDevice Device = GetIVulkanDynamicRHI()->RHIGetVkDevice();
 
-		RHICmdList.ImmediateFlush(EImmediateFlushType::FlushRHIThread);
+	for (int S = 0; S < InOutSegmentInstances.Num(); ++S)
+	{
+		// There doesn't seem to be a publicly exposed way to allocate Vulkan memory,
+		// so we allocate a buffer and then get its backing memory to use as our own.
+		const FRHIBufferDesc BufferDesc = FRHIBufferDesc(MemoryRequirements[S].size, 0, EBufferUsageFlags::UnorderedAccess | EBufferUsageFlags::ByteAddressBuffer);
+		FRHIResourceCreateInfo CreateInfo(TEXT("FNNERuntimeRDGMLExtensionsForVulkanModelInstance_PipelineSessionMemory"));
+		FBufferRHIRef PipelineSessionMemoryBuffer = GetIVulkanDynamicRHI()->RHICreateBuffer(RHICmdList, BufferDesc, ERHIAccess::SRVCompute, CreateInfo);
+		FVulkanRHIAllocationInfo AllocInfo = GetIVulkanDynamicRHI()->RHIGetAllocationInfo(PipelineSessionMemoryBuffer);
+
+		VkBindDataGraphPipelineSessionMemoryInfoARM BindDataGraphPipelineSessionMemoryInfo = {};
+		BindDataGraphPipelineSessionMemoryInfo.sType = VK_STRUCTURE_TYPE_BIND_DATA_GRAPH_PIPELINE_SESSION_MEMORY_INFO_ARM;
+		BindDataGraphPipelineSessionMemoryInfo.memory = AllocInfo.Handle;
+		BindDataGraphPipelineSessionMemoryInfo.memoryOffset = AllocInfo.Offset;
+		BindDataGraphPipelineSessionMemoryInfo.session = InOutSegmentInstances[S].DataGraphPipelineSession;
+		VERIFYVULKANRESULT(vkBindDataGraphPipelineSessionMemoryARM_p(Device, 1, &BindDataGraphPipelineSessionMemoryInfo));
 
 		// Store pipeline session memory buffers into FRDGPooledBuffers for later use.
-		for (int S = 0; S < SegmentInstances.Num(); ++S)
-		{
-			FRDGBufferDesc BufferDesc = FRDGBufferDesc::CreateByteAddressDesc(PipelineSessionMemoryBuffers[S]->GetSize());
-			SegmentInstances[S].PipelineSessionMemoryPooledBuffer = new FRDGPooledBuffer(PipelineSessionMemoryBuffers[S], BufferDesc, 0, TEXT("FNNERuntimeRDGMLExtensionsForVulkanModelInstance_PipelineSessionMemory"));
-		}
+		FRDGBufferDesc RDGBufferDesc = FRDGBufferDesc::CreateByteAddressDesc(PipelineSessionMemoryBuffer->GetSize());
+		InOutSegmentInstances[S].PipelineSessionMemoryPooledBuffer = new FRDGPooledBuffer(PipelineSessionMemoryBuffer, RDGBufferDesc, 0, TEXT("FNNERuntimeRDGMLExtensionsForVulkanModelInstance_PipelineSessionMemory"));
+	}
+}
 
-		RenderThreadDoneEvent->Trigger();
-	});
+void FNNERuntimeRDGMLExtensionsForVulkanModelInstance::RecreatePipelineSessionsIfNeeded_RenderThread(FRHICommandListImmediate& RHICmdList)
+{
+	check(IsInRenderingThread());
+
+	TArray<VkPipeline> Pipelines;
+	const uint32 NewPipelinesVersion = ParentModelShaped->GetPipelines(Pipelines);
+	if (NewPipelinesVersion == PipelinesVersion)
+	{
+		return;
+	}
+
+	// Sessions are tied to the pipeline they were created for, so we need new ones. Creating these is cheap compared to the
+	// pipeline compilation that has just finished, so it's done inline rather than delaying the caller.
+	TArray<FSegmentInstance> NewSegmentInstances;
+	TArray<VkMemoryRequirements> PipelineSessionMemoryRequirements;
+	CreatePipelineSessions(Pipelines, NewSegmentInstances, PipelineSessionMemoryRequirements);
+	BindPipelineSessionMemory_RenderThread(RHICmdList, NewSegmentInstances, PipelineSessionMemoryRequirements);
 
-	RenderThreadDoneEvent->Wait();
-	FGenericPlatformProcess::ReturnSynchEventToPool(RenderThreadDoneEvent);
+	// The old sessions might still be in use by in-flight executions, so retire them rather than destroying them now.
+	FNNERuntimeRDGMLExtensionsForVulkanDeferredDeletionQueue::Get().Enqueue([OldSegmentInstances = MoveTemp(SegmentInstances)](VkDevice Device, const VkAllocationCallbacks* Allocator) mutable {
+		for (FSegmentInstance& S : OldSegmentInstances)
+		{
+			vkDestroyDataGraphPipelineSessionARM_p(Device, S.DataGraphPipelineSession, Allocator);
+		}
+		OldSegmentInstances.Empty();
+	}, GetLastUseFence());
 
-	return ESetInputTensorShapesStatus::Ok;
+	SegmentInstances = MoveTemp(NewSegmentInstances);
+	PipelinesVersion = NewPipelinesVersion;
 }
 
 TConstArrayView<UE::NNE::FTensorDesc> FNNERuntimeRDGMLExtensionsForVulkanModelInstance::GetInputTensorDescs() const
@@ -827,16 +1652,28 @@ TConstArrayView<UE::NNE::FTensorDesc> FNNERuntimeRDGMLExtensionsForVulkanModelIn
 
 TConstArrayView<UE::NNE::FTensorShape> FNNERuntimeRDGMLExtensionsForVulkanModelInstance::GetInputTensorShapes() const
 {
+	// The shaped model is swapped on the rendering thread (under this lock), but this can be called from any thread. The shapes of a
+	// shaped model never change, and a replaced one is kept alive for a few frames by the deferred deletion queue, so the view stays
+	// valid after the lock is released.
+	FScopeLock Lock(&ShapesRequestCriticalSection);
 	// If SetInputTensorShapes hasn't been called yet then we won't know the input tensor shapes.
 	return ParentModelShaped ? ParentModelShaped->InputTensorShapes : TConstArrayView<UE::NNE::FTensorShape>{};
 }
 
 TConstArrayView<UE::NNE::FTensorShape> FNNERuntimeRDGMLExtensionsForVulkanModelInstance::GetOutputTensorShapes() const
 {
+	// See GetInputTensorShapes.
+	FScopeLock Lock(&ShapesRequestCriticalSection);
 	// If SetInputTensorShapes hasn't been called yet then we won't know the output tensor shapes.
 	return ParentModelShaped ? ParentModelShaped->OutputTensorShapes : TConstArrayView<UE::NNE::FTensorShape>{};
 }
 
+bool FNNERuntimeRDGMLExtensionsForVulkanModelInstance::GetOutputTensorShapesFor(TConstArrayView<UE::NNE::FTensorShape> InInputShapes,
+	TArray<UE::NNE::FTensorShape>& OutOutputShapes) const
+{
+	return ParentModelUnshaped->InferOutputTensorShapes(InInputShapes, OutOutputShapes);
+}
+
 BEGIN_SHADER_PARAMETER_STRUCT(FRDGPassParameters, )
 	RDG_BUFFER_ACCESS_ARRAY(TensorBuffers)
 	RDG_BUFFER_ACCESS_ARRAY(PipelineSessionMemoryBuffers)
@@ -854,6 +1691,9 @@ FNNERuntimeRDGMLExtensionsForVulkanModelInstance::EEnqueueRDGStatus FNNERuntimeR
 		return EEnqueueRDGStatus::Fail;
 	}
 
+	// Switch over to the optimized pipelines if they have finished compiling in the background.
+	RecreatePipelineSessionsIfNeeded_RenderThread(RDGBuilder.RHICmdList);
+
 	// Validate that the number of inputs/outputs is as expected. 
 	// We don't have too much detail about the buffers themselves so can't validate formats and shapes, but we can at least validate the total byte size
 	// (which we do in the below loop).
@@ -870,7 +1710,13 @@ FNNERuntimeRDGMLExtensionsForVulkanModelInstance::EEnqueueRDGStatus FNNERuntimeR
 	{
 		const FNNERuntimeRDGMLExtensionsForVulkanModelUnshaped::FTensorInfoUnshaped& TensorInfoUnshaped = ParentModelUnshaped->TensorInfosUnshaped[T];
 		const FNNERuntimeRDGMLExtensionsForVulkanModelShaped::FTensorInfoShaped& TensorInfoShaped = ParentModelShaped->TensorInfosShaped[T];
-		if (TensorInfoUnshaped.IsIntermediate())
+		if (TensorInfoUnshaped.bSharedConstant)
+		{
+			// Every inference (of every model instance) reads the same copy of the constant data, see CreateInternal.
+			check(ParentModelUnshaped->SharedConstantsPooledBuffer.IsValid());
+			RDGPassParams->TensorBuffers.Emplace(RDGBuilder.RegisterExternalBuffer(ParentModelUnshaped->SharedConstantsPooledBuffer), ERHIAccess::SRVCompute);
+		}
+		else if (TensorInfoUnshaped.IsIntermediate())
 		{
 			// We use RDG for intermediate tensors so that it can re-use memory etc. rather than allocating them up-front.
 			FRDGBufferDesc BufferDesc = FRDGBufferDesc::CreateByteAddressDesc(TensorInfoShaped.NumBytes);
@@ -899,17 +1745,24 @@ FNNERuntimeRDGMLExtensionsForVulkanModelInstance::EEnqueueRDGStatus FNNERuntimeR
 		}
 	}
 	// Also include all the buffers we created to hold the pipeline session memory, so that these are tracked correctly.
+	TArray<VkPipeline> Pipelines;
+	TArray<VkDataGraphPipelineSessionARM> DataGraphPipelineSessions;
 	for (const FSegmentInstance& S : SegmentInstances)
 	{
 		RDGPassParams->PipelineSessionMemoryBuffers.Emplace(RDGBuilder.RegisterExternalBuffer(S.PipelineSessionMemoryPooledBuffer), ERHIAccess::UAVCompute);
+		Pipelines.Add(S.Pipeline);
+		DataGraphPipelineSessions.Add(S.DataGraphPipelineSession);
 	}
 
+	// Note that everything is captured by value (or shared pointer), as this instance might be given new shapes or be destroyed
+	// before the pass or the RHI thread work runs. The objects themselves are kept alive until this execution's fence has signalled
+	// by the deferred deletion queue (see UnsetInputTensorShapes_RenderThread).
 	RDGBuilder.AddPass(
 		RDG_EVENT_NAME("FNNERuntimeRDGMLExtensionsForVulkanModelInstance_SegmentInstance"),
 		RDGPassParams,
 		ERDGPassFlags::Compute,
-		[RDGPassParams, &InFlightExecutions = InFlightExecutions, this, ParentModelShaped = this->ParentModelShaped.Get(), ParentModelUnshaped = this->ParentModelUnshaped.Get(),
-		 DescriptorPool = DescriptorPool, &SegmentInstances = this->SegmentInstances](FRHICommandListImmediate& RHICmdList)
+		[RDGPassParams, This = this->AsShared(), ParentModelShaped = this->ParentModelShaped, ParentModelUnshaped = this->ParentModelUnshaped,
+		 DescriptorPool = DescriptorPool, Pipelines = MoveTemp(Pipelines), DataGraphPipelineSessions = MoveTemp(DataGraphPipelineSessions)](FRHICommandListImmediate& RHICmdList)
 		{
 			// Get the RHI buffers from the RDG buffers.
 			TArray<FRHIBuffer*> RHIBuffers;
@@ -927,58 +1780,36 @@ FNNERuntimeRDGMLExtensionsForVulkanModelInstance::EEnqueueRDGStatus FNNERuntimeR
 
 			// Clean up any finished executions and wait until we have a free one 
 			// (otherwise we would try to allocate too many descriptor sets).
-			CleanupFinishedExecutions(RHICmdList);
-			while (InFlightExecutions.Num() >= MAX_CONCURRENT_EXECUTIONS_PER_INSTANCE)
+			This->CleanupFinishedExecutions(RHICmdList);
+			while (This->InFlightExecutions.Num() >= MAX_CONCURRENT_EXECUTIONS_PER_INSTANCE)
 			{
 				// We need to flush the RHI thread otherwise we might deadlock.
 				RHICmdList.ImmediateFlush(EImmediateFlushType::FlushRHIThread);
-				CleanupFinishedExecutions(RHICmdList);
+				This->CleanupFinishedExecutions(RHICmdList);
 			}
 
-			// This is a new execution.
-			InFlightExecutions.PushLast(FExecution{});
-			FExecution& Execution = InFlightExecutions.Last();
+			// This is a new execution. The fence is created up-front, as the RHI thread records it against the tensor objects it uses.
+			TSharedPtr<FExecution> Execution = MakeShared<FExecution>();
+			Execution->GPUFence = RHICreateGPUFence("FNNERuntimeRDGMLExtensionsForVulkanModelInstance_Execution");
+			This->InFlightExecutions.PushLast(Execution);
 
 			// Create resources and submit the graph inference on the RHI thread.
-			RHICmdList.EnqueueLambda([RHIBuffers = MoveTemp(RHIBuffers), &Execution, ParentModelShaped, ParentModelUnshaped, DescriptorPool, &SegmentInstances](FRHICommandListImmediate& RHICmdList) {
+			RHICmdList.EnqueueLambda([RHIBuffers = MoveTemp(RHIBuffers), Execution, TensorObjectCache = This->TensorObjectCache, ParentModelShaped, ParentModelUnshaped, DescriptorPool,
+				Pipelines, DataGraphPipelineSessions](FRHICommandListImmediate& RHICmdList) {
 				VkDevice Device = GetIVulkanDynamicRHI()->RHIGetVkDevice();
-				const VkAllocationCallbacks* Allocator = GetIVulkanDynamicRHI()->RHIGetVkAllocationCallbacks();
 
-				// Create resources for this execution.
-				// VkTensors and VkTensorViews for all inputs, outputs and intermediates (between segments).
-				Execution.VulkanTensors.Reserve(RHIBuffers.Num());
-				Execution.VulkanTensorViews.Reserve(RHIBuffers.Num());
+				// Find (or create, the first time round) the VkTensorViews for all inputs, outputs and intermediates (between segments).
+				Execution->VulkanTensorViews.Reserve(RHIBuffers.Num());
 				for (int32 TensorId = 0; TensorId < RHIBuffers.Num(); ++TensorId)
 				{
-					VkTensorCreateInfoARM TensorCreateInfo = {};
-					TensorCreateInfo.sType = VK_STRUCTURE_TYPE_TENSOR_CREATE_INFO_ARM;
-					TensorCreateInfo.pDescription = &ParentModelShaped->TensorInfosShaped[TensorId].VulkanDesc;
-					VkTensorARM VulkanTensor;
-					VERIFYVULKANRESULT(vkCreateTensorARM_p(Device, &TensorCreateInfo, Allocator, &VulkanTensor));
-					Execution.VulkanTensors.Add(VulkanTensor);
-
-					VkBindTensorMemoryInfoARM BindTensorMemoryInfo = {};
-					BindTensorMemoryInfo.sType = VK_STRUCTURE_TYPE_BIND_TENSOR_MEMORY_INFO_ARM;
-					BindTensorMemoryInfo.tensor = VulkanTensor;
-
-					FRHIBuffer* RHIBuffer = RHIBuffers[TensorId];
-					const FVulkanRHIAllocationInfo& Allocation = GetIVulkanDynamicRHI()->RHIGetAllocationInfo(RHIBuffer);
-					BindTensorMemoryInfo.memory = Allocation.Handle;
-					BindTensorMemoryInfo.memoryOffset = Allocation.Offset;
-
-					VERIFYVULKANRESULT(vkBindTensorMemoryARM_p(Device, 1, &BindTensorMemoryInfo));
-
-					VkTensorViewCreateInfoARM TensorViewCreateInfo = {};
-					TensorViewCreateInfo.sType = VK_STRUCTURE_TYPE_TENSOR_VIEW_CREATE_INFO_ARM;
-					TensorViewCreateInfo.format = TensorCreateInfo.pDescription->format;
-					TensorViewCreateInfo.tensor = VulkanTensor;
-					VkTensorViewARM VulkanTensorView;
-					VERIFYVULKANRESULT(vkCreateTensorViewARM_p(Device, &TensorViewCreateInfo, Allocator, &VulkanTensorView));
-					Execution.VulkanTensorViews.Add(VulkanTensorView);
+					// Shared constants are all in the same buffer, at different offsets.
+					Execution->VulkanTensorViews.Add(TensorObjectCache->FindOrCreateTensorView(RHIBuffers[TensorId], ParentModelUnshaped->TensorInfosUnshaped[TensorId].SharedConstantOffset,
+						ParentModelShaped->TensorInfosShaped[TensorId].VulkanDesc, Execution->GPUFence));
 				}
+				TensorObjectCache->RetireUnusedEntries();
 
 				// Descriptor sets for each segment.
-				Execution.DescriptorSets.AddZeroed(ParentModelShaped->SegmentsShaped.Num());
+				Execution->DescriptorSets.AddZeroed(ParentModelShaped->SegmentsShaped.Num());
 				for (int S = 0; S < ParentModelShaped->SegmentsShaped.Num(); ++S)
 				{
 					// Allocate a new descriptor set.
@@ -987,7 +1818,7 @@ FNNERuntimeRDGMLExtensionsForVulkanModelInstance::EEnqueueRDGStatus FNNERuntimeR
 					AllocInfo.descriptorPool = DescriptorPool;
 					AllocInfo.descriptorSetCount = 1;
 					AllocInfo.pSetLayouts = &ParentModelUnshaped->SegmentsUnshaped[S].DescriptorSetLayout;
-					VkDescriptorSet& DescriptorSet = Execution.DescriptorSets[S];
+					VkDescriptorSet& DescriptorSet = Execution->DescriptorSets[S];
 					VERIFYVULKANRESULT(vkAllocateDescriptorSets_p(Device, &AllocInfo, &DescriptorSet));
 
 					// Update descriptor sets to bind the input/output buffers for this segment
@@ -1001,7 +1832,7 @@ FNNERuntimeRDGMLExtensionsForVulkanModelInstance::EEnqueueRDGStatus FNNERuntimeR
 						VkWriteDescriptorSetTensorARM& TensorInfo = TensorInfos.AddZeroed_GetRef();
 						TensorInfo.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET_TENSOR_ARM;
 						TensorInfo.tensorViewCount = 1;
-						TensorInfo.pTensorViews = &Execution.VulkanTensorViews[Bindings[B].TensorId];
+						TensorInfo.pTensorViews = &Execution->VulkanTensorViews[Bindings[B].TensorId];
 
 						VkWriteDescriptorSet DescriptorSetWrite = {};
 						DescriptorSetWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
@@ -1019,85 +1850,141 @@ FNNERuntimeRDGMLExtensionsForVulkanModelInstance::EEnqueueRDGStatus FNNERuntimeR
 					// Finally we can add the command to run the graph.
 					VkCommandBuffer CommandBuffer = GetIVulkanDynamicRHI()->RHIGetActiveVkCommandBuffer();
 					vkCmdBindDescriptorSets_p(CommandBuffer, VK_PIPELINE_BIND_POINT_DATA_GRAPH_ARM, ParentModelUnshaped->SegmentsUnshaped[S].PipelineLayout, 0, 1, &DescriptorSet, 0, NULL);
-					vkCmdBindPipeline_p(CommandBuffer, VK_PIPELINE_BIND_POINT_DATA_GRAPH_ARM, ParentModelShaped->SegmentsShaped[S].Pipeline);
-					vkCmdDispatchDataGraphARM_p(CommandBuffer, SegmentInstances[S].DataGraphPipelineSession, NULL);
+					vkCmdBindPipeline_p(CommandBuffer, VK_PIPELINE_BIND_POINT_DATA_GRAPH_ARM, Pipelines[S]);
+					vkCmdDispatchDataGraphARM_p(CommandBuffer, DataGraphPipelineSessions[S], NULL);
 
 					// As we've messed about with the Vulkan state, tell the RHI to reset it.
 					GetIVulkanDynamicRHI()->RHIFinishExternalComputeWork(CommandBuffer);
 				}
 			});
 
-			// Create and store a GPU fence so that we can tell when this execution has finished.
-			Execution.GPUFence = RHICreateGPUFence("FNNERuntimeRDGMLExtensionsForVulkanModelInstance_Execution");
-			RHICmdList.WriteGPUFence(Execution.GPUFence);
+			// Signal the GPU fence so that we can tell when this execution has finished.
+			RHICmdList.WriteGPUFence(Execution->GPUFence);
 		}
 	);
 
 	return EEnqueueRDGStatus::Ok;
 }
 
-void FNNERuntimeRDGMLExtensionsForVulkanModelInstance::UnsetInputTensorShapes()
+void FNNERuntimeRDGMLExtensionsForVulkanModelInstance::UnsetInputTensorShapes_RenderThread()
 {
-	// Destroy Vulkan resources on the RHI thread, and wait for that to finish.
-	FEvent* RenderThreadDoneEvent = FGenericPlatformProcess::GetSynchEventFromPool(true);
-	ENQUEUE_RENDER_COMMAND(NNERuntimeRDGMLExtensionsForVulkanModel_DestroySegments)([&](FRHICommandListImmediate& RHICmdList) {
-		// Wait for any outstanding executions to finish.
-		while (!InFlightExecutions.IsEmpty())
+	check(IsInRenderingThread());
+
+	// The executions that are still in-flight keep their own descriptor sets (which are cleaned up as normal by CleanupFinishedExecutions),
+	// and the tensors and views they use stay in the TensorObjectCache until they go unused, but they also use the pipeline sessions and
+	// the shaped model's pipelines.
+	// Retire these through the deferred deletion queue rather than waiting for those executions to finish.
+	FNNERuntimeRDGMLExtensionsForVulkanDeferredDeletionQueue::Get().Enqueue([SegmentInstances = MoveTemp(SegmentInstances),
+		ParentModelShaped = MoveTemp(ParentModelShaped)](VkDevice Device, const VkAllocationCallbacks* Allocator) mutable {
+		for (FSegmentInstance& S : SegmentInstances)
 		{
-			FPlatformProcess::Sleep(0.0f);
-			// We need to flush the RHI thread otherwise we might deadlock.
-			RHICmdList.ImmediateFlush(EImmediateFlushType::FlushRHIThread);
-			CleanupFinishedExecutions(RHICmdList);
+			vkDestroyDataGraphPipelineSessionARM_p(Device, S.DataGraphPipelineSession, Allocator);
 		}
+		SegmentInstances.Empty();
+		ParentModelShaped.Reset();
+	}, GetLastUseFence());
 
-		// Destroy resources
-		RHICmdList.EnqueueLambda([&](FRHICommandListImmediate& RHICmdList) {
-			VkDevice Device = GetIVulkanDynamicRHI()->RHIGetVkDevice();
-			const VkAllocationCallbacks* Allocator = GetIVulkanDynamicRHI()->RHIGetVkAllocationCallbacks();
-
-			for (FSegmentInstance& S : SegmentInstances)
-			{
-				vkDestroyDataGraphPipelineSessionARM_p(Device, S.DataGraphPipelineSession, Allocator);
-			}
-			SegmentInstances.Empty(); // Destroy the textures on the render thread (rather than letting the default destructor run on the game thread).
-		});
-
-		RHICmdList.ImmediateFlush(EImmediateFlushType::FlushRHIThread);
-		RenderThreadDoneEvent->Trigger();
-	});
-
-	RenderThreadDoneEvent->Wait();
-	FGenericPlatformProcess::ReturnSynchEventToPool(RenderThreadDoneEvent);
-	
 	// Note that this model instance object may still be re-used afterwards if it is given new tensor shapes,
 	// so restore everything to sensible defaults.
+	SegmentInstances.Reset();
 	ParentModelShaped.Reset();
 }
 
+FGPUFenceRHIRef FNNERuntimeRDGMLExtensionsForVulkanModelInstance::GetLastUseFence() const
+{
+	return InFlightExecutions.IsEmpty() ? nullptr : InFlightExecutions.Last()->GPUFence;
+}
+
 void FNNERuntimeRDGMLExtensionsForVulkanModelInstance::CleanupFinishedExecutions(FRHICommandListImmediate& RHICmdList)
 {
 	check(IsInRenderingThread());
 
-	while (!InFlightExecutions.IsEmpty() && InFlightExecutions.First().GPUFence->Poll())
+	while (!InFlightExecutions.IsEmpty() && InFlightExecutions.First()->GPUFence->Poll())
 	{
 		// Clean up and remove this execution on the RHI thread.
-		FExecution& Execution = InFlightExecutions.First();
-
-		RHICmdList.EnqueueLambda([Execution = MoveTemp(Execution), DescriptorPool = DescriptorPool](FRHICommandListImmediate& RHICmdList) {
+		// The tensors and views are owned by the TensorObjectCache, which retires them itself once they are no longer used.
+		RHICmdList.EnqueueLambda([Execution = InFlightExecutions.First(), DescriptorPool = DescriptorPool](FRHICommandListImmediate& RHICmdList) {
 			VkDevice Device = GetIVulkanDynamicRHI()->RHIGetVkDevice();
-			const VkAllocationCallbacks* Allocator = GetIVulkanDynamicRHI()->RHIGetVkAllocationCallbacks();
-			
-			VERIFYVULKANRESULT(vkFreeDescriptorSets_p(Device, DescriptorPool, Execution.DescriptorSets.Num(), Execution.DescriptorSets.GetData()));
-			for (VkTensorViewARM TensorView : Execution.VulkanTensorViews)
-			{
-				vkDestroyTensorViewARM_p(Device, TensorView, Allocator);
-			}
-			for (VkTensorARM Tensor : Execution.VulkanTensors)
-			{
-				vkDestroyTensorARM_p(Device, Tensor, Allocator);
-			}
+			VERIFYVULKANRESULT(vkFreeDescriptorSets_p(Device, DescriptorPool, Execution->DescriptorSets.Num(), Execution->DescriptorSets.GetData()));
 		});
 
 		InFlightExecutions.PopFirst();
 	}
 }
+
+VkTensorViewARM FNNERuntimeRDGMLExtensionsForVulkanModelInstance::FTensorObjectCache::FindOrCreateTensorView(FRHIBuffer* Buffer, VkDeviceSize Offset,
+	const VkTensorDescriptionARM& Description, const FGPUFenceRHIRef& ExecutionFence)
+{
+	const FVulkanRHIAllocationInfo& Allocation = GetIVulkanDynamicRHI()->RHIGetAllocationInfo(Buffer);
+
+	FTensorObjectKey Key;
+	Key.Buffer = Buffer;
+	Key.Memory = Allocation.Handle;
+	Key.Offset = Allocation.Offset + Offset;
+	Key.Description.Add(Description.format);
+	Key.Description.Append(Description.pDimensions, Description.dimensionCount);
+
+	FTensorObject* Entry = Entries.Find(Key);
+	if (Entry == nullptr)
+	{
+		VkDevice Device = GetIVulkanDynamicRHI()->RHIGetVkDevice();
+		const VkAllocationCallbacks* Allocator = GetIVulkanDynamicRHI()->RHIGetVkAllocationCallbacks();
+
+		Entry = &Entries.Add(Key);
+		Entry->Buffer = Buffer;
+
+		VkTensorCreateInfoARM TensorCreateInfo = {};
+		TensorCreateInfo.sType = VK_STRUCTURE_TYPE_TENSOR_CREATE_INFO_ARM;
+		TensorCreateInfo.pDescription = &Description;
+		VERIFYVULKANRESULT(vkCreateTensorARM_p(Device, &TensorCreateInfo, Allocator, &Entry->Tensor));
+
+		VkBindTensorMemoryInfoARM BindTensorMemoryInfo = {};
+		BindTensorMemoryInfo.sType = VK_STRUCTURE_TYPE_BIND_TENSOR_MEMORY_INFO_ARM;
+		BindTensorMemoryInfo.tensor = Entry->Tensor;
+		BindTensorMemoryInfo.memory = Key.Memory;
+		BindTensorMemoryInfo.memoryOffset = Key.Offset;
+		VERIFYVULKANRESULT(vkBindTensorMemoryARM_p(Device, 1, &BindTensorMemoryInfo));
+
+		VkTensorViewCreateInfoARM TensorViewCreateInfo = {};
+		TensorViewCreateInfo.sType = VK_STRUCTURE_TYPE_TENSOR_VIEW_CREATE_INFO_ARM;
+		TensorViewCreateInfo.format = Description.format;
+		TensorViewCreateInfo.tensor = Entry->Tensor;
+		VERIFYVULKANRESULT(vkCreateTensorViewARM_p(Device, &TensorViewCreateInfo, Allocator, &Entry->TensorView));
+	}
+
+	Entry->LastUsedExecutionIdx = NumExecutions;
+	Entry->LastUseFence = ExecutionFence;
+	return Entry->TensorView;
+}
+
+void FNNERuntimeRDGMLExtensionsForVulkanModelInstance::FTensorObjectCache::RetireUnusedEntries()
+{
+	++NumExecutions;
+	for (auto It = Entries.CreateIterator(); It; ++It)
+	{
+		FTensorObject& Entry = It.Value();
+		if (NumExecutions - Entry.LastUsedExecutionIdx <= TENSOR_OBJECT_CACHE_MAX_UNUSED_EXECUTIONS)
+		{
+			continue;
+		}
+
+		// The executions which used it might still be running on the GPU, so this can't be destroyed straight away.
+		FNNERuntimeRDGMLExtensionsForVulkanDeferredDeletionQueue::Get().Enqueue([Buffer = MoveTemp(Entry.Buffer), Tensor = Entry.Tensor, TensorView = Entry.TensorView](VkDevice Device,
+			const VkAllocationCallbacks* Allocator) mutable {
+			vkDestroyTensorViewARM_p(Device, TensorView, Allocator);
+			vkDestroyTensorARM_p(Device, Tensor, Allocator);
+			Buffer.SafeRelease();
+		}, MoveTemp(Entry.LastUseFence));
+		It.RemoveCurrent();
+	}
+}
+
+void FNNERuntimeRDGMLExtensionsForVulkanModelInstance::FTensorObjectCache::DestroyAllEntries(VkDevice Device, const VkAllocationCallbacks* Allocator)
+{
+	for (TPair<FTensorObjectKey, FTensorObject>& Entry : Entries)
+	{
+		vkDestroyTensorViewARM_p(Device, Entry.Value.TensorView, Allocator);
+		vkDestroyTensorARM_p(Device, Entry.Value.Tensor, Allocator);
+	}
+	Entries.Empty();
+}
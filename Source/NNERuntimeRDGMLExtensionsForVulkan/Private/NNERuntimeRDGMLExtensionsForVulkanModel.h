@@ -9,6 +9,15 @@
 #include "IVulkanDynamicRHI.h"
 #include "Containers/Deque.h"
 #include "RenderGraphResources.h"
+#include "Async/Future.h"
+#include "HAL/CriticalSection.h"
+#include "Hash/xxhash.h"
+#include "Memory/SharedBuffer.h"
+#include "Tasks/Task.h"
+#include "Templates/Atomic.h"
+#include "NNERuntimeRDGMLExtensionsForVulkanModelFormat.h"
+#include "NNERuntimeRDGMLExtensionsForVulkanModelInterface.h"
+#include "NNERuntimeRDGMLExtensionsForVulkanShapeInference.h"
 
 // There are three model classes in this file so that data can be shared between different instances of the same model. There is a one-to-many
 // relationship between these: One 'unshaped model' can be used by many 'shaped models' and one 'shaped model' can be used by many 'model instances'.
@@ -22,30 +31,120 @@
 //			can re-use the same shaped model.
 //  3. FNNERuntimeRDGMLExtensionsForVulkanModelInstance - this corresponds to NNE's IModelInstanceRDG and contains a pipeline session so that it can
 //         be used to run inferences.
+// Shaped models are made up of FNNERuntimeRDGMLExtensionsForVulkanSegmentShaped objects (one per segment), which are themselves cached in the
+// unshaped model so that shaped models which only differ in the shapes of some segments can share the rest.
 
-// The unshaped model class parses the VGF file and creates some of the Vulkan resources which can be shared amongst
+struct FNNERuntimeRDGMLExtensionsForVulkanSegmentShaped;
+
+// The unshaped model class reads the model description (decoded from the VGF when the model was imported/cooked, see
+// FNNERuntimeRDGMLExtensionsForVulkanModelFormat) and creates some of the Vulkan resources which can be shared amongst
 // any shaped models using this model. For example, shader modules are not created here as they depend on shape
 // information that might not be present, and intermediate buffers are not allocated here as they would
 // need to be unique for each inference, but constant buffers that are the same for every inference can be created here.
-class FNNERuntimeRDGMLExtensionsForVulkanModelUnshaped : public UE::NNE::IModelRDG, public TSharedFromThis<FNNERuntimeRDGMLExtensionsForVulkanModelUnshaped>
+class FNNERuntimeRDGMLExtensionsForVulkanModelUnshaped : public INNERuntimeRDGMLExtensionsForVulkanModel, public TSharedFromThis<FNNERuntimeRDGMLExtensionsForVulkanModelUnshaped>
 {
 public:
+	// Synchronous version of CreateAsync, which blocks the calling thread until the model has been created.
 	static TSharedPtr<FNNERuntimeRDGMLExtensionsForVulkanModelUnshaped> Create(const TSharedPtr<UE::NNE::FSharedModelData>& InModelData);
+	// Reads the model data and creates the Vulkan objects for the model on a task graph worker thread, so that the calling thread
+	// isn't blocked. The future is fulfilled with nullptr if the model couldn't be created.
+	// If a model already exists for byte-identical model data (e.g. from another asset, or another call for the same asset) then
+	// that model is returned instead, so that its shaped models and pipelines are shared rather than created again.
+	static TFuture<TSharedPtr<FNNERuntimeRDGMLExtensionsForVulkanModelUnshaped>> CreateAsync(const TSharedPtr<UE::NNE::FSharedModelData>& InModelData);
 
 	virtual ~FNNERuntimeRDGMLExtensionsForVulkanModelUnshaped();
 
+	// Synchronous version of CreateModelInstanceRDGAsync.
 	virtual TSharedPtr<UE::NNE::IModelInstanceRDG> CreateModelInstanceRDG() override;
+	// Creates a new model instance on a task graph worker thread.
+	virtual TFuture<TSharedPtr<INNERuntimeRDGMLExtensionsForVulkanModelInstance>> CreateModelInstanceRDGAsync() override;
+
+	// Creates shaped models for each of the given sets of input shapes, so that later calls to SetInputTensorShapes with these shapes
+	// don't need to do shape inference or compile any pipelines. The sets are processed in parallel on task graph worker threads, and the
+	// resulting shaped models are kept alive for as long as this model. If bWarmUpDispatch is true, a single inference is also run for
+	// each set of shapes (on uninitialized data) to absorb any lazy initialization that the driver does on the first dispatch.
+	// The future is fulfilled once the shaped models have been created (not waiting for the dispatches), with false if any failed.
+	virtual TFuture<bool> PrewarmShapesAsync(TArray<TArray<UE::NNE::FTensorShape>> InputShapeSets, bool bWarmUpDispatch) override;
+
+	// Releases the model data (the SPIR-V code and constants), which is only needed for creating new shaped models, to save memory once
+	// all the input shapes that will be used have been prepared (e.g. with PrewarmShapesAsync). All the shaped models that exist at this
+	// point are kept from then on, and SetInputTensorShapes fails for any other shapes. This waits for any shaped models which are still
+	// being created, and any pipelines which are still being compiled. Note that a frozen model can't be reused for other assets with the
+	// same model data (see CreateAsync), so a new model will be created for those.
+	virtual void Freeze() override;
+
+	// If all of the model's input shapes are concrete (e.g. because they were pinned when the model was imported) then the model only
+	// ever has one shaped model. In that case this returns true along with the input shapes for it.
+	bool GetStaticInputShapes(TArray<UE::NNE::FTensorShape>& OutInputShapes) const;
+
+	// Works out the shapes of the model outputs for the given input shapes, without creating a shaped model (so no shader modules or
+	// pipelines are created). This runs shape inference for each segment (see InferTensorShapes), and remembers the result so that
+	// asking again for the same shapes is quick.
+	// This can be called from any thread, including whilst the model is being frozen. Returns false (having logged an error) if it fails.
+	virtual bool InferOutputTensorShapes(TConstArrayView<UE::NNE::FTensorShape> ModelInputShapes, TArray<UE::NNE::FTensorShape>& OutOutputShapes) override;
+
+	// The number of shaped models that have been evicted from the recently used list (see RecentlyUsedShapedModels).
+	virtual uint32 GetNumShapedModelEvictions() const override { return NumShapedModelEvictions; }
 
 private:
 	FNNERuntimeRDGMLExtensionsForVulkanModelUnshaped();
 
-	// If a shaped model already exists with the given input shapes, return it. If not, create a new one.
+	// Looks up the model data in the registry of existing models (see CreateAsync), and creates a new model if it's not there.
+	// This can be called on any thread.
+	static TSharedPtr<FNNERuntimeRDGMLExtensionsForVulkanModelUnshaped> FindOrCreateInternal(const TSharedPtr<UE::NNE::FSharedModelData>& InModelData);
+	// Does the actual work for CreateAsync. This can be called on any thread.
+	static TSharedPtr<FNNERuntimeRDGMLExtensionsForVulkanModelUnshaped> CreateInternal(const TSharedPtr<UE::NNE::FSharedModelData>& InModelData,
+		const FXxHash64& InModelDataHash);
+
+	// Does the actual work for CreateModelInstanceRDGAsync. This can be called on any thread.
+	TSharedPtr<class FNNERuntimeRDGMLExtensionsForVulkanModelInstance> CreateModelInstance();
+
+	// If a shaped model already exists with the given input shapes, return it. If not, create a new one on a task graph worker thread.
+	TFuture<TSharedPtr<class FNNERuntimeRDGMLExtensionsForVulkanModelShaped>> FindOrCreateShapedModelAsync(TConstArrayView<UE::NNE::FTensorShape> ModelInputShapes);
+	// Synchronous version of FindOrCreateShapedModelAsync, for use when already on a worker thread.
 	TSharedPtr<class FNNERuntimeRDGMLExtensionsForVulkanModelShaped> FindOrCreateShapedModel(TConstArrayView<UE::NNE::FTensorShape> ModelInputShapes);
+	// Returns the shaped model for the given shapes if it's already in the cache, or a future for it if another thread is already
+	// creating it. Otherwise bOutShouldCreate is set and the caller must call CreateAndPublishShapedModel, which means that each
+	// shaped model is only ever created once even if many model instances are given the same new shapes at the same time.
+	TFuture<TSharedPtr<class FNNERuntimeRDGMLExtensionsForVulkanModelShaped>> FindOrBeginCreatingShapedModel(const TArray<UE::NNE::FTensorShape>& Key, bool& bOutShouldCreate);
+	// Creates the shaped model and hands it to any other threads which are waiting for it.
+	TSharedPtr<class FNNERuntimeRDGMLExtensionsForVulkanModelShaped> CreateAndPublishShapedModel(const TArray<UE::NNE::FTensorShape>& Key);
+	// Ends the creation started by FindOrBeginCreatingShapedModel, handing the result (which is nullptr if it failed) to any other threads
+	// which are waiting for it. If it succeeded, it must already be in the cache.
+	void PublishShapedModel(const TArray<UE::NNE::FTensorShape>& Key, const TSharedPtr<class FNNERuntimeRDGMLExtensionsForVulkanModelShaped>& ShapedModel);
+	// Creates a new shaped model and adds it to the cache. This does shape inference and pipeline compilation so can be slow,
+	// which is why it's called on a worker thread by FindOrCreateShapedModelAsync.
+	TSharedPtr<class FNNERuntimeRDGMLExtensionsForVulkanModelShaped> CreateShapedModel(TConstArrayView<UE::NNE::FTensorShape> ModelInputShapes);
+	// Runs shape inference for a segment whose input shapes have been filled in, then creates its shader module and starts compiling
+	// its pipeline. Triggers Segment.ShapeInferenceDone when finished, even if it failed.
+	void CreateSegmentShaped(int32 SegmentIdx, FNNERuntimeRDGMLExtensionsForVulkanSegmentShaped& Segment);
+	// If shape inference was already run for this segment with these input shapes when the model was imported/cooked (see
+	// UE::NNERuntimeRDGMLExtensionsForVulkan::PreShapedInputShapesFileName), fills in OutResults from the model data and returns true.
+	// BindingShapes is in the same order as the segment's bindings, with only the inputs filled in.
+	bool FindPreShapedSegment(int32 SegmentIdx, TConstArrayView<TArray<int64_t>> BindingShapes, ShapeInferenceResults& OutResults) const;
+	// Runs shape inference for each segment in turn (using the pre-shaped results and the shape inference cache where possible) to get
+	// the shapes of all the tensors, indexed by TensorId, without creating any shader modules or pipelines.
+	bool InferTensorShapes(TConstArrayView<UE::NNE::FTensorShape> ModelInputShapes, TArray<TArray<int64_t>>& OutTensorShapes) const;
+
+	// Output shapes that InferOutputTensorShapes has worked out with shape inference, keyed by the input shapes. Entries are dropped
+	// (roughly oldest first) once there are MAX_INFERRED_OUTPUT_SHAPES of them.
+	TMap<TArray<UE::NNE::FTensorShape>, TArray<UE::NNE::FTensorShape>> InferredOutputShapes;
+	FCriticalSection InferredOutputShapesCriticalSection;
 
 	// It's important that we keep a shared pointer to model data, as this contains the VGF binary (with constants and SPIR-V code)
 	// which we need to use later on (after the Create function has returned). NNE does not guarantee that the model data
 	// will be kept around after this point, so we have to do it here.
 	TSharedPtr<UE::NNE::FSharedModelData> SharedModelData;
+	// Hash of the whole model data, which forms part of the key for the pipelines stored in the pipeline cache.
+	FXxHash64 ModelDataHash;
+	// The tables in the model data (see FNNERuntimeRDGMLExtensionsForVulkanModelFormat), which are kept alive by SharedModelData.
+	const FNNERuntimeRDGMLExtensionsForVulkanModelFormat::FHeader* ModelFormatHeader = nullptr;
+	// If the constants were compressed in the model data, this is where they are decompressed to (and then used from).
+	FSharedBuffer DecompressedConstants;
+	// Holds the data of the constants which were turned into inputs when the model was cooked (see FTensorInfoUnshaped::bSharedConstant), so
+	// that there is one copy of them for all the shaped models rather than one in every pipeline. Only accessed on the rendering thread,
+	// where it's created by a command enqueued by CreateInternal (so before anything else can use the model).
+	TRefCountPtr<FRDGPooledBuffer> SharedConstantsPooledBuffer;
 
 	// The VGF format describes a connected graph of 'segments', where each segment is either a Compute shader
 	// or an ML Extensions for Vulkan Graph. This struct contains the information about a segment that we need to run it,
@@ -77,12 +176,15 @@ private:
 		};
 
 		FString Name; // Only for debugging, no effect on behaviour.
+		int32 ModuleIndex; // Which module in the VGF this segment runs. Several segments can run the same module.
+		TArray<int32> ConstantIndexes; // Indexes into the VGF's constant table, for all of the segment's constants (including shared ones).
 		VkDescriptorSetLayout DescriptorSetLayout;
 		VkPipelineLayout PipelineLayout;
 		TArray<FBinding> Bindings; // Inputs and outputs for this segment.
 		TConstArrayView<uint32_t> SPIRVCode; // This is a view of the SPIR-V code embedded in the VGF. The underlying data is kept alive by the SharedModelData shared ptr.
 		const char* SPIRVEntryPoint; // This is a raw pointer to a string embedded in the VGF. This data is kept alive by the SharedModelData shared ptr.
 		// Information about constants in this segment. As we don't create the pipeline until shape has been inferred, we need to keep this around.
+		// Constants which were turned into inputs (i.e. bindings) when the model was cooked aren't included, as they aren't passed to the pipeline.
 		TArray<FConstantInfo> ConstantInfos;
 	};
 
@@ -98,8 +200,14 @@ private:
 		int32 ModelInputIdx = -1; // If this is a model input tensor, this says which input number it is. -1 means not an input.
 		int32 ModelOutputIdx = -1; // If this is a model output tensor, this says which output number it is. -1 means not an output.
 		VkTensorDescriptionARM VulkanDesc; // Note that the shape (pDimensions) in here will be nullptr, as it hasn't been shaped yet. It does however have format etc.
-
-		bool IsIntermediate() const { return ModelInputIdx == -1 && ModelOutputIdx == -1; }
+		// Set if this tensor holds the data of a constant which was turned into an input when the model was cooked (see
+		// FNNERuntimeRDGMLExtensionsForVulkanModelFormat::FTensor::SharedConstantIdx). Its shape is always concrete, and it's bound to
+		// SharedConstantsPooledBuffer at SharedConstantOffset rather than being allocated for each inference.
+		bool bSharedConstant = false;
+		TArray<int64_t> SharedConstantShape;
+		uint64 SharedConstantOffset = 0;
+
+		bool IsIntermediate() const { return ModelInputIdx == -1 && ModelOutputIdx == -1 && !bSharedConstant; }
 	};
 
 	// Descriptions of input, output and intermediate (between segment) tensors. 
@@ -112,8 +220,104 @@ private:
 	// Multiple model instances can use the same shaped model and when the last instance dies this shaped model
 	// will be freed. We deliberately use weak ptr so that this cache doesn't keep the shaped model alive indefinitely.
 	TMap<TArray<UE::NNE::FTensorShape>, TWeakPtr<FNNERuntimeRDGMLExtensionsForVulkanModelShaped>> ShapedModels;
+	// Keeps the most recently used shaped models alive (most recent last) even when no model instances are using them, so that
+	// e.g. flipping between two resolutions doesn't redo shape inference and pipeline compilation each time. This is bounded
+	// by both the number of entries and their estimated memory usage (see the project settings). Protected by ShapedModelsCriticalSection.
+	TArray<TSharedPtr<FNNERuntimeRDGMLExtensionsForVulkanModelShaped>> RecentlyUsedShapedModels;
+	int32 MaxRecentlyUsedShapedModels = 0;
+	uint64 RecentlyUsedShapedModelsMemoryBudget = 0;
+	// Number of shaped models that have been dropped from RecentlyUsedShapedModels to stay within the limits.
+	TAtomic<uint32> NumShapedModelEvictions = 0;
+	// Moves (or adds) the given shaped model to the most recently used end, evicting the least recently used as needed.
+	// ShapedModelsCriticalSection must be held.
+	void MarkShapedModelRecentlyUsed(const TSharedPtr<FNNERuntimeRDGMLExtensionsForVulkanModelShaped>& ShapedModel);
+
+	// Shaped models which have been created by PrewarmShapesAsync (or which existed when Freeze was called). Unlike the cache above, these are strong references so that the
+	// prewarmed shaped models stay around even when no model instances are using them. Also protected by ShapedModelsCriticalSection.
+	TArray<TSharedPtr<FNNERuntimeRDGMLExtensionsForVulkanModelShaped>> PrewarmedShapedModels;
+	// Shaped models which are currently being created, along with the promises for any other callers that want the same shapes.
+	// Also protected by ShapedModelsCriticalSection.
+	TMap<TArray<UE::NNE::FTensorShape>, TArray<TPromise<TSharedPtr<FNNERuntimeRDGMLExtensionsForVulkanModelShaped>>>> PendingShapedModels;
+	// Optimized pipeline compilations (see CreateShapedModel) which might still be running. Also protected by ShapedModelsCriticalSection.
+	TArray<UE::Tasks::FTask> OptimizedPipelineTasks;
+	// Set by Freeze, after which no new shaped models are created. Also protected by ShapedModelsCriticalSection.
+	bool bFrozen = false;
+	// Held for reading by anything that reads the model data (see CreateShapedModel and InferOutputTensorShapes), and for writing by Freeze
+	// whilst it releases the model data. Readers must not take this recursively.
+	FRWLock ModelDataLock;
+	// Shaped models are created on worker threads, so access to the cache needs to be synchronised.
+	FCriticalSection ShapedModelsCriticalSection;
+
+	// Everything that a segment's shape inference and pipeline depend on, other than what's the same for the whole model.
+	struct FSegmentShapedKey
+	{
+		int32 ModuleIndex;
+		TArray<int32> ConstantIndexes;
+		// For each binding: its Vulkan binding index and format, followed by the concrete shape for inputs (outputs are inferred).
+		TArray<int64> Bindings;
+
+		bool operator==(const FSegmentShapedKey& Other) const
+		{
+			return ModuleIndex == Other.ModuleIndex && ConstantIndexes == Other.ConstantIndexes && Bindings == Other.Bindings;
+		}
+		friend uint32 GetTypeHash(const FSegmentShapedKey& Key)
+		{
+			return HashCombineFast(HashCombineFast(::GetTypeHash(Key.ModuleIndex), GetArrayHash(Key.ConstantIndexes.GetData(), Key.ConstantIndexes.Num())),
+				GetArrayHash(Key.Bindings.GetData(), Key.Bindings.Num()));
+		}
+	};
+	// Cache of the shaped segments used by any of this model's shaped models. A module which is run by several segments with the same
+	// inputs, or shaped models which only differ in the shapes going into later segments, then share the same shader modules and pipelines
+	// rather than doing shape inference and compiling them all over again. Like ShapedModels, this uses weak pointers so that segments
+	// are freed along with the last shaped model using them.
+	TMap<FSegmentShapedKey, TWeakPtr<FNNERuntimeRDGMLExtensionsForVulkanSegmentShaped>> SegmentsShapedCache;
+	FCriticalSection SegmentsShapedCacheCriticalSection;
 
 	friend class FNNERuntimeRDGMLExtensionsForVulkanModelInstance;
+#if WITH_DEV_AUTOMATION_TESTS
+	friend struct FNNERuntimeRDGMLExtensionsForVulkanModelTestAccess;
+#endif
+};
+
+// Information needed about a segment once the shapes of its inputs are known. This is shared by every shaped model (and therefore
+// model instance) of the same unshaped model which runs the same module with the same inputs (see SegmentsShapedCache), so that
+// its shape inference, shader module and pipeline are only done once.
+struct FNNERuntimeRDGMLExtensionsForVulkanSegmentShaped
+{
+	~FNNERuntimeRDGMLExtensionsForVulkanSegmentShaped();
+
+	// Another thread might find this segment in the cache whilst it's still being created, so waits for this before reading anything else.
+	// By the time this is triggered, shape inference has finished and (if it succeeded) PipelineTask has been started.
+	UE::Tasks::FTaskEvent ShapeInferenceDone{ UE_SOURCE_LOCATION };
+	bool bShapeInferenceSucceeded = false;
+
+	// The concrete shape of each binding, in the same order as FSegmentUnshaped::Bindings.
+	TArray<TArray<int64_t>> BindingShapes;
+	// Rough estimate of how much memory the pipeline for this segment uses (see FNNERuntimeRDGMLExtensionsForVulkanModelShaped::EstimatedMemoryBytes).
+	uint64 EstimatedMemoryBytes = 0;
+
+	// Everything that the pipeline is created from. The pipeline is compiled in the background (see CreateDataGraphPipelineAsync),
+	// so these need to stay alive (and not move) until the compilation tasks have completed, which is why they live here.
+	TArray<VkDataGraphPipelineConstantARM> DataGraphPipelineConstants;
+	TArray<VkTensorDescriptionARM> BindingTensorDescriptions; // pDimensions points into BindingShapes.
+	TArray<VkDataGraphPipelineResourceInfoARM> DataGraphPipelineResourcesInfos;
+	VkDataGraphPipelineShaderModuleCreateInfoARM DataGraphPipelineShaderModuleCreateInfo = {};
+	VkDataGraphPipelineCreateInfoARM DataGraphPipelineCreateInfo = {};
+	FXxHash64 PipelineKey;
+
+	VkShaderModule ShaderModule = VK_NULL_HANDLE;
+	// Completes once Pipeline has first been filled in.
+	UE::Tasks::TTask<VkResult> PipelineTask;
+	// If we created an unoptimized pipeline first, this is the optimized one which is compiled in the background.
+	bool bNeedsOptimizedPipeline = false;
+	VkPipeline OptimizedPipeline = VK_NULL_HANDLE;
+
+	// This might initially be a quickly compiled (unoptimized) pipeline, which is replaced once the fully optimized one has compiled
+	// in the background. Protected by PipelinesCriticalSection.
+	VkPipeline Pipeline = VK_NULL_HANDLE;
+	// Incremented each time the pipeline is replaced with an optimized one. The replaced pipeline is handed to the deferred deletion queue.
+	uint32 PipelinesVersion = 0;
+	mutable FCriticalSection PipelinesCriticalSection;
 };
 
 // The shaped model class builds upon an unshaped model and has concrete shapes for every tensor.
@@ -121,27 +325,27 @@ private:
 // Common resources shared between different shaped models are simply referenced from the 'parent' unshaped model.
 class FNNERuntimeRDGMLExtensionsForVulkanModelShaped
 {
-public:
-	~FNNERuntimeRDGMLExtensionsForVulkanModelShaped();
-
 private:
 	// Reference to common data shared between all shaped models which are based on the same unshaped model.
-	// Importantly the smart pointer also prevents the common data from being destroyed whilst we are still using it.
-	TSharedPtr<FNNERuntimeRDGMLExtensionsForVulkanModelUnshaped> ParentModelUnshaped;
+	// This is a weak pointer, as the unshaped model can hold strong references to its shaped models (see PrewarmedShapedModels).
+	// Anything that uses a shaped model (model instances, background pipeline compilation) holds a strong reference to both.
+	TWeakPtr<FNNERuntimeRDGMLExtensionsForVulkanModelUnshaped> ParentModelUnshaped;
 
 	// Details about the whole model's inputs and outputs, which we pass down to the model instance for access from its public API.
 	TArray<UE::NNE::FTensorShape> InputTensorShapes;
 	TArray<UE::NNE::FTensorShape> OutputTensorShapes;
 
-	// Information needed about a segment that is unique for each shaped model, but shared between model instances.
-	// (as opposed to the information in the parent unshaped model's FSegmentUnshaped, which is shared).
-	struct FSegmentShaped
-	{
-		VkShaderModule ShaderModule;
-		VkPipeline Pipeline;
-	};
+	// Rough estimate of how much memory the pipelines for this shaped model use. We can't query this from the driver, but the
+	// constants are baked into each pipeline so they (and the code) make up the bulk of it. Segments shared with other shaped
+	// models are counted in each of them.
+	uint64 EstimatedMemoryBytes = 0;
+
+	// One for each segment in the parent unshaped model, possibly shared with other shaped models.
+	TArray<TSharedPtr<FNNERuntimeRDGMLExtensionsForVulkanSegmentShaped>> SegmentsShaped;
 
-	TArray<FSegmentShaped> SegmentsShaped;
+	// Returns the current pipeline for each segment, along with a version number which changes whenever any of them are replaced
+	// with optimized ones, so that model instances know to recreate their sessions. Can be called on any thread.
+	uint32 GetPipelines(TArray<VkPipeline>& OutPipelines) const;
 
 	// Description of an input, output or intermediate (between segments) tensor, with concrete shape specified
 	// (FTensorInfoUnshaped might not have a concrete shape).
@@ -157,6 +361,9 @@ private:
 
 	friend class FNNERuntimeRDGMLExtensionsForVulkanModelUnshaped;
 	friend class FNNERuntimeRDGMLExtensionsForVulkanModelInstance;
+#if WITH_DEV_AUTOMATION_TESTS
+	friend struct FNNERuntimeRDGMLExtensionsForVulkanModelTestAccess;
+#endif
 };
 
 // The model instance class builds upon a shaped model and adds the Vulkan resources to run an inference for a model,
@@ -165,7 +372,7 @@ private:
 // The lifecycle of this class is a bit weird/awkward, because a lot of the resources it manages can't be created
 // until the tensor shapes are known, i.e. after SetInputTensorShapes is called. SetInputTensorShapes can also
 // be called multiple times during its lifetime, so these resources may need to be recreated multiple times.
-class FNNERuntimeRDGMLExtensionsForVulkanModelInstance : public UE::NNE::IModelInstanceRDG
+class FNNERuntimeRDGMLExtensionsForVulkanModelInstance : public INNERuntimeRDGMLExtensionsForVulkanModelInstance, public TSharedFromThis<FNNERuntimeRDGMLExtensionsForVulkanModelInstance>
 {
 public:
 	FNNERuntimeRDGMLExtensionsForVulkanModelInstance() {}
@@ -175,33 +382,75 @@ public:
 	virtual TConstArrayView<UE::NNE::FTensorDesc> GetOutputTensorDescs() const override;
 	virtual TConstArrayView<UE::NNE::FTensorShape> GetInputTensorShapes() const override;
 	virtual TConstArrayView<UE::NNE::FTensorShape> GetOutputTensorShapes() const override;
+	// Synchronous version of SetInputTensorShapesAsync. Returns Ok if the shapes were applied or superseded. This can also be called
+	// on the rendering thread, in which case the work is done inline and the new shapes are used by the next EnqueueRDG.
 	virtual ESetInputTensorShapesStatus SetInputTensorShapes(TConstArrayView<UE::NNE::FTensorShape> InInputShapes) override;
 
+	// Performs shape inference and creates the pipelines (if not already cached) on a task graph worker thread, then
+	// swaps the new shapes in on the rendering thread. Until the future is fulfilled, the instance keeps its previous shapes.
+	// Setting the same shapes as are already set is a no-op and the returned future is already fulfilled.
+	virtual TFuture<EShapesRequestStatus> SetInputTensorShapesAsync(TConstArrayView<UE::NNE::FTensorShape> InInputShapes) override;
+	// See FNNERuntimeRDGMLExtensionsForVulkanModelUnshaped::InferOutputTensorShapes.
+	virtual bool GetOutputTensorShapesFor(TConstArrayView<UE::NNE::FTensorShape> InInputShapes, TArray<UE::NNE::FTensorShape>& OutOutputShapes) const override;
+
 	virtual ESetInputTensorShapesStatus EnqueueRDG(FRDGBuilder& RDGBuilder, TConstArrayView<UE::NNE::FTensorBindingRDG> Inputs,
 		TConstArrayView<UE::NNE::FTensorBindingRDG> Outputs) override;
 private:
-	void UnsetInputTensorShapes(); // Destroys all resources created as a result of SetInputTensorShapes.
+	// Runs a single inference on temporary (cleared) input and output buffers, which are then thrown away. See PrewarmShapesAsync.
+	void EnqueueWarmUpDispatch_RenderThread(FRHICommandListImmediate& RHICmdList);
+
+	// Releases all resources created as a result of SetInputTensorShapes. These are handed off to the deferred deletion queue
+	// so that any executions still in-flight can finish using them, without the calling thread waiting for the GPU.
+	// ShapesRequestCriticalSection must be held, as this changes ParentModelShaped.
+	void UnsetInputTensorShapes_RenderThread();
+	// Returns the fence of the most recent execution, or null if there aren't any in-flight. As the executions complete in order,
+	// once this has signalled the GPU has finished with all of this instance's resources.
+	FGPUFenceRHIRef GetLastUseFence() const;
 	void CleanupFinishedExecutions(FRHICommandListImmediate& RHICmdList);
 
-	// Reference to common data (shared between all model instances of this model).
-	// Importantly the smart pointer also prevents the common data from being destroyed whilst we are still using it.
-	TSharedPtr<FNNERuntimeRDGMLExtensionsForVulkanModelUnshaped> ParentModelUnshaped;
-	// Reference to common data (shared between all model instances of the same shaped model).
-	// Importantly the smart pointer also prevents the common data from being destroyed whilst we are still using it.
-	TSharedPtr<FNNERuntimeRDGMLExtensionsForVulkanModelShaped> ParentModelShaped;
-
 	// Information needed about a segment that is unique for each model instance
 	// (as opposed to the information in the parent model's FSegmentShaped, which is shared).
 	struct FSegmentInstance
 	{
+		// The pipeline that the session was created for. This is the pipeline that we dispatch, as the shaped model may since
+		// have swapped in an optimized pipeline (see RecreatePipelineSessionsIfNeeded_RenderThread).
+		VkPipeline Pipeline;
 		VkDataGraphPipelineSessionARM DataGraphPipelineSession;
 		// Buffer object which owns the memory that we use for the Graph Pipeline Session.
 		// (This is never actually used as a buffer!)
 		TRefCountPtr<FRDGPooledBuffer> PipelineSessionMemoryPooledBuffer;
 	};
 
+	// Creates a pipeline session for each of the given pipelines and queries how much memory they need. Can be called on any thread.
+	static void CreatePipelineSessions(TConstArrayView<VkPipeline> Pipelines, TArray<FSegmentInstance>& OutSegmentInstances,
+		TArray<VkMemoryRequirements>& OutMemoryRequirements);
+	// Allocates and binds the memory for sessions created by CreatePipelineSessions. The memory has to be allocated through the RHI.
+	static void BindPipelineSessionMemory_RenderThread(FRHICommandListImmediate& RHICmdList, TArray<FSegmentInstance>& InOutSegmentInstances,
+		TConstArrayView<VkMemoryRequirements> MemoryRequirements);
+	// If the shaped model has swapped in optimized pipelines since our sessions were created, creates new sessions for those
+	// and retires the old ones.
+	void RecreatePipelineSessionsIfNeeded_RenderThread(FRHICommandListImmediate& RHICmdList);
+	// Starts a SetInputTensorShapes request, giving it the next ID. Returns false if there's nothing to do as these shapes are already set.
+	bool BeginShapesRequest(TConstArrayView<UE::NNE::FTensorShape> InInputShapes, uint64& OutRequestId);
+	// Finishes a SetInputTensorShapes request, once the shaped model has been found or created (or failed, if it's null) and the
+	// pipeline sessions for it have been created. Requests older than the last one applied are thrown away.
+	EShapesRequestStatus ApplyShapesRequest_RenderThread(FRHICommandListImmediate& RHICmdList, uint64 RequestId,
+		TSharedPtr<FNNERuntimeRDGMLExtensionsForVulkanModelShaped> NewParentModelShaped, uint32 NewPipelinesVersion,
+		TArray<FSegmentInstance> NewSegmentInstances, TConstArrayView<VkMemoryRequirements> PipelineSessionMemoryRequirements);
+
+	// Reference to common data (shared between all model instances of this model).
+	// Importantly the smart pointer also prevents the common data from being destroyed whilst we are still using it.
+	TSharedPtr<FNNERuntimeRDGMLExtensionsForVulkanModelUnshaped> ParentModelUnshaped;
+	// Reference to common data (shared between all model instances of the same shaped model).
+	// Importantly the smart pointer also prevents the common data from being destroyed whilst we are still using it.
+	// This is only changed on the rendering thread, with ShapesRequestCriticalSection held, so it can be read without the lock there
+	// but other threads must take the lock.
+	TSharedPtr<FNNERuntimeRDGMLExtensionsForVulkanModelShaped> ParentModelShaped;
+
 	// An FSegmentInstance for each Segment in the model.
 	TArray<FSegmentInstance> SegmentInstances;
+	// The parent shaped model's PipelinesVersion that SegmentInstances were created for.
+	uint32 PipelinesVersion = 0;
 
 	// Pool that we use to allocate all the descriptor sets (one per segment) from.
 	VkDescriptorPool DescriptorPool;
@@ -211,15 +460,79 @@ private:
 	struct FExecution
 	{
 		TArray<VkDescriptorSet> DescriptorSets; // One for each segment
-		TArray<VkTensorARM> VulkanTensors; // One for each tensor in TensorInfos.
-		TArray<VkTensorViewARM> VulkanTensorViews; // One for each tensor in TensorInfos.
+		TArray<VkTensorViewARM> VulkanTensorViews; // One for each tensor in TensorInfos. These are owned by the TensorObjectCache.
 		FGPUFenceRHIRef GPUFence; // Tells us when the GPU has finished with this execution, so that we can free the resources in here.
 	};
 
+	// Everything that a VkTensorARM (and its view) depends on. Tensors always use linear tiling and packed strides.
+	struct FTensorObjectKey
+	{
+		// The buffer is included as well as its memory, as the memory handle of a buffer which has since been freed might be reused
+		// by another allocation. The cache entry holds a reference to the buffer, so this pointer can't be reused while it exists.
+		FRHIBuffer* Buffer;
+		VkDeviceMemory Memory;
+		VkDeviceSize Offset;
+		// The format followed by the dimensions.
+		TArray<int64_t, TInlineAllocator<8>> Description;
+
+		bool operator==(const FTensorObjectKey& Other) const
+		{
+			return Buffer == Other.Buffer && Memory == Other.Memory && Offset == Other.Offset && Description == Other.Description;
+		}
+		friend uint32 GetTypeHash(const FTensorObjectKey& Key)
+		{
+			return HashCombineFast(HashCombineFast(HashCombineFast(::GetTypeHash(Key.Buffer), ::GetTypeHash((uint64)Key.Memory)), ::GetTypeHash((uint64)Key.Offset)),
+				GetArrayHash(Key.Description.GetData(), Key.Description.Num()));
+		}
+	};
+	struct FTensorObject
+	{
+		TRefCountPtr<FRHIBuffer> Buffer; // Keeps the memory that the tensor is bound to alive.
+		VkTensorARM Tensor;
+		VkTensorViewARM TensorView;
+		uint64 LastUsedExecutionIdx; // See FTensorObjectCache::NumExecutions.
+		FGPUFenceRHIRef LastUseFence; // Fence of the most recent execution that used this tensor.
+	};
+	// RDG gives us the same pooled buffers (at the same memory and offset) frame after frame, so rather than creating and destroying
+	// a tensor and view for each of them in every execution, they are kept here and re-used. Entries which haven't been used for a
+	// while (e.g. the buffer has dropped out of the RDG pool or the shapes have changed) are retired through the deferred deletion queue.
+	// This is only accessed on the RHI thread. It's shared with the RHI thread lambdas, so that it stays alive until they have run.
+	struct FTensorObjectCache
+	{
+		TMap<FTensorObjectKey, FTensorObject> Entries;
+		uint64 NumExecutions = 0;
+
+		// Returns the view of a tensor with the given description, bound to the given buffer at the given offset (on top of the buffer's
+		// own offset in its memory), creating it if needed. The fence is that of the execution which is using it.
+		VkTensorViewARM FindOrCreateTensorView(FRHIBuffer* Buffer, VkDeviceSize Offset, const VkTensorDescriptionARM& Description,
+			const FGPUFenceRHIRef& ExecutionFence);
+		// Retires the entries which haven't been used by any of the most recent executions. Called once after each execution.
+		void RetireUnusedEntries();
+		// Destroys all the entries straight away. Only used once the GPU has finished with all of them (see the instance's destructor).
+		void DestroyAllEntries(VkDevice Device, const VkAllocationCallbacks* Allocator);
+	};
+	TSharedRef<FTensorObjectCache> TensorObjectCache = MakeShared<FTensorObjectCache>();
+
 	// There can be multiple executions of this model instance in-flight at the same time as the render thread can be queuing
 	// up commands for the next frame whilst the GPU is still rendering the previous one.
 	// This array should only be modified by the rendering thread to avoid synchronisation problems.
-	TDeque<FExecution> InFlightExecutions;
+	// The executions are shared with the RHI thread lambdas which fill them in, so that they stay alive even if this
+	// instance is destroyed before the RHI thread gets to them.
+	TDeque<TSharedPtr<FExecution>> InFlightExecutions;
+
+	// Input shapes from the most recently applied SetInputTensorShapes call, so that repeated calls with the same shapes
+	// (which is common, e.g. callers setting the shapes every frame just in case) return straight away without any work.
+	TArray<UE::NNE::FTensorShape> AppliedInputShapes;
+	// Each SetInputTensorShapes call that has to do some work is given the next ID. These can complete out of order (e.g. if a
+	// later one finds its shaped model already cached), so only a request newer than the applied one is swapped in.
+	uint64 LastShapesRequestId = 0;
+	// The ID of the request whose outcome the instance currently has. This only moves on when a request is applied, or fails (which
+	// clears the shapes).
+	uint64 AppliedShapesRequestId = 0;
+	// Requests which haven't been applied or thrown away yet. The shapes can't be assumed to stay as they are until this is zero.
+	uint32 NumPendingShapesRequests = 0;
+	// Protects the members above (and changes to ParentModelShaped), as SetInputTensorShapes and the shape getters can be called from any thread.
+	mutable FCriticalSection ShapesRequestCriticalSection;
 
 	friend class FNNERuntimeRDGMLExtensionsForVulkanModelUnshaped;
 };
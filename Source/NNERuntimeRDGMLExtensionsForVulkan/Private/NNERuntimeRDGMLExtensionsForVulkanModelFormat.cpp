@@ -0,0 +1,902 @@
+// SPDX-FileCopyrightText: Copyright 2025 Arm Limited and/or its affiliates <open-source-office@arm.com>
+// SPDX-License-Identifier: MIT
+
+#include "NNERuntimeRDGMLExtensionsForVulkanModelFormat.h"
+#include "NNERuntimeRDGMLExtensionsForVulkanModule.h"
+#include "NNERuntimeRDGMLExtensionsForVulkanShapeInference.h"
+#include "Algo/Transform.h"
+#include "Async/ParallelFor.h"
+#include "Misc/Compression.h"
+
+#include "vgf/decoder.h" // The VGF parser from the ML SDK for Vulkan
+
+namespace
+{
+
+	// Works out where the next table goes in the payload and moves PayloadSize past it. The table is aligned relative to the start
+	// of the model data, which is PayloadOffset bytes before the payload.
+	template<typename T>
+	FNNERuntimeRDGMLExtensionsForVulkanModelFormat::FTableRange PlaceTable(uint64& PayloadSize, TConstArrayView64<T> Table, uint64 PayloadOffset,
+		uint32 Alignment = FNNERuntimeRDGMLExtensionsForVulkanModelFormat::PAYLOAD_ALIGNMENT)
+	{
+		PayloadSize = Align(PayloadOffset + PayloadSize, Alignment) - PayloadOffset;
+		FNNERuntimeRDGMLExtensionsForVulkanModelFormat::FTableRange Range = { PayloadSize, (uint64)Table.Num() };
+		PayloadSize += Table.Num() * sizeof(T);
+		return Range;
+	}
+
+	// Copies a table to where PlaceTable put it.
+	template<typename T>
+	void CopyTable(uint8* Payload, const FNNERuntimeRDGMLExtensionsForVulkanModelFormat::FTableRange& Range, TConstArrayView64<T> Table)
+	{
+		FMemory::Memcpy(Payload + Range.Offset, Table.GetData(), Table.Num() * sizeof(T));
+	}
+
+	// Checks that a table is within the payload and correctly aligned for its element type.
+	template<typename T>
+	bool IsTableValid(TConstArrayView64<uint8> Payload, const FNNERuntimeRDGMLExtensionsForVulkanModelFormat::FTableRange& Range, uint64 MaxNum = MAX_int32)
+	{
+		const uint64 PayloadSize = Payload.Num();
+		return Range.Offset % alignof(T) == 0 && Range.Offset <= PayloadSize && Range.Num <= MaxNum && Range.Num <= (PayloadSize - Range.Offset) / sizeof(T);
+	}
+
+	// Checks that a range of elements is within a table of the given size.
+	bool IsRangeValid(uint64 First, uint64 Num, uint64 TableNum)
+	{
+		return First <= TableNum && Num <= TableNum - First;
+	}
+
+	// Checks that there is a null-terminated string at the given offset.
+	bool IsStringValid(TConstArrayView64<uint8> Vgf, uint64 Offset)
+	{
+		return Offset < (uint64)Vgf.Num() && FMemory::Memchr(Vgf.GetData() + Offset, 0, Vgf.Num() - Offset) != nullptr;
+	}
+
+} // namespace
+
+bool FNNERuntimeRDGMLExtensionsForVulkanModelFormat::Write(TConstArrayView64<uint8> Vgf, TConstArrayView<TArray<int32>> InputShapeOverrides,
+	TConstArrayView<TArray<UE::NNE::FTensorShape>> PreShapeInputShapeSets, bool bCompressConstants, uint64 SharedConstantMinBytes, bool bOptimizeCode,
+	TArray64<uint8>& OutData)
+{
+	// Converts a pointer returned by the decoder (which points into the VGF data) to an offset into the VGF.
+	auto GetVgfOffset = [&Vgf](const void* Pointer, uint64 Size, uint64& OutOffset) {
+		const uint8* Ptr = reinterpret_cast<const uint8*>(Pointer);
+		if (Ptr < Vgf.GetData() || Ptr > Vgf.GetData() + Vgf.Num() || Size > (uint64)(Vgf.GetData() + Vgf.Num() - Ptr))
+		{
+			UE_LOG(LogNNERuntimeRDGMLExtensionsForVulkan, Error, TEXT("Corrupt VGF (data out of bounds)."));
+			return false;
+		}
+		OutOffset = Ptr - Vgf.GetData();
+		return true;
+	};
+
+	// Parse VGF header which contains details of other sections in the file.
+	TArray<uint8_t> HeaderDecoderMemory;
+	HeaderDecoderMemory.AddUninitialized(mlsdk_decoder_header_decoder_mem_reqs());
+	mlsdk_decoder_header_decoder* HeaderDecoder = mlsdk_decoder_create_header_decoder(Vgf.GetData(), HeaderDecoderMemory.GetData());
+	if (!mlsdk_decoder_is_header_valid(HeaderDecoder))
+	{
+		UE_LOG(LogNNERuntimeRDGMLExtensionsForVulkan, Error, TEXT("Invalid VGF header."));
+		return false;
+	}
+	if (!mlsdk_decoder_is_header_compatible(HeaderDecoder))
+	{
+		UE_LOG(LogNNERuntimeRDGMLExtensionsForVulkan, Error, TEXT("Incompatible VGF header."));
+		return false;
+	}
+
+	// Create decoder objects for each section in the VGF that we care about:
+	//		Module Table:
+	//			Each module is either a compute shader or a data graph.
+	//			The order of these is arbitrary and there is a further information in the VGF that describes how to run these.
+	//		Model Resource Table:
+	//			This is a list of tensor descriptions (data formats, size etc.) which is indexed
+	//			into by other fields in the VGF.
+	//		Model Sequence:
+	//			This defines the order that the modules should be executed in as well as their inputs and outputs.
+	//		Constant table:
+	//			Contains the raw constant data for all constant tensors used in the model.
+	mlsdk_decoder_vgf_section_info SectionInfos[4];
+	for (mlsdk_decoder_section SectionType = mlsdk_decoder_section_modules; SectionType <= mlsdk_decoder_section_constants;
+		SectionType = mlsdk_decoder_section(SectionType + 1))
+	{
+		mlsdk_decoder_get_header_section_info(HeaderDecoder, SectionType, &SectionInfos[SectionType]);
+		if (SectionInfos[SectionType].offset + SectionInfos[SectionType].size > (uint64)Vgf.Num())
+		{
+			UE_LOG(LogNNERuntimeRDGMLExtensionsForVulkan, Error, TEXT("Corrupt VGF header (section out of bounds)."));
+			return false;
+		}
+	}
+	TArray<uint8_t> ModuleTableDecoderMemory;
+	TArray<uint8_t> ModelResourceTableDecoderMemory;
+	TArray<uint8_t> ModelSequenceDecoderMemory;
+	TArray<uint8_t> ConstantTableDecoderMemory;
+	ModuleTableDecoderMemory.AddUninitialized(mlsdk_decoder_module_table_decoder_mem_reqs());
+	ModelResourceTableDecoderMemory.AddUninitialized(mlsdk_decoder_model_resource_table_decoder_mem_reqs());
+	ModelSequenceDecoderMemory.AddUninitialized(mlsdk_decoder_model_sequence_decoder_mem_reqs());
+	ConstantTableDecoderMemory.AddUninitialized(mlsdk_decoder_constant_table_decoder_mem_reqs());
+	mlsdk_decoder_module_table_decoder* ModuleTableDecoder =
+		mlsdk_decoder_create_module_table_decoder(Vgf.GetData() + SectionInfos[mlsdk_decoder_section_modules].offset, ModuleTableDecoderMemory.GetData());
+	mlsdk_decoder_model_resource_table_decoder* ModelResourceTableDecoder =
+		mlsdk_decoder_create_model_resource_table_decoder(Vgf.GetData() + SectionInfos[mlsdk_decoder_section_resources].offset, ModelResourceTableDecoderMemory.GetData());
+	mlsdk_decoder_model_sequence_decoder* ModelSequenceDecoder =
+		mlsdk_decoder_create_model_sequence_decoder(Vgf.GetData() + SectionInfos[mlsdk_decoder_section_model_sequence].offset, ModelSequenceDecoderMemory.GetData());
+	mlsdk_decoder_constant_table_decoder* ConstantTableDecoder =
+		mlsdk_decoder_create_constant_table_decoder(Vgf.GetData() + SectionInfos[mlsdk_decoder_section_constants].offset, ConstantTableDecoderMemory.GetData());
+
+	TArray<FTensor> Tensors;
+	TArray<uint32> ModelInputs;
+	TArray<uint32> ModelOutputs;
+	TArray<FSegment> Segments;
+	TArray<FBinding> Bindings;
+	TArray<FConstant> Constants;
+	TArray<int64> Dimensions;
+	TArray<uint32> RewrittenCode;
+
+	// Gather the format and shape of each resource in the model resource table. We will look these up later.
+	// Note that not all resources will have a concrete shape.
+	struct FResourceDesc
+	{
+		int32 Format = 0;
+		uint32 FirstDimension = 0;
+		uint32 NumDimensions = 0;
+		// Lookup from the index in the VGF model resource table to our renumbered IDs.
+		// Not all resources have a TensorId though, so this can be -1 (e.g. for constants).
+		int32 TensorId = -1;
+	};
+	const size_t NumModelResourceTableEntries = mlsdk_decoder_get_model_resource_table_num_entries(ModelResourceTableDecoder);
+	TArray<FResourceDesc> ResourceDescs;
+	ResourceDescs.Reserve(NumModelResourceTableEntries);
+	for (int ResourceIdx = 0; ResourceIdx < NumModelResourceTableEntries; ++ResourceIdx)
+	{
+		FResourceDesc& ResourceDesc = ResourceDescs.AddDefaulted_GetRef();
+		// The VGF format enum is just the regular Vulkan VkFormat.
+		ResourceDesc.Format = (int32)mlsdk_decoder_get_vk_format(ModelResourceTableDecoder, ResourceIdx);
+
+		mlsdk_decoder_tensor_dimensions DimsRaw;
+		mlsdk_decoder_model_resource_table_get_tensor_shape(ModelResourceTableDecoder, ResourceIdx, &DimsRaw);
+		ResourceDesc.FirstDimension = Dimensions.Num();
+		ResourceDesc.NumDimensions = DimsRaw.size;
+		for (int I = 0; I < DimsRaw.size; ++I)
+		{
+			int64 x = DimsRaw.data[I];
+			if (x <= 0)
+			{
+				// Negative values indicate that this dimension isn't specified in the model, and will need to determined
+				// by shape inference which can be done once the user calls SetInputTensorShapes to set concrete shapes.
+				x = -1; // Normalize any unspecified dimension to -1, for consistency with NNE tensor shape types.
+			}
+			Dimensions.Add(x);
+		}
+
+		mlsdk_decoder_tensor_dimensions StridesRaw;
+		mlsdk_decoder_model_resource_table_get_tensor_strides(ModelResourceTableDecoder, ResourceIdx, &StridesRaw);
+		if (StridesRaw.size > 0)
+		{
+			UE_LOG(LogNNERuntimeRDGMLExtensionsForVulkan, Error, TEXT("Strides not supported."));
+			return false;
+		}
+
+		mlsdk_decoder_mrt_category Category = mlsdk_decoder_model_resource_table_get_category(ModelResourceTableDecoder, ResourceIdx);
+		if (Category == mlsdk_decoder_mrt_category::mlsdk_decoder_mrt_category_input ||
+			Category == mlsdk_decoder_mrt_category::mlsdk_decoder_mrt_category_output ||
+			Category == mlsdk_decoder_mrt_category::mlsdk_decoder_mrt_category_intermediate)
+		{
+			// These are the tensors that need to be allocated and matched up between segments at inference time,
+			// so are given the next (consecutive) ID.
+			ResourceDesc.TensorId = Tensors.Num();
+			FTensor& Tensor = Tensors.AddZeroed_GetRef();
+			Tensor.Format = ResourceDesc.Format;
+			Tensor.ModelInputIdx = -1; // Filled in below.
+			Tensor.ModelOutputIdx = -1; // Filled in below.
+			Tensor.FirstDimension = ResourceDesc.FirstDimension;
+			Tensor.NumDimensions = ResourceDesc.NumDimensions;
+			Tensor.SharedConstantIdx = -1;
+		}
+	}
+
+	// Check which tensors are model inputs/output.
+	auto ProcessModelEndpoints = [&](mlsdk_decoder_binding_slots_handle BindingSlots, TArray<uint32>& OutTensorIds, int32 FTensor::* PointerToTensorInputOrOutputIdx)
+		{
+			const size_t NumBindings = mlsdk_decoder_binding_slot_size(ModelSequenceDecoder, BindingSlots);
+			for (int Idx = 0; Idx < NumBindings; ++Idx)
+			{
+				uint32_t ResourceIndex = mlsdk_decoder_binding_slot_mrt_index(ModelSequenceDecoder, BindingSlots, Idx);
+				if (ResourceIndex >= NumModelResourceTableEntries)
+				{
+					UE_LOG(LogNNERuntimeRDGMLExtensionsForVulkan, Error, TEXT("Corrupt VGF (resource index out of bounds)."));
+					return false;
+				}
+
+				int32 TensorId = ResourceDescs[ResourceIndex].TensorId;
+				if (TensorId == -1)
+				{
+					UE_LOG(LogNNERuntimeRDGMLExtensionsForVulkan, Error, TEXT("Invalid VGF (model input or output has incorrect resource type)."));
+					return false;
+				}
+				// Which model input/output this is (presumably the order of inputs/outputs in the VGF is not guaranteed to match the model input/output order)
+				Tensors[TensorId].*PointerToTensorInputOrOutputIdx = Idx;
+				OutTensorIds.Add(TensorId);
+			}
+
+			return true;
+		};
+
+	if (!ProcessModelEndpoints(mlsdk_decoder_model_sequence_get_input_binding_slot(ModelSequenceDecoder), ModelInputs, &FTensor::ModelInputIdx) ||
+		!ProcessModelEndpoints(mlsdk_decoder_model_sequence_get_output_binding_slot(ModelSequenceDecoder), ModelOutputs, &FTensor::ModelOutputIdx))
+	{
+		return false; // Error already logged by ProcessModelEndpoints.
+	}
+
+	// Lookup from the module index to where its optimized code is in the rewritten code table (see bOptimizeCode).
+	TMap<int32, TPair<uint64, uint32>> OptimizedModuleCode;
+	// Lookup from the index in the VGF constant table to the tensor that the constant was turned into (see SharedConstantMinBytes).
+	TMap<int32, int32> SharedConstantTensorIds;
+
+	// Loop over model sequence table, which is a list of 'segments' describing which modules (see above) to run in what order
+	// and what inputs/outputs they should have. This order handles any dependencies between modules.
+	const size_t NumModelSequenceTableEntries = mlsdk_decoder_get_model_sequence_table_size(ModelSequenceDecoder);
+	for (int ModelSequenceTableIdx = 0; ModelSequenceTableIdx < NumModelSequenceTableEntries; ++ModelSequenceTableIdx)
+	{
+		FSegment& Segment = Segments.AddZeroed_GetRef();
+
+		const char* SegmentNameRaw = mlsdk_decoder_model_sequence_get_segment_name(ModelSequenceDecoder, ModelSequenceTableIdx);
+		if (!GetVgfOffset(SegmentNameRaw, 1, Segment.NameOffset))
+		{
+			return false;
+		}
+
+		int32_t ModuleIndex = mlsdk_decoder_model_sequence_get_segment_module_index(ModelSequenceDecoder, ModelSequenceTableIdx);
+		Segment.ModuleIndex = ModuleIndex;
+
+		mlsdk_decoder_module_type SegmentType = mlsdk_decoder_model_sequence_get_segment_type(ModelSequenceDecoder, ModelSequenceTableIdx);
+		if (SegmentType != mlsdk_decoder_module_type::mlsdk_decoder_module_type_graph)
+		{
+			UE_LOG(LogNNERuntimeRDGMLExtensionsForVulkan, Error, TEXT("Non-graph segments not supported."));
+			return false;
+		}
+
+		// Gather graph pipeline bindings for inputs and outputs of this segment.
+		Segment.FirstBinding = Bindings.Num();
+		auto ProcessSegmentEndpoints = [&](mlsdk_decoder_binding_slots_handle BindingSlots, bool bIsOutput) {
+			const size_t NumBindings = mlsdk_decoder_binding_slot_size(ModelSequenceDecoder, BindingSlots);
+			for (int I = 0; I < NumBindings; ++I)
+			{
+				uint32_t ResourceIndex = mlsdk_decoder_binding_slot_mrt_index(ModelSequenceDecoder, BindingSlots, I);
+				if (ResourceIndex >= NumModelResourceTableEntries)
+				{
+					UE_LOG(LogNNERuntimeRDGMLExtensionsForVulkan, Error, TEXT("Corrupt VGF (resource index out of bounds)."));
+					return false;
+				}
+
+				int32 TensorId = ResourceDescs[ResourceIndex].TensorId;
+				if (TensorId == -1)
+				{
+					UE_LOG(LogNNERuntimeRDGMLExtensionsForVulkan, Error, TEXT("Invalid VGF (segment input or output has incorrect resource type)."));
+					return false;
+				}
+
+				FBinding& Binding = Bindings.AddZeroed_GetRef();
+				Binding.VulkanBindingIdx = mlsdk_decoder_binding_slot_binding_id(ModelSequenceDecoder, BindingSlots, I);
+				Binding.TensorId = TensorId;
+				Binding.bIsOutput = bIsOutput;
+			}
+			return true;
+			};
+
+		if (!ProcessSegmentEndpoints(mlsdk_decoder_model_sequence_get_segment_input_binding_slot(ModelSequenceDecoder, ModelSequenceTableIdx), false) ||
+			!ProcessSegmentEndpoints(mlsdk_decoder_model_sequence_get_segment_output_binding_slot(ModelSequenceDecoder, ModelSequenceTableIdx), true))
+		{
+			return false; // Error already logged by ProcessSegmentEndpoints.
+		}
+		Segment.NumBindings = Bindings.Num() - Segment.FirstBinding;
+
+		const size_t NumDescriptorSets = mlsdk_decoder_model_sequence_get_segment_descriptorset_info_size(ModelSequenceDecoder, ModelSequenceTableIdx);
+		if (NumDescriptorSets != 1)
+		{
+			// These are probably only needed for compute segments (which we don't support yet), and for graph segments we have all the info we need
+			// in the segment input/output bindings, so we just do a basic sanity check on this.
+			UE_LOG(LogNNERuntimeRDGMLExtensionsForVulkan, Error, TEXT("Descriptor sets count unexpected."));
+			return false;
+		}
+
+		mlsdk_decoder_push_constant_ranges_handle PushConstantsRanges = mlsdk_decoder_model_sequence_get_segment_push_constant_range(ModelSequenceDecoder, ModelSequenceTableIdx);
+		const size_t NumPushConstantRanges = mlsdk_decoder_get_push_constant_ranges_size(ModelSequenceDecoder, PushConstantsRanges);
+		if (NumPushConstantRanges != 0)
+		{
+			// These are probably intended to be used for compute segments, but we don't support these yet.
+			UE_LOG(LogNNERuntimeRDGMLExtensionsForVulkan, Error, TEXT("Push constants not supported."));
+			return false;
+		}
+
+		// Constants for this segment.
+		const size_t NumModelConstants = mlsdk_decoder_get_constant_table_num_entries(ConstantTableDecoder);
+		mlsdk_decoder_constant_indexes ConstantIndexes;
+		mlsdk_decoder_model_sequence_get_segment_constant_indexes(ModelSequenceDecoder, ModelSequenceTableIdx, &ConstantIndexes);
+		Segment.FirstConstant = Constants.Num();
+		Segment.NumConstants = ConstantIndexes.size;
+		for (int ConstantIdxWithinSegment = 0; ConstantIdxWithinSegment < ConstantIndexes.size; ++ConstantIdxWithinSegment)
+		{
+			int ModelConstantIdx = ConstantIndexes.data[ConstantIdxWithinSegment];
+			if (ModelConstantIdx < 0 || ModelConstantIdx >= NumModelConstants)
+			{
+				UE_LOG(LogNNERuntimeRDGMLExtensionsForVulkan, Error, TEXT("Corrupt VGF (segment constant idx out of bounds)."));
+				return false;
+			}
+
+			uint32_t ResourceIndex = mlsdk_decoder_constant_table_get_mrt_index(ConstantTableDecoder, ModelConstantIdx);
+			if (ResourceIndex >= NumModelResourceTableEntries)
+			{
+				UE_LOG(LogNNERuntimeRDGMLExtensionsForVulkan, Error, TEXT("Corrupt VGF (constant resource idx out of bounds)."));
+				return false;
+			}
+
+			mlsdk_decoder_constant_data ConstantData;
+			mlsdk_decoder_constant_table_get_data(ConstantTableDecoder, ModelConstantIdx, &ConstantData);
+
+			FConstant& Constant = Constants.AddZeroed_GetRef();
+			Constant.ConstantIndex = ModelConstantIdx;
+			Constant.Format = ResourceDescs[ResourceIndex].Format;
+			Constant.FirstDimension = ResourceDescs[ResourceIndex].FirstDimension;
+			Constant.NumDimensions = ResourceDescs[ResourceIndex].NumDimensions;
+			Constant.SharedTensorId = -1;
+			Constant.DataSize = ConstantData.size;
+			if (!GetVgfOffset(ConstantData.data, ConstantData.size, Constant.DataOffset))
+			{
+				return false;
+			}
+		}
+
+		mlsdk_decoder_module_type ModuleType = mlsdk_decoder_get_module_type(ModuleTableDecoder, ModuleIndex);
+		if (ModuleType != mlsdk_decoder_module_type_graph)
+		{
+			UE_LOG(LogNNERuntimeRDGMLExtensionsForVulkan, Error, TEXT("Non-graph modules not supported."));
+			return false;
+		}
+
+		mlsdk_decoder_spirv_code SPIRVCode;
+		mlsdk_decoder_get_module_code(ModuleTableDecoder, ModuleIndex, &SPIRVCode);
+		if (SPIRVCode.code == nullptr || SPIRVCode.words == 0)
+		{
+			UE_LOG(LogNNERuntimeRDGMLExtensionsForVulkan, Error, TEXT("Missing SPIRV code for module."));
+			return false;
+		}
+		Segment.CodeNumWords = SPIRVCode.words;
+		if (!GetVgfOffset(SPIRVCode.code, SPIRVCode.words * sizeof(uint32), Segment.CodeOffset))
+		{
+			return false;
+		}
+
+		if (!GetVgfOffset(mlsdk_decoder_get_module_entry_point(ModuleTableDecoder, ModuleIndex), 1, Segment.EntryPointOffset))
+		{
+			return false;
+		}
+
+		// Turn the large constants into extra inputs of the segment, bound to tensors holding the constant data, so that the data
+		// isn't baked into every pipeline. Segments which use the same constant from the VGF share the same tensor.
+		if (SharedConstantMinBytes > 0)
+		{
+			uint32 NextBindingIdx = 0;
+			for (const FBinding& Binding : TConstArrayView<FBinding>(Bindings).Slice(Segment.FirstBinding, Segment.NumBindings))
+			{
+				NextBindingIdx = FMath::Max(NextBindingIdx, Binding.VulkanBindingIdx + 1);
+			}
+
+			TMap<uint32_t, uint32_t> ConstantIdToBinding;
+			for (uint32 ConstantIdxWithinSegment = 0; ConstantIdxWithinSegment < Segment.NumConstants; ++ConstantIdxWithinSegment)
+			{
+				const int32 ConstantIdx = Segment.FirstConstant + ConstantIdxWithinSegment;
+				FConstant& Constant = Constants[ConstantIdx];
+				if (Constant.DataSize < SharedConstantMinBytes)
+				{
+					continue;
+				}
+
+				if (!SharedConstantTensorIds.Contains(Constant.ConstantIndex))
+				{
+					SharedConstantTensorIds.Add(Constant.ConstantIndex, Tensors.Num());
+					FTensor& Tensor = Tensors.AddZeroed_GetRef();
+					Tensor.Format = Constant.Format;
+					Tensor.ModelInputIdx = -1;
+					Tensor.ModelOutputIdx = -1;
+					Tensor.FirstDimension = Constant.FirstDimension;
+					Tensor.NumDimensions = Constant.NumDimensions;
+					Tensor.SharedConstantIdx = ConstantIdx;
+				}
+				Constant.SharedTensorId = SharedConstantTensorIds[Constant.ConstantIndex];
+
+				FBinding& Binding = Bindings.AddZeroed_GetRef();
+				Binding.VulkanBindingIdx = NextBindingIdx;
+				Binding.TensorId = Constant.SharedTensorId;
+				ConstantIdToBinding.Add(ConstantIdxWithinSegment, NextBindingIdx++);
+			}
+			Segment.NumBindings = Bindings.Num() - Segment.FirstBinding;
+
+			if (!ConstantIdToBinding.IsEmpty())
+			{
+				TArray<uint32_t> NewCode;
+				if (!RewriteGraphConstantsAsInputs(TConstArrayView<uint32_t>(SPIRVCode.code, (int32)SPIRVCode.words), ConstantIdToBinding, NewCode))
+				{
+					UE_LOG(LogNNERuntimeRDGMLExtensionsForVulkan, Error, TEXT("Failed to turn constants into inputs for segment %hs."), SegmentNameRaw);
+					return false;
+				}
+				Segment.bRewrittenCode = true;
+				Segment.CodeOffset = RewrittenCode.Num();
+				Segment.CodeNumWords = NewCode.Num();
+				RewrittenCode.Append(NewCode.GetData(), NewCode.Num());
+			}
+		}
+
+		if (bOptimizeCode)
+		{
+			// Segments which run the same module share its optimized code, unless their constants were rewritten above.
+			if (const TPair<uint64, uint32>* OptimizedCode = Segment.bRewrittenCode ? nullptr : OptimizedModuleCode.Find(ModuleIndex))
+			{
+				Segment.bRewrittenCode = true;
+				Segment.CodeOffset = OptimizedCode->Key;
+				Segment.CodeNumWords = OptimizedCode->Value;
+			}
+			else
+			{
+				TArray<uint32_t> NewCode;
+				if (!OptimizeGraphModule(Segment.bRewrittenCode ?
+					TConstArrayView<uint32_t>(RewrittenCode).Slice((int32)Segment.CodeOffset, (int32)Segment.CodeNumWords) :
+					TConstArrayView<uint32_t>(SPIRVCode.code, (int32)SPIRVCode.words), NewCode))
+				{
+					UE_LOG(LogNNERuntimeRDGMLExtensionsForVulkan, Error, TEXT("Failed to optimize SPIR-V for segment %hs."), SegmentNameRaw);
+					return false;
+				}
+				UE_LOG(LogNNERuntimeRDGMLExtensionsForVulkan, Display, TEXT("Optimized SPIR-V for segment %hs (module %d) from %llu to %d bytes."),
+					SegmentNameRaw, ModuleIndex, (uint64)(Segment.CodeNumWords * sizeof(uint32)), NewCode.Num() * (int32)sizeof(uint32));
+
+				if (Segment.bRewrittenCode)
+				{
+					// This segment's rewritten code is the last thing in the table, so replace it.
+					RewrittenCode.SetNum((int32)Segment.CodeOffset);
+				}
+				else
+				{
+					OptimizedModuleCode.Add(ModuleIndex, { (uint64)RewrittenCode.Num(), (uint32)NewCode.Num() });
+				}
+				Segment.bRewrittenCode = true;
+				Segment.CodeOffset = RewrittenCode.Num();
+				Segment.CodeNumWords = NewCode.Num();
+				RewrittenCode.Append(NewCode.GetData(), NewCode.Num());
+			}
+		}
+	}
+
+	// Pin any of the model input dimensions that were overridden when the model was imported.
+	if (InputShapeOverrides.Num() > ModelInputs.Num())
+	{
+		UE_LOG(LogNNERuntimeRDGMLExtensionsForVulkan, Error, TEXT("Input shape overrides given for %d inputs, but the model only has %d."), InputShapeOverrides.Num(), ModelInputs.Num());
+		return false;
+	}
+	for (int32 InputIdx = 0; InputIdx < InputShapeOverrides.Num(); ++InputIdx)
+	{
+		const TArray<int32>& Override = InputShapeOverrides[InputIdx];
+		if (Override.IsEmpty())
+		{
+			continue; // This input isn't overridden.
+		}
+		const FTensor& Tensor = Tensors[ModelInputs[InputIdx]];
+		if (Override.Num() != Tensor.NumDimensions)
+		{
+			UE_LOG(LogNNERuntimeRDGMLExtensionsForVulkan, Error, TEXT("Input shape override for input %d has %d dimensions, but the input has %d."), InputIdx, Override.Num(), Tensor.NumDimensions);
+			return false;
+		}
+		for (int32 DimIdx = 0; DimIdx < Override.Num(); ++DimIdx)
+		{
+			int64& Dim = Dimensions[Tensor.FirstDimension + DimIdx];
+			if (Override[DimIdx] != -1)
+			{
+				if (Dim != -1 && Dim != Override[DimIdx])
+				{
+					UE_LOG(LogNNERuntimeRDGMLExtensionsForVulkan, Error, TEXT("Input shape override for input %d conflicts with dimension %d specified in the model."), InputIdx, DimIdx);
+					return false;
+				}
+				Dim = Override[DimIdx];
+			}
+		}
+	}
+
+	// If all the model input shapes are now concrete then the model is static, so make sure it's pre-shaped for those shapes.
+	TArray<UE::NNE::FTensorShape> StaticInputShapes;
+	for (uint32 TensorId : ModelInputs)
+	{
+		const TConstArrayView<int64> Shape = TConstArrayView<int64>(Dimensions).Slice(Tensors[TensorId].FirstDimension, Tensors[TensorId].NumDimensions);
+		if (Shape.Contains(-1))
+		{
+			StaticInputShapes.Reset();
+			break;
+		}
+		TArray<uint32> ShapeU32;
+		Algo::Transform(Shape, ShapeU32, [](int64 Dim) { return (uint32)Dim; });
+		StaticInputShapes.Add(UE::NNE::FTensorShape::Make(ShapeU32));
+	}
+	const bool bIsStatic = StaticInputShapes.Num() == ModelInputs.Num();
+	TArray<TArray<UE::NNE::FTensorShape>> AllPreShapeInputShapeSets(PreShapeInputShapeSets);
+	if (bIsStatic && !AllPreShapeInputShapeSets.Contains(StaticInputShapes))
+	{
+		AllPreShapeInputShapeSets.Add(StaticInputShapes);
+	}
+	const int32 StaticSetIdx = bIsStatic ? AllPreShapeInputShapeSets.IndexOfByKey(StaticInputShapes) : INDEX_NONE;
+
+	// Run shape inference for each of the requested sets of model input shapes, going through the segments in order so that
+	// the output shapes of one segment are known before they are needed as input shapes for a later one.
+	TArray<FPreShapedModel> PreShapedModels;
+	TArray<FShape> PreShapedTensorShapes;
+	TArray<FPreShapedSegment> PreShapedSegments;
+	TArray<uint32> PreShapedCode;
+	for (int32 SetIdx = 0; SetIdx < AllPreShapeInputShapeSets.Num(); ++SetIdx)
+	{
+		const TArray<UE::NNE::FTensorShape>& InputShapes = AllPreShapeInputShapeSets[SetIdx];
+		if (InputShapes.Num() != ModelInputs.Num())
+		{
+			UE_LOG(LogNNERuntimeRDGMLExtensionsForVulkan, Error, TEXT("Pre-shaped input shapes %d: expected %d input shapes but got %d."), SetIdx, ModelInputs.Num(), InputShapes.Num());
+			return false;
+		}
+
+		TArray<TArray<int64_t>> TensorShapes;
+		TensorShapes.SetNum(Tensors.Num());
+		for (int32 TensorId = 0; TensorId < Tensors.Num(); ++TensorId)
+		{
+			if (Tensors[TensorId].SharedConstantIdx != -1)
+			{
+				// Constants always have concrete shapes.
+				Algo::Transform(TConstArrayView<int64>(Dimensions).Slice(Tensors[TensorId].FirstDimension, Tensors[TensorId].NumDimensions), TensorShapes[TensorId],
+					[](int64 Dim) { return (int64_t)Dim; });
+			}
+		}
+		for (int32 InputIdx = 0; InputIdx < InputShapes.Num(); ++InputIdx)
+		{
+			const FTensor& Tensor = Tensors[ModelInputs[InputIdx]];
+			const TConstArrayView<uint32> Shape = InputShapes[InputIdx].GetData();
+			bool bCompatible = Shape.Num() == Tensor.NumDimensions;
+			for (int32 DimIdx = 0; bCompatible && DimIdx < Shape.Num(); ++DimIdx)
+			{
+				const int64 ModelDim = Dimensions[Tensor.FirstDimension + DimIdx];
+				bCompatible = ModelDim == -1 || ModelDim == Shape[DimIdx];
+			}
+			if (!bCompatible)
+			{
+				UE_LOG(LogNNERuntimeRDGMLExtensionsForVulkan, Error, TEXT("Pre-shaped input shapes %d: shape of input %d is not compatible with the model."), SetIdx, InputIdx);
+				return false;
+			}
+			Algo::Transform(Shape, TensorShapes[ModelInputs[InputIdx]], [](uint32 Dim) { return (int64_t)Dim; });
+		}
+
+		FPreShapedModel& PreShapedModel = PreShapedModels.AddZeroed_GetRef();
+		PreShapedModel.FirstTensorShape = PreShapedTensorShapes.Num();
+		PreShapedModel.FirstSegment = PreShapedSegments.Num();
+		for (const FSegment& Segment : Segments)
+		{
+			const TConstArrayView<FBinding> SegmentBindings = TConstArrayView<FBinding>(Bindings).Slice(Segment.FirstBinding, Segment.NumBindings);
+
+			FDescriptorSetBindingToShapeMap SegmentInputShapes;
+			for (const FBinding& Binding : SegmentBindings)
+			{
+				if (!Binding.bIsOutput)
+				{
+					SegmentInputShapes.Add({ 0, Binding.VulkanBindingIdx }, TensorShapes[Binding.TensorId]);
+				}
+			}
+
+			// Not cached (see FNNERuntimeRDGMLExtensionsForVulkanShapeInferenceCache), as the results are stored in the model data instead.
+			const ShapeInferenceResults Results = RunShapeInference(Segment.bRewrittenCode ?
+				TConstArrayView<uint32_t>(RewrittenCode).Slice((int32)Segment.CodeOffset, (int32)Segment.CodeNumWords) :
+				TConstArrayView<uint32_t>(reinterpret_cast<const uint32_t*>(Vgf.GetData() + Segment.CodeOffset), (int32)Segment.CodeNumWords), SegmentInputShapes);
+			if (!Results.Success)
+			{
+				UE_LOG(LogNNERuntimeRDGMLExtensionsForVulkan, Error, TEXT("Pre-shaped input shapes %d: shape inference failed."), SetIdx);
+				return false;
+			}
+
+			for (const FBinding& Binding : SegmentBindings)
+			{
+				if (Binding.bIsOutput)
+				{
+					const TArray<int64_t>* OutputShape = Results.OutputShapes.Find({ 0, Binding.VulkanBindingIdx });
+					if (OutputShape == nullptr)
+					{
+						UE_LOG(LogNNERuntimeRDGMLExtensionsForVulkan, Error, TEXT("Pre-shaped input shapes %d: shape inference didn't produce a shape for an output."), SetIdx);
+						return false;
+					}
+					TensorShapes[Binding.TensorId] = *OutputShape;
+				}
+			}
+
+			PreShapedSegments.Add({ (uint64)PreShapedCode.Num(), (uint64)Results.NewCode.Num() });
+			PreShapedCode.Append(Results.NewCode.GetData(), Results.NewCode.Num());
+		}
+
+		for (int32 TensorId = 0; TensorId < Tensors.Num(); ++TensorId)
+		{
+			const TArray<int64_t>& Shape = TensorShapes[TensorId];
+			if (Shape.Num() != Tensors[TensorId].NumDimensions || Shape.Contains(-1))
+			{
+				UE_LOG(LogNNERuntimeRDGMLExtensionsForVulkan, Error, TEXT("Pre-shaped input shapes %d: shape inference didn't produce a concrete shape for every tensor."), SetIdx);
+				return false;
+			}
+			PreShapedTensorShapes.Add({ (uint32)Dimensions.Num(), (uint32)Shape.Num() });
+			Algo::Transform(Shape, Dimensions, [](int64_t Dim) { return (int64)Dim; });
+		}
+
+		if (SetIdx == StaticSetIdx)
+		{
+			// Make the shapes of the intermediate tensors and model outputs concrete too.
+			for (int32 TensorId = 0; TensorId < Tensors.Num(); ++TensorId)
+			{
+				for (int32 DimIdx = 0; DimIdx < TensorShapes[TensorId].Num(); ++DimIdx)
+				{
+					Dimensions[Tensors[TensorId].FirstDimension + DimIdx] = TensorShapes[TensorId][DimIdx];
+				}
+			}
+		}
+	}
+
+	// Copies data from the VGF to the end of Dest (unless it's already been copied), and updates the offset to point to the copy.
+	auto Repack = [&Vgf](TArray64<uint8>& Dest, TMap<TPair<uint64, uint64>, uint64>& Copies, uint64& InOutOffset, uint64 Size, uint32 Alignment) {
+		if (const uint64* CopyOffset = Copies.Find({ InOutOffset, Size }))
+		{
+			InOutOffset = *CopyOffset;
+			return;
+		}
+		Dest.AddZeroed(Align(Dest.Num(), Alignment) - Dest.Num());
+		Copies.Add({ InOutOffset, Size }, Dest.Num());
+		Dest.Append(Vgf.GetData() + InOutOffset, Size);
+		InOutOffset = Dest.Num() - Size;
+	};
+
+	// If the constants are going to be compressed, or any of the SPIR-V code has been replaced, the parts of the VGF that are still
+	// used are copied out of it and the VGF itself isn't stored. Otherwise the VGF is stored as it is, as that avoids a copy.
+	TConstArrayView64<uint8> StoredVgf = Vgf;
+	TArray64<uint8> RepackedVgf;
+	if (bCompressConstants || !RewrittenCode.IsEmpty())
+	{
+		TMap<TPair<uint64, uint64>, uint64> VgfCopies;
+		for (FSegment& Segment : Segments)
+		{
+			Repack(RepackedVgf, VgfCopies, Segment.NameOffset, FCStringAnsi::Strlen(reinterpret_cast<const char*>(Vgf.GetData() + Segment.NameOffset)) + 1, 1);
+			Repack(RepackedVgf, VgfCopies, Segment.EntryPointOffset, FCStringAnsi::Strlen(reinterpret_cast<const char*>(Vgf.GetData() + Segment.EntryPointOffset)) + 1, 1);
+			if (!Segment.bRewrittenCode)
+			{
+				Repack(RepackedVgf, VgfCopies, Segment.CodeOffset, Segment.CodeNumWords * sizeof(uint32), sizeof(uint32));
+			}
+		}
+		if (!bCompressConstants)
+		{
+			for (FConstant& Constant : Constants)
+			{
+				Repack(RepackedVgf, VgfCopies, Constant.DataOffset, Constant.DataSize, CONSTANT_ALIGNMENT);
+			}
+		}
+		StoredVgf = RepackedVgf;
+	}
+
+	// The constant data is most of the VGF, so optionally compress it.
+	TArray<FConstantChunk> ConstantChunks;
+	TArray64<uint8> CompressedConstants;
+	if (bCompressConstants)
+	{
+		// Each constant is aligned, so that it can be used in-place once decompressed. Constants shared by several segments are only stored once.
+		TArray64<uint8> DecompressedConstants;
+		TMap<TPair<uint64, uint64>, uint64> ConstantCopies;
+		for (FConstant& Constant : Constants)
+		{
+			Repack(DecompressedConstants, ConstantCopies, Constant.DataOffset, Constant.DataSize, CONSTANT_ALIGNMENT);
+		}
+
+		// Chunks are compressed independently (and in parallel, as this is slow for large models).
+		const int32 NumChunks = (int32)FMath::DivideAndRoundUp<int64>(DecompressedConstants.Num(), CONSTANT_CHUNK_SIZE);
+		TArray<TArray<uint8>> CompressedChunks;
+		CompressedChunks.SetNum(NumChunks);
+		ParallelFor(NumChunks, [&](int32 ChunkIdx) {
+			const int64 UncompressedOffset = (int64)ChunkIdx * CONSTANT_CHUNK_SIZE;
+			const int32 UncompressedSize = (int32)FMath::Min<int64>(CONSTANT_CHUNK_SIZE, DecompressedConstants.Num() - UncompressedOffset);
+			TArray<uint8>& CompressedChunk = CompressedChunks[ChunkIdx];
+			int32 CompressedSize = FCompression::CompressMemoryBound(NAME_Oodle, UncompressedSize);
+			CompressedChunk.SetNumUninitialized(CompressedSize);
+			if (!FCompression::CompressMemory(NAME_Oodle, CompressedChunk.GetData(), CompressedSize, DecompressedConstants.GetData() + UncompressedOffset, UncompressedSize) ||
+				CompressedSize >= UncompressedSize)
+			{
+				// Not worth compressing, so store it as it is (which is indicated by the sizes being the same).
+				CompressedChunk = TArray<uint8>(DecompressedConstants.GetData() + UncompressedOffset, UncompressedSize);
+			}
+			else
+			{
+				CompressedChunk.SetNum(CompressedSize);
+			}
+		});
+		for (int32 ChunkIdx = 0; ChunkIdx < NumChunks; ++ChunkIdx)
+		{
+			const uint64 UncompressedOffset = (uint64)ChunkIdx * CONSTANT_CHUNK_SIZE;
+			ConstantChunks.Add({ (uint64)CompressedConstants.Num(), (uint64)CompressedChunks[ChunkIdx].Num(),
+				UncompressedOffset, FMath::Min<uint64>(CONSTANT_CHUNK_SIZE, DecompressedConstants.Num() - UncompressedOffset) });
+			CompressedConstants.Append(CompressedChunks[ChunkIdx]);
+		}
+		UE_LOG(LogNNERuntimeRDGMLExtensionsForVulkan, Display, TEXT("Compressed model constants from %lld to %lld bytes."), (int64)DecompressedConstants.Num(), (int64)CompressedConstants.Num());
+	}
+
+	// Now lay it all out. Where everything goes is worked out first, so that the model data is only allocated once at its final size
+	// and the VGF (which can be very large) is copied straight into it rather than going via any temporary buffers.
+	check(OutData.Num() % PAYLOAD_ALIGNMENT == 0);
+	const int64 PayloadOffset = OutData.Num();
+	FHeader Header;
+	uint64 PayloadSize = sizeof(FHeader);
+	Header.Tensors = PlaceTable<FTensor>(PayloadSize, Tensors, PayloadOffset);
+	Header.ModelInputs = PlaceTable<uint32>(PayloadSize, ModelInputs, PayloadOffset);
+	Header.ModelOutputs = PlaceTable<uint32>(PayloadSize, ModelOutputs, PayloadOffset);
+	Header.Segments = PlaceTable<FSegment>(PayloadSize, Segments, PayloadOffset);
+	Header.Bindings = PlaceTable<FBinding>(PayloadSize, Bindings, PayloadOffset);
+	Header.Constants = PlaceTable<FConstant>(PayloadSize, Constants, PayloadOffset);
+	Header.Dimensions = PlaceTable<int64>(PayloadSize, Dimensions, PayloadOffset);
+	Header.PreShapedModels = PlaceTable<FPreShapedModel>(PayloadSize, PreShapedModels, PayloadOffset);
+	Header.PreShapedTensorShapes = PlaceTable<FShape>(PayloadSize, PreShapedTensorShapes, PayloadOffset);
+	Header.PreShapedSegments = PlaceTable<FPreShapedSegment>(PayloadSize, PreShapedSegments, PayloadOffset);
+	Header.PreShapedCode = PlaceTable<uint32>(PayloadSize, PreShapedCode, PayloadOffset);
+	Header.ConstantChunks = PlaceTable<FConstantChunk>(PayloadSize, ConstantChunks, PayloadOffset);
+	Header.CompressedConstants = PlaceTable<uint8>(PayloadSize, CompressedConstants, PayloadOffset);
+	Header.RewrittenCode = PlaceTable<uint32>(PayloadSize, RewrittenCode, PayloadOffset);
+	// The VGF goes last, starting on a new page so that the (small) tables above are all together in the first page(s).
+	Header.Vgf = PlaceTable<uint8>(PayloadSize, StoredVgf, PayloadOffset, PAGE_ALIGNMENT);
+	OutData.Reserve(PayloadOffset + PayloadSize); // Exactly, as growing would add slack proportional to the (large) size.
+	OutData.AddZeroed(PayloadSize); // Zeroed so that the padding between tables is deterministic.
+	uint8* Payload = OutData.GetData() + PayloadOffset;
+	FMemory::Memcpy(Payload, &Header, sizeof(Header));
+	CopyTable<FTensor>(Payload, Header.Tensors, Tensors);
+	CopyTable<uint32>(Payload, Header.ModelInputs, ModelInputs);
+	CopyTable<uint32>(Payload, Header.ModelOutputs, ModelOutputs);
+	CopyTable<FSegment>(Payload, Header.Segments, Segments);
+	CopyTable<FBinding>(Payload, Header.Bindings, Bindings);
+	CopyTable<FConstant>(Payload, Header.Constants, Constants);
+	CopyTable<int64>(Payload, Header.Dimensions, Dimensions);
+	CopyTable<uint8>(Payload, Header.Vgf, StoredVgf);
+	CopyTable<FPreShapedModel>(Payload, Header.PreShapedModels, PreShapedModels);
+	CopyTable<FShape>(Payload, Header.PreShapedTensorShapes, PreShapedTensorShapes);
+	CopyTable<FPreShapedSegment>(Payload, Header.PreShapedSegments, PreShapedSegments);
+	CopyTable<uint32>(Payload, Header.PreShapedCode, PreShapedCode);
+	CopyTable<FConstantChunk>(Payload, Header.ConstantChunks, ConstantChunks);
+	CopyTable<uint8>(Payload, Header.CompressedConstants, CompressedConstants);
+	CopyTable<uint32>(Payload, Header.RewrittenCode, RewrittenCode);
+
+	return true;
+}
+
+const FNNERuntimeRDGMLExtensionsForVulkanModelFormat::FHeader* FNNERuntimeRDGMLExtensionsForVulkanModelFormat::Validate(TConstArrayView64<uint8> Payload)
+{
+	auto Fail = [](const TCHAR* Reason) -> const FHeader* {
+		UE_LOG(LogNNERuntimeRDGMLExtensionsForVulkan, Error, TEXT("Invalid model data (%s)."), Reason);
+		return nullptr;
+	};
+
+	if (Payload.Num() < sizeof(FHeader) || !IsAligned(Payload.GetData(), PAYLOAD_ALIGNMENT))
+	{
+		return Fail(TEXT("missing or misaligned header"));
+	}
+	const FHeader* Header = reinterpret_cast<const FHeader*>(Payload.GetData());
+
+	if (!IsTableValid<FTensor>(Payload, Header->Tensors) || !IsTableValid<uint32>(Payload, Header->ModelInputs) ||
+		!IsTableValid<uint32>(Payload, Header->ModelOutputs) || !IsTableValid<FSegment>(Payload, Header->Segments) ||
+		!IsTableValid<FBinding>(Payload, Header->Bindings) || !IsTableValid<FConstant>(Payload, Header->Constants) ||
+		!IsTableValid<int64>(Payload, Header->Dimensions) || !IsTableValid<uint8>(Payload, Header->Vgf, MAX_int64) ||
+		Header->Vgf.Offset % PAYLOAD_ALIGNMENT != 0 || !IsTableValid<FPreShapedModel>(Payload, Header->PreShapedModels) ||
+		!IsTableValid<FShape>(Payload, Header->PreShapedTensorShapes) || !IsTableValid<FPreShapedSegment>(Payload, Header->PreShapedSegments) ||
+		!IsTableValid<uint32>(Payload, Header->PreShapedCode) || !IsTableValid<FConstantChunk>(Payload, Header->ConstantChunks) ||
+		!IsTableValid<uint8>(Payload, Header->CompressedConstants, MAX_int64) || !IsTableValid<uint32>(Payload, Header->RewrittenCode))
+	{
+		return Fail(TEXT("table out of bounds"));
+	}
+
+	const TConstArrayView64<uint8> Vgf = GetVgf(Header);
+	const uint64 NumTensors = Header->Tensors.Num;
+
+	for (const FTensor& Tensor : GetTable<FTensor>(Header, Header->Tensors))
+	{
+		if (!IsRangeValid(Tensor.FirstDimension, Tensor.NumDimensions, Header->Dimensions.Num) ||
+			Tensor.ModelInputIdx < -1 || Tensor.ModelInputIdx >= (int64)Header->ModelInputs.Num ||
+			Tensor.ModelOutputIdx < -1 || Tensor.ModelOutputIdx >= (int64)Header->ModelOutputs.Num ||
+			Tensor.SharedConstantIdx < -1 || Tensor.SharedConstantIdx >= (int64)Header->Constants.Num ||
+			(Tensor.SharedConstantIdx != -1 && (Tensor.ModelInputIdx != -1 || Tensor.ModelOutputIdx != -1)))
+		{
+			return Fail(TEXT("tensor"));
+		}
+	}
+	for (const TConstArrayView<uint32>& Endpoints : { GetTable<uint32>(Header, Header->ModelInputs), GetTable<uint32>(Header, Header->ModelOutputs) })
+	{
+		for (uint32 TensorId : Endpoints)
+		{
+			if (TensorId >= NumTensors)
+			{
+				return Fail(TEXT("model input or output"));
+			}
+		}
+	}
+	for (const FSegment& Segment : GetTable<FSegment>(Header, Header->Segments))
+	{
+		if (!IsRangeValid(Segment.FirstBinding, Segment.NumBindings, Header->Bindings.Num) ||
+			!IsRangeValid(Segment.FirstConstant, Segment.NumConstants, Header->Constants.Num) ||
+			!IsStringValid(Vgf, Segment.NameOffset) || !IsStringValid(Vgf, Segment.EntryPointOffset) ||
+			Segment.CodeNumWords == 0 || Segment.CodeNumWords > MAX_int32 || (Segment.bRewrittenCode ?
+				!IsRangeValid(Segment.CodeOffset, Segment.CodeNumWords, Header->RewrittenCode.Num) :
+				(Segment.CodeOffset % sizeof(uint32) != 0 || !IsRangeValid(Segment.CodeOffset, Segment.CodeNumWords * sizeof(uint32), Vgf.Num()))))
+		{
+			return Fail(TEXT("segment"));
+		}
+	}
+	for (const FBinding& Binding : GetTable<FBinding>(Header, Header->Bindings))
+	{
+		if (Binding.TensorId >= NumTensors)
+		{
+			return Fail(TEXT("segment binding"));
+		}
+	}
+	uint64 DecompressedConstantsSize = 0;
+	for (const FConstantChunk& Chunk : GetTable<FConstantChunk>(Header, Header->ConstantChunks))
+	{
+		if (Chunk.UncompressedOffset != DecompressedConstantsSize || Chunk.UncompressedSize == 0 || Chunk.UncompressedSize > CONSTANT_CHUNK_SIZE ||
+			Chunk.CompressedSize > MAX_int32 || !IsRangeValid(Chunk.CompressedOffset, Chunk.CompressedSize, Header->CompressedConstants.Num))
+		{
+			return Fail(TEXT("constant chunk"));
+		}
+		DecompressedConstantsSize += Chunk.UncompressedSize;
+	}
+	const uint64 ConstantDataSize = Header->ConstantChunks.Num > 0 ? DecompressedConstantsSize : Vgf.Num();
+	for (const FConstant& Constant : GetTable<FConstant>(Header, Header->Constants))
+	{
+		if (!IsRangeValid(Constant.FirstDimension, Constant.NumDimensions, Header->Dimensions.Num) ||
+			!IsRangeValid(Constant.DataOffset, Constant.DataSize, ConstantDataSize) ||
+			Constant.SharedTensorId < -1 || Constant.SharedTensorId >= (int64)NumTensors ||
+			(Constant.SharedTensorId != -1 && GetTable<FTensor>(Header, Header->Tensors)[Constant.SharedTensorId].SharedConstantIdx == -1))
+		{
+			return Fail(TEXT("constant"));
+		}
+	}
+
+	for (const FPreShapedModel& PreShapedModel : GetTable<FPreShapedModel>(Header, Header->PreShapedModels))
+	{
+		if (!IsRangeValid(PreShapedModel.FirstTensorShape, NumTensors, Header->PreShapedTensorShapes.Num) ||
+			!IsRangeValid(PreShapedModel.FirstSegment, Header->Segments.Num, Header->PreShapedSegments.Num))
+		{
+			return Fail(TEXT("pre-shaped model"));
+		}
+		const TConstArrayView<FTensor> Tensors = GetTable<FTensor>(Header, Header->Tensors);
+		const TConstArrayView<FShape> Shapes = GetTable<FShape>(Header, Header->PreShapedTensorShapes).Slice(PreShapedModel.FirstTensorShape, (int32)NumTensors);
+		for (int32 TensorId = 0; TensorId < Tensors.Num(); ++TensorId)
+		{
+			if (Shapes[TensorId].NumDimensions != Tensors[TensorId].NumDimensions)
+			{
+				return Fail(TEXT("pre-shaped model"));
+			}
+		}
+	}
+	for (const FShape& Shape : GetTable<FShape>(Header, Header->PreShapedTensorShapes))
+	{
+		if (!IsRangeValid(Shape.FirstDimension, Shape.NumDimensions, Header->Dimensions.Num))
+		{
+			return Fail(TEXT("pre-shaped tensor shape"));
+		}
+	}
+	for (const FPreShapedSegment& PreShapedSegment : GetTable<FPreShapedSegment>(Header, Header->PreShapedSegments))
+	{
+		if (PreShapedSegment.CodeNumWords == 0 || !IsRangeValid(PreShapedSegment.CodeOffset, PreShapedSegment.CodeNumWords, Header->PreShapedCode.Num))
+		{
+			return Fail(TEXT("pre-shaped segment"));
+		}
+	}
+
+	return Header;
+}
+
+bool FNNERuntimeRDGMLExtensionsForVulkanModelFormat::DecompressConstantChunk(const FHeader* Header, int32 ChunkIdx, uint8* DecompressedConstants)
+{
+	const FConstantChunk& Chunk = GetTable<FConstantChunk>(Header, Header->ConstantChunks)[ChunkIdx];
+	const uint8* CompressedData = GetCompressedConstants(Header).GetData() + Chunk.CompressedOffset;
+	uint8* UncompressedData = DecompressedConstants + Chunk.UncompressedOffset;
+	if (Chunk.CompressedSize == Chunk.UncompressedSize)
+	{
+		FMemory::Memcpy(UncompressedData, CompressedData, Chunk.UncompressedSize);
+		return true;
+	}
+	return FCompression::UncompressMemory(NAME_Oodle, UncompressedData, (int32)Chunk.UncompressedSize, CompressedData, (int32)Chunk.CompressedSize);
+}
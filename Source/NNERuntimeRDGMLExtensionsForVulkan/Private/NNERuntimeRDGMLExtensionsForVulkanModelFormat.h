@@ -0,0 +1,195 @@
+// SPDX-FileCopyrightText: Copyright 2025 Arm Limited and/or its affiliates <open-source-office@arm.com>
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include "Containers/Array.h"
+#include "Containers/ArrayView.h"
+#include "NNETypes.h"
+
+// The layout of the model data produced by UNNERuntimeRDGMLExtensionsForVulkan::CreateModelData (following the GUID and version).
+// The VGF is decoded when the model is imported/cooked rather than every time a model is created at runtime, and the results are
+// stored as flat tables of plain structs which can be used in-place once Validate has checked them.
+// The VGF itself is kept at the end of the payload, as the SPIR-V code and constant data are used directly from it.
+// All offsets are in bytes. Table offsets are relative to the start of the payload (i.e. the FHeader), and offsets into the
+// VGF are relative to the start of the VGF. Everything is little-endian with explicit padding, so the layout is the same
+// on every platform that we support.
+struct FNNERuntimeRDGMLExtensionsForVulkanModelFormat
+{
+	// The payload and all the tables within it start at a multiple of this.
+	static constexpr uint32 PAYLOAD_ALIGNMENT = 16;
+	// The VGF starts at a multiple of this from the start of the model data. This means that when the model data is memory-mapped
+	// (see UNNERuntimeRDGMLExtensionsForVulkan::CreateModelRDGFromFileAsync), which starts it on a page boundary, the small tables
+	// before the VGF share as few pages as possible with the SPIR-V code and constant data, and only the pages that are used
+	// become resident. 16KB covers both 4KB and 16KB pages. The model data itself only needs PAYLOAD_ALIGNMENT, as asking
+	// FSharedModelData for more would make it copy any buffer that isn't already aligned to it, such as a mapping on a device with 4KB pages.
+	static constexpr uint32 PAGE_ALIGNMENT = 16384;
+	// When the constants are compressed, each one starts at a multiple of this in the decompressed constants, and they are
+	// compressed in independent chunks of (at most) this size so that they can be decompressed in parallel.
+	static constexpr uint32 CONSTANT_ALIGNMENT = 64;
+	static constexpr uint32 CONSTANT_CHUNK_SIZE = 256 * 1024;
+
+	// Where a table is in the payload.
+	struct FTableRange
+	{
+		uint64 Offset;
+		uint64 Num; // Number of elements, not bytes.
+	};
+
+	struct FHeader
+	{
+		FTableRange Tensors; // FTensor
+		FTableRange ModelInputs; // uint32 TensorId for each model input
+		FTableRange ModelOutputs; // uint32 TensorId for each model output
+		FTableRange Segments; // FSegment
+		FTableRange Bindings; // FBinding
+		FTableRange Constants; // FConstant
+		FTableRange Dimensions; // int64, referenced by FTensor, FConstant and FShape
+		FTableRange Vgf; // uint8. Only the parts of the VGF which are used, if the constants are compressed or any of the code was rewritten.
+		FTableRange PreShapedModels; // FPreShapedModel
+		FTableRange PreShapedTensorShapes; // FShape
+		FTableRange PreShapedSegments; // FPreShapedSegment
+		FTableRange PreShapedCode; // uint32 SPIR-V words
+		FTableRange ConstantChunks; // FConstantChunk. Empty unless the constants are compressed.
+		FTableRange CompressedConstants; // uint8
+		FTableRange RewrittenCode; // uint32 SPIR-V words, for segments whose constants were turned into inputs or whose code was optimized (see Write).
+	};
+
+	// An input, output or intermediate (between segments) tensor. The index into this table is the 'TensorId'.
+	struct FTensor
+	{
+		int32 Format; // VkFormat
+		int32 ModelInputIdx; // -1 if not a model input.
+		int32 ModelOutputIdx; // -1 if not a model output.
+		uint32 FirstDimension; // Into the dimensions table. Dimensions which aren't specified in the model are -1.
+		uint32 NumDimensions;
+		// Into the constants table if this tensor holds the data of a constant which was turned into an input (see Write), or -1.
+		// These tensors are bound to a single copy of the data which is shared by all the shaped models.
+		int32 SharedConstantIdx;
+	};
+
+	// An entry in the VGF's model sequence table.
+	struct FSegment
+	{
+		uint64 NameOffset; // Null-terminated string in the VGF.
+		uint64 EntryPointOffset; // Null-terminated string in the VGF.
+		uint64 CodeOffset; // SPIR-V code in the VGF, or in words into the rewritten code table if bRewrittenCode.
+		uint64 CodeNumWords;
+		int32 ModuleIndex;
+		uint32 FirstBinding; // Into the bindings table.
+		uint32 NumBindings;
+		uint32 FirstConstant; // Into the constants table.
+		uint32 NumConstants;
+		uint32 bRewrittenCode;
+	};
+
+	// An input or output of a segment.
+	struct FBinding
+	{
+		uint32 VulkanBindingIdx;
+		uint32 TensorId;
+		uint32 bIsOutput;
+	};
+
+	// A constant used by a segment. The ID of the constant within the segment is its index within the segment's constants.
+	struct FConstant
+	{
+		uint64 DataOffset; // Constant data in the VGF, or in the decompressed constants if they are compressed.
+		uint64 DataSize;
+		int32 ConstantIndex; // Index into the VGF's constant table.
+		int32 Format; // VkFormat
+		uint32 FirstDimension; // Into the dimensions table.
+		uint32 NumDimensions;
+		// The tensor that this constant was turned into (see Write), or -1. If set, the constant isn't passed to the pipeline.
+		int32 SharedTensorId;
+		uint32 Padding;
+	};
+
+	// A set of model input shapes that shape inference was run for when the model was imported/cooked, so that it doesn't need
+	// to be run at runtime (see UE::NNERuntimeRDGMLExtensionsForVulkan::PreShapedInputShapesFileName).
+	struct FPreShapedModel
+	{
+		uint32 FirstTensorShape; // Into the pre-shaped tensor shapes table, one for each tensor (including the model inputs).
+		uint32 FirstSegment; // Into the pre-shaped segments table, one for each segment.
+	};
+
+	// A concrete tensor shape.
+	struct FShape
+	{
+		uint32 FirstDimension; // Into the dimensions table.
+		uint32 NumDimensions;
+	};
+
+	// The shaped SPIR-V code of a segment, i.e. the result of shape inference.
+	struct FPreShapedSegment
+	{
+		uint64 CodeOffset; // Into the pre-shaped code table, in words.
+		uint64 CodeNumWords;
+	};
+
+	// A chunk of the compressed constants, compressed with Oodle. Chunks are decompressed to consecutive ranges of the decompressed
+	// constants. If CompressedSize == UncompressedSize then the chunk didn't compress and is stored as it is.
+	struct FConstantChunk
+	{
+		uint64 CompressedOffset; // Into the compressed constants table.
+		uint64 CompressedSize;
+		uint64 UncompressedOffset; // Into the decompressed constants.
+		uint64 UncompressedSize;
+	};
+
+	static_assert(sizeof(FHeader) == 240 && sizeof(FTensor) == 24 && sizeof(FSegment) == 56 && sizeof(FBinding) == 12 && sizeof(FConstant) == 40 &&
+		sizeof(FPreShapedModel) == 8 && sizeof(FShape) == 8 && sizeof(FPreShapedSegment) == 16 && sizeof(FConstantChunk) == 32,
+		"Model data layout must not change without bumping UNNERuntimeRDGMLExtensionsForVulkan::ModelDataVersion");
+
+	// Decodes the VGF and appends the payload to OutData, which must already be padded to PAYLOAD_ALIGNMENT. OutData is only grown once.
+	// InputShapeOverrides pins unspecified dimensions of the model inputs (-1 leaves a dimension unspecified, and an empty or missing
+	// shape leaves the whole input alone). If all of the model input shapes are then concrete, the model is static: its input shapes
+	// are added to the pre-shaped ones and the inferred shapes of all the other tensors are stored in the tensor table too, so the
+	// model looks fully shaped to the runtime and never needs to run shape inference.
+	// Shape inference is also run for each of the given sets of model input shapes, with the results stored in the pre-shaped tables.
+	// If bCompressConstants, the constant data is compressed (see FConstantChunk) and only the rest of the VGF is stored.
+	// Constants of at least SharedConstantMinBytes (if non-zero) are turned into extra inputs of their segments, bound to tensors which
+	// hold the constant data, so that the runtime keeps one copy of them on the GPU rather than one in every pipeline.
+	// If bOptimizeCode, the SPIR-V code of each segment is stripped and compacted (see OptimizeGraphModule).
+	// Returns false (having logged an error) if the VGF is invalid, uses features that we don't support or shape inference fails.
+	static bool Write(TConstArrayView64<uint8> Vgf, TConstArrayView<TArray<int32>> InputShapeOverrides,
+		TConstArrayView<TArray<UE::NNE::FTensorShape>> PreShapeInputShapeSets, bool bCompressConstants, uint64 SharedConstantMinBytes, bool bOptimizeCode,
+		TArray64<uint8>& OutData);
+
+	// Checks that all the tables and offsets are within bounds and consistent with each other, so that the payload can be used
+	// directly. Returns nullptr (having logged an error) if not.
+	static const FHeader* Validate(TConstArrayView64<uint8> Payload);
+
+	// Validate checks that all tables apart from the VGF have fewer than MAX_int32 elements.
+	template<typename T>
+	static TConstArrayView<T> GetTable(const FHeader* Header, const FTableRange& Range)
+	{
+		return TConstArrayView<T>(reinterpret_cast<const T*>(reinterpret_cast<const uint8*>(Header) + Range.Offset), (int32)Range.Num);
+	}
+	static TConstArrayView64<uint8> GetVgf(const FHeader* Header)
+	{
+		return TConstArrayView64<uint8>(reinterpret_cast<const uint8*>(Header) + Header->Vgf.Offset, (int64)Header->Vgf.Num);
+	}
+	// The SPIR-V code of a segment, which is either in the VGF or the rewritten code table.
+	static TConstArrayView<uint32> GetSegmentCode(const FHeader* Header, const FSegment& Segment)
+	{
+		if (Segment.bRewrittenCode)
+		{
+			return GetTable<uint32>(Header, Header->RewrittenCode).Slice((int32)Segment.CodeOffset, (int32)Segment.CodeNumWords);
+		}
+		return TConstArrayView<uint32>(reinterpret_cast<const uint32*>(GetVgf(Header).GetData() + Segment.CodeOffset), (int32)Segment.CodeNumWords);
+	}
+	static TConstArrayView64<uint8> GetCompressedConstants(const FHeader* Header)
+	{
+		return TConstArrayView64<uint8>(reinterpret_cast<const uint8*>(Header) + Header->CompressedConstants.Offset, (int64)Header->CompressedConstants.Num);
+	}
+	// The size of the decompressed constants, or 0 if the constants aren't compressed. Validate checks that the chunks are consecutive.
+	static uint64 GetDecompressedConstantsSize(const FHeader* Header)
+	{
+		const TConstArrayView<FConstantChunk> Chunks = GetTable<FConstantChunk>(Header, Header->ConstantChunks);
+		return Chunks.IsEmpty() ? 0 : Chunks.Last().UncompressedOffset + Chunks.Last().UncompressedSize;
+	}
+	// Decompresses the given chunk into the decompressed constants buffer (of GetDecompressedConstantsSize). Returns false if the data is corrupt.
+	// This can be called on any thread, and for different chunks at the same time.
+	static bool DecompressConstantChunk(const FHeader* Header, int32 ChunkIdx, uint8* DecompressedConstants);
+};
@@ -6,6 +6,9 @@
 #include "Interfaces/IPluginManager.h"
 #include "Misc/Paths.h"
 #include "NNERuntimeRDGMLExtensionsForVulkan.h"
+#include "NNERuntimeRDGMLExtensionsForVulkanDeferredDeletion.h"
+#include "NNERuntimeRDGMLExtensionsForVulkanPipelineCache.h"
+#include "NNERuntimeRDGMLExtensionsForVulkanShapeInferenceCache.h"
 #if WITH_EDITOR
 #include "EditorClassUtils.h"
 #include "Factories/Factory.h"
@@ -61,8 +64,16 @@ bool InitializeForInference()
 	LoadFunction((void**)&vkDestroyDataGraphPipelineSessionARM_p, "vkDestroyDataGraphPipelineSessionARM");
 	LoadFunction((void**)&vkDestroyTensorARM_p, "vkDestroyTensorARM");
 	LoadFunction((void**)&vkDestroyTensorViewARM_p, "vkDestroyTensorViewARM");
+	LoadFunction((void**)&vkGetTensorMemoryRequirementsARM_p, "vkGetTensorMemoryRequirementsARM");
+
+	LoadFunction((void**)&vkCreateDeferredOperationKHR_p, "vkCreateDeferredOperationKHR");
+	LoadFunction((void**)&vkDeferredOperationJoinKHR_p, "vkDeferredOperationJoinKHR");
+	LoadFunction((void**)&vkGetDeferredOperationMaxConcurrencyKHR_p, "vkGetDeferredOperationMaxConcurrencyKHR");
+	LoadFunction((void**)&vkGetDeferredOperationResultKHR_p, "vkGetDeferredOperationResultKHR");
+	LoadFunction((void**)&vkDestroyDeferredOperationKHR_p, "vkDestroyDeferredOperationKHR");
 
 	LoadFunction((void**)&vkGetPhysicalDeviceQueueFamilyProperties_p, "vkGetPhysicalDeviceQueueFamilyProperties", true);
+	LoadFunction((void**)&vkGetPhysicalDeviceProperties_p, "vkGetPhysicalDeviceProperties", true);
 	LoadFunction((void**)&vkCreatePipelineLayout_p, "vkCreatePipelineLayout");
 	LoadFunction((void**)&vkCreateShaderModule_p, "vkCreateShaderModule");
 	LoadFunction((void**)&vkCreateDescriptorSetLayout_p, "vkCreateDescriptorSetLayout");
@@ -77,6 +88,12 @@ bool InitializeForInference()
 	LoadFunction((void**)&vkDestroyDescriptorSetLayout_p, "vkDestroyDescriptorSetLayout");
 	LoadFunction((void**)&vkDestroyDescriptorPool_p, "vkDestroyDescriptorPool");
 	LoadFunction((void**)&vkFreeDescriptorSets_p, "vkFreeDescriptorSets");
+	LoadFunction((void**)&vkCreatePipelineCache_p, "vkCreatePipelineCache");
+	LoadFunction((void**)&vkGetPipelineCacheData_p, "vkGetPipelineCacheData");
+	LoadFunction((void**)&vkDestroyPipelineCache_p, "vkDestroyPipelineCache");
+
+	// This one is optional, so is loaded directly rather than through LoadFunction (which would treat it as an error).
+	vkGetDataGraphPipelinePropertiesARM_p = (PFN_vkGetDataGraphPipelinePropertiesARM)VulkanRHI->RHIGetVkDeviceProcAddr("vkGetDataGraphPipelinePropertiesARM");
 
 	if (ErrorGettingFunctions)
 	{
@@ -106,6 +123,11 @@ void FNNERuntimeRDGMLExtensionsForVulkanModule::StartupModule()
 	// Note that this may fail, but that's fine - we just won't support running inferences. We can still create model data for later inferences
 	// which we need when cooking.
 	bool SupportsInference = InitializeForInference();
+	if (SupportsInference)
+	{
+		FNNERuntimeRDGMLExtensionsForVulkanDeferredDeletionQueue::Get().Initialize();
+		FNNERuntimeRDGMLExtensionsForVulkanPipelineCache::Get().Initialize();
+	}
 
 	// Create and register the runtime object with the NNE framework.
 	NNERuntimeRDGMLExtensionsForVulkan = NewObject<UNNERuntimeRDGMLExtensionsForVulkan>();
@@ -123,6 +145,15 @@ void FNNERuntimeRDGMLExtensionsForVulkanModule::ShutdownModule()
 		NNERuntimeRDGMLExtensionsForVulkan->RemoveFromRoot(); // Allow GC to destroy it.
 		NNERuntimeRDGMLExtensionsForVulkan.Reset();
 	}
+
+	// Persist the pipeline cache for next time. This waits for pipelines that are still compiling in the background first, which
+	// can replace (and so release) other pipelines, so it comes before the deletion queue is flushed.
+	FNNERuntimeRDGMLExtensionsForVulkanPipelineCache::Get().Shutdown();
+	// The shape inference cache stores each entry as it goes, so there's nothing to save, but report how it did like the pipeline cache.
+	const FNNERuntimeRDGMLExtensionsForVulkanShapeInferenceCache& ShapeInferenceCache = FNNERuntimeRDGMLExtensionsForVulkanShapeInferenceCache::Get();
+	UE_LOG(LogNNERuntimeRDGMLExtensionsForVulkan, Log, TEXT("Shape inference cache: %u hits, %u misses."), ShapeInferenceCache.GetNumHits(), ShapeInferenceCache.GetNumMisses());
+	// Destroy any Vulkan objects that models and model instances have released but which were still waiting for the GPU.
+	FNNERuntimeRDGMLExtensionsForVulkanDeferredDeletionQueue::Get().Shutdown();
 }
 
 IMPLEMENT_MODULE(FNNERuntimeRDGMLExtensionsForVulkanModule, NNERuntimeRDGMLExtensionsForVulkan);
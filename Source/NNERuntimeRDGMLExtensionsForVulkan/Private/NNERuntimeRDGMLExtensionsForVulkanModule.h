@@ -7,11 +7,10 @@
 #include "UObject/WeakObjectPtr.h"
 #include "Containers/Array.h"
 #include "VulkanThirdParty.h"
+#include "NNERuntimeRDGMLExtensionsForVulkanLog.h"
 
 class UNNERuntimeRDGMLExtensionsForVulkan;
 
-DECLARE_LOG_CATEGORY_EXTERN(LogNNERuntimeRDGMLExtensionsForVulkan, Log, All);
-
 class FNNERuntimeRDGMLExtensionsForVulkanModule : public IModuleInterface
 {
 private:
@@ -35,9 +34,20 @@ PFN_vkBindDataGraphPipelineSessionMemoryARM				vkBindDataGraphPipelineSessionMem
 PFN_vkDestroyDataGraphPipelineSessionARM				vkDestroyDataGraphPipelineSessionARM_p				 = nullptr;
 PFN_vkDestroyTensorARM									vkDestroyTensorARM_p								 = nullptr;
 PFN_vkDestroyTensorViewARM								vkDestroyTensorViewARM_p							 = nullptr;
+PFN_vkGetTensorMemoryRequirementsARM					vkGetTensorMemoryRequirementsARM_p					 = nullptr;
+// Optional - used to store pipeline identifiers in the pipeline cache if available.
+PFN_vkGetDataGraphPipelinePropertiesARM					vkGetDataGraphPipelinePropertiesARM_p				 = nullptr;
+
+// Function pointers for VK_KHR_deferred_host_operations (enabled by the PreInit module).
+PFN_vkCreateDeferredOperationKHR						vkCreateDeferredOperationKHR_p						 = nullptr;
+PFN_vkDeferredOperationJoinKHR							vkDeferredOperationJoinKHR_p						 = nullptr;
+PFN_vkGetDeferredOperationMaxConcurrencyKHR				vkGetDeferredOperationMaxConcurrencyKHR_p			 = nullptr;
+PFN_vkGetDeferredOperationResultKHR						vkGetDeferredOperationResultKHR_p					 = nullptr;
+PFN_vkDestroyDeferredOperationKHR						vkDestroyDeferredOperationKHR_p						 = nullptr;
 
 // Function pointers for core Vulkan functions (unfortunately Unreal doesn't expose these outside of the VulkanRHI module).
 PFN_vkGetPhysicalDeviceQueueFamilyProperties            vkGetPhysicalDeviceQueueFamilyProperties_p			 = nullptr;
+PFN_vkGetPhysicalDeviceProperties						vkGetPhysicalDeviceProperties_p						 = nullptr;
 PFN_vkCreatePipelineLayout								vkCreatePipelineLayout_p							 = nullptr;
 PFN_vkCreateShaderModule								vkCreateShaderModule_p								 = nullptr;
 PFN_vkCreateDescriptorSetLayout							vkCreateDescriptorSetLayout_p						 = nullptr;
@@ -52,3 +62,6 @@ PFN_vkDestroyPipeline									vkDestroyPipeline_p									 = nullptr;
 PFN_vkDestroyDescriptorSetLayout						vkDestroyDescriptorSetLayout_p						 = nullptr;
 PFN_vkDestroyDescriptorPool								vkDestroyDescriptorPool_p							 = nullptr;
 PFN_vkFreeDescriptorSets								vkFreeDescriptorSets_p								 = nullptr;
+PFN_vkCreatePipelineCache								vkCreatePipelineCache_p								 = nullptr;
+PFN_vkGetPipelineCacheData								vkGetPipelineCacheData_p							 = nullptr;
+PFN_vkDestroyPipelineCache								vkDestroyPipelineCache_p							 = nullptr;
@@ -0,0 +1,402 @@
+// SPDX-FileCopyrightText: Copyright 2025 Arm Limited and/or its affiliates <open-source-office@arm.com>
+// SPDX-License-Identifier: MIT
+
+#include "NNERuntimeRDGMLExtensionsForVulkanPipelineCache.h"
+#include "NNERuntimeRDGMLExtensionsForVulkanModule.h"
+#include "NNERuntimeRDGMLExtensionsForVulkanStats.h"
+#include "Async/Async.h"
+#include "IVulkanDynamicRHI.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "HAL/Event.h"
+#include "Misc/ScopeLock.h"
+#include "Serialization/MemoryReader.h"
+#include "Serialization/MemoryWriter.h"
+
+class FVulkanDevice; // Forward declaration needed for VulkanUtil.h
+#include "VulkanUtil.h"
+
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Pipeline cache hits"), STAT_NNERuntimeRDGMLExtensionsForVulkan_PipelineCacheHits, STATGROUP_NNERuntimeRDGMLExtensionsForVulkan);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Pipeline cache misses"), STAT_NNERuntimeRDGMLExtensionsForVulkan_PipelineCacheMisses, STATGROUP_NNERuntimeRDGMLExtensionsForVulkan);
+CSV_DEFINE_CATEGORY(NNERuntimeRDGMLExtensionsForVulkan, true);
+
+FNNERuntimeRDGMLExtensionsForVulkanPipelineCache& FNNERuntimeRDGMLExtensionsForVulkanPipelineCache::Get()
+{
+	static FNNERuntimeRDGMLExtensionsForVulkanPipelineCache Cache;
+	return Cache;
+}
+
+void FNNERuntimeRDGMLExtensionsForVulkanPipelineCache::Initialize()
+{
+	VkDevice Device = GetIVulkanDynamicRHI()->RHIGetVkDevice();
+	const VkAllocationCallbacks* Allocator = GetIVulkanDynamicRHI()->RHIGetVkAllocationCallbacks();
+
+	bSupportsIdentifiers = vkGetDataGraphPipelinePropertiesARM_p != nullptr;
+
+	// The file name is unique to this device and driver, so that e.g. switching GPU or updating the driver doesn't
+	// overwrite the cache for the other one. The driver also validates the data itself, but this means we don't rely on that.
+	VkPhysicalDeviceProperties Properties = {};
+	vkGetPhysicalDeviceProperties_p(GetIVulkanDynamicRHI()->RHIGetVkPhysicalDevice(), &Properties);
+	FString UUIDString = BytesToHex(Properties.pipelineCacheUUID, VK_UUID_SIZE);
+	FilePath = FPaths::Combine(FPaths::ProjectSavedDir(), TEXT("NNERuntimeRDGMLExtensionsForVulkan"),
+		FString::Printf(TEXT("PipelineCache_%08x_%08x_%s_%08x.bin"), Properties.vendorID, Properties.deviceID, *UUIDString, Properties.driverVersion));
+
+	// Load the previous cache, if there is one. Any problems here just mean we start from an empty cache.
+	TArray<uint8> PipelineCacheData;
+	TArray<uint8> FileData;
+	if (FFileHelper::LoadFileToArray(FileData, *FilePath, FILEREAD_Silent))
+	{
+		FMemoryReader Reader(FileData);
+		uint32 Magic = 0;
+		uint32 Version = 0;
+		Reader << Magic;
+		Reader << Version;
+		if (Magic == FILE_MAGIC && Version == FILE_VERSION)
+		{
+			Reader << Identifiers;
+			Reader << PipelineCacheData;
+		}
+		if (Reader.IsError() || Magic != FILE_MAGIC || Version != FILE_VERSION)
+		{
+			UE_LOG(LogNNERuntimeRDGMLExtensionsForVulkan, Warning, TEXT("Ignoring invalid or out of date pipeline cache file '%s'."), *FilePath);
+			Identifiers.Empty();
+			PipelineCacheData.Empty();
+		}
+		else
+		{
+			UE_LOG(LogNNERuntimeRDGMLExtensionsForVulkan, Log, TEXT("Loaded pipeline cache '%s' (%d bytes, %d pipeline identifiers)."),
+				*FilePath, PipelineCacheData.Num(), Identifiers.Num());
+		}
+	}
+
+	VkPipelineCacheCreateInfo PipelineCacheCreateInfo = {};
+	PipelineCacheCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+	PipelineCacheCreateInfo.initialDataSize = PipelineCacheData.Num();
+	PipelineCacheCreateInfo.pInitialData = PipelineCacheData.GetData();
+	if (vkCreatePipelineCache_p(Device, &PipelineCacheCreateInfo, Allocator, &PipelineCache) != VK_SUCCESS)
+	{
+		// The driver might reject the data (even though it should just ignore it if incompatible), so try again without it.
+		PipelineCacheCreateInfo.initialDataSize = 0;
+		PipelineCacheCreateInfo.pInitialData = nullptr;
+		VERIFYVULKANRESULT(vkCreatePipelineCache_p(Device, &PipelineCacheCreateInfo, Allocator, &PipelineCache));
+	}
+
+	TickerHandle = FTSTicker::GetCoreTicker().AddTicker(FTickerDelegate::CreateLambda([this](float DeltaTime) {
+		// Don't start another save if the last one is still running.
+		if (bDirty && (!SaveFuture.IsValid() || SaveFuture.IsReady()))
+		{
+			SaveFuture = Async(EAsyncExecution::ThreadPool, [this]() { Save(); });
+		}
+		return true;
+	}), SAVE_INTERVAL_SECONDS);
+}
+
+void FNNERuntimeRDGMLExtensionsForVulkanPipelineCache::Shutdown()
+{
+	if (PipelineCache == VK_NULL_HANDLE)
+	{
+		// Never initialized.
+		return;
+	}
+
+	// Pipelines might still be compiling in the background (e.g. the optimized pipelines of tiered compilation), which use the
+	// VkPipelineCache and update the identifiers, so wait for them before saving and destroying it.
+	TArray<UE::Tasks::FTask> TasksToWaitFor;
+	{
+		FScopeLock Lock(&PendingTasksCriticalSection);
+		TasksToWaitFor = MoveTemp(PendingTasks);
+	}
+	UE::Tasks::Wait(TasksToWaitFor);
+
+	FTSTicker::GetCoreTicker().RemoveTicker(TickerHandle);
+	TickerHandle.Reset();
+	if (SaveFuture.IsValid())
+	{
+		SaveFuture.Wait();
+	}
+	Save();
+
+	UE_LOG(LogNNERuntimeRDGMLExtensionsForVulkan, Log, TEXT("Pipeline cache: %u hits, %u misses."), GetNumHits(), GetNumMisses());
+
+	// Nothing can be using the cache at this point (it's only used during pipeline creation, not by the pipelines themselves,
+	// and we've waited for any creations that were still running).
+	vkDestroyPipelineCache_p(GetIVulkanDynamicRHI()->RHIGetVkDevice(), PipelineCache, GetIVulkanDynamicRHI()->RHIGetVkAllocationCallbacks());
+	PipelineCache = VK_NULL_HANDLE;
+}
+
+void FNNERuntimeRDGMLExtensionsForVulkanPipelineCache::Save()
+{
+	if (!bDirty.Exchange(false))
+	{
+		return;
+	}
+
+	VkDevice Device = GetIVulkanDynamicRHI()->RHIGetVkDevice();
+	TArray<uint8> PipelineCacheData;
+	size_t PipelineCacheDataSize = 0;
+	VERIFYVULKANRESULT(vkGetPipelineCacheData_p(Device, PipelineCache, &PipelineCacheDataSize, nullptr));
+	PipelineCacheData.AddUninitialized(PipelineCacheDataSize);
+	// The cache might have grown in between the two calls, in which case we get VK_INCOMPLETE and a (still valid) subset of the data.
+	VkResult Result = vkGetPipelineCacheData_p(Device, PipelineCache, &PipelineCacheDataSize, PipelineCacheData.GetData());
+	if (Result != VK_SUCCESS && Result != VK_INCOMPLETE)
+	{
+		UE_LOG(LogNNERuntimeRDGMLExtensionsForVulkan, Warning, TEXT("Failed to get pipeline cache data (%d)."), Result);
+		return;
+	}
+	PipelineCacheData.SetNum(PipelineCacheDataSize);
+
+	TArray<uint8> FileData;
+	FMemoryWriter Writer(FileData);
+	uint32 Magic = FILE_MAGIC;
+	uint32 Version = FILE_VERSION;
+	Writer << Magic;
+	Writer << Version;
+	{
+		FScopeLock Lock(&IdentifiersCriticalSection);
+		Writer << Identifiers;
+	}
+	Writer << PipelineCacheData;
+
+	if (!FFileHelper::SaveArrayToFile(FileData, *FilePath))
+	{
+		UE_LOG(LogNNERuntimeRDGMLExtensionsForVulkan, Warning, TEXT("Failed to save pipeline cache to '%s'."), *FilePath);
+		return;
+	}
+	UE_LOG(LogNNERuntimeRDGMLExtensionsForVulkan, Verbose, TEXT("Saved pipeline cache '%s' (%d bytes). %u hits, %u misses so far."),
+		*FilePath, FileData.Num(), GetNumHits(), GetNumMisses());
+}
+
+VkResult FNNERuntimeRDGMLExtensionsForVulkanPipelineCache::TryCreateDataGraphPipelineWithoutCompiling(VkDevice Device, const VkDataGraphPipelineCreateInfoARM& CreateInfo,
+	const FXxHash64& Key, const VkAllocationCallbacks* Allocator, VkPipeline* OutPipeline)
+{
+	if (bSupportsIdentifiers)
+	{
+		VkResult Result = CreateDataGraphPipelineFromIdentifier(Device, CreateInfo, Key, Allocator, OutPipeline);
+		if (Result != VK_PIPELINE_COMPILE_REQUIRED)
+		{
+			if (Result == VK_SUCCESS)
+			{
+				RecordHit();
+			}
+			return Result;
+		}
+	}
+
+	// The driver returns VK_PIPELINE_COMPILE_REQUIRED rather than compiling if the pipeline isn't in the VkPipelineCache.
+	VkDataGraphPipelineCreateInfoARM CreateInfoNoCompile = CreateInfo;
+	CreateInfoNoCompile.flags |= VK_PIPELINE_CREATE_2_FAIL_ON_PIPELINE_COMPILE_REQUIRED_BIT_KHR;
+	VkResult Result = vkCreateDataGraphPipelinesARM_p(Device, VK_NULL_HANDLE, PipelineCache, 1, &CreateInfoNoCompile, Allocator, OutPipeline);
+	if (Result == VK_SUCCESS)
+	{
+		RecordHit();
+		if (bSupportsIdentifiers)
+		{
+			StoreIdentifier(Device, *OutPipeline, Key);
+		}
+	}
+	return Result;
+}
+
+UE::Tasks::TTask<VkResult> FNNERuntimeRDGMLExtensionsForVulkanPipelineCache::CreateDataGraphPipelineAsync(VkDevice Device, const VkDataGraphPipelineCreateInfoARM& CreateInfo,
+	const FXxHash64& Key, const VkAllocationCallbacks* Allocator, VkPipeline* OutPipeline, EOptimization Optimization, UE::Tasks::ETaskPriority Priority)
+{
+	// Creating from an identifier doesn't compile anything, so there's no point deferring it.
+	if (bSupportsIdentifiers && Optimization == EOptimization::Full)
+	{
+		VkResult Result = CreateDataGraphPipelineFromIdentifier(Device, CreateInfo, Key, Allocator, OutPipeline);
+		if (Result != VK_PIPELINE_COMPILE_REQUIRED)
+		{
+			if (Result == VK_SUCCESS)
+			{
+				RecordHit();
+			}
+			return UE::Tasks::MakeCompletedTask<VkResult>(Result);
+		}
+	}
+
+	// Things which need to stay alive until the deferred operation has completed.
+	struct FDeferredCreation
+	{
+		VkDeferredOperationKHR DeferredOperation = VK_NULL_HANDLE;
+		// Ask the driver whether this came from the VkPipelineCache, so that we can report this.
+		VkPipelineCreationFeedback PipelineCreationFeedback = {};
+		VkPipelineCreationFeedbackCreateInfo PipelineCreationFeedbackCreateInfo = {};
+		VkDataGraphPipelineCreateInfoARM CreateInfoWithFeedback = {};
+		// Signalled once the operation has completed, to wake any joiners which were told that there was nothing for them to do yet.
+		FEventRef CompletedEvent{ EEventMode::ManualReset };
+	};
+	TSharedRef<FDeferredCreation> Deferred = MakeShared<FDeferredCreation>();
+	Deferred->PipelineCreationFeedbackCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CREATION_FEEDBACK_CREATE_INFO;
+	Deferred->PipelineCreationFeedbackCreateInfo.pPipelineCreationFeedback = &Deferred->PipelineCreationFeedback;
+	Deferred->PipelineCreationFeedbackCreateInfo.pNext = CreateInfo.pNext;
+	Deferred->CreateInfoWithFeedback = CreateInfo;
+	Deferred->CreateInfoWithFeedback.pNext = &Deferred->PipelineCreationFeedbackCreateInfo;
+	if (Optimization == EOptimization::Disabled)
+	{
+		// Drivers are free to ignore this, in which case we just get a normal pipeline.
+		Deferred->CreateInfoWithFeedback.flags |= VK_PIPELINE_CREATE_2_DISABLE_OPTIMIZATION_BIT_KHR;
+	}
+
+	VERIFYVULKANRESULT(vkCreateDeferredOperationKHR_p(Device, Allocator, &Deferred->DeferredOperation));
+	VkResult CreateResult = vkCreateDataGraphPipelinesARM_p(Device, Deferred->DeferredOperation, PipelineCache, 1, &Deferred->CreateInfoWithFeedback, Allocator, OutPipeline);
+
+	// If the driver has deferred the work, join the operation from as many workers as it says it can make use of. Each of these
+	// returns once there's nothing more for it to do.
+	TArray<UE::Tasks::FTask> Joiners;
+	if (CreateResult == VK_OPERATION_DEFERRED_KHR)
+	{
+		const uint32 MaxConcurrency = vkGetDeferredOperationMaxConcurrencyKHR_p(Device, Deferred->DeferredOperation);
+		const uint32 NumJoiners = FMath::Clamp<uint32>(MaxConcurrency, 1, FMath::Max(1, FTaskGraphInterface::Get().GetNumWorkerThreads()));
+		for (uint32 J = 0; J < NumJoiners; ++J)
+		{
+			Joiners.Add(UE::Tasks::Launch(UE_SOURCE_LOCATION, [Device, Deferred]() {
+				VkResult JoinResult = vkDeferredOperationJoinKHR_p(Device, Deferred->DeferredOperation);
+				// Idle means there's no work for us right now but there might be later, so keep trying until the operation
+				// is complete (VK_SUCCESS) or there's nothing left for this thread (VK_THREAD_DONE_KHR). Rather than spinning,
+				// wait for the operation to complete, checking back with increasing intervals in case more work becomes available.
+				uint32 WaitMs = 1;
+				while (JoinResult == VK_THREAD_IDLE_KHR)
+				{
+					if (Deferred->CompletedEvent->Wait(WaitMs))
+					{
+						return;
+					}
+					WaitMs = FMath::Min(WaitMs * 2, MAX_IDLE_JOINER_WAIT_MS);
+					JoinResult = vkDeferredOperationJoinKHR_p(Device, Deferred->DeferredOperation);
+				}
+				if (JoinResult == VK_SUCCESS)
+				{
+					Deferred->CompletedEvent->Trigger();
+				}
+			}, Priority));
+		}
+	}
+
+	UE::Tasks::TTask<VkResult> Task = UE::Tasks::Launch(UE_SOURCE_LOCATION, [this, Device, Key, Allocator, OutPipeline, Deferred, CreateResult, Optimization]() {
+		VkResult Result = CreateResult;
+		if (Result == VK_OPERATION_DEFERRED_KHR)
+		{
+			Result = vkGetDeferredOperationResultKHR_p(Device, Deferred->DeferredOperation);
+		}
+		else if (Result == VK_OPERATION_NOT_DEFERRED_KHR)
+		{
+			// The driver chose to do the work immediately, on the calling thread.
+			Result = VK_SUCCESS;
+		}
+		vkDestroyDeferredOperationKHR_p(Device, Deferred->DeferredOperation, Allocator);
+
+		if (Result == VK_SUCCESS && Optimization == EOptimization::Full)
+		{
+			OnPipelineCompiled(Device, *OutPipeline, Key, Deferred->PipelineCreationFeedback);
+		}
+		return Result;
+	}, UE::Tasks::Prerequisites(Joiners), Priority);
+
+	{
+		FScopeLock Lock(&PendingTasksCriticalSection);
+		PendingTasks.RemoveAllSwap([](const UE::Tasks::FTask& PendingTask) { return PendingTask.IsCompleted(); });
+		PendingTasks.Add(Task);
+	}
+	return Task;
+}
+
+void FNNERuntimeRDGMLExtensionsForVulkanPipelineCache::RecordHit()
+{
+	++NumHits;
+	INC_DWORD_STAT(STAT_NNERuntimeRDGMLExtensionsForVulkan_PipelineCacheHits);
+	CSV_CUSTOM_STAT(NNERuntimeRDGMLExtensionsForVulkan, PipelineCacheHits, 1, ECsvCustomStatOp::Accumulate);
+}
+
+void FNNERuntimeRDGMLExtensionsForVulkanPipelineCache::RecordMiss()
+{
+	++NumMisses;
+	INC_DWORD_STAT(STAT_NNERuntimeRDGMLExtensionsForVulkan_PipelineCacheMisses);
+	CSV_CUSTOM_STAT(NNERuntimeRDGMLExtensionsForVulkan, PipelineCacheMisses, 1, ECsvCustomStatOp::Accumulate);
+}
+
+void FNNERuntimeRDGMLExtensionsForVulkanPipelineCache::OnPipelineCompiled(VkDevice Device, VkPipeline Pipeline, const FXxHash64& Key,
+	const VkPipelineCreationFeedback& Feedback)
+{
+	// If the driver didn't fill in the feedback then we have to assume it was compiled.
+	const bool bCacheHit = (Feedback.flags & VK_PIPELINE_CREATION_FEEDBACK_VALID_BIT) != 0 &&
+		(Feedback.flags & VK_PIPELINE_CREATION_FEEDBACK_APPLICATION_PIPELINE_CACHE_HIT_BIT) != 0;
+	if (bCacheHit)
+	{
+		RecordHit();
+	}
+	else
+	{
+		RecordMiss();
+		bDirty = true;
+	}
+
+	if (bSupportsIdentifiers)
+	{
+		StoreIdentifier(Device, Pipeline, Key);
+	}
+}
+
+VkResult FNNERuntimeRDGMLExtensionsForVulkanPipelineCache::CreateDataGraphPipelineFromIdentifier(VkDevice Device, const VkDataGraphPipelineCreateInfoARM& CreateInfo,
+	const FXxHash64& Key, const VkAllocationCallbacks* Allocator, VkPipeline* OutPipeline)
+{
+	TArray<uint8> Identifier;
+	{
+		FScopeLock Lock(&IdentifiersCriticalSection);
+		const TArray<uint8>* Found = Identifiers.Find(Key.Hash);
+		if (Found == nullptr)
+		{
+			return VK_PIPELINE_COMPILE_REQUIRED;
+		}
+		Identifier = *Found;
+	}
+
+	// The identifier is added to the front of the existing chain, which still has to describe the pipeline (its shader module,
+	// constants etc.) so that the driver can check that it matches. We tell the driver to fail rather than compile if it doesn't
+	// recognise the identifier (e.g. the driver's own cache has been cleared), so that we can fall back to the normal path.
+	VkDataGraphPipelineIdentifierCreateInfoARM IdentifierCreateInfo = {};
+	IdentifierCreateInfo.sType = VK_STRUCTURE_TYPE_DATA_GRAPH_PIPELINE_IDENTIFIER_CREATE_INFO_ARM;
+	IdentifierCreateInfo.pNext = CreateInfo.pNext;
+	IdentifierCreateInfo.identifierSize = Identifier.Num();
+	IdentifierCreateInfo.pIdentifier = Identifier.GetData();
+
+	VkDataGraphPipelineCreateInfoARM CreateInfoWithIdentifier = CreateInfo;
+	CreateInfoWithIdentifier.pNext = &IdentifierCreateInfo;
+	CreateInfoWithIdentifier.flags |= VK_PIPELINE_CREATE_2_FAIL_ON_PIPELINE_COMPILE_REQUIRED_BIT_KHR;
+
+	VkResult Result = vkCreateDataGraphPipelinesARM_p(Device, VK_NULL_HANDLE, PipelineCache, 1, &CreateInfoWithIdentifier, Allocator, OutPipeline);
+	if (Result != VK_SUCCESS)
+	{
+		// Stale identifier - forget it, it will be replaced once the pipeline has been compiled.
+		FScopeLock Lock(&IdentifiersCriticalSection);
+		Identifiers.Remove(Key.Hash);
+		return VK_PIPELINE_COMPILE_REQUIRED;
+	}
+	return VK_SUCCESS;
+}
+
+void FNNERuntimeRDGMLExtensionsForVulkanPipelineCache::StoreIdentifier(VkDevice Device, VkPipeline Pipeline, const FXxHash64& Key)
+{
+	VkDataGraphPipelineInfoARM PipelineInfo = {};
+	PipelineInfo.sType = VK_STRUCTURE_TYPE_DATA_GRAPH_PIPELINE_INFO_ARM;
+	PipelineInfo.dataGraphPipeline = Pipeline;
+
+	// First query the size, then the data itself.
+	VkDataGraphPipelinePropertyQueryResultARM Query = {};
+	Query.sType = VK_STRUCTURE_TYPE_DATA_GRAPH_PIPELINE_PROPERTY_QUERY_RESULT_ARM;
+	Query.property = VK_DATA_GRAPH_PIPELINE_PROPERTY_IDENTIFIER_ARM;
+	if (vkGetDataGraphPipelinePropertiesARM_p(Device, &PipelineInfo, 1, &Query) != VK_SUCCESS || Query.dataSize == 0)
+	{
+		return;
+	}
+	TArray<uint8> Identifier;
+	Identifier.AddUninitialized(Query.dataSize);
+	Query.pData = Identifier.GetData();
+	if (vkGetDataGraphPipelinePropertiesARM_p(Device, &PipelineInfo, 1, &Query) != VK_SUCCESS)
+	{
+		return;
+	}
+
+	FScopeLock Lock(&IdentifiersCriticalSection);
+	Identifiers.Add(Key.Hash, MoveTemp(Identifier));
+	bDirty = true;
+}
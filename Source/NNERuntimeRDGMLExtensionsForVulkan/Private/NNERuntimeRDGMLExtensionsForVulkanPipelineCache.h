@@ -0,0 +1,105 @@
+// SPDX-FileCopyrightText: Copyright 2025 Arm Limited and/or its affiliates <open-source-office@arm.com>
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include "Async/Future.h"
+#include "Containers/Map.h"
+#include "Containers/Ticker.h"
+#include "HAL/CriticalSection.h"
+#include "Hash/xxhash.h"
+#include "Tasks/Task.h"
+#include "Templates/Atomic.h"
+#include "VulkanThirdParty.h"
+
+// Owns the VkPipelineCache that all data graph pipelines are created with, and persists it to the project's saved directory
+// so that pipelines don't need to be recompiled from scratch on every launch.
+// Where the driver supports it, the data graph pipeline identifier of each pipeline is also stored. Creating a pipeline
+// from its identifier lets the driver skip compilation entirely, if it still has the compiled pipeline available.
+// The file on disk is specific to the physical device and driver version, so changing either of these results in a cold start
+// rather than the driver being given data that it can't use.
+class FNNERuntimeRDGMLExtensionsForVulkanPipelineCache
+{
+public:
+	static FNNERuntimeRDGMLExtensionsForVulkanPipelineCache& Get();
+
+	// Loads the cache from disk (if present) and creates the VkPipelineCache. Only needed if we support running inferences.
+	void Initialize();
+	// Waits for any pipelines which are still being created, then saves the cache to disk and destroys the VkPipelineCache.
+	void Shutdown();
+
+	enum class EOptimization
+	{
+		// A normal, fully optimized pipeline.
+		Full,
+		// Asks the driver to compile the pipeline as quickly as possible, at the expense of its performance. These pipelines aren't
+		// counted in the hit/miss statistics and their identifiers aren't stored, as they are only ever used until a fully optimized
+		// pipeline is available.
+		Disabled,
+	};
+
+	// Creates a fully optimized data graph pipeline if it can be done without compiling anything (i.e. from a stored identifier or
+	// the VkPipelineCache), otherwise returns VK_PIPELINE_COMPILE_REQUIRED. This can be called from any thread.
+	VkResult TryCreateDataGraphPipelineWithoutCompiling(VkDevice Device, const VkDataGraphPipelineCreateInfoARM& CreateInfo, const FXxHash64& Key,
+		const VkAllocationCallbacks* Allocator, VkPipeline* OutPipeline);
+
+	// Starts creating a data graph pipeline using the cache. Key should uniquely identify everything that the pipeline is created from
+	// (SPIR-V code, constants, tensor shapes etc.), and is used to look up and store the pipeline identifier.
+	// The compilation is done through a deferred host operation which is joined by task graph workers (as many as the driver can use),
+	// so the calling thread can get on with other work in the meantime. CreateInfo (and everything it points to) and OutPipeline
+	// must stay valid until the returned task has completed. This can be called from any thread.
+	UE::Tasks::TTask<VkResult> CreateDataGraphPipelineAsync(VkDevice Device, const VkDataGraphPipelineCreateInfoARM& CreateInfo, const FXxHash64& Key,
+		const VkAllocationCallbacks* Allocator, VkPipeline* OutPipeline, EOptimization Optimization = EOptimization::Full,
+		UE::Tasks::ETaskPriority Priority = UE::Tasks::ETaskPriority::Normal);
+
+	uint32 GetNumHits() const { return NumHits; }
+	uint32 GetNumMisses() const { return NumMisses; }
+
+private:
+	// Writes the VkPipelineCache data and the pipeline identifiers to disk, if anything has changed since the last save.
+	void Save();
+	// Tries to create the pipeline from a previously stored identifier. Returns VK_PIPELINE_COMPILE_REQUIRED if there is no stored
+	// identifier or the driver no longer has the pipeline for it.
+	VkResult CreateDataGraphPipelineFromIdentifier(VkDevice Device, const VkDataGraphPipelineCreateInfoARM& CreateInfo, const FXxHash64& Key,
+		const VkAllocationCallbacks* Allocator, VkPipeline* OutPipeline);
+	// Counts a pipeline which was found in the cache or had to be compiled, in NumHits/NumMisses and the stats and CSV profiler.
+	void RecordHit();
+	void RecordMiss();
+	// Updates the hit/miss counts and stores the identifier once a pipeline has been created from scratch.
+	void OnPipelineCompiled(VkDevice Device, VkPipeline Pipeline, const FXxHash64& Key, const VkPipelineCreationFeedback& Feedback);
+	// Queries the identifier of a newly created pipeline and stores it for next time.
+	void StoreIdentifier(VkDevice Device, VkPipeline Pipeline, const FXxHash64& Key);
+
+	// Identifies this file format, so that we don't load anything else by mistake.
+	static const uint32 FILE_MAGIC = 0x4E4E4543; // 'NNEC'
+	static const uint32 FILE_VERSION = 1;
+	// How often the cache is saved whilst the application is running (if it has changed), so that a crash or a
+	// platform that doesn't shut down cleanly still benefits next time.
+	static constexpr float SAVE_INTERVAL_SECONDS = 60.0f;
+	// The longest that a joiner of a deferred operation which has no work for it waits before asking the driver again.
+	static constexpr uint32 MAX_IDLE_JOINER_WAIT_MS = 16;
+
+	FString FilePath;
+	VkPipelineCache PipelineCache = VK_NULL_HANDLE;
+
+	// Pipeline identifiers (opaque driver data), keyed by the hash passed to CreateDataGraphPipeline.
+	TMap<uint64, TArray<uint8>> Identifiers;
+	FCriticalSection IdentifiersCriticalSection;
+	// False if the driver doesn't support vkGetDataGraphPipelinePropertiesARM, in which case we only use the VkPipelineCache.
+	bool bSupportsIdentifiers = false;
+
+	// Set whenever a pipeline is compiled, as that's when the contents of the cache will have changed.
+	TAtomic<bool> bDirty = false;
+	// Pipeline creations started by CreateDataGraphPipelineAsync which might not have completed yet, so that Shutdown can wait for them.
+	TArray<UE::Tasks::FTask> PendingTasks;
+	FCriticalSection PendingTasksCriticalSection;
+
+	// Pending background save, if any.
+	TFuture<void> SaveFuture;
+	FTSTicker::FDelegateHandle TickerHandle;
+
+	// Pipelines which were found in the cache (either from the identifier or the driver reporting a VkPipelineCache hit) vs. compiled.
+	// These are also reported through the stats system (stat NNERuntimeRDGMLExtensionsForVulkan) and the CSV profiler.
+	TAtomic<uint32> NumHits = 0;
+	TAtomic<uint32> NumMisses = 0;
+};
@@ -2,8 +2,12 @@
 // SPDX-License-Identifier: MIT
 
 #include "NNERuntimeRDGMLExtensionsForVulkanShapeInference.h"
-#include "NNERuntimeRDGMLExtensionsForVulkanModule.h"
+#include "NNERuntimeRDGMLExtensionsForVulkanLog.h"
 #include "Algo/Transform.h"
+#include "Math/UnrealMathUtility.h"
+#include "Misc/ScopeExit.h"
+#include "Misc/ScopeLock.h"
+#include "Templates/UniquePtr.h"
 
 #include "spirv-tools/libspirv.h"
 #include "spirv-tools/spirv.hpp11"
@@ -25,25 +29,305 @@ namespace {
 	template<typename T, void(*DeleterFuncPtr)(T*)>
 	using TUniquePtrWithCustomDeleter = TUniquePtr<T, CustomDeleter<T, DeleterFuncPtr>>;
 
-	uint32_t GetSingleWordOperand(const spv_parsed_instruction_t& Instruction, int OperandIdx) {
-		check(Instruction.operands[OperandIdx].num_words == 1);
-		return Instruction.words[Instruction.operands[OperandIdx].offset];
+	// A context is only read by the parser and validator, so a single one is shared by all calls (on any thread).
+	const spv_context_t* GetSharedContext()
+	{
+		static TUniquePtrWithCustomDeleter<spv_context_t, spvContextDestroy> Context(spvContextCreate(SPV_ENV_VULKAN_1_3));
+		return Context.Get();
+	}
+
+	void LogOptimizerMessage(spv_message_level_t Level, const char* Source, const spv_position_t* Position, const char* Message)
+	{
+		UE_LOG(LogNNERuntimeRDGMLExtensionsForVulkan, Display, TEXT("spvOptimizer: %hs"), Message);
+	}
+
+	// Optimizers which have had the passes used by OptimizeGraphModule registered, so they can be reused rather than set up for every module.
+	// An optimizer can't be run on several threads at once, so each is taken out of the pool while it's in use.
+	class FGraphModuleOptimizerPool
+	{
+	public:
+		using FOptimizerPtr = TUniquePtrWithCustomDeleter<spv_optimizer_t, spvOptimizerDestroy>;
+
+		FOptimizerPtr Acquire()
+		{
+			{
+				FScopeLock Lock(&CriticalSection);
+				if (!FreeOptimizers.IsEmpty())
+				{
+					return FreeOptimizers.Pop();
+				}
+			}
+
+			FOptimizerPtr Optimizer(spvOptimizerCreate(SPV_ENV_VULKAN_1_3));
+			if (Optimizer == nullptr)
+			{
+				UE_LOG(LogNNERuntimeRDGMLExtensionsForVulkan, Error, TEXT("Failed to create spv_optimizer_t"));
+				return nullptr;
+			}
+			spvOptimizerSetMessageConsumer(Optimizer.Get(), &LogOptimizerMessage);
+
+			// Only passes which don't need to understand the graph instructions, as most of the optimizer's passes are for functions.
+			// Interface variables are kept even if unused, as they correspond to the segment's bindings.
+			const char* PassFlags[] = { "--strip-debug", "--strip-nonsemantic", "--eliminate-dead-const", "--compact-ids" };
+			if (!spvOptimizerRegisterPassesFromFlags(Optimizer.Get(), PassFlags, UE_ARRAY_COUNT(PassFlags)))
+			{
+				UE_LOG(LogNNERuntimeRDGMLExtensionsForVulkan, Error, TEXT("Failed to register SPIR-V optimizer passes"));
+				return nullptr;
+			}
+			return Optimizer;
+		}
+
+		void Release(FOptimizerPtr Optimizer)
+		{
+			FScopeLock Lock(&CriticalSection);
+			FreeOptimizers.Add(MoveTemp(Optimizer));
+		}
+
+	private:
+		FCriticalSection CriticalSection;
+		TArray<FOptimizerPtr> FreeOptimizers;
+	};
+
+	FGraphModuleOptimizerPool GraphModuleOptimizerPool;
+
+	// Optimizers which have had the graph shape pass registered for a particular set of input shapes. Passes can't be removed from an
+	// optimizer, so one can only be reused for the same input shapes, but those are often shared (e.g. by the segments of a model that
+	// take the model's inputs, or when a shaped model is created again after being evicted). The least recently released optimizers
+	// are destroyed once there are too many.
+	class FGraphShapeOptimizerPool
+	{
+	public:
+		using FOptimizerPtr = TUniquePtrWithCustomDeleter<spv_optimizer_t, spvOptimizerDestroy>;
+
+		struct FEntry
+		{
+			// Sorted by binding. The pass is given pointers into these, so they're owned by the entry and never change.
+			TArray<TPair<TPair<uint32_t, uint32_t>, TArray<int64_t>>> InputShapes;
+			TArray<spv_graph_shape_input> InputShapesForSpirv;
+			FOptimizerPtr Optimizer;
+		};
+
+		TUniquePtr<FEntry> Acquire(const FDescriptorSetBindingToShapeMap& InputShapes)
+		{
+			TArray<TPair<TPair<uint32_t, uint32_t>, TArray<int64_t>>> SortedInputShapes = InputShapes.Array();
+			SortedInputShapes.Sort([](const auto& A, const auto& B) {
+				return A.Key.Key != B.Key.Key ? A.Key.Key < B.Key.Key : A.Key.Value < B.Key.Value;
+			});
+
+			{
+				FScopeLock Lock(&CriticalSection);
+				for (int32 I = FreeEntries.Num() - 1; I >= 0; --I)
+				{
+					if (FreeEntries[I]->InputShapes == SortedInputShapes)
+					{
+						TUniquePtr<FEntry> Entry = MoveTemp(FreeEntries[I]);
+						FreeEntries.RemoveAt(I);
+						return Entry;
+					}
+				}
+			}
+
+			TUniquePtr<FEntry> Entry = MakeUnique<FEntry>();
+			Entry->Optimizer = FOptimizerPtr(spvOptimizerCreate(SPV_ENV_VULKAN_1_3));
+			if (Entry->Optimizer == nullptr)
+			{
+				UE_LOG(LogNNERuntimeRDGMLExtensionsForVulkan, Error, TEXT("Failed to create spv_optimizer_t"));
+				return nullptr;
+			}
+			spvOptimizerSetMessageConsumer(Entry->Optimizer.Get(), &LogOptimizerMessage);
+
+			Entry->InputShapes = MoveTemp(SortedInputShapes);
+			Algo::Transform(Entry->InputShapes, Entry->InputShapesForSpirv, [](auto&& x) {
+				spv_graph_shape_input input;
+				input.descriptor_set = x.Key.Key;
+				input.binding_id = x.Key.Value;
+				input.rank = x.Value.Num();
+				input.shape = x.Value.GetData();
+				return input;
+			});
+			spvOptimizerRegisterGraphShapePass(Entry->Optimizer.Get(), Entry->InputShapesForSpirv.Num(), Entry->InputShapesForSpirv.GetData());
+			return Entry;
+		}
+
+		void Release(TUniquePtr<FEntry> Entry)
+		{
+			FScopeLock Lock(&CriticalSection);
+			FreeEntries.Add(MoveTemp(Entry));
+			if (FreeEntries.Num() > MAX_FREE_ENTRIES)
+			{
+				FreeEntries.RemoveAt(0);
+			}
+		}
+
+	private:
+		static constexpr int32 MAX_FREE_ENTRIES = 32;
+
+		FCriticalSection CriticalSection;
+		TArray<TUniquePtr<FEntry>> FreeEntries; // Least recently released first.
+	};
+
+	FGraphShapeOptimizerPool GraphShapeOptimizerPool;
+
+	// Finds the shapes of all the tensor variables in the given (valid) SPIR-V code, by walking the words directly rather than using the
+	// SPIRV-Tools parser, which is slow for large graphs as it allocates for every instruction. Only the declarations needed to resolve the
+	// shapes are recorded, in arrays indexed by SPIR-V ID. Returns false if the code is truncated, a tensor variable has no binding or
+	// one of its dimensions isn't an OpConstant.
+	// bOutFullyShaped is set if every tensor type in the module (including those within the graph) has a shape.
+	bool ExtractTensorShapes(TConstArrayView<uint32_t> Code, FDescriptorSetBindingToShapeMap& OutShapes, bool& bOutFullyShaped)
+	{
+		bOutFullyShaped = true;
+		constexpr int32 HeaderNumWords = 5;
+		constexpr uint32_t NoValue = ~0u;
+		if (Code.Num() < HeaderNumWords || Code[3] > (uint32_t)MAX_int32)
+		{
+			return false;
+		}
+		const int32 Bound = (int32)Code[3];
+
+		// The word offset of the declaration of each ID that we care about (types and constants), or 0.
+		TArray<int32> Declarations;
+		Declarations.SetNumZeroed(Bound);
+		TArray<uint32_t> DescriptorSets;
+		DescriptorSets.Init(NoValue, Bound);
+		TArray<uint32_t> Bindings;
+		Bindings.Init(NoValue, Bound);
+		TArray<int32> Variables; // Word offsets of the OpVariables.
+
+		for (int32 Offset = HeaderNumWords; Offset < Code.Num(); )
+		{
+			const uint32_t NumWords = Code[Offset] >> 16;
+			if (NumWords == 0 || NumWords > (uint32_t)(Code.Num() - Offset))
+			{
+				return false;
+			}
+
+			switch (spv::Op(Code[Offset] & 0xFFFF))
+			{
+			case spv::Op::OpDecorate: // Target, Decoration, Literal
+				if (NumWords >= 4 && Code[Offset + 1] < (uint32_t)Bound)
+				{
+					const spv::Decoration Decoration = spv::Decoration(Code[Offset + 2]);
+					if (Decoration == spv::Decoration::DescriptorSet)
+					{
+						DescriptorSets[Code[Offset + 1]] = Code[Offset + 3];
+					}
+					else if (Decoration == spv::Decoration::Binding)
+					{
+						Bindings[Code[Offset + 1]] = Code[Offset + 3];
+					}
+				}
+				break;
+			case spv::Op::OpTypePointer: // Result, Storage Class, Type
+				if (NumWords >= 2 && Code[Offset + 1] < (uint32_t)Bound)
+				{
+					Declarations[Code[Offset + 1]] = Offset;
+				}
+				break;
+			case spv::Op::OpTypeTensorARM: // Result, Element Type, Rank, Shape (the last two are optional)
+				bOutFullyShaped &= NumWords >= 5;
+				if (NumWords >= 2 && Code[Offset + 1] < (uint32_t)Bound)
+				{
+					Declarations[Code[Offset + 1]] = Offset;
+				}
+				break;
+			case spv::Op::OpConstant: // Type, Result, Value
+			case spv::Op::OpConstantComposite: // Type, Result, Constituents...
+				if (NumWords >= 3 && Code[Offset + 2] < (uint32_t)Bound)
+				{
+					Declarations[Code[Offset + 2]] = Offset;
+				}
+				break;
+			case spv::Op::OpVariable: // Type, Result, Storage Class
+				if (NumWords >= 3 && Code[Offset + 2] < (uint32_t)Bound)
+				{
+					Variables.Add(Offset);
+				}
+				break;
+			default:
+				break;
+			}
+			Offset += NumWords;
+		}
+
+		// Gets the declaration of the given ID if it has the given opcode and at least the given number of words.
+		auto FindDeclaration = [&](uint32_t Id, spv::Op Opcode, uint32_t MinNumWords) -> const uint32_t* {
+			if (Id >= (uint32_t)Bound || Declarations[Id] == 0)
+			{
+				return nullptr;
+			}
+			const uint32_t* Declaration = &Code[Declarations[Id]];
+			return spv::Op(Declaration[0] & 0xFFFF) == Opcode && (Declaration[0] >> 16) >= MinNumWords ? Declaration : nullptr;
+		};
+
+		for (int32 VariableOffset : Variables)
+		{
+			const uint32_t VariableId = Code[VariableOffset + 2];
+			const uint32_t* PointerType = FindDeclaration(Code[VariableOffset + 1], spv::Op::OpTypePointer, 4);
+			const uint32_t* TensorType = PointerType ? FindDeclaration(PointerType[3], spv::Op::OpTypeTensorARM, 5) : nullptr;
+			const uint32_t* ShapeDeclaration = TensorType ? FindDeclaration(TensorType[4], spv::Op::OpConstantComposite, 3) : nullptr;
+			if (ShapeDeclaration == nullptr)
+			{
+				continue; // Not a tensor, or a tensor without a shape.
+			}
+
+			const uint32_t ShapeNumWords = ShapeDeclaration[0] >> 16;
+			TArray<int64_t> Shape;
+			Shape.Reserve(ShapeNumWords - 3);
+			for (uint32_t WordIdx = 3; WordIdx < ShapeNumWords; ++WordIdx)
+			{
+				// Dropping a dimension would give the tensor the wrong rank, so anything other than a plain constant is an error.
+				const uint32_t* DimDeclaration = FindDeclaration(ShapeDeclaration[WordIdx], spv::Op::OpConstant, 4);
+				if (DimDeclaration == nullptr)
+				{
+					return false;
+				}
+				Shape.Add(static_cast<int64_t>(DimDeclaration[3]));
+			}
+
+			if (DescriptorSets[VariableId] == NoValue || Bindings[VariableId] == NoValue)
+			{
+				return false;
+			}
+			OutShapes.Add({ DescriptorSets[VariableId], Bindings[VariableId] }, MoveTemp(Shape));
+		}
+
+		return true;
 	}
 
 } // namespace
 
 ShapeInferenceResults RunShapeInference(TConstArrayView<uint32_t> Code, FDescriptorSetBindingToShapeMap InputShapes)
 {
-	TUniquePtrWithCustomDeleter<spv_optimizer_t, spvOptimizerDestroy> Optimizer(spvOptimizerCreate(SPV_ENV_VULKAN_1_3));
-	if (Optimizer == nullptr)
+	// If every tensor in the module already has a shape (e.g. the VGF was exported for fixed input shapes) then the shape pass has
+	// nothing to do, so the code is used as it is. The given input shapes still have to match the ones in the code.
 	{
-		UE_LOG(LogNNERuntimeRDGMLExtensionsForVulkan, Error, TEXT("Failed to create spv_optimizer_t"));
-		return ShapeInferenceResults{ false };
+		ShapeInferenceResults Results;
+		bool bFullyShaped = false;
+		if (ExtractTensorShapes(Code, Results.OutputShapes, bFullyShaped) && bFullyShaped)
+		{
+			for (const TPair<TPair<uint32_t, uint32_t>, TArray<int64_t>>& InputShape : InputShapes)
+			{
+				const TArray<int64_t>* DeclaredShape = Results.OutputShapes.Find(InputShape.Key);
+				if (DeclaredShape == nullptr || *DeclaredShape != InputShape.Value)
+				{
+					UE_LOG(LogNNERuntimeRDGMLExtensionsForVulkan, Error, TEXT("Input shape for binding %u doesn't match the shape in the fully shaped SPIR-V"), InputShape.Key.Get<1>());
+					return ShapeInferenceResults{ false };
+				}
+			}
+			Results.NewCode = TArray<uint32_t>(Code.GetData(), Code.Num());
+			Results.Success = true;
+			return Results;
+		}
 	}
 
-	spvOptimizerSetMessageConsumer(Optimizer.Get(), [](spv_message_level_t Level, const char* Source, const spv_position_t* Position, const char* Message) {
-		UE_LOG(LogNNERuntimeRDGMLExtensionsForVulkan, Display, TEXT("spvOptimizer: %hs"), Message);
-	});
+	TUniquePtr<FGraphShapeOptimizerPool::FEntry> OptimizerEntry = GraphShapeOptimizerPool.Acquire(InputShapes);
+	if (OptimizerEntry == nullptr)
+	{
+		// Error will have been logged by Acquire.
+		return ShapeInferenceResults{ false };
+	}
+	ON_SCOPE_EXIT{ GraphShapeOptimizerPool.Release(MoveTemp(OptimizerEntry)); };
+	spv_optimizer_t* Optimizer = OptimizerEntry->Optimizer.Get();
 
 	TUniquePtrWithCustomDeleter<spv_optimizer_options_t, spvOptimizerOptionsDestroy> OptimizerOptions(spvOptimizerOptionsCreate());
 	if (OptimizerOptions == nullptr)
@@ -52,20 +336,8 @@ ShapeInferenceResults RunShapeInference(TConstArrayView<uint32_t> Code, FDescrip
 		return ShapeInferenceResults{ false };
 	}
 
-	TArray<spv_graph_shape_input> InputShapesForSpirv;
-	Algo::Transform(InputShapes, InputShapesForSpirv, [](auto&& x) {
-		spv_graph_shape_input input;
-		input.descriptor_set = x.Get<0>().Get<0>();
-		input.binding_id = x.Get<0>().Get<1>();
-		input.rank = x.Get<1>().Num();
-		input.shape = x.Get<1>().GetData();
-		return input;
-	});
-
-	spvOptimizerRegisterGraphShapePass(Optimizer.Get(), InputShapesForSpirv.Num(), InputShapesForSpirv.GetData());
-
 	spv_binary_t* OptimizedBinaryRaw = nullptr;
-	spv_result_t Result = spvOptimizerRun(Optimizer.Get(), Code.GetData(), Code.Num(), &OptimizedBinaryRaw, OptimizerOptions.Get());
+	spv_result_t Result = spvOptimizerRun(Optimizer, Code.GetData(), Code.Num(), &OptimizedBinaryRaw, OptimizerOptions.Get());
 	TUniquePtrWithCustomDeleter<spv_binary_t, spvBinaryDestroy> OptimizedCode(OptimizedBinaryRaw);
 	if (Result != SPV_SUCCESS)
 	{
@@ -73,111 +345,279 @@ ShapeInferenceResults RunShapeInference(TConstArrayView<uint32_t> Code, FDescrip
 		return ShapeInferenceResults{ false };
 	}
 
-	// Parse the binary with the newly shaped graph, to extract the output tensor shapes
-	TUniquePtrWithCustomDeleter<spv_context_t, spvContextDestroy> Context(spvContextCreate(SPV_ENV_VULKAN_1_3));
+	// Extract the output tensor shapes from the newly shaped graph.
+	ShapeInferenceResults Results;
+	bool bFullyShaped = false;
+	if (!ExtractTensorShapes(TConstArrayView<uint32_t>(OptimizedCode->code, (int32)OptimizedCode->wordCount), Results.OutputShapes, bFullyShaped))
+	{
+		UE_LOG(LogNNERuntimeRDGMLExtensionsForVulkan, Error, TEXT("Failed to extract tensor shapes from the shaped SPIR-V"));
+		return ShapeInferenceResults{ false };
+	}
+
+	Results.NewCode = TArray<uint32_t>(OptimizedCode->code, OptimizedCode->wordCount);
+	Results.Success = true;
+	return Results;
+}
+
+bool RewriteGraphConstantsAsInputs(TConstArrayView<uint32_t> Code, const TMap<uint32_t, uint32_t>& ConstantIdToBinding, TArray<uint32_t>& OutCode)
+{
+	const spv_context_t* Context = GetSharedContext();
 	if (Context == nullptr)
 	{
 		UE_LOG(LogNNERuntimeRDGMLExtensionsForVulkan, Error, TEXT("Failed to create spv_context_t"));
-		return ShapeInferenceResults{ false };
+		return false;
 	}
 
-	// Struct that is passed into the parsing callback to record things we need later
-	struct ParsingResultsStruct
+	// Copy of each instruction, as the parsed ones are transient.
+	struct FInstruction
 	{
-		TArray<spv_parsed_instruction_t> ParsedInstructions;
-		TArray<TArray<spv_parsed_operand_t>> ParsedOperands; // First index is the instruction idx, second index is the operand idx within the instruction
-		TMap<uint32_t, uint32_t> IdToDeclarationInstructionIdx;
-		TMap<TPair<uint32_t, spv::Decoration>, uint32_t> IdToDecorations; // Map from (SPIR-V ID and decoration kind) to the decoration value
-	} ParsingResults;
+		spv::Op Opcode;
+		uint32_t ResultId;
+		uint32_t TypeId;
+		TArray<uint32_t> Words;
+		TArray<spv_parsed_operand_t> Operands;
+	};
+	TArray<FInstruction> Instructions;
 
 	auto ParsingCallback = [](void* UserData, const spv_parsed_instruction_t* Instruction) -> spv_result_t {
-		ParsingResultsStruct& Results = *static_cast<ParsingResultsStruct*>(UserData);
+		TArray<FInstruction>& Results = *static_cast<TArray<FInstruction>*>(UserData);
+		Results.Add({ spv::Op(Instruction->opcode), Instruction->result_id, Instruction->type_id,
+			TArray<uint32_t>(Instruction->words, Instruction->num_words), TArray<spv_parsed_operand_t>(Instruction->operands, Instruction->num_operands) });
+		return SPV_SUCCESS;
+	};
 
-		// Store the parsed instruction and its operands so that we can look back at them later.
-		// Note that we need to copy the structs as they are transient
-		Results.ParsedInstructions.Add(*Instruction);
-		Results.ParsedOperands.Add(TArray<spv_parsed_operand_t>(Instruction->operands, Instruction->num_operands));
-		// Update the copied instruction struct's pointer to point to our new copy, not the transient ones
-		Results.ParsedInstructions.Last().operands = Results.ParsedOperands.Last().GetData();
+	spv_diagnostic_t* DiagnosticRaw = nullptr;
+	spv_result_t Result = spvBinaryParse(Context, &Instructions, Code.GetData(), Code.Num(), nullptr, ParsingCallback, &DiagnosticRaw);
+	TUniquePtrWithCustomDeleter<spv_diagnostic_t, spvDiagnosticDestroy> Diagnostic(DiagnosticRaw);
+	if (Result != SPV_SUCCESS)
+	{
+		UE_LOG(LogNNERuntimeRDGMLExtensionsForVulkan, Error, TEXT("Failed to run spvBinaryParse, error code = %i, diagnostic = %hs"), Result, Diagnostic->error);
+		return false;
+	}
 
-		if (Instruction->result_id != 0)
+	// Find everything that needs changing. New global declarations are all put just before the first graph (or function), by which
+	// point all the existing types have been declared, and the constants themselves are replaced by graph inputs.
+	TMap<uint32_t, int32> IdToInstructionIdx;
+	TMap<uint32_t, uint32_t> TensorTypeToPointerType; // Existing UniformConstant pointer types, which can't be declared again.
+	TArray<int32> ConstantInstructionIdxs;
+	int32 FirstGraphOrFunctionIdx = INDEX_NONE;
+	int32 GraphIdx = INDEX_NONE;
+	int32 EntryPointIdx = INDEX_NONE;
+	int32 LastDecorateIdx = INDEX_NONE;
+	int32 LastGraphInputIdx = INDEX_NONE;
+	int32 NumGraphs = 0;
+	uint32_t IntTypeId = 0;
+	for (int32 I = 0; I < Instructions.Num(); ++I)
+	{
+		const FInstruction& Instruction = Instructions[I];
+		if (Instruction.ResultId != 0)
 		{
-			Results.IdToDeclarationInstructionIdx.Add(Instruction->result_id, uint32_t(Results.ParsedInstructions.Num()) - 1);
+			IdToInstructionIdx.Add(Instruction.ResultId, I);
 		}
-		if (Instruction->opcode == uint16_t(spv::Op::OpDecorate) &&
-			Instruction->num_operands >= 3 && Instruction->operands[1].type == SPV_OPERAND_TYPE_DECORATION)
+		switch (Instruction.Opcode)
 		{
-			uint32 DecoratedId = GetSingleWordOperand(*Instruction, 0);
-			spv::Decoration DecorationKind = spv::Decoration(GetSingleWordOperand(*Instruction, 1));
-			uint32 DecorationValue = GetSingleWordOperand(*Instruction, 2);
-			if (DecorationKind == spv::Decoration::Binding || DecorationKind == spv::Decoration::DescriptorSet)
+		case spv::Op::OpGraphARM:
+			GraphIdx = I;
+			++NumGraphs;
+			FirstGraphOrFunctionIdx = FirstGraphOrFunctionIdx == INDEX_NONE ? I : FirstGraphOrFunctionIdx;
+			break;
+		case spv::Op::OpFunction:
+			FirstGraphOrFunctionIdx = FirstGraphOrFunctionIdx == INDEX_NONE ? I : FirstGraphOrFunctionIdx;
+			break;
+		case spv::Op::OpGraphEntryPointARM:
+			EntryPointIdx = I;
+			break;
+		case spv::Op::OpDecorate:
+			LastDecorateIdx = I;
+			break;
+		case spv::Op::OpGraphInputARM:
+			LastGraphInputIdx = I;
+			break;
+		case spv::Op::OpTypeInt:
+			// Any 32-bit integer will do for the input indexes, but prefer unsigned.
+			if (Instruction.Words[2] == 32 && (IntTypeId == 0 || Instruction.Words[3] == 0))
+			{
+				IntTypeId = Instruction.ResultId;
+			}
+			break;
+		case spv::Op::OpTypePointer:
+			if (spv::StorageClass(Instruction.Words[2]) == spv::StorageClass::UniformConstant)
+			{
+				TensorTypeToPointerType.Add(Instruction.Words[3], Instruction.ResultId);
+			}
+			break;
+		case spv::Op::OpGraphConstantARM:
+			if (ConstantIdToBinding.Contains(Instruction.Words[3]))
 			{
-				Results.IdToDecorations.Add({ DecoratedId, DecorationKind }, DecorationValue);
+				ConstantInstructionIdxs.Add(I);
 			}
+			break;
+		default:
+			break;
 		}
+	}
+	if (NumGraphs != 1 || EntryPointIdx == INDEX_NONE || LastDecorateIdx == INDEX_NONE)
+	{
+		UE_LOG(LogNNERuntimeRDGMLExtensionsForVulkan, Error, TEXT("Can't rewrite graph constants: unsupported module layout."));
+		return false;
+	}
+	if (ConstantInstructionIdxs.Num() != ConstantIdToBinding.Num())
+	{
+		UE_LOG(LogNNERuntimeRDGMLExtensionsForVulkan, Error, TEXT("Can't rewrite graph constants: constant not found in the graph."));
+		return false;
+	}
+	const int32* GraphTypeIdx = IdToInstructionIdx.Find(Instructions[GraphIdx].TypeId);
+	if (GraphTypeIdx == nullptr || Instructions[*GraphTypeIdx].Opcode != spv::Op::OpTypeGraphARM)
+	{
+		UE_LOG(LogNNERuntimeRDGMLExtensionsForVulkan, Error, TEXT("Can't rewrite graph constants: graph type not found."));
+		return false;
+	}
+	const FInstruction& GraphType = Instructions[*GraphTypeIdx];
+	const FInstruction& EntryPoint = Instructions[EntryPointIdx];
+	const uint32_t NumInputs = GraphType.Words[2];
+	// The entry point's operands are the graph, its name and then the interface variables (inputs followed by outputs).
+	if (GraphType.Words.Num() < 3 + (int32)NumInputs || EntryPoint.Operands.Num() < 2 + (int32)NumInputs)
+	{
+		UE_LOG(LogNNERuntimeRDGMLExtensionsForVulkan, Error, TEXT("Can't rewrite graph constants: graph inputs don't match the entry point."));
+		return false;
+	}
 
-		return SPV_SUCCESS;
+	auto MakeInstruction = [](spv::Op Opcode, std::initializer_list<uint32_t> Operands) {
+		TArray<uint32_t> Words;
+		Words.Add(((uint32_t)(Operands.size() + 1) << 16) | (uint32_t)Opcode);
+		Words.Append(Operands.begin(), (int32)Operands.size());
+		return Words;
 	};
 
-	spv_diagnostic_t* DiagnosticRaw = nullptr;
-	Result = spvBinaryParse(Context.Get(), &ParsingResults, OptimizedCode->code, OptimizedCode->wordCount, nullptr, ParsingCallback, &DiagnosticRaw);
-	TUniquePtrWithCustomDeleter<spv_diagnostic_t, spvDiagnosticDestroy> Diagnostic(DiagnosticRaw);
-	if (Result != SPV_SUCCESS)
+	uint32_t Bound = Code[3];
+	TArray<uint32_t> NewGlobals;
+	TArray<uint32_t> NewDecorations;
+	TArray<uint32_t> NewGraphInputs;
+	TArray<uint32_t> NewInputTypes;
+	TArray<uint32_t> NewInterfaceVariables;
+	if (IntTypeId == 0)
 	{
-		UE_LOG(LogNNERuntimeRDGMLExtensionsForVulkan, Error, TEXT("Failed to run spvBinaryParse, error code = %i, diagnostic = %hs"), Result, Diagnostic->error);
-		return ShapeInferenceResults{ false };
+		IntTypeId = Bound++;
+		NewGlobals.Append(MakeInstruction(spv::Op::OpTypeInt, { IntTypeId, 32, 0 }));
 	}
+	for (int32 ConstantNum = 0; ConstantNum < ConstantInstructionIdxs.Num(); ++ConstantNum)
+	{
+		const FInstruction& Constant = Instructions[ConstantInstructionIdxs[ConstantNum]];
+		const uint32_t TensorTypeId = Constant.TypeId;
 
-	ShapeInferenceResults Results;
+		uint32_t PointerTypeId;
+		if (const uint32_t* ExistingPointerTypeId = TensorTypeToPointerType.Find(TensorTypeId))
+		{
+			PointerTypeId = *ExistingPointerTypeId;
+		}
+		else
+		{
+			PointerTypeId = Bound++;
+			TensorTypeToPointerType.Add(TensorTypeId, PointerTypeId);
+			NewGlobals.Append(MakeInstruction(spv::Op::OpTypePointer, { PointerTypeId, (uint32_t)spv::StorageClass::UniformConstant, TensorTypeId }));
+		}
+		const uint32_t VariableId = Bound++;
+		const uint32_t InputIndexId = Bound++;
+		NewGlobals.Append(MakeInstruction(spv::Op::OpVariable, { PointerTypeId, VariableId, (uint32_t)spv::StorageClass::UniformConstant }));
+		NewGlobals.Append(MakeInstruction(spv::Op::OpConstant, { IntTypeId, InputIndexId, NumInputs + ConstantNum }));
+
+		NewDecorations.Append(MakeInstruction(spv::Op::OpDecorate, { VariableId, (uint32_t)spv::Decoration::DescriptorSet, 0 }));
+		NewDecorations.Append(MakeInstruction(spv::Op::OpDecorate, { VariableId, (uint32_t)spv::Decoration::Binding, ConstantIdToBinding[Constant.Words[3]] }));
+
+		// The graph input takes over the constant's result ID, so the rest of the graph doesn't need to change.
+		NewGraphInputs.Append(MakeInstruction(spv::Op::OpGraphInputARM, { TensorTypeId, Constant.ResultId, InputIndexId }));
+		NewInputTypes.Add(TensorTypeId);
+		NewInterfaceVariables.Add(VariableId);
+	}
 
-	// Process the parsed instructions to extract the output shapes.
-	for (int I = 0; I < ParsingResults.ParsedInstructions.Num(); ++I)
+	OutCode.Reset(Code.Num() + NewGlobals.Num() + NewDecorations.Num() + NewGraphInputs.Num() + NewInputTypes.Num() + NewInterfaceVariables.Num());
+	OutCode.Append(Code.GetData(), 5); // Header
+	OutCode[3] = Bound;
+	const int32 GraphInputsInsertIdx = FMath::Max(GraphIdx, LastGraphInputIdx);
+	for (int32 I = 0; I < Instructions.Num(); ++I)
 	{
-		const spv_parsed_instruction_t& Instruction = ParsingResults.ParsedInstructions[I];
-		if (Instruction.opcode == uint16_t(spv::Op::OpVariable))
+		const FInstruction& Instruction = Instructions[I];
+		if (I == FirstGraphOrFunctionIdx)
 		{
-			uint32 VariableId = Instruction.result_id;
+			OutCode.Append(NewGlobals);
+		}
 
-			// Find where the variable is declared
-			const spv_parsed_instruction_t& VariableDeclaration = ParsingResults.ParsedInstructions[*ParsingResults.IdToDeclarationInstructionIdx.Find(VariableId)];
-			// Find the type of the variable, which will always be OpTypePointer
-			const spv_parsed_instruction_t& PointerTypeDeclaration = ParsingResults.ParsedInstructions[*ParsingResults.IdToDeclarationInstructionIdx.Find(VariableDeclaration.type_id)];
-			// Find the type that the pointer points to
-			const spv_parsed_instruction_t& TensorTypeDeclaration = ParsingResults.ParsedInstructions[*ParsingResults.IdToDeclarationInstructionIdx.Find(GetSingleWordOperand(PointerTypeDeclaration, 2))];
-			if (TensorTypeDeclaration.opcode != uint32_t(spv::Op::OpTypeTensorARM))
-			{
-				continue;
-			}
+		if (I == *GraphTypeIdx)
+		{
+			// The new inputs go after the existing ones (and before the outputs).
+			TArray<uint32_t> Words = Instruction.Words;
+			Words[2] += NewInputTypes.Num();
+			Words.Insert(NewInputTypes, 3 + (int32)NumInputs);
+			Words[0] = ((uint32_t)Words.Num() << 16) | (uint32_t)Instruction.Opcode;
+			OutCode.Append(Words);
+		}
+		else if (I == EntryPointIdx)
+		{
+			TArray<uint32_t> Words = Instruction.Words;
+			Words.Insert(NewInterfaceVariables, 2 + (int32)NumInputs < Instruction.Operands.Num() ? Instruction.Operands[2 + NumInputs].offset : Words.Num());
+			Words[0] = ((uint32_t)Words.Num() << 16) | (uint32_t)Instruction.Opcode;
+			OutCode.Append(Words);
+		}
+		else if (!ConstantInstructionIdxs.Contains(I))
+		{
+			OutCode.Append(Instruction.Words);
+		}
 
-			// Get the tensor shape from the tensor type declaration
-			const spv_parsed_instruction_t& ShapeDeclaration = ParsingResults.ParsedInstructions[*ParsingResults.IdToDeclarationInstructionIdx.Find(GetSingleWordOperand(TensorTypeDeclaration, 3))];
-			if (ShapeDeclaration.opcode != uint32_t(spv::Op::OpConstantComposite))
-			{
-				continue;
-			}
-			TArray<int64_t> Shape;
-			for (int Dim = 0; Dim < ShapeDeclaration.num_operands - 2; ++Dim)
-			{
-				uint32_t DimId = GetSingleWordOperand(ShapeDeclaration, Dim + 2);
-				// Find the instruction which declares this dimension's value
-				const spv_parsed_instruction_t& DimDeclaration = ParsingResults.ParsedInstructions[*ParsingResults.IdToDeclarationInstructionIdx.Find(DimId)];
+		if (I == LastDecorateIdx)
+		{
+			OutCode.Append(NewDecorations);
+		}
+		if (I == GraphInputsInsertIdx)
+		{
+			OutCode.Append(NewGraphInputs);
+		}
+	}
+	return true;
+}
 
-				if (DimDeclaration.opcode !=uint32_t(spv::Op::OpConstant))
-				{
-					continue;
-				}
+bool OptimizeGraphModule(TConstArrayView<uint32_t> Code, TArray<uint32_t>& OutCode)
+{
+	FGraphModuleOptimizerPool::FOptimizerPtr Optimizer = GraphModuleOptimizerPool.Acquire();
+	if (Optimizer == nullptr)
+	{
+		// Error will have been logged by Acquire.
+		return false;
+	}
+	ON_SCOPE_EXIT{ GraphModuleOptimizerPool.Release(MoveTemp(Optimizer)); };
 
-				uint32_t DimValue = GetSingleWordOperand(DimDeclaration, 2);
-				Shape.Add(static_cast<int64_t>(DimValue));
-			}
+	TUniquePtrWithCustomDeleter<spv_optimizer_options_t, spvOptimizerOptionsDestroy> OptimizerOptions(spvOptimizerOptionsCreate());
+	if (OptimizerOptions == nullptr)
+	{
+		UE_LOG(LogNNERuntimeRDGMLExtensionsForVulkan, Error, TEXT("Failed to create spv_optimizer_options_t"));
+		return false;
+	}
 
-			uint32 DescriptorSet = *ParsingResults.IdToDecorations.Find({ VariableId, spv::Decoration::DescriptorSet });
-			uint32 BindingIdx = *ParsingResults.IdToDecorations.Find({ VariableId, spv::Decoration::Binding });
-			Results.OutputShapes.Add({ DescriptorSet, BindingIdx }, MoveTemp(Shape));
-		}
+	spv_binary_t* OptimizedBinaryRaw = nullptr;
+	spv_result_t Result = spvOptimizerRun(Optimizer.Get(), Code.GetData(), Code.Num(), &OptimizedBinaryRaw, OptimizerOptions.Get());
+	TUniquePtrWithCustomDeleter<spv_binary_t, spvBinaryDestroy> OptimizedCode(OptimizedBinaryRaw);
+	if (Result != SPV_SUCCESS)
+	{
+		UE_LOG(LogNNERuntimeRDGMLExtensionsForVulkan, Error, TEXT("Failed to run spvOptimizerRun, error: %i"), Result);
+		return false;
 	}
 
-	Results.NewCode = TArray<uint32_t>(OptimizedCode->code, OptimizedCode->wordCount);
-	Results.Success = true;
-	return Results;
+	// The optimizer validates its input, but not its output.
+	const spv_context_t* Context = GetSharedContext();
+	if (Context == nullptr)
+	{
+		UE_LOG(LogNNERuntimeRDGMLExtensionsForVulkan, Error, TEXT("Failed to create spv_context_t"));
+		return false;
+	}
+	spv_diagnostic_t* DiagnosticRaw = nullptr;
+	Result = spvValidateBinary(Context, OptimizedCode->code, OptimizedCode->wordCount, &DiagnosticRaw);
+	TUniquePtrWithCustomDeleter<spv_diagnostic_t, spvDiagnosticDestroy> Diagnostic(DiagnosticRaw);
+	if (Result != SPV_SUCCESS)
+	{
+		UE_LOG(LogNNERuntimeRDGMLExtensionsForVulkan, Error, TEXT("Optimized SPIR-V failed validation, error code = %i, diagnostic = %hs"), Result,
+			Diagnostic != nullptr ? Diagnostic->error : "");
+		return false;
+	}
+
+	OutCode = TArray<uint32_t>(OptimizedCode->code, OptimizedCode->wordCount);
+	return true;
 }
@@ -1,7 +1,8 @@
 // SPDX-FileCopyrightText: Copyright 2025 Arm Limited and/or its affiliates <open-source-office@arm.com>
 // SPDX-License-Identifier: MIT
 
-// This file provides an interface to the third party SPIRV-Tools code, specifically the graph shape inference pass.
+// This file provides an interface to the third party SPIRV-Tools code, specifically the graph shape inference pass (along with the
+// passes used to optimize modules when models are cooked, and a rewrite of graph constants which uses the SPIRV-Tools parser).
 
 #pragma once
 
@@ -21,5 +22,16 @@ struct ShapeInferenceResults
 
 // Performs shape inference on the graph contained in the given SPIR-V code, using the given input shapes and propagating 
 // shape information through the graph. The result is new SPIR-V code that is fully shaped and a map of output tensor shapes
-// indexed by their binding information.
-ShapeInferenceResults RunShapeInference(TConstArrayView<uint32_t> Code, FDescriptorSetBindingToShapeMap InputShapes);
\ No newline at end of file
+// indexed by their binding information. If the code is already fully shaped, it's returned as it is without running the pass.
+ShapeInferenceResults RunShapeInference(TConstArrayView<uint32_t> Code, FDescriptorSetBindingToShapeMap InputShapes);
+
+// Turns some of the graph constants (OpGraphConstantARM) of the graph contained in the given SPIR-V code into extra inputs of the graph,
+// so that the constant data can be bound as a tensor in the descriptor set rather than being baked into the pipeline.
+// ConstantIdToBinding maps the GraphConstantID of each constant to rewrite to the binding idx (in descriptor set 0) of its new input.
+// Only modules with a single graph are supported. Returns false (having logged an error) if the code couldn't be rewritten.
+bool RewriteGraphConstantsAsInputs(TConstArrayView<uint32_t> Code, const TMap<uint32_t, uint32_t>& ConstantIdToBinding, TArray<uint32_t>& OutCode);
+
+// Strips debug information, removes unused constants and types and renumbers the IDs of the given SPIR-V code, then validates the result.
+// This makes the code smaller and quicker for the driver to parse, without changing what it does.
+// Returns false (having logged an error) if the code couldn't be optimized or the result isn't valid.
+bool OptimizeGraphModule(TConstArrayView<uint32_t> Code, TArray<uint32_t>& OutCode);
@@ -0,0 +1,260 @@
+// SPDX-FileCopyrightText: Copyright 2025 Arm Limited and/or its affiliates <open-source-office@arm.com>
+// SPDX-License-Identifier: MIT
+
+#include "NNERuntimeRDGMLExtensionsForVulkanShapeInferenceCache.h"
+#include "NNERuntimeRDGMLExtensionsForVulkanModule.h"
+#include "NNERuntimeRDGMLExtensionsForVulkanSettings.h"
+#include "NNERuntimeRDGMLExtensionsForVulkanStats.h"
+#include "HAL/FileManager.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Guid.h"
+#include "Misc/Paths.h"
+#include "Misc/ScopeLock.h"
+#include "Serialization/MemoryReader.h"
+#include "Serialization/MemoryWriter.h"
+#if WITH_EDITOR
+#include "DerivedDataCacheInterface.h"
+#endif
+
+#include "spirv-tools/libspirv.h"
+
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Shape inference cache hits"), STAT_NNERuntimeRDGMLExtensionsForVulkan_ShapeInferenceCacheHits, STATGROUP_NNERuntimeRDGMLExtensionsForVulkan);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Shape inference cache misses"), STAT_NNERuntimeRDGMLExtensionsForVulkan_ShapeInferenceCacheMisses, STATGROUP_NNERuntimeRDGMLExtensionsForVulkan);
+
+FNNERuntimeRDGMLExtensionsForVulkanShapeInferenceCache& FNNERuntimeRDGMLExtensionsForVulkanShapeInferenceCache::Get()
+{
+	static FNNERuntimeRDGMLExtensionsForVulkanShapeInferenceCache Cache;
+	return Cache;
+}
+
+FNNERuntimeRDGMLExtensionsForVulkanShapeInferenceCache::FNNERuntimeRDGMLExtensionsForVulkanShapeInferenceCache()
+{
+	SPIRVToolsVersion = spvSoftwareVersionString();
+	Directory = FPaths::Combine(FPaths::ProjectSavedDir(), TEXT("NNERuntimeRDGMLExtensionsForVulkan"), TEXT("ShapeInference"));
+	MaxDirectorySize = (int64)GetDefault<UNNERuntimeRDGMLExtensionsForVulkanSettings>()->ShapeInferenceCacheMaxSizeMB * 1024 * 1024;
+}
+
+ShapeInferenceResults FNNERuntimeRDGMLExtensionsForVulkanShapeInferenceCache::RunShapeInference(TConstArrayView<uint32_t> Code, const FDescriptorSetBindingToShapeMap& InputShapes)
+{
+	const FXxHash64 Key = MakeKey(Code, InputShapes);
+
+	ShapeInferenceResults Results{ false };
+	if (Load(Key, Results))
+	{
+		++NumHits;
+		INC_DWORD_STAT(STAT_NNERuntimeRDGMLExtensionsForVulkan_ShapeInferenceCacheHits);
+		CSV_CUSTOM_STAT(NNERuntimeRDGMLExtensionsForVulkan, ShapeInferenceCacheHits, 1, ECsvCustomStatOp::Accumulate);
+		return Results;
+	}
+
+	++NumMisses;
+	INC_DWORD_STAT(STAT_NNERuntimeRDGMLExtensionsForVulkan_ShapeInferenceCacheMisses);
+	CSV_CUSTOM_STAT(NNERuntimeRDGMLExtensionsForVulkan, ShapeInferenceCacheMisses, 1, ECsvCustomStatOp::Accumulate);
+	Results = ::RunShapeInference(Code, InputShapes);
+	// Failures aren't cached, so that the error is logged each time.
+	if (Results.Success)
+	{
+		Store(Key, Results);
+	}
+	return Results;
+}
+
+FXxHash64 FNNERuntimeRDGMLExtensionsForVulkanShapeInferenceCache::MakeKey(TConstArrayView<uint32_t> Code, const FDescriptorSetBindingToShapeMap& InputShapes) const
+{
+	// Sort the inputs, so that the key doesn't depend on the order they were added to the map.
+	TArray<TPair<uint32_t, uint32_t>> Bindings;
+	InputShapes.GetKeys(Bindings);
+	Bindings.Sort([](const TPair<uint32_t, uint32_t>& A, const TPair<uint32_t, uint32_t>& B) { return A.Key != B.Key ? A.Key < B.Key : A.Value < B.Value; });
+
+	FXxHash64Builder Builder;
+	Builder.Update(&FILE_VERSION, sizeof(FILE_VERSION));
+	Builder.Update(*SPIRVToolsVersion, SPIRVToolsVersion.Len() * sizeof(TCHAR));
+	Builder.Update(Code.GetData(), Code.Num() * sizeof(Code[0]));
+	for (const TPair<uint32_t, uint32_t>& Binding : Bindings)
+	{
+		const TArray<int64_t>& Shape = InputShapes[Binding];
+		const int32 Rank = Shape.Num();
+		Builder.Update(&Binding.Key, sizeof(Binding.Key));
+		Builder.Update(&Binding.Value, sizeof(Binding.Value));
+		Builder.Update(&Rank, sizeof(Rank));
+		Builder.Update(Shape.GetData(), Shape.Num() * sizeof(Shape[0]));
+	}
+	return Builder.Finalize();
+}
+
+bool FNNERuntimeRDGMLExtensionsForVulkanShapeInferenceCache::Load(const FXxHash64& Key, ShapeInferenceResults& OutResults) const
+{
+	TArray<uint8> Data;
+#if WITH_EDITOR
+	const FString DDCKey = FString::Printf(TEXT("NNERTVKSHAPE_%016llx"), Key.Hash);
+	if (!GetDerivedDataCacheRef().GetSynchronous(*DDCKey, Data, TEXTVIEW("NNERuntimeRDGMLExtensionsForVulkan shape inference")))
+	{
+		return false;
+	}
+#else
+	const FString FilePath = FPaths::Combine(Directory, FString::Printf(TEXT("%016llx.bin"), Key.Hash));
+	if (!FFileHelper::LoadFileToArray(Data, *FilePath, FILEREAD_Silent))
+	{
+		return false;
+	}
+	// Eviction goes by the modification time, so this keeps entries that are still being used.
+	if (MaxDirectorySize > 0)
+	{
+		IFileManager::Get().SetTimeStamp(*FilePath, FDateTime::UtcNow());
+	}
+#endif
+
+	// Any problems here just mean we run shape inference again (and overwrite the entry).
+	FMemoryReader Reader(Data);
+	uint32 Magic = 0;
+	uint32 Version = 0;
+	uint64 StoredKey = 0;
+	Reader << Magic;
+	Reader << Version;
+	Reader << StoredKey;
+	if (Reader.IsError() || Magic != FILE_MAGIC || Version != FILE_VERSION || StoredKey != Key.Hash)
+	{
+		UE_LOG(LogNNERuntimeRDGMLExtensionsForVulkan, Warning, TEXT("Ignoring invalid shape inference cache entry %016llx."), Key.Hash);
+		return false;
+	}
+	Serialize(Reader, OutResults);
+	if (Reader.IsError())
+	{
+		UE_LOG(LogNNERuntimeRDGMLExtensionsForVulkan, Warning, TEXT("Ignoring invalid shape inference cache entry %016llx."), Key.Hash);
+		return false;
+	}
+	OutResults.Success = true;
+	return true;
+}
+
+void FNNERuntimeRDGMLExtensionsForVulkanShapeInferenceCache::Store(const FXxHash64& Key, const ShapeInferenceResults& Results) const
+{
+	TArray<uint8> Data;
+	FMemoryWriter Writer(Data);
+	uint32 Magic = FILE_MAGIC;
+	uint32 Version = FILE_VERSION;
+	uint64 StoredKey = Key.Hash;
+	Writer << Magic;
+	Writer << Version;
+	Writer << StoredKey;
+	Serialize(Writer, const_cast<ShapeInferenceResults&>(Results));
+
+#if WITH_EDITOR
+	const FString DDCKey = FString::Printf(TEXT("NNERTVKSHAPE_%016llx"), Key.Hash);
+	GetDerivedDataCacheRef().Put(*DDCKey, Data, TEXTVIEW("NNERuntimeRDGMLExtensionsForVulkan shape inference"));
+#else
+	// Write to a temporary file and then move it into place, so that another thread or process reading the same entry
+	// never sees a partially written file.
+	const FString FilePath = FPaths::Combine(Directory, FString::Printf(TEXT("%016llx.bin"), Key.Hash));
+	const FString TempFilePath = FilePath + TEXT(".") + FGuid::NewGuid().ToString() + TEXT(".tmp");
+	if (!FFileHelper::SaveArrayToFile(Data, *TempFilePath) || !IFileManager::Get().Move(*FilePath, *TempFilePath, true, true))
+	{
+		UE_LOG(LogNNERuntimeRDGMLExtensionsForVulkan, Warning, TEXT("Failed to save shape inference cache entry '%s'."), *FilePath);
+		IFileManager::Get().Delete(*TempFilePath, false, false, true);
+	}
+	else if (MaxDirectorySize > 0)
+	{
+		AddToDirectorySize(Data.Num());
+	}
+#endif
+}
+
+void FNNERuntimeRDGMLExtensionsForVulkanShapeInferenceCache::AddToDirectorySize(int64 FileSize) const
+{
+	FScopeLock Lock(&DirectoryCriticalSection);
+	// Overwriting an existing entry counts it twice, which just means the directory is scanned a bit sooner than it needs to be.
+	if (DirectorySize >= 0)
+	{
+		DirectorySize += FileSize;
+		if (DirectorySize <= MaxDirectorySize)
+		{
+			return;
+		}
+	}
+
+	struct FEntry
+	{
+		FString Path;
+		FDateTime ModificationTime;
+		int64 Size;
+	};
+	TArray<FEntry> Entries;
+	DirectorySize = 0;
+	IFileManager::Get().IterateDirectoryStat(*Directory, [&Entries, this](const TCHAR* Path, const FFileStatData& StatData) {
+		if (!StatData.bIsDirectory && FPaths::GetExtension(Path) == TEXT("bin"))
+		{
+			Entries.Add({ Path, StatData.ModificationTime, StatData.FileSize });
+			DirectorySize += StatData.FileSize;
+		}
+		return true;
+	});
+	if (DirectorySize <= MaxDirectorySize)
+	{
+		return;
+	}
+
+	// Go down to three quarters of the limit, so that once the cache is full the directory isn't scanned again on every store.
+	// Another process might be using the same directory, in which case it might have already deleted some of these.
+	Entries.Sort([](const FEntry& A, const FEntry& B) { return A.ModificationTime < B.ModificationTime; });
+	const int64 TargetSize = MaxDirectorySize / 4 * 3;
+	int32 NumDeleted = 0;
+	for (const FEntry& Entry : Entries)
+	{
+		if (DirectorySize <= TargetSize)
+		{
+			break;
+		}
+		if (IFileManager::Get().Delete(*Entry.Path, false, false, true) || !IFileManager::Get().FileExists(*Entry.Path))
+		{
+			DirectorySize -= Entry.Size;
+			++NumDeleted;
+		}
+	}
+	UE_LOG(LogNNERuntimeRDGMLExtensionsForVulkan, Verbose, TEXT("Deleted %d shape inference cache entries to stay within %lld bytes."), NumDeleted, MaxDirectorySize);
+}
+
+void FNNERuntimeRDGMLExtensionsForVulkanShapeInferenceCache::Serialize(FArchive& Ar, ShapeInferenceResults& Results)
+{
+	// The shapes and code are serialized as raw bytes, as int64_t and uint32_t aren't necessarily the same types as UE's int64 and uint32.
+	auto SerializeArray = [&Ar](auto& Array) {
+		int32 Num = Array.Num();
+		Ar << Num;
+		if (Ar.IsLoading())
+		{
+			if (Num < 0 || (int64)Num * sizeof(Array[0]) > Ar.TotalSize() - Ar.Tell())
+			{
+				Ar.SetError();
+				return;
+			}
+			Array.SetNumUninitialized(Num);
+		}
+		Ar.Serialize(Array.GetData(), Num * sizeof(Array[0]));
+	};
+
+	int32 NumOutputs = Results.OutputShapes.Num();
+	Ar << NumOutputs;
+	if (Ar.IsLoading())
+	{
+		Results.OutputShapes.Empty();
+		for (int32 I = 0; I < NumOutputs && !Ar.IsError(); ++I)
+		{
+			uint32 DescriptorSet = 0;
+			uint32 Binding = 0;
+			Ar << DescriptorSet;
+			Ar << Binding;
+			SerializeArray(Results.OutputShapes.Add({ DescriptorSet, Binding }));
+		}
+	}
+	else
+	{
+		for (TPair<TPair<uint32_t, uint32_t>, TArray<int64_t>>& Output : Results.OutputShapes)
+		{
+			uint32 DescriptorSet = Output.Key.Key;
+			uint32 Binding = Output.Key.Value;
+			Ar << DescriptorSet;
+			Ar << Binding;
+			SerializeArray(Output.Value);
+		}
+	}
+	SerializeArray(Results.NewCode);
+}
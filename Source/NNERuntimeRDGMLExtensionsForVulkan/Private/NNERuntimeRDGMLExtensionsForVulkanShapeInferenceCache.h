@@ -0,0 +1,59 @@
+// SPDX-FileCopyrightText: Copyright 2025 Arm Limited and/or its affiliates <open-source-office@arm.com>
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include "NNERuntimeRDGMLExtensionsForVulkanShapeInference.h"
+#include "Hash/xxhash.h"
+#include "HAL/CriticalSection.h"
+#include "Templates/Atomic.h"
+
+// Persists the results of shape inference, so that launching the application again (or creating the same model with the same
+// shapes again) doesn't need to run SPIRV-Tools. Entries are keyed by a hash of the segment's SPIR-V code, the input shapes and
+// the SPIRV-Tools version, so they never need invalidating - a different model, shape or SPIRV-Tools just uses a different entry.
+// In the editor these are stored in the derived data cache (so are shared with anything else using the same DDC), otherwise
+// they are stored as individual files in the project's saved directory, which is kept within the size limit from the project settings
+// by deleting the least recently used files.
+class FNNERuntimeRDGMLExtensionsForVulkanShapeInferenceCache
+{
+public:
+	static FNNERuntimeRDGMLExtensionsForVulkanShapeInferenceCache& Get();
+
+	// Returns the cached results if there are some, otherwise runs shape inference and caches the results if it succeeded.
+	// This can be called from any thread.
+	ShapeInferenceResults RunShapeInference(TConstArrayView<uint32_t> Code, const FDescriptorSetBindingToShapeMap& InputShapes);
+
+	uint32 GetNumHits() const { return NumHits; }
+	uint32 GetNumMisses() const { return NumMisses; }
+
+private:
+	FNNERuntimeRDGMLExtensionsForVulkanShapeInferenceCache();
+
+	FXxHash64 MakeKey(TConstArrayView<uint32_t> Code, const FDescriptorSetBindingToShapeMap& InputShapes) const;
+	bool Load(const FXxHash64& Key, ShapeInferenceResults& OutResults) const;
+	void Store(const FXxHash64& Key, const ShapeInferenceResults& Results) const;
+
+	// Adds a newly stored file to DirectorySize, and if that takes it over the limit then deletes the least recently used files.
+	// The directory is scanned the first time this is called, and whenever it's over the limit.
+	void AddToDirectorySize(int64 FileSize) const;
+
+	static void Serialize(FArchive& Ar, ShapeInferenceResults& Results);
+
+	// Identifies this data format, so that we don't load anything else by mistake. The version needs bumping whenever the
+	// format or the meaning of the results changes (anything in SPIRV-Tools is covered by its version being in the key).
+	static const uint32 FILE_MAGIC = 0x4E4E4553; // 'NNES'
+	static const uint32 FILE_VERSION = 1;
+
+	// SPIRV-Tools version string, which forms part of the key.
+	FString SPIRVToolsVersion;
+	// Where the files are stored, if not using the DDC.
+	FString Directory;
+	// The size limit for the directory, or 0 for no limit.
+	int64 MaxDirectorySize = 0;
+	// The total size of the files in the directory, or -1 if it hasn't been scanned yet. Protected by DirectoryCriticalSection.
+	mutable int64 DirectorySize = -1;
+	mutable FCriticalSection DirectoryCriticalSection;
+
+	TAtomic<uint32> NumHits = 0;
+	TAtomic<uint32> NumMisses = 0;
+};
@@ -0,0 +1,12 @@
+// SPDX-FileCopyrightText: Copyright 2025 Arm Limited and/or its affiliates <open-source-office@arm.com>
+// SPDX-License-Identifier: MIT
+
+// The plugin's stats group and CSV profiler category, shared by the caches which report their hits and misses.
+
+#pragma once
+
+#include "ProfilingDebugging/CsvProfiler.h"
+#include "Stats/Stats.h"
+
+DECLARE_STATS_GROUP(TEXT("NNERuntimeRDGMLExtensionsForVulkan"), STATGROUP_NNERuntimeRDGMLExtensionsForVulkan, STATCAT_Advanced);
+CSV_DECLARE_CATEGORY_EXTERN(NNERuntimeRDGMLExtensionsForVulkan);
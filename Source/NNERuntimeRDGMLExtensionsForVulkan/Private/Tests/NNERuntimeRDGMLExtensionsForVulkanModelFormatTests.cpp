@@ -0,0 +1,253 @@
+// SPDX-FileCopyrightText: Copyright 2025 Arm Limited and/or its affiliates <open-source-office@arm.com>
+// SPDX-License-Identifier: MIT
+
+#include "NNERuntimeRDGMLExtensionsForVulkanModelFormat.h"
+#include "Math/RandomStream.h"
+#include "Misc/AutomationTest.h"
+#include "Misc/Compression.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+namespace
+{
+	using FModelFormat = FNNERuntimeRDGMLExtensionsForVulkanModelFormat;
+
+	// Builds a payload by hand, to check that Validate catches each kind of inconsistency that Write would never produce.
+	struct FTestPayload
+	{
+		TArray<uint8, TAlignedHeapAllocator<FModelFormat::PAYLOAD_ALIGNMENT>> Data;
+
+		FTestPayload()
+		{
+			Data.AddZeroed(sizeof(FModelFormat::FHeader));
+		}
+
+		// Note this is invalidated by AddTable.
+		FModelFormat::FHeader& Header()
+		{
+			return *reinterpret_cast<FModelFormat::FHeader*>(Data.GetData());
+		}
+
+		template<typename T>
+		FModelFormat::FTableRange AddTable(TConstArrayView<T> Table)
+		{
+			Data.AddZeroed(Align(Data.Num(), FModelFormat::PAYLOAD_ALIGNMENT) - Data.Num());
+			const FModelFormat::FTableRange Range = { (uint64)Data.Num(), (uint64)Table.Num() };
+			Data.Append(reinterpret_cast<const uint8*>(Table.GetData()), Table.Num() * sizeof(T));
+			return Range;
+		}
+
+		TConstArrayView64<uint8> View() const
+		{
+			return TConstArrayView64<uint8>(Data.GetData(), Data.Num());
+		}
+	};
+
+	// A model with one segment, which has one input and one output and uses one constant (stored in the VGF table).
+	FTestPayload MakeValidPayload()
+	{
+		FTestPayload Payload;
+
+		const int64 Dimensions[] = { 1, -1, -1, 3, 1, 4 };
+		const FModelFormat::FTensor Tensors[] = {
+			{ 0, 0, -1, 0, 4, -1 },
+			{ 0, -1, 0, 0, 4, -1 },
+		};
+		const uint32 ModelInputs[] = { 0 };
+		const uint32 ModelOutputs[] = { 1 };
+		const FModelFormat::FBinding Bindings[] = { { 0, 0, 0 }, { 1, 1, 1 } };
+		const FModelFormat::FConstant Constants[] = { { 32, 16, 0, 0, 4, 2, -1, 0 } };
+		// "main\0", followed by the constant data at 32 and one word of code (the SPIR-V magic number) at 48.
+		uint8 Vgf[52] = { 'm', 'a', 'i', 'n', 0 };
+		FMemory::Memcpy(Vgf + 48, "\x03\x02\x23\x07", 4);
+		const FModelFormat::FSegment Segments[] = { { 0, 0, 48, 1, 0, 0, 2, 0, 1, 0 } };
+
+		const FModelFormat::FTableRange TensorsRange = Payload.AddTable<FModelFormat::FTensor>(Tensors);
+		const FModelFormat::FTableRange ModelInputsRange = Payload.AddTable<uint32>(ModelInputs);
+		const FModelFormat::FTableRange ModelOutputsRange = Payload.AddTable<uint32>(ModelOutputs);
+		const FModelFormat::FTableRange SegmentsRange = Payload.AddTable<FModelFormat::FSegment>(Segments);
+		const FModelFormat::FTableRange BindingsRange = Payload.AddTable<FModelFormat::FBinding>(Bindings);
+		const FModelFormat::FTableRange ConstantsRange = Payload.AddTable<FModelFormat::FConstant>(Constants);
+		const FModelFormat::FTableRange DimensionsRange = Payload.AddTable<int64>(Dimensions);
+		const FModelFormat::FTableRange VgfRange = Payload.AddTable<uint8>(Vgf);
+
+		FModelFormat::FHeader& Header = Payload.Header();
+		Header.Tensors = TensorsRange;
+		Header.ModelInputs = ModelInputsRange;
+		Header.ModelOutputs = ModelOutputsRange;
+		Header.Segments = SegmentsRange;
+		Header.Bindings = BindingsRange;
+		Header.Constants = ConstantsRange;
+		Header.Dimensions = DimensionsRange;
+		Header.Vgf = VgfRange;
+		return Payload;
+	}
+
+	template<typename T>
+	T& GetMutableTableEntry(FTestPayload& Payload, const FModelFormat::FTableRange& Range, int32 Idx)
+	{
+		return reinterpret_cast<T*>(Payload.Data.GetData() + Range.Offset)[Idx];
+	}
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FNNERuntimeRDGMLExtensionsForVulkanModelFormatValidateTest, "Plugins.NNERuntimeRDGMLExtensionsForVulkan.ModelFormat.Validate",
+	EAutomationTestFlags_ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FNNERuntimeRDGMLExtensionsForVulkanModelFormatValidateTest::RunTest(const FString& Parameters)
+{
+	{
+		FTestPayload Payload;
+		TestTrue(TEXT("A payload with every table empty is valid"), FModelFormat::Validate(Payload.View()) == &Payload.Header());
+	}
+	{
+		FTestPayload Payload = MakeValidPayload();
+		TestTrue(TEXT("A consistent payload is valid"), FModelFormat::Validate(Payload.View()) == &Payload.Header());
+	}
+
+	// Each of the cases below corrupts a valid payload in one way. The reason that Validate logs is checked too, so that each case
+	// is known to fail for the reason it was meant to rather than for another one.
+	struct FCorruption
+	{
+		const TCHAR* What;
+		const TCHAR* Reason;
+		TFunction<void(FTestPayload& Payload)> Corrupt;
+	};
+	const FCorruption Corruptions[] = {
+		{ TEXT("Table past the end of the payload"), TEXT("table out of bounds"),
+			[](FTestPayload& Payload) { Payload.Header().Dimensions.Num += 1000; } },
+		{ TEXT("Misaligned table"), TEXT("table out of bounds"),
+			[](FTestPayload& Payload) { Payload.Header().Tensors.Offset += 2; } },
+		{ TEXT("Table with too many elements"), TEXT("table out of bounds"),
+			[](FTestPayload& Payload) { Payload.Header().Tensors.Num = MAX_uint64 / sizeof(FModelFormat::FTensor); } },
+		{ TEXT("Tensor dimensions past the end of the dimensions table"), TEXT("tensor"),
+			[](FTestPayload& Payload) { GetMutableTableEntry<FModelFormat::FTensor>(Payload, Payload.Header().Tensors, 1).FirstDimension = 4; } },
+		{ TEXT("Tensor which is an input that doesn't exist"), TEXT("tensor"),
+			[](FTestPayload& Payload) { GetMutableTableEntry<FModelFormat::FTensor>(Payload, Payload.Header().Tensors, 1).ModelInputIdx = 1; } },
+		{ TEXT("Model output which is a tensor that doesn't exist"), TEXT("model input or output"),
+			[](FTestPayload& Payload) { GetMutableTableEntry<uint32>(Payload, Payload.Header().ModelOutputs, 0) = 2; } },
+		{ TEXT("Segment with no code"), TEXT("segment"),
+			[](FTestPayload& Payload) { GetMutableTableEntry<FModelFormat::FSegment>(Payload, Payload.Header().Segments, 0).CodeNumWords = 0; } },
+		{ TEXT("Segment code past the end of the VGF"), TEXT("segment"),
+			[](FTestPayload& Payload) { GetMutableTableEntry<FModelFormat::FSegment>(Payload, Payload.Header().Segments, 0).CodeNumWords = 2; } },
+		{ TEXT("Segment name which isn't null-terminated"), TEXT("segment"),
+			[](FTestPayload& Payload) { GetMutableTableEntry<FModelFormat::FSegment>(Payload, Payload.Header().Segments, 0).NameOffset = 48; } },
+		{ TEXT("Segment bindings past the end of the bindings table"), TEXT("segment"),
+			[](FTestPayload& Payload) { GetMutableTableEntry<FModelFormat::FSegment>(Payload, Payload.Header().Segments, 0).NumBindings = 3; } },
+		{ TEXT("Binding to a tensor that doesn't exist"), TEXT("segment binding"),
+			[](FTestPayload& Payload) { GetMutableTableEntry<FModelFormat::FBinding>(Payload, Payload.Header().Bindings, 1).TensorId = 2; } },
+		{ TEXT("Constant data past the end of the VGF"), TEXT("constant"),
+			[](FTestPayload& Payload) { GetMutableTableEntry<FModelFormat::FConstant>(Payload, Payload.Header().Constants, 0).DataSize = 100; } },
+		{ TEXT("Constant shared through a tensor which isn't a shared constant"), TEXT("constant"),
+			[](FTestPayload& Payload) { GetMutableTableEntry<FModelFormat::FConstant>(Payload, Payload.Header().Constants, 0).SharedTensorId = 0; } },
+	};
+	TMap<FString, int32> NumExpectedErrors;
+	for (const FCorruption& Corruption : Corruptions)
+	{
+		++NumExpectedErrors.FindOrAdd(FString::Printf(TEXT("Invalid model data (%s)"), Corruption.Reason));
+	}
+	for (const TPair<FString, int32>& ExpectedError : NumExpectedErrors)
+	{
+		AddExpectedError(ExpectedError.Key, EAutomationExpectedErrorFlags::Contains, ExpectedError.Value, false);
+	}
+	for (const FCorruption& Corruption : Corruptions)
+	{
+		FTestPayload Payload = MakeValidPayload();
+		Corruption.Corrupt(Payload);
+		TestNull(Corruption.What, FModelFormat::Validate(Payload.View()));
+	}
+
+	{
+		FTestPayload Payload = MakeValidPayload();
+		AddExpectedError(TEXT("Invalid model data (missing or misaligned header)"), EAutomationExpectedErrorFlags::Contains, 2, false);
+		TestNull(TEXT("Payload smaller than the header"), FModelFormat::Validate(Payload.View().Left(sizeof(FModelFormat::FHeader) - 1)));
+		TestNull(TEXT("Misaligned payload"), FModelFormat::Validate(Payload.View().RightChop(4)));
+	}
+
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FNNERuntimeRDGMLExtensionsForVulkanModelFormatConstantChunksTest, "Plugins.NNERuntimeRDGMLExtensionsForVulkan.ModelFormat.ConstantChunks",
+	EAutomationTestFlags_ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FNNERuntimeRDGMLExtensionsForVulkanModelFormatConstantChunksTest::RunTest(const FString& Parameters)
+{
+	// Some data that compresses well, for the first chunk, and some that doesn't, which is stored as it is in the second chunk.
+	TArray<uint8> ConstantData;
+	for (int32 Idx = 0; Idx < 4096; ++Idx)
+	{
+		ConstantData.Add((uint8)(Idx / 64));
+	}
+	FRandomStream Random(1234);
+	for (int32 Idx = 0; Idx < 256; ++Idx)
+	{
+		ConstantData.Add((uint8)Random.RandHelper(256));
+	}
+
+	TArray<uint8> CompressedConstants;
+	int32 CompressedSize = FCompression::CompressMemoryBound(NAME_Oodle, 4096);
+	CompressedConstants.SetNumUninitialized(CompressedSize);
+	if (!TestTrue(TEXT("Compressing the first chunk"), FCompression::CompressMemory(NAME_Oodle, CompressedConstants.GetData(), CompressedSize, ConstantData.GetData(), 4096)) ||
+		!TestTrue(TEXT("The first chunk is smaller once compressed"), CompressedSize < 4096))
+	{
+		return false;
+	}
+	CompressedConstants.SetNum(CompressedSize);
+	CompressedConstants.Append(ConstantData.GetData() + 4096, 256);
+
+	auto MakePayload = [&CompressedConstants, CompressedSize](TConstArrayView<FModelFormat::FConstantChunk> Chunks, uint64 ConstantDataSize) {
+		FTestPayload Payload;
+		const int64 Dimensions[] = { (int64)ConstantDataSize };
+		const FModelFormat::FConstant Constants[] = { { 0, ConstantDataSize, 0, 0, 0, 1, -1, 0 } };
+		const FModelFormat::FTableRange ChunksRange = Payload.AddTable(Chunks);
+		const FModelFormat::FTableRange CompressedConstantsRange = Payload.AddTable<uint8>(CompressedConstants);
+		const FModelFormat::FTableRange ConstantsRange = Payload.AddTable<FModelFormat::FConstant>(Constants);
+		const FModelFormat::FTableRange DimensionsRange = Payload.AddTable<int64>(Dimensions);
+		FModelFormat::FHeader& Header = Payload.Header();
+		Header.ConstantChunks = ChunksRange;
+		Header.CompressedConstants = CompressedConstantsRange;
+		Header.Constants = ConstantsRange;
+		Header.Dimensions = DimensionsRange;
+		return Payload;
+	};
+
+	const FModelFormat::FConstantChunk Chunks[] = {
+		{ 0, (uint64)CompressedSize, 0, 4096 },
+		{ (uint64)CompressedSize, 256, 4096, 256 },
+	};
+	{
+		const FTestPayload Payload = MakePayload(Chunks, ConstantData.Num());
+		const FModelFormat::FHeader* Header = FModelFormat::Validate(Payload.View());
+		if (!TestNotNull(TEXT("Payload with compressed constants"), Header))
+		{
+			return false;
+		}
+		TestEqual(TEXT("Decompressed constants size"), (int64)FModelFormat::GetDecompressedConstantsSize(Header), (int64)ConstantData.Num());
+
+		TArray<uint8> DecompressedConstants;
+		DecompressedConstants.SetNumZeroed(ConstantData.Num());
+		TestTrue(TEXT("Decompressing the compressed chunk"), FModelFormat::DecompressConstantChunk(Header, 0, DecompressedConstants.GetData()));
+		TestTrue(TEXT("Decompressing the stored chunk"), FModelFormat::DecompressConstantChunk(Header, 1, DecompressedConstants.GetData()));
+		TestTrue(TEXT("Decompressed constants"), DecompressedConstants == ConstantData);
+	}
+
+	// The chunks must tile the decompressed constants exactly, as DecompressConstantChunk writes each one in place.
+	FModelFormat::FConstantChunk BadChunks[UE_ARRAY_COUNT(Chunks)];
+	auto TestBadChunks = [&](const TCHAR* What, uint64 ConstantDataSize, TFunctionRef<void()> Corrupt) {
+		FMemory::Memcpy(BadChunks, Chunks, sizeof(Chunks));
+		Corrupt();
+		TestNull(What, FModelFormat::Validate(MakePayload(BadChunks, ConstantDataSize).View()));
+	};
+	AddExpectedError(TEXT("Invalid model data (constant chunk)"), EAutomationExpectedErrorFlags::Contains, 5, false);
+	AddExpectedError(TEXT("Invalid model data (constant)"), EAutomationExpectedErrorFlags::Contains, 1, false);
+	TestBadChunks(TEXT("Gap between chunks"), ConstantData.Num() + 1, [&] { BadChunks[1].UncompressedOffset += 1; });
+	TestBadChunks(TEXT("Overlapping chunks"), ConstantData.Num() - 1, [&] { BadChunks[1].UncompressedOffset -= 1; });
+	TestBadChunks(TEXT("Empty chunk"), 4096, [&] { BadChunks[1].UncompressedSize = 0; });
+	TestBadChunks(TEXT("Chunk bigger than the chunk size"), FModelFormat::CONSTANT_CHUNK_SIZE + 256,
+		[&] { BadChunks[0].UncompressedSize = FModelFormat::CONSTANT_CHUNK_SIZE + 1; BadChunks[1].UncompressedOffset = BadChunks[0].UncompressedSize; });
+	TestBadChunks(TEXT("Chunk past the end of the compressed constants"), ConstantData.Num(), [&] { BadChunks[1].CompressedSize += 1; });
+	TestBadChunks(TEXT("Constant past the end of the decompressed constants"), ConstantData.Num() + 1, [] {});
+
+	return true;
+}
+
+#endif // WITH_DEV_AUTOMATION_TESTS
@@ -0,0 +1,242 @@
+// SPDX-FileCopyrightText: Copyright 2025 Arm Limited and/or its affiliates <open-source-office@arm.com>
+// SPDX-License-Identifier: MIT
+
+#include "NNERuntimeRDGMLExtensionsForVulkanModel.h"
+#include "Algo/Count.h"
+#include "Async/ParallelFor.h"
+#include "Misc/AutomationTest.h"
+#include "Misc/ScopeLock.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+// Gives the tests below access to the parts of the unshaped and shaped models that they check. None of these need a Vulkan device,
+// as the models are made directly rather than from model data, so they have no segments.
+struct FNNERuntimeRDGMLExtensionsForVulkanModelTestAccess
+{
+	using FModelUnshaped = FNNERuntimeRDGMLExtensionsForVulkanModelUnshaped;
+	using FModelShaped = FNNERuntimeRDGMLExtensionsForVulkanModelShaped;
+
+	static TSharedPtr<FModelUnshaped> MakeModel(int32 MaxRecentlyUsedShapedModels, uint64 RecentlyUsedShapedModelsMemoryBudget)
+	{
+		TSharedPtr<FModelUnshaped> Model(new FModelUnshaped());
+		Model->MaxRecentlyUsedShapedModels = MaxRecentlyUsedShapedModels;
+		Model->RecentlyUsedShapedModelsMemoryBudget = RecentlyUsedShapedModelsMemoryBudget;
+		return Model;
+	}
+
+	static TSharedPtr<FModelShaped> MakeShapedModel(uint64 EstimatedMemoryBytes)
+	{
+		TSharedPtr<FModelShaped> ShapedModel = MakeShared<FModelShaped>();
+		ShapedModel->EstimatedMemoryBytes = EstimatedMemoryBytes;
+		return ShapedModel;
+	}
+
+	// Does what CreateShapedModel does once it has made the shaped model.
+	static void AddShapedModel(FModelUnshaped& Model, const TArray<UE::NNE::FTensorShape>& Key, const TSharedPtr<FModelShaped>& ShapedModel)
+	{
+		FScopeLock Lock(&Model.ShapedModelsCriticalSection);
+		Model.ShapedModels.Add(Key, ShapedModel);
+		Model.MarkShapedModelRecentlyUsed(ShapedModel);
+	}
+
+	static void MarkShapedModelRecentlyUsed(FModelUnshaped& Model, const TSharedPtr<FModelShaped>& ShapedModel)
+	{
+		FScopeLock Lock(&Model.ShapedModelsCriticalSection);
+		Model.MarkShapedModelRecentlyUsed(ShapedModel);
+	}
+
+	static TArray<TSharedPtr<FModelShaped>> GetRecentlyUsedShapedModels(FModelUnshaped& Model)
+	{
+		FScopeLock Lock(&Model.ShapedModelsCriticalSection);
+		return Model.RecentlyUsedShapedModels;
+	}
+
+	static TFuture<TSharedPtr<FModelShaped>> FindOrBeginCreatingShapedModel(FModelUnshaped& Model, const TArray<UE::NNE::FTensorShape>& Key, bool& bOutShouldCreate)
+	{
+		return Model.FindOrBeginCreatingShapedModel(Key, bOutShouldCreate);
+	}
+
+	static void PublishShapedModel(FModelUnshaped& Model, const TArray<UE::NNE::FTensorShape>& Key, const TSharedPtr<FModelShaped>& ShapedModel)
+	{
+		Model.PublishShapedModel(Key, ShapedModel);
+	}
+
+	static bool IsPending(FModelUnshaped& Model, const TArray<UE::NNE::FTensorShape>& Key)
+	{
+		FScopeLock Lock(&Model.ShapedModelsCriticalSection);
+		return Model.PendingShapedModels.Contains(Key);
+	}
+
+	static void SetFrozen(FModelUnshaped& Model)
+	{
+		FScopeLock Lock(&Model.ShapedModelsCriticalSection);
+		Model.bFrozen = true;
+	}
+};
+
+namespace
+{
+	using FTestAccess = FNNERuntimeRDGMLExtensionsForVulkanModelTestAccess;
+
+	TArray<UE::NNE::FTensorShape> MakeKey(uint32 Dim)
+	{
+		return { UE::NNE::FTensorShape::Make(TArray<uint32>{ 1, Dim, Dim, 3 }) };
+	}
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FNNERuntimeRDGMLExtensionsForVulkanRecentlyUsedShapedModelsTest, "Plugins.NNERuntimeRDGMLExtensionsForVulkan.Model.RecentlyUsedShapedModels",
+	EAutomationTestFlags_ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FNNERuntimeRDGMLExtensionsForVulkanRecentlyUsedShapedModelsTest::RunTest(const FString& Parameters)
+{
+	using FModelShaped = FTestAccess::FModelShaped;
+
+	{
+		const TSharedPtr<FTestAccess::FModelUnshaped> Model = FTestAccess::MakeModel(3, 1000);
+		const TSharedPtr<FModelShaped> A = FTestAccess::MakeShapedModel(100);
+		const TSharedPtr<FModelShaped> B = FTestAccess::MakeShapedModel(100);
+		const TSharedPtr<FModelShaped> C = FTestAccess::MakeShapedModel(100);
+		const TSharedPtr<FModelShaped> D = FTestAccess::MakeShapedModel(100);
+		const TSharedPtr<FModelShaped> E = FTestAccess::MakeShapedModel(900);
+		const TSharedPtr<FModelShaped> F = FTestAccess::MakeShapedModel(5000);
+
+		for (const TSharedPtr<FModelShaped>& ShapedModel : { A, B, C })
+		{
+			FTestAccess::MarkShapedModelRecentlyUsed(*Model, ShapedModel);
+		}
+		TestTrue(TEXT("Within both limits, nothing is evicted"), FTestAccess::GetRecentlyUsedShapedModels(*Model) == TArray<TSharedPtr<FModelShaped>>{ A, B, C });
+		TestEqual(TEXT("Evictions within both limits"), (int32)Model->GetNumShapedModelEvictions(), 0);
+
+		FTestAccess::MarkShapedModelRecentlyUsed(*Model, D);
+		TestTrue(TEXT("Over the count limit, the least recently used is evicted"), FTestAccess::GetRecentlyUsedShapedModels(*Model) == TArray<TSharedPtr<FModelShaped>>{ B, C, D });
+
+		FTestAccess::MarkShapedModelRecentlyUsed(*Model, B);
+		TestTrue(TEXT("Using a retained model moves it to the back"), FTestAccess::GetRecentlyUsedShapedModels(*Model) == TArray<TSharedPtr<FModelShaped>>{ C, D, B });
+		TestEqual(TEXT("Evictions after reusing a retained model"), (int32)Model->GetNumShapedModelEvictions(), 1);
+
+		FTestAccess::MarkShapedModelRecentlyUsed(*Model, E);
+		TestTrue(TEXT("Over the memory budget, the least recently used are evicted until it fits"), FTestAccess::GetRecentlyUsedShapedModels(*Model) ==
+			TArray<TSharedPtr<FModelShaped>>{ B, E });
+		TestEqual(TEXT("Evictions after going over the memory budget"), (int32)Model->GetNumShapedModelEvictions(), 3);
+
+		FTestAccess::MarkShapedModelRecentlyUsed(*Model, F);
+		TestTrue(TEXT("The most recently used is kept even if it's over the memory budget on its own"), FTestAccess::GetRecentlyUsedShapedModels(*Model) ==
+			TArray<TSharedPtr<FModelShaped>>{ F });
+		TestEqual(TEXT("Evictions after a model over the memory budget on its own"), (int32)Model->GetNumShapedModelEvictions(), 5);
+	}
+
+	{
+		const TSharedPtr<FTestAccess::FModelUnshaped> Model = FTestAccess::MakeModel(0, 1000);
+		FTestAccess::MarkShapedModelRecentlyUsed(*Model, FTestAccess::MakeShapedModel(100));
+		TestTrue(TEXT("A count limit of zero retains nothing"), FTestAccess::GetRecentlyUsedShapedModels(*Model).IsEmpty());
+	}
+
+	{
+		// Evicted shaped models are only freed once nothing else uses them, and are then no longer found in the cache.
+		const TSharedPtr<FTestAccess::FModelUnshaped> Model = FTestAccess::MakeModel(1, 1000);
+		TSharedPtr<FModelShaped> A = FTestAccess::MakeShapedModel(100);
+		const TSharedPtr<FModelShaped> B = FTestAccess::MakeShapedModel(100);
+		FTestAccess::AddShapedModel(*Model, MakeKey(8), A);
+		FTestAccess::AddShapedModel(*Model, MakeKey(16), B);
+
+		bool bShouldCreate = false;
+		TFuture<TSharedPtr<FModelShaped>> Found = FTestAccess::FindOrBeginCreatingShapedModel(*Model, MakeKey(8), bShouldCreate);
+		TestFalse(TEXT("An evicted model that is still in use is found in the cache"), bShouldCreate);
+		TestTrue(TEXT("The evicted model that is still in use"), Found.IsValid() && Found.Get() == A);
+
+		// Finding it made it the most recently used, so use the other one again to evict it before dropping the last reference.
+		FTestAccess::FindOrBeginCreatingShapedModel(*Model, MakeKey(16), bShouldCreate);
+		TestFalse(TEXT("Another evicted model that is still in use is found in the cache"), bShouldCreate);
+		Found = TFuture<TSharedPtr<FModelShaped>>();
+		A.Reset();
+		FTestAccess::FindOrBeginCreatingShapedModel(*Model, MakeKey(8), bShouldCreate);
+		TestTrue(TEXT("An evicted model that is no longer in use needs creating again"), bShouldCreate);
+		FTestAccess::PublishShapedModel(*Model, MakeKey(8), nullptr);
+	}
+
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FNNERuntimeRDGMLExtensionsForVulkanSingleFlightShapedModelsTest, "Plugins.NNERuntimeRDGMLExtensionsForVulkan.Model.SingleFlightShapedModels",
+	EAutomationTestFlags_ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FNNERuntimeRDGMLExtensionsForVulkanSingleFlightShapedModelsTest::RunTest(const FString& Parameters)
+{
+	using FModelShaped = FTestAccess::FModelShaped;
+
+	const TSharedPtr<FTestAccess::FModelUnshaped> Model = FTestAccess::MakeModel(8, MAX_uint64);
+	const TArray<UE::NNE::FTensorShape> Key = MakeKey(8);
+
+	// Lots of threads asking for the same new shapes at once: only one of them creates the shaped model, and the rest wait for it.
+	const int32 NumCallers = 64;
+	TArray<TFuture<TSharedPtr<FModelShaped>>> Futures;
+	Futures.SetNum(NumCallers);
+	TArray<bool> ShouldCreate;
+	ShouldCreate.Init(false, NumCallers);
+	ParallelFor(NumCallers, [&](int32 CallerIdx) {
+		bool bShouldCreate = false;
+		Futures[CallerIdx] = FTestAccess::FindOrBeginCreatingShapedModel(*Model, Key, bShouldCreate);
+		ShouldCreate[CallerIdx] = bShouldCreate;
+	});
+
+	const int32 CreatorIdx = ShouldCreate.Find(true);
+	TestEqual(TEXT("Number of callers told to create the shaped model"), (int32)Algo::Count(ShouldCreate, true), 1);
+	if (CreatorIdx == INDEX_NONE)
+	{
+		return false;
+	}
+	for (int32 CallerIdx = 0; CallerIdx < NumCallers; ++CallerIdx)
+	{
+		if (CallerIdx != CreatorIdx && (!Futures[CallerIdx].IsValid() || Futures[CallerIdx].IsReady()))
+		{
+			AddError(FString::Printf(TEXT("Caller %d isn't waiting for the shaped model to be created."), CallerIdx));
+		}
+	}
+
+	// Asking again whilst it's being created also waits, rather than creating it again.
+	bool bShouldCreate = true;
+	TFuture<TSharedPtr<FModelShaped>> LateFuture = FTestAccess::FindOrBeginCreatingShapedModel(*Model, Key, bShouldCreate);
+	TestFalse(TEXT("Asking whilst it's being created"), bShouldCreate);
+
+	const TSharedPtr<FModelShaped> ShapedModel = FTestAccess::MakeShapedModel(100);
+	FTestAccess::AddShapedModel(*Model, Key, ShapedModel);
+	FTestAccess::PublishShapedModel(*Model, Key, ShapedModel);
+
+	TestFalse(TEXT("Still pending once published"), FTestAccess::IsPending(*Model, Key));
+	for (int32 CallerIdx = 0; CallerIdx < NumCallers; ++CallerIdx)
+	{
+		if (CallerIdx != CreatorIdx && (!Futures[CallerIdx].IsReady() || Futures[CallerIdx].Get() != ShapedModel))
+		{
+			AddError(FString::Printf(TEXT("Caller %d wasn't given the created shaped model."), CallerIdx));
+		}
+	}
+	TestTrue(TEXT("The late caller was given the created shaped model"), LateFuture.IsReady() && LateFuture.Get() == ShapedModel);
+
+	// From now on it's found in the cache.
+	TFuture<TSharedPtr<FModelShaped>> CachedFuture = FTestAccess::FindOrBeginCreatingShapedModel(*Model, Key, bShouldCreate);
+	TestFalse(TEXT("Asking once it has been created"), bShouldCreate);
+	TestTrue(TEXT("The cached shaped model"), CachedFuture.IsReady() && CachedFuture.Get() == ShapedModel);
+
+	// If creation fails, the waiters are given nullptr and the next caller tries again.
+	const TArray<UE::NNE::FTensorShape> FailingKey = MakeKey(16);
+	FTestAccess::FindOrBeginCreatingShapedModel(*Model, FailingKey, bShouldCreate);
+	TestTrue(TEXT("Asking for other new shapes"), bShouldCreate);
+	TFuture<TSharedPtr<FModelShaped>> FailedFuture = FTestAccess::FindOrBeginCreatingShapedModel(*Model, FailingKey, bShouldCreate);
+	FTestAccess::PublishShapedModel(*Model, FailingKey, nullptr);
+	TestTrue(TEXT("A waiter is given nullptr if creation fails"), FailedFuture.IsReady() && !FailedFuture.Get().IsValid());
+	FTestAccess::FindOrBeginCreatingShapedModel(*Model, FailingKey, bShouldCreate);
+	TestTrue(TEXT("Asking again after creation failed"), bShouldCreate);
+	FTestAccess::PublishShapedModel(*Model, FailingKey, nullptr);
+
+	// Once frozen, shapes that are already cached are still found but new ones fail straight away.
+	FTestAccess::SetFrozen(*Model);
+	CachedFuture = FTestAccess::FindOrBeginCreatingShapedModel(*Model, Key, bShouldCreate);
+	TestTrue(TEXT("The cached shaped model once frozen"), !bShouldCreate && CachedFuture.IsReady() && CachedFuture.Get() == ShapedModel);
+	AddExpectedError(TEXT("model that has been frozen"), EAutomationExpectedErrorFlags::Contains, 1);
+	TFuture<TSharedPtr<FModelShaped>> FrozenFuture = FTestAccess::FindOrBeginCreatingShapedModel(*Model, FailingKey, bShouldCreate);
+	TestTrue(TEXT("New shapes once frozen"), !bShouldCreate && FrozenFuture.IsReady() && !FrozenFuture.Get().IsValid());
+
+	return true;
+}
+
+#endif // WITH_DEV_AUTOMATION_TESTS
@@ -0,0 +1,397 @@
+// SPDX-FileCopyrightText: Copyright 2025 Arm Limited and/or its affiliates <open-source-office@arm.com>
+// SPDX-License-Identifier: MIT
+
+#include "NNERuntimeRDGMLExtensionsForVulkan.h"
+#include "NNERuntimeRDGMLExtensionsForVulkanModel.h"
+#include "NNERuntimeRDGMLExtensionsForVulkanModelFormat.h"
+#include "NNE.h"
+#include "Algo/Compare.h"
+#include "Algo/Transform.h"
+#include "HAL/FileManager.h"
+#include "Interfaces/IPluginManager.h"
+#include "Misc/AutomationTest.h"
+#include "Misc/CommandLine.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "Serialization/MemoryWriter.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+// These tests run over every VGF in the plugin's Tests/Vgf directory, or the directory given by
+// -NNERuntimeRDGMLExtensionsForVulkanTestVgfDir=<dir> on the command line. There is one test per VGF, or if there are no VGFs then a single
+// test which fails, so that the model data code doesn't silently go untested.
+namespace
+{
+	using FModelFormat = FNNERuntimeRDGMLExtensionsForVulkanModelFormat;
+
+	FString GetTestVgfDir()
+	{
+		FString Dir;
+		if (FParse::Value(FCommandLine::Get(), TEXT("NNERuntimeRDGMLExtensionsForVulkanTestVgfDir="), Dir))
+		{
+			return Dir;
+		}
+		const TSharedPtr<IPlugin> Plugin = IPluginManager::Get().FindPlugin(TEXT("NNERuntimeRDGMLExtensionsForVulkan"));
+		return Plugin.IsValid() ? FPaths::Combine(Plugin->GetBaseDir(), TEXT("Tests"), TEXT("Vgf")) : FString();
+	}
+
+	void GetTestVgfs(TArray<FString>& OutBeautifiedNames, TArray<FString>& OutTestCommands)
+	{
+		const FString Dir = GetTestVgfDir();
+		TArray<FString> FileNames;
+		if (!Dir.IsEmpty())
+		{
+			IFileManager::Get().FindFiles(FileNames, *FPaths::Combine(Dir, TEXT("*.vgf")), true, false);
+		}
+		for (const FString& FileName : FileNames)
+		{
+			OutBeautifiedNames.Add(FPaths::GetBaseFilename(FileName));
+			OutTestCommands.Add(FPaths::Combine(Dir, FileName));
+		}
+		if (FileNames.IsEmpty())
+		{
+			OutBeautifiedNames.Add(TEXT("NoVgfs"));
+			OutTestCommands.Add(FString());
+		}
+	}
+
+	// Loads the VGF for one of the tests from GetTestVgfs, failing the test if there isn't one.
+	bool LoadTestVgf(FAutomationTestBase& Test, const FString& Parameters, TArray64<uint8>& OutVgf)
+	{
+		if (Parameters.IsEmpty())
+		{
+			Test.AddError(FString::Printf(TEXT("No VGFs found in '%s'. Add some there, or give another directory with ")
+				TEXT("-NNERuntimeRDGMLExtensionsForVulkanTestVgfDir=<directory>."), *GetTestVgfDir()));
+			return false;
+		}
+		if (!FFileHelper::LoadFileToArray(OutVgf, *Parameters))
+		{
+			Test.AddError(FString::Printf(TEXT("Failed to load %s."), *Parameters));
+			return false;
+		}
+		return true;
+	}
+
+	// Makes the model data for a VGF in the same way as UNNERuntimeRDGMLExtensionsForVulkan::CreateModelData, but with the given
+	// options rather than the project settings. Returns nullptr (having logged an error) if Write fails.
+	TSharedPtr<UE::NNE::FSharedModelData> MakeModelData(FAutomationTestBase& Test, TConstArrayView64<uint8> Vgf, bool bCompressConstants,
+		uint64 SharedConstantMinBytes, bool bOptimizeCode)
+	{
+		TArray64<uint8> ModelData;
+		FMemoryWriter64 Writer(ModelData);
+		Writer << UNNERuntimeRDGMLExtensionsForVulkan::ModelDataGUID;
+		Writer << UNNERuntimeRDGMLExtensionsForVulkan::ModelDataVersion;
+		ModelData.AddZeroed(UNNERuntimeRDGMLExtensionsForVulkan::ModelDataPayloadOffset - ModelData.Num());
+
+		if (!FModelFormat::Write(Vgf, {}, {}, bCompressConstants, SharedConstantMinBytes, bOptimizeCode, ModelData))
+		{
+			return nullptr;
+		}
+		// Write only grows the model data once, to exactly the size it needs (which the allocator might then round up).
+		Test.TestEqual(TEXT("Model data capacity"), ModelData.Max(), (int64)FMemory::QuantizeSize(ModelData.Num()));
+
+		return MakeShared<UE::NNE::FSharedModelData>(MakeSharedBufferFromArray(MoveTemp(ModelData)), FModelFormat::PAYLOAD_ALIGNMENT);
+	}
+
+	// The validated payload of some model data, with its constants decompressed if they were compressed.
+	struct FPayload
+	{
+		TSharedPtr<UE::NNE::FSharedModelData> ModelData;
+		const FModelFormat::FHeader* Header = nullptr;
+		TArray64<uint8> DecompressedConstants;
+
+		bool Read(FAutomationTestBase& Test, const TSharedPtr<UE::NNE::FSharedModelData>& InModelData)
+		{
+			if (!Test.TestTrue(TEXT("Writing the model data"), InModelData.IsValid()))
+			{
+				return false;
+			}
+			ModelData = InModelData;
+			Header = FModelFormat::Validate(ModelData->GetView().RightChop(UNNERuntimeRDGMLExtensionsForVulkan::ModelDataPayloadOffset));
+			if (!Test.TestNotNull(TEXT("Validated payload"), Header))
+			{
+				return false;
+			}
+			DecompressedConstants.SetNumUninitialized(FModelFormat::GetDecompressedConstantsSize(Header));
+			for (int32 ChunkIdx = 0; ChunkIdx < (int32)Header->ConstantChunks.Num; ++ChunkIdx)
+			{
+				if (!FModelFormat::DecompressConstantChunk(Header, ChunkIdx, DecompressedConstants.GetData()))
+				{
+					Test.AddError(FString::Printf(TEXT("Failed to decompress constant chunk %d."), ChunkIdx));
+					return false;
+				}
+			}
+			return true;
+		}
+
+		template<typename T>
+		TConstArrayView<T> GetTable(const FModelFormat::FTableRange& Range) const
+		{
+			return FModelFormat::GetTable<T>(Header, Range);
+		}
+
+		TConstArrayView64<uint8> GetConstantData(const FModelFormat::FConstant& Constant) const
+		{
+			const TConstArrayView64<uint8> ConstantData = Header->ConstantChunks.Num > 0 ? TConstArrayView64<uint8>(DecompressedConstants) : FModelFormat::GetVgf(Header);
+			return ConstantData.Slice((int64)Constant.DataOffset, (int64)Constant.DataSize);
+		}
+
+		const char* GetVgfString(uint64 Offset) const
+		{
+			return reinterpret_cast<const char*>(FModelFormat::GetVgf(Header).GetData() + Offset);
+		}
+
+		TConstArrayView<int64> GetDimensions(uint32 FirstDimension, uint32 NumDimensions) const
+		{
+			return GetTable<int64>(Header->Dimensions).Slice(FirstDimension, NumDimensions);
+		}
+	};
+
+	// Parses the optional file of input shapes which sits next to a VGF (with a .shapes extension rather than .vgf). This has the same
+	// format as UE::NNERuntimeRDGMLExtensionsForVulkan::PreShapedInputShapesFileName: one set of input shapes per line, each input's shape
+	// separated by ';' and each dimension by ','.
+	bool LoadInputShapeSets(const FString& VgfFileName, TArray<TArray<UE::NNE::FTensorShape>>& OutInputShapeSets)
+	{
+		FString Text;
+		if (!FFileHelper::LoadFileToString(Text, *FPaths::ChangeExtension(VgfFileName, TEXT("shapes"))))
+		{
+			return false;
+		}
+		TArray<FString> Lines;
+		Text.ParseIntoArrayLines(Lines);
+		for (const FString& Line : Lines)
+		{
+			TArray<FString> Shapes;
+			Line.ParseIntoArray(Shapes, TEXT(";"), false);
+			TArray<UE::NNE::FTensorShape>& InputShapes = OutInputShapeSets.AddDefaulted_GetRef();
+			for (const FString& Shape : Shapes)
+			{
+				TArray<FString> Dims;
+				Shape.ParseIntoArray(Dims, TEXT(","));
+				TArray<uint32> Dimensions;
+				Algo::Transform(Dims, Dimensions, [](const FString& Dim) { return (uint32)FCString::Atoi(*Dim); });
+				InputShapes.Add(UE::NNE::FTensorShape::Make(Dimensions));
+			}
+		}
+		return true;
+	}
+
+	bool IsInferenceSupported()
+	{
+		TWeakInterfacePtr<INNERuntimeRDG> Runtime = UE::NNE::GetRuntime<INNERuntimeRDG>(TEXT("NNERuntimeRDGMLExtensionsForVulkan"));
+		const UNNERuntimeRDGMLExtensionsForVulkan* RuntimeObject = Runtime.IsValid() ? Cast<UNNERuntimeRDGMLExtensionsForVulkan>(Runtime.GetObject()) : nullptr;
+		return RuntimeObject != nullptr && RuntimeObject->SupportsInference;
+	}
+}
+
+IMPLEMENT_COMPLEX_AUTOMATION_TEST(FNNERuntimeRDGMLExtensionsForVulkanModelDataRoundTripTest, "Plugins.NNERuntimeRDGMLExtensionsForVulkan.Vgf.ModelDataRoundTrip",
+	EAutomationTestFlags_ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+void FNNERuntimeRDGMLExtensionsForVulkanModelDataRoundTripTest::GetTests(TArray<FString>& OutBeautifiedNames, TArray<FString>& OutTestCommands) const
+{
+	GetTestVgfs(OutBeautifiedNames, OutTestCommands);
+}
+
+// Writes the model data with each combination of the options which change how it's stored, and checks that they all describe the same
+// model as the plain model data, which stores the VGF as it is.
+bool FNNERuntimeRDGMLExtensionsForVulkanModelDataRoundTripTest::RunTest(const FString& Parameters)
+{
+	TArray64<uint8> Vgf;
+	if (!LoadTestVgf(*this, Parameters, Vgf))
+	{
+		return false;
+	}
+
+	FPayload Plain;
+	if (!Plain.Read(*this, MakeModelData(*this, Vgf, false, 0, false)))
+	{
+		return false;
+	}
+	TestEqual(TEXT("Constant chunks in the plain model data"), (int64)Plain.Header->ConstantChunks.Num, (int64)0);
+	if (Plain.Header->RewrittenCode.Num == 0)
+	{
+		TestTrue(TEXT("The plain model data stores the VGF as it is"), Algo::Compare(FModelFormat::GetVgf(Plain.Header), Vgf));
+	}
+
+	struct FVariant
+	{
+		const TCHAR* Name;
+		bool bCompressConstants;
+		uint64 SharedConstantMinBytes;
+		bool bOptimizeCode;
+	};
+	const FVariant Variants[] = {
+		{ TEXT("Compressed"), true, 0, false },
+		{ TEXT("Shared constants"), false, 1024, false },
+		{ TEXT("Optimized"), false, 0, true },
+		{ TEXT("Compressed, shared constants, optimized"), true, 1024, true },
+	};
+	for (const FVariant& Variant : Variants)
+	{
+		const FString Prefix = FString(Variant.Name) + TEXT(": ");
+		auto What = [&Prefix](const TCHAR* Check) { return Prefix + Check; };
+
+		FPayload Payload;
+		if (!Payload.Read(*this, MakeModelData(*this, Vgf, Variant.bCompressConstants, Variant.SharedConstantMinBytes, Variant.bOptimizeCode)))
+		{
+			continue;
+		}
+
+		TestTrue(*What(TEXT("Model inputs")), Algo::Compare(Payload.GetTable<uint32>(Payload.Header->ModelInputs), Plain.GetTable<uint32>(Plain.Header->ModelInputs)));
+		TestTrue(*What(TEXT("Model outputs")), Algo::Compare(Payload.GetTable<uint32>(Payload.Header->ModelOutputs), Plain.GetTable<uint32>(Plain.Header->ModelOutputs)));
+
+		// Shared constants are added as extra tensors after the others.
+		const TConstArrayView<FModelFormat::FTensor> PlainTensors = Plain.GetTable<FModelFormat::FTensor>(Plain.Header->Tensors);
+		const TConstArrayView<FModelFormat::FTensor> Tensors = Payload.GetTable<FModelFormat::FTensor>(Payload.Header->Tensors);
+		if (!TestTrue(*What(TEXT("Number of tensors")), Tensors.Num() >= PlainTensors.Num()))
+		{
+			continue;
+		}
+		for (int32 TensorId = 0; TensorId < Tensors.Num(); ++TensorId)
+		{
+			const FModelFormat::FTensor& Tensor = Tensors[TensorId];
+			if (TensorId >= PlainTensors.Num())
+			{
+				TestTrue(*What(TEXT("Extra tensors are shared constants")), Tensor.SharedConstantIdx != -1);
+				continue;
+			}
+			const FModelFormat::FTensor& PlainTensor = PlainTensors[TensorId];
+			if (Tensor.Format != PlainTensor.Format || Tensor.ModelInputIdx != PlainTensor.ModelInputIdx || Tensor.ModelOutputIdx != PlainTensor.ModelOutputIdx ||
+				Tensor.SharedConstantIdx != -1 || !Algo::Compare(Payload.GetDimensions(Tensor.FirstDimension, Tensor.NumDimensions),
+					Plain.GetDimensions(PlainTensor.FirstDimension, PlainTensor.NumDimensions)))
+			{
+				AddError(Prefix + FString::Printf(TEXT("Tensor %d differs from the plain model data."), TensorId));
+			}
+		}
+
+		const TConstArrayView<FModelFormat::FConstant> PlainConstants = Plain.GetTable<FModelFormat::FConstant>(Plain.Header->Constants);
+		const TConstArrayView<FModelFormat::FConstant> Constants = Payload.GetTable<FModelFormat::FConstant>(Payload.Header->Constants);
+		if (!TestEqual(*What(TEXT("Number of constants")), Constants.Num(), PlainConstants.Num()))
+		{
+			continue;
+		}
+		for (int32 ConstantIdx = 0; ConstantIdx < Constants.Num(); ++ConstantIdx)
+		{
+			const FModelFormat::FConstant& Constant = Constants[ConstantIdx];
+			const FModelFormat::FConstant& PlainConstant = PlainConstants[ConstantIdx];
+			const bool bShouldBeShared = Variant.SharedConstantMinBytes > 0 && Constant.DataSize >= Variant.SharedConstantMinBytes;
+			if (Constant.ConstantIndex != PlainConstant.ConstantIndex || Constant.Format != PlainConstant.Format ||
+				!Algo::Compare(Payload.GetConstantData(Constant), Plain.GetConstantData(PlainConstant)) ||
+				!Algo::Compare(Payload.GetDimensions(Constant.FirstDimension, Constant.NumDimensions), Plain.GetDimensions(PlainConstant.FirstDimension, PlainConstant.NumDimensions)) ||
+				(Constant.SharedTensorId != -1) != bShouldBeShared)
+			{
+				AddError(Prefix + FString::Printf(TEXT("Constant %d differs from the plain model data."), ConstantIdx));
+			}
+		}
+
+		const TConstArrayView<FModelFormat::FSegment> PlainSegments = Plain.GetTable<FModelFormat::FSegment>(Plain.Header->Segments);
+		const TConstArrayView<FModelFormat::FSegment> Segments = Payload.GetTable<FModelFormat::FSegment>(Payload.Header->Segments);
+		if (!TestEqual(*What(TEXT("Number of segments")), Segments.Num(), PlainSegments.Num()))
+		{
+			continue;
+		}
+		for (int32 SegmentIdx = 0; SegmentIdx < Segments.Num(); ++SegmentIdx)
+		{
+			const FModelFormat::FSegment& Segment = Segments[SegmentIdx];
+			const FModelFormat::FSegment& PlainSegment = PlainSegments[SegmentIdx];
+			if (Segment.ModuleIndex != PlainSegment.ModuleIndex || Segment.NumConstants != PlainSegment.NumConstants ||
+				FCStringAnsi::Strcmp(Payload.GetVgfString(Segment.NameOffset), Plain.GetVgfString(PlainSegment.NameOffset)) != 0 ||
+				FCStringAnsi::Strcmp(Payload.GetVgfString(Segment.EntryPointOffset), Plain.GetVgfString(PlainSegment.EntryPointOffset)) != 0 ||
+				(!Segment.bRewrittenCode && !PlainSegment.bRewrittenCode &&
+					!Algo::Compare(FModelFormat::GetSegmentCode(Payload.Header, Segment), FModelFormat::GetSegmentCode(Plain.Header, PlainSegment))))
+			{
+				AddError(Prefix + FString::Printf(TEXT("Segment %d differs from the plain model data."), SegmentIdx));
+			}
+		}
+
+		// Compressing the constants takes them out of the VGF.
+		if (Variant.bCompressConstants && !Constants.IsEmpty())
+		{
+			TestTrue(*What(TEXT("Constants are stored compressed")), Payload.Header->ConstantChunks.Num > 0);
+			TestTrue(*What(TEXT("Stored VGF is smaller than the original")), FModelFormat::GetVgf(Payload.Header).Num() < FModelFormat::GetVgf(Plain.Header).Num());
+		}
+	}
+
+	return true;
+}
+
+IMPLEMENT_COMPLEX_AUTOMATION_TEST(FNNERuntimeRDGMLExtensionsForVulkanInferOutputShapesTest, "Plugins.NNERuntimeRDGMLExtensionsForVulkan.Vgf.InferOutputShapes",
+	EAutomationTestFlags::EditorContext | EAutomationTestFlags::ClientContext | EAutomationTestFlags::ProductFilter)
+
+void FNNERuntimeRDGMLExtensionsForVulkanInferOutputShapesTest::GetTests(TArray<FString>& OutBeautifiedNames, TArray<FString>& OutTestCommands) const
+{
+	GetTestVgfs(OutBeautifiedNames, OutTestCommands);
+}
+
+// Checks that the output shapes from InferOutputTensorShapes (which doesn't create a shaped model) are the same as those of a model
+// instance which has been given the same input shapes. The input shapes are read from a .shapes file next to the VGF.
+bool FNNERuntimeRDGMLExtensionsForVulkanInferOutputShapesTest::RunTest(const FString& Parameters)
+{
+	TArray64<uint8> Vgf;
+	if (!LoadTestVgf(*this, Parameters, Vgf))
+	{
+		return false;
+	}
+
+	if (!IsInferenceSupported())
+	{
+		AddInfo(TEXT("Skipped, as this device doesn't support running inferences."));
+		return true;
+	}
+	const TSharedPtr<UE::NNE::FSharedModelData> ModelData = MakeModelData(*this, Vgf, false, 0, false);
+	if (!TestTrue(TEXT("Writing the model data"), ModelData.IsValid()))
+	{
+		return false;
+	}
+	const TSharedPtr<FNNERuntimeRDGMLExtensionsForVulkanModelUnshaped> Model = FNNERuntimeRDGMLExtensionsForVulkanModelUnshaped::Create(ModelData);
+	if (!TestTrue(TEXT("Creating the model"), Model.IsValid()))
+	{
+		return false;
+	}
+	TArray<TArray<UE::NNE::FTensorShape>> InputShapeSets;
+	if (!LoadInputShapeSets(Parameters, InputShapeSets))
+	{
+		// Without any shapes, only a model whose inputs are all specified can be checked.
+		TArray<UE::NNE::FTensorShape> StaticInputShapes;
+		if (!Model->GetStaticInputShapes(StaticInputShapes))
+		{
+			AddInfo(TEXT("Skipped, as the model has unspecified input dimensions but there is no .shapes file for it."));
+			return true;
+		}
+		InputShapeSets.Add(MoveTemp(StaticInputShapes));
+	}
+
+	const TSharedPtr<UE::NNE::IModelInstanceRDG> Instance = Model->CreateModelInstanceRDG();
+	if (!TestTrue(TEXT("Creating a model instance"), Instance.IsValid()))
+	{
+		return false;
+	}
+	for (int32 SetIdx = 0; SetIdx < InputShapeSets.Num(); ++SetIdx)
+	{
+		const TArray<UE::NNE::FTensorShape>& InputShapes = InputShapeSets[SetIdx];
+		TArray<UE::NNE::FTensorShape> InferredShapes;
+		if (!Model->InferOutputTensorShapes(InputShapes, InferredShapes))
+		{
+			AddError(FString::Printf(TEXT("Failed to infer the output shapes for input shapes %d."), SetIdx));
+			continue;
+		}
+		if (Instance->SetInputTensorShapes(InputShapes) != UE::NNE::IModelInstanceRDG::ESetInputTensorShapesStatus::Ok)
+		{
+			AddError(FString::Printf(TEXT("Failed to set input shapes %d on a model instance."), SetIdx));
+			continue;
+		}
+		if (!Algo::Compare(Instance->GetOutputTensorShapes(), InferredShapes))
+		{
+			AddError(FString::Printf(TEXT("Inferred output shapes for input shapes %d differ from the model instance's."), SetIdx));
+		}
+
+		// Asking again gives the remembered result.
+		TArray<UE::NNE::FTensorShape> RememberedShapes;
+		TestTrue(FString::Printf(TEXT("Inferring the output shapes for input shapes %d again"), SetIdx),
+			Model->InferOutputTensorShapes(InputShapes, RememberedShapes) && RememberedShapes == InferredShapes);
+	}
+
+	return true;
+}
+
+#endif // WITH_DEV_AUTOMATION_TESTS
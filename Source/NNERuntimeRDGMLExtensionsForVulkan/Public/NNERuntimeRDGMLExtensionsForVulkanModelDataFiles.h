@@ -0,0 +1,29 @@
+// SPDX-FileCopyrightText: Copyright 2025 Arm Limited and/or its affiliates <open-source-office@arm.com>
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include "Containers/Array.h"
+#include "Containers/ArrayView.h"
+#include "Containers/UnrealString.h"
+
+// The additional files (see UNNEModelData::Init) that the runtime reads when it creates its model data from a VGF. These are
+// written by the editor's VGF factory from its import settings, but can also be passed to UNNEModelData::Init directly.
+namespace UE::NNERuntimeRDGMLExtensionsForVulkan
+{
+	/// Name of an optional additional file listing sets of input shapes that shape inference should be run for when the model is
+	/// imported/cooked, so that models created with these shapes don't need to run it on device.
+	/// It is UTF-8 text with one set of input shapes per line, each input's shape separated by ';' and each dimension by ',',
+	/// e.g. "1,720,1280,3;1,4" for a model with two inputs (see FormatInputShapesFile).
+	NNERUNTIMERDGMLEXTENSIONSFORVULKAN_API extern const TCHAR* const PreShapedInputShapesFileName;
+
+	/// Name of an optional additional file which pins dimensions of the model inputs that aren't specified in the VGF. It has the same
+	/// format as PreShapedInputShapesFileName but with a single line, where -1 leaves a dimension as it is and an empty shape leaves the
+	/// whole input as it is. If this makes all the model input shapes concrete then the model is static, so shape inference is done
+	/// when it's imported rather than on device.
+	NNERUNTIMERDGMLEXTENSIONSFORVULKAN_API extern const TCHAR* const InputShapeOverridesFileName;
+
+	/// Formats sets of input shapes (each of which has the dimensions of each model input) as the contents of one of the files above.
+	/// The result still needs converting to UTF-8.
+	NNERUNTIMERDGMLEXTENSIONSFORVULKAN_API FString FormatInputShapesFile(TConstArrayView<TArray<TArray<int32>>> InputShapeSets);
+}
@@ -0,0 +1,85 @@
+// SPDX-FileCopyrightText: Copyright 2025 Arm Limited and/or its affiliates <open-source-office@arm.com>
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include "Async/Future.h"
+#include "Containers/Array.h"
+#include "Containers/ArrayView.h"
+#include "NNERuntimeRDG.h"
+#include "Templates/SharedPointer.h"
+#include "UObject/ObjectPtr.h"
+
+class UNNEModelData;
+
+/// The ML Extensions for Vulkan® model instance, which extends NNE's IModelInstanceRDG with asynchronous versions of its functions.
+/// Model instances created by the functions below (or by INNERuntimeRDGMLExtensionsForVulkanModel::CreateModelInstanceRDGAsync) are of this type.
+class INNERuntimeRDGMLExtensionsForVulkanModelInstance : public UE::NNE::IModelInstanceRDG
+{
+public:
+	/// The result of a call to SetInputTensorShapesAsync.
+	enum class EShapesRequestStatus : uint8
+	{
+		/// The shapes have been applied, so the next EnqueueRDG uses them.
+		Applied,
+		/// A later call was applied (or failed) first, so these shapes were never used. The instance has the later call's shapes.
+		Superseded,
+		/// The shapes couldn't be applied (e.g. shape inference failed). Unless this was superseded by a later call, the instance is left
+		/// without any shapes, so EnqueueRDG fails until it is given some.
+		Failed,
+	};
+
+	/// Performs shape inference and creates the pipelines (if not already cached) on a task graph worker thread, then
+	/// swaps the new shapes in on the rendering thread. Until the future is fulfilled, the instance keeps its previous shapes.
+	/// Setting the same shapes as are already set is a no-op and the returned future is already fulfilled.
+	virtual TFuture<EShapesRequestStatus> SetInputTensorShapesAsync(TConstArrayView<UE::NNE::FTensorShape> InInputShapes) = 0;
+
+	/// Returns the output shapes that the given input shapes would give, without changing this instance's shapes or creating any
+	/// pipelines (see INNERuntimeRDGMLExtensionsForVulkanModel::InferOutputTensorShapes).
+	virtual bool GetOutputTensorShapesFor(TConstArrayView<UE::NNE::FTensorShape> InInputShapes, TArray<UE::NNE::FTensorShape>& OutOutputShapes) const = 0;
+};
+
+/// The ML Extensions for Vulkan® model, which extends NNE's IModelRDG with asynchronous versions of its functions.
+class INNERuntimeRDGMLExtensionsForVulkanModel : public UE::NNE::IModelRDG
+{
+public:
+	/// Creates a new model instance on a task graph worker thread.
+	virtual TFuture<TSharedPtr<INNERuntimeRDGMLExtensionsForVulkanModelInstance>> CreateModelInstanceRDGAsync() = 0;
+
+	/// Creates shaped models for each of the given sets of input shapes, so that later calls to SetInputTensorShapes with these shapes
+	/// don't need to do shape inference or compile any pipelines. The sets are processed in parallel on task graph worker threads, and the
+	/// results are kept for as long as this model. If bWarmUpDispatch is true, a single inference is also run for each set of shapes
+	/// to absorb any lazy initialization that the driver does on the first dispatch.
+	/// The future is fulfilled once the shaped models have been created (not waiting for the dispatches), with false if any failed.
+	virtual TFuture<bool> PrewarmShapesAsync(TArray<TArray<UE::NNE::FTensorShape>> InputShapeSets, bool bWarmUpDispatch) = 0;
+
+	/// Releases the model data (the SPIR-V code and constants), which is only needed for preparing new input shapes, to save memory once
+	/// all the input shapes that will be used have been prepared (e.g. with PrewarmShapesAsync). The shapes prepared so far are kept
+	/// from then on, and SetInputTensorShapes fails for any other shapes. This blocks until any shapes which are still being prepared
+	/// are ready, so wait for PrewarmShapesAsync first to avoid blocking. It is safe to call this whilst other threads are using the model.
+	virtual void Freeze() = 0;
+
+	/// Works out the shapes of the model outputs for the given input shapes, by running shape inference but without compiling any
+	/// pipelines, so this is much quicker than SetInputTensorShapes for shapes that haven't been used before. Results are remembered, so
+	/// asking again for the same shapes is quick. This can be called from any thread. Returns false (having logged an error) if it fails,
+	/// including for shapes that haven't been used before once the model has been frozen.
+	virtual bool InferOutputTensorShapes(TConstArrayView<UE::NNE::FTensorShape> ModelInputShapes, TArray<UE::NNE::FTensorShape>& OutOutputShapes) = 0;
+
+	/// Returns how many prepared sets of input shapes have been released to stay within the project settings' limits on how many (and
+	/// how much memory) the model keeps whilst no model instance is using them. If this keeps growing whilst switching between the same
+	/// few shapes, each switch is preparing them again, so raising the limits would help.
+	virtual uint32 GetNumShapedModelEvictions() const = 0;
+};
+
+namespace UE::NNERuntimeRDGMLExtensionsForVulkan
+{
+	/// Creates a model for the given model data on a task graph worker thread, so that the calling thread isn't blocked.
+	/// This must be called on the game thread, as it reads the asset (and the project settings for the shapes to prewarm it with).
+	/// The future is fulfilled with nullptr if the model couldn't be created (having logged an error).
+	NNERUNTIMERDGMLEXTENSIONSFORVULKAN_API TFuture<TSharedPtr<INNERuntimeRDGMLExtensionsForVulkanModel>> CreateModelAsync(TObjectPtr<UNNEModelData> ModelData);
+
+	/// Creates a model from a file containing cooked model data (as stored in a UNNEModelData for this runtime), memory-mapping the
+	/// file where possible. This can be called from any thread.
+	/// The future is fulfilled with nullptr if the model couldn't be created (having logged an error).
+	NNERUNTIMERDGMLEXTENSIONSFORVULKAN_API TFuture<TSharedPtr<INNERuntimeRDGMLExtensionsForVulkanModel>> CreateModelFromFileAsync(const FString& Filename);
+}
@@ -0,0 +1,101 @@
+// SPDX-FileCopyrightText: Copyright 2025 Arm Limited and/or its affiliates <open-source-office@arm.com>
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include "Engine/DeveloperSettings.h"
+#include "UObject/SoftObjectPtr.h"
+
+#include "NNERuntimeRDGMLExtensionsForVulkanSettings.generated.h"
+
+class UNNEModelData;
+
+/// The concrete shape of a single input tensor.
+USTRUCT()
+struct FNNERuntimeRDGMLExtensionsForVulkanTensorShape
+{
+	GENERATED_BODY()
+
+	UPROPERTY(EditAnywhere, Category = "Shapes", meta = (ClampMin = "1"))
+	TArray<int32> Dimensions;
+};
+
+/// Shapes for all of a model's inputs, i.e. what would be passed to a single call of SetInputTensorShapes.
+USTRUCT()
+struct FNNERuntimeRDGMLExtensionsForVulkanInputShapes
+{
+	GENERATED_BODY()
+
+	UPROPERTY(EditAnywhere, Category = "Shapes")
+	TArray<FNNERuntimeRDGMLExtensionsForVulkanTensorShape> InputShapes;
+};
+
+/// A model asset and the input shapes to prepare it for.
+USTRUCT()
+struct FNNERuntimeRDGMLExtensionsForVulkanModelPrewarm
+{
+	GENERATED_BODY()
+
+	UPROPERTY(EditAnywhere, Category = "Shapes")
+	TSoftObjectPtr<UNNEModelData> ModelData;
+
+	UPROPERTY(EditAnywhere, Category = "Shapes")
+	TArray<FNNERuntimeRDGMLExtensionsForVulkanInputShapes> ShapeSets;
+};
+
+/// Project settings for the ML Extensions for Vulkan® NNE runtime.
+UCLASS(config = Engine, defaultconfig, meta = (DisplayName = "NNE Runtime ML Extensions for Vulkan"))
+class NNERUNTIMERDGMLEXTENSIONSFORVULKAN_API UNNERuntimeRDGMLExtensionsForVulkanSettings : public UDeveloperSettings
+{
+	GENERATED_BODY()
+
+public:
+	/// Input shapes to prepare models for as soon as they are created, so that the first call to SetInputTensorShapes with
+	/// these shapes doesn't need to do shape inference or compile pipelines. This is useful for e.g. the resolutions that an
+	/// upscaler can run at, so that this work can be done behind a loading screen rather than when the resolution changes.
+	UPROPERTY(config, EditAnywhere, Category = "Prewarming")
+	TArray<FNNERuntimeRDGMLExtensionsForVulkanModelPrewarm> PrewarmShapes;
+
+	/// Also run a single inference (on zeroed inputs) for each of the prewarmed shapes, so that any work the driver defers
+	/// until the first dispatch of a pipeline is done up-front too.
+	UPROPERTY(config, EditAnywhere, Category = "Prewarming")
+	bool bPrewarmDispatch = false;
+
+	/// How many shaped models (i.e. sets of input shapes) to keep for each model after all the model instances using them have moved on
+	/// to other shapes. This avoids redoing shape inference and pipeline compilation when e.g. the resolution flips back and forth.
+	UPROPERTY(config, EditAnywhere, Category = "Caching", meta = (ClampMin = "0"))
+	int32 MaxRetainedShapedModels = 8;
+
+	/// Limit on the (estimated) memory used by the pipelines of the shaped models kept for each model, in megabytes.
+	UPROPERTY(config, EditAnywhere, Category = "Caching", meta = (ClampMin = "0"))
+	int32 RetainedShapedModelsMemoryBudgetMB = 256;
+
+	/// Limit on the size of the shape inference results cached in the project's saved directory (outside of the editor, which uses the
+	/// derived data cache instead), in megabytes. The least recently used results are deleted once this is exceeded. 0 means no limit.
+	UPROPERTY(config, EditAnywhere, Category = "Caching", meta = (ClampMin = "0"))
+	int32 ShapeInferenceCacheMaxSizeMB = 64;
+
+	/// If a pipeline isn't already in the pipeline cache, first compile it with optimizations disabled so that it can be used as soon
+	/// as possible, then compile the fully optimized version in the background and swap it in once it's ready. Disabling this means
+	/// waiting for the fully optimized pipeline before a model can be used with new input shapes.
+	UPROPERTY(config, EditAnywhere, Category = "Pipelines")
+	bool bTieredPipelineCompilation = true;
+
+	/// Compress the constant data (weights) in cooked models. This makes packages smaller and reduces the data read when loading
+	/// a model, at the cost of decompressing it (in parallel on worker threads) when the model is created.
+	UPROPERTY(config, EditAnywhere, Category = "Cooking")
+	bool bCompressModelConstants = false;
+
+	/// Constants (weights) of at least this size, in kilobytes, are turned into inputs of the model's pipelines when models are cooked, and
+	/// bound to a single copy of the data on the GPU for each model rather than being baked into every pipeline. This saves GPU memory
+	/// when a model is used with several sets of input shapes (each of which has its own pipelines), but may prevent some driver
+	/// optimizations which rely on knowing the weights when the pipeline is compiled. 0 disables this.
+	UPROPERTY(config, EditAnywhere, Category = "Cooking", meta = (ClampMin = "0"))
+	int32 SharedConstantMinSizeKB = 0;
+
+	/// Optimize the SPIR-V code of cooked models: strip debug information (e.g. names), remove unused constants and types, and compact
+	/// the IDs. This makes packages smaller and the code quicker for the driver to parse when pipelines are compiled. The sizes before
+	/// and after are logged for each module.
+	UPROPERTY(config, EditAnywhere, Category = "Cooking")
+	bool bOptimizeModelCode = false;
+};
@@ -17,7 +17,11 @@ public class NNERuntimeRDGMLExtensionsForVulkanEditor : ModuleRules
 				"CoreUObject",
 				"UnrealEd",
 				"NNE",
-				"Engine"
+				"Engine",
+				"NNERuntimeRDGMLExtensionsForVulkan",
+				"PropertyEditor",
+				"Slate",
+				"SlateCore"
 			}
 		);
 	}
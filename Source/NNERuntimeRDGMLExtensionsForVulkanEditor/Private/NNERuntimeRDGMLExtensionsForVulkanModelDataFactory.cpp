@@ -4,8 +4,21 @@
 #include "NNERuntimeRDGMLExtensionsForVulkanModelDataFactory.h"
 
 #include "NNEModelData.h"
+#include "Algo/Transform.h"
+#include "NNERuntimeRDGMLExtensionsForVulkanModelDataFiles.h"
 #include "EngineAnalytics.h"
+#include "Framework/Application/SlateApplication.h"
+#include "Framework/Docking/TabManager.h"
+#include "IDetailsView.h"
 #include "Kismet/GameplayStatics.h"
+#include "Misc/Paths.h"
+#include "PropertyEditorModule.h"
+#include "Widgets/Input/SButton.h"
+#include "Widgets/Layout/SUniformGridPanel.h"
+#include "Widgets/SBoxPanel.h"
+#include "Widgets/SWindow.h"
+
+#define LOCTEXT_NAMESPACE "NNERuntimeRDGMLExtensionsForVulkanModelDataFactory"
 
 UNNERuntimeRDGMLExtensionsForVulkanModelDataFactory::UNNERuntimeRDGMLExtensionsForVulkanModelDataFactory(const FObjectInitializer& ObjectInitializer)
 {
@@ -16,6 +29,18 @@ UNNERuntimeRDGMLExtensionsForVulkanModelDataFactory::UNNERuntimeRDGMLExtensionsF
 	Formats.Add("vgf;VGF serialized neural network");
 }
 
+UObject* UNNERuntimeRDGMLExtensionsForVulkanModelDataFactory::FactoryCreateFile(UClass* InClass, UObject* InParent, FName InName, EObjectFlags Flags,
+	const FString& Filename, const TCHAR* Parms, FFeedbackContext* Warn, bool& bOutOperationCanceled)
+{
+	if (!ShowImportSettingsDialog(Filename))
+	{
+		bOutOperationCanceled = true;
+		return nullptr;
+	}
+	// This loads the file and calls FactoryCreateBinary.
+	return Super::FactoryCreateFile(InClass, InParent, InName, Flags, Filename, Parms, Warn, bOutOperationCanceled);
+}
+
 UObject* UNNERuntimeRDGMLExtensionsForVulkanModelDataFactory::FactoryCreateBinary(UClass* Class, UObject* InParent, FName Name, EObjectFlags Flags, UObject* Context, const TCHAR* Type, const uint8*& Buffer, const uint8* BufferEnd, FFeedbackContext* Warn)
 {
 	GEditor->GetEditorSubsystem<UImportSubsystem>()->BroadcastAssetPreImport(this, Class, InParent, Name, Type);
@@ -28,7 +53,29 @@ UObject* UNNERuntimeRDGMLExtensionsForVulkanModelDataFactory::FactoryCreateBinar
 
 	UNNEModelData* ModelData = NewObject<UNNEModelData>(InParent, Class, Name, Flags);
 	TConstArrayView<uint8> BufferView = MakeArrayView(Buffer, BufferEnd - Buffer);
-	ModelData->Init(Type, BufferView);
+
+	// Pass the import settings on to the runtime in the format it expects (see NNERuntimeRDGMLExtensionsForVulkanModelDataFiles.h).
+	TMap<FString, TConstArrayView64<uint8>> AdditionalBuffers;
+	TArray<TArray<int32>> InputShapeOverridesDims;
+	Algo::Transform(InputShapeOverrides, InputShapeOverridesDims, [](const FNNERuntimeRDGMLExtensionsForVulkanInputShapeOverride& Override) { return Override.Dimensions; });
+	const FTCHARToUTF8 InputShapeOverridesUTF8(*UE::NNERuntimeRDGMLExtensionsForVulkan::FormatInputShapesFile(MakeArrayView(&InputShapeOverridesDims, 1)));
+	if (!InputShapeOverrides.IsEmpty())
+	{
+		AdditionalBuffers.Add(UE::NNERuntimeRDGMLExtensionsForVulkan::InputShapeOverridesFileName,
+			TConstArrayView64<uint8>(reinterpret_cast<const uint8*>(InputShapeOverridesUTF8.Get()), InputShapeOverridesUTF8.Length()));
+	}
+	TArray<TArray<TArray<int32>>> PreShapedInputShapeSets;
+	for (const FNNERuntimeRDGMLExtensionsForVulkanInputShapes& ShapeSet : PreShapedInputShapes)
+	{
+		Algo::Transform(ShapeSet.InputShapes, PreShapedInputShapeSets.AddDefaulted_GetRef(), [](const FNNERuntimeRDGMLExtensionsForVulkanTensorShape& Shape) { return Shape.Dimensions; });
+	}
+	const FTCHARToUTF8 PreShapedInputShapesUTF8(*UE::NNERuntimeRDGMLExtensionsForVulkan::FormatInputShapesFile(PreShapedInputShapeSets));
+	if (!PreShapedInputShapes.IsEmpty())
+	{
+		AdditionalBuffers.Add(UE::NNERuntimeRDGMLExtensionsForVulkan::PreShapedInputShapesFileName,
+			TConstArrayView64<uint8>(reinterpret_cast<const uint8*>(PreShapedInputShapesUTF8.Get()), PreShapedInputShapesUTF8.Length()));
+	}
+	ModelData->Init(Type, BufferView, AdditionalBuffers);
 
 	GEditor->GetEditorSubsystem<UImportSubsystem>()->BroadcastAssetPostImport(this, ModelData);
 
@@ -49,3 +96,76 @@ bool UNNERuntimeRDGMLExtensionsForVulkanModelDataFactory::FactoryCanImport(const
 {
 	return Filename.EndsWith(FString("vgf"));
 }
+
+void UNNERuntimeRDGMLExtensionsForVulkanModelDataFactory::CleanUp()
+{
+	Super::CleanUp();
+	bImportAllWithSameSettings = false;
+}
+
+bool UNNERuntimeRDGMLExtensionsForVulkanModelDataFactory::ShowImportSettingsDialog(const FString& Filename)
+{
+	// Automated imports (e.g. from the command line) take their settings from the factory settings rather than asking.
+	if (IsAutomatedImport() || bImportAllWithSameSettings || !FSlateApplication::IsInitialized())
+	{
+		return true;
+	}
+
+	FPropertyEditorModule& PropertyEditorModule = FModuleManager::LoadModuleChecked<FPropertyEditorModule>("PropertyEditor");
+	FDetailsViewArgs DetailsViewArgs;
+	DetailsViewArgs.bAllowSearch = false;
+	DetailsViewArgs.NameAreaSettings = FDetailsViewArgs::HideNameArea;
+	const TSharedRef<IDetailsView> DetailsView = PropertyEditorModule.CreateDetailView(DetailsViewArgs);
+	// Only our import settings are editable properties of the factory, so that's all this shows.
+	DetailsView->SetObject(this);
+
+	enum class EResult { Cancel, Import, ImportAll };
+	EResult Result = EResult::Cancel;
+	const TSharedRef<SWindow> Window = SNew(SWindow)
+		.Title(FText::Format(LOCTEXT("ImportSettingsTitle", "VGF Import Settings: {0}"), FText::FromString(FPaths::GetCleanFilename(Filename))))
+		.SizingRule(ESizingRule::UserSized)
+		.ClientSize(FVector2D(600.0f, 400.0f));
+	auto MakeButton = [&Result, &Window](const FText& Text, EResult ButtonResult) {
+		return SNew(SButton)
+			.HAlign(HAlign_Center)
+			.Text(Text)
+			.OnClicked_Lambda([&Result, &Window, ButtonResult]() {
+				Result = ButtonResult;
+				Window->RequestDestroyWindow();
+				return FReply::Handled();
+			});
+	};
+	Window->SetContent(
+		SNew(SVerticalBox)
+		+ SVerticalBox::Slot()
+		.FillHeight(1.0f)
+		[
+			DetailsView
+		]
+		+ SVerticalBox::Slot()
+		.AutoHeight()
+		.HAlign(HAlign_Right)
+		.Padding(4.0f)
+		[
+			SNew(SUniformGridPanel)
+			.SlotPadding(2.0f)
+			+ SUniformGridPanel::Slot(0, 0)
+			[
+				MakeButton(LOCTEXT("ImportAll", "Import All"), EResult::ImportAll)
+			]
+			+ SUniformGridPanel::Slot(1, 0)
+			[
+				MakeButton(LOCTEXT("Import", "Import"), EResult::Import)
+			]
+			+ SUniformGridPanel::Slot(2, 0)
+			[
+				MakeButton(LOCTEXT("Cancel", "Cancel"), EResult::Cancel)
+			]
+		]);
+	FSlateApplication::Get().AddModalWindow(Window, FGlobalTabmanager::Get()->GetRootWindow());
+
+	bImportAllWithSameSettings = Result == EResult::ImportAll;
+	return Result != EResult::Cancel;
+}
+
+#undef LOCTEXT_NAMESPACE
@@ -4,13 +4,27 @@
 #pragma once
 
 #include "Factories/Factory.h"
+#include "NNERuntimeRDGMLExtensionsForVulkanSettings.h"
 
 #include "NNERuntimeRDGMLExtensionsForVulkanModelDataFactory.generated.h"
 
+/// Dimensions to pin for one of the model's inputs.
+USTRUCT()
+struct FNNERuntimeRDGMLExtensionsForVulkanInputShapeOverride
+{
+	GENERATED_BODY()
+
+	/// One entry for each dimension of the input, with -1 for dimensions that should be left as they are in the model.
+	/// Leave this empty to not override this input at all.
+	UPROPERTY(EditAnywhere, Category = "Import Settings", meta = (ClampMin = "-1"))
+	TArray<int32> Dimensions;
+};
+
 /// Simple asset factory which takes .vgf files and creates a UNNEModelData asset for them.
 /// This is pretty much identical to the vanilla UNNEModelDataFactory, but declares support for .vgf files instead of .onnx.
-/// It also gives us the option of adding custom import settings that are specific for our runtime, for example shape overrides
-/// (see the UNNERuntimeIREEModelDataFactory class for an example of this.)
+/// It also has import settings that are specific to our runtime, which are shown in a dialog when importing interactively (or can be
+/// set with the factory settings of an automated import). They are stored with the asset as additional files and applied by the
+/// runtime when it creates its model data (see NNERuntimeRDGMLExtensionsForVulkanModelDataFiles.h).
 UCLASS()
 class UNNERuntimeRDGMLExtensionsForVulkanModelDataFactory : public UFactory
 {
@@ -21,7 +35,28 @@ public:
 
 public:
 	//~ Begin UFactory Interface
+	virtual UObject* FactoryCreateFile(UClass* InClass, UObject* InParent, FName InName, EObjectFlags Flags, const FString& Filename, const TCHAR* Parms, FFeedbackContext* Warn, bool& bOutOperationCanceled) override;
 	virtual UObject* FactoryCreateBinary(UClass* Class, UObject* InParent, FName Name, EObjectFlags Flags, UObject* Context, const TCHAR* Type, const uint8*& Buffer, const uint8* BufferEnd, FFeedbackContext* Warn) override;
 	virtual bool FactoryCanImport(const FString& Filename) override;
+	virtual void CleanUp() override;
 	//~ End UFactory Interface
+
+	/// Pins dimensions that aren't specified in the model (e.g. the batch size), with one entry for each model input in order.
+	/// These are propagated through the model when it's imported, and if all the input shapes become concrete then the model is
+	/// static: shape inference is done at import time rather than on device, and its single shaped model is prepared when it's loaded.
+	UPROPERTY(EditAnywhere, Category = "Import Settings")
+	TArray<FNNERuntimeRDGMLExtensionsForVulkanInputShapeOverride> InputShapeOverrides;
+
+	/// Sets of input shapes that the model will be used with (e.g. the resolutions that it runs at). Shape inference is done for these
+	/// when the model is imported/cooked, so that setting these shapes on device doesn't need to run it. Every dimension must be given.
+	UPROPERTY(EditAnywhere, Category = "Import Settings")
+	TArray<FNNERuntimeRDGMLExtensionsForVulkanInputShapes> PreShapedInputShapes;
+
+private:
+	// Shows the import settings above in a modal dialog, unless the user has already chosen to use the same settings for the rest
+	// of the files being imported. Returns false if the user cancelled.
+	bool ShowImportSettingsDialog(const FString& Filename);
+
+	// Set when the user picks "Import All" in the dialog, until the end of the current batch of imports (see CleanUp).
+	bool bImportAllWithSameSettings = false;
 };
@@ -0,0 +1,50 @@
+#!/usr/bin/env bash
+# SPDX-FileCopyrightText: Copyright 2025 Arm Limited and/or its affiliates <open-source-office@arm.com>
+# SPDX-License-Identifier: MIT
+
+# This script fetches the dependencies of the VGF benchmark (at the same commits as BuildThirdParty.ps1) and builds it on Linux.
+# The benchmark is written to Intermediate/VGFBenchmarkBuild/Build/VGFBenchmark.
+
+set -euo pipefail
+
+ScriptDir="$(cd "$(dirname "${BASH_SOURCE[0]}")" && pwd)"
+PluginDir="$(cd "$ScriptDir/../.." && pwd)"
+
+# Helper function that does a shallow clone of a repository at the specified commit (hash, branch or tag).
+CloneRepoFromCommit() {
+    local RepoUrl="$1" Commit="$2" TargetDirName="$3"
+    git init "$TargetDirName"
+    git -C "$TargetDirName" remote add origin "$RepoUrl"
+    git -C "$TargetDirName" fetch --depth=1 origin "$Commit"
+    git -C "$TargetDirName" checkout FETCH_HEAD
+}
+
+# Create and use a temporary folder for downloading and building
+WorkingDir="$PluginDir/Intermediate/VGFBenchmarkBuild"
+rm -rf "$WorkingDir"
+mkdir -p "$WorkingDir"
+cd "$WorkingDir"
+
+# --- Clone repositories ---
+echo "Cloning ai-ml-sdk-vgf-library..."
+CloneRepoFromCommit "https://github.com/arm/ai-ml-sdk-vgf-library.git" "v0.7.0" "ai-ml-sdk-vgf-library"
+
+echo "Cloning flatbuffers..."
+CloneRepoFromCommit "https://github.com/google/flatbuffers.git" "v23.5.26" "flatbuffers"
+
+echo "Cloning SPIRV-Tools..."
+CloneRepoFromCommit "https://github.com/arm/SPIRV-Tools.git" "staging-2025-09-09" "SPIRV-Tools"
+
+echo "Cloning SPIRV-Headers..."
+CloneRepoFromCommit "https://github.com/arm/SPIRV-Headers.git" "vulkan-sdk-1.4.321.0" "SPIRV-Headers"
+
+# --- Build ---
+echo "Building VGFBenchmark..."
+cmake -S "$ScriptDir" -B "Build" -DCMAKE_BUILD_TYPE=Release \
+    -DML_SDK_VGF_LIB_PATH="$WorkingDir/ai-ml-sdk-vgf-library" \
+    -DFLATBUFFERS_PATH="$WorkingDir/flatbuffers" \
+    -DSPIRV_TOOLS_PATH="$WorkingDir/SPIRV-Tools" \
+    -DSPIRV_HEADERS_PATH="$WorkingDir/SPIRV-Headers"
+cmake --build "Build" --target VGFBenchmark -j"$(nproc)"
+
+echo "Successfully built $WorkingDir/Build/VGFBenchmark"
@@ -0,0 +1,458 @@
+// SPDX-FileCopyrightText: Copyright 2025 Arm Limited and/or its affiliates <open-source-office@arm.com>
+// SPDX-License-Identifier: MIT
+
+// Minimal stand-ins for the engine types and macros used by the plugin's shape inference code
+// (NNERuntimeRDGMLExtensionsForVulkanShapeInference.cpp), so that the benchmark can build that file as it is rather than a copy of it.
+// The headers next to this one have the same paths as the engine headers that the plugin includes, and just include this.
+// Only what the plugin's code uses is provided, built on the standard library; none of it is meant to match the engine's performance
+// characteristics exactly, but the containers are thin wrappers so they don't distort the timings.
+
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cstdarg>
+#include <cstdint>
+#include <cstdio>
+#include <initializer_list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+using int8 = int8_t;
+using int16 = int16_t;
+using int32 = int32_t;
+using int64 = int64_t;
+using uint8 = uint8_t;
+using uint16 = uint16_t;
+using uint32 = uint32_t;
+using uint64 = uint64_t;
+
+#define INDEX_NONE (-1)
+#define MAX_int32 ((int32)0x7fffffff)
+#define UE_ARRAY_COUNT(Array) (sizeof(Array) / sizeof((Array)[0]))
+#define TEXT(String) String
+#define check(Expression) assert(Expression)
+
+#define ENGINE_SHIM_JOIN_INNER(A, B) A##B
+#define ENGINE_SHIM_JOIN(A, B) ENGINE_SHIM_JOIN_INNER(A, B)
+
+template<typename T>
+std::remove_reference_t<T>&& MoveTemp(T&& Value)
+{
+	return std::move(Value);
+}
+
+struct FMath
+{
+	template<typename T>
+	static constexpr T Max(T A, T B)
+	{
+		return A < B ? B : A;
+	}
+
+	template<typename T>
+	static constexpr T Min(T A, T B)
+	{
+		return B < A ? B : A;
+	}
+};
+
+template<typename KeyType, typename ValueType>
+struct TPair
+{
+	KeyType Key;
+	ValueType Value;
+
+	TPair() = default;
+	TPair(KeyType InKey, ValueType InValue)
+		: Key(std::move(InKey))
+		, Value(std::move(InValue))
+	{
+	}
+
+	template<int Index>
+	auto& Get()
+	{
+		static_assert(Index == 0 || Index == 1);
+		if constexpr (Index == 0)
+		{
+			return Key;
+		}
+		else
+		{
+			return Value;
+		}
+	}
+
+	template<int Index>
+	const auto& Get() const
+	{
+		return const_cast<TPair*>(this)->template Get<Index>();
+	}
+
+	bool operator==(const TPair& Other) const
+	{
+		return Key == Other.Key && Value == Other.Value;
+	}
+
+	bool operator!=(const TPair& Other) const
+	{
+		return !(*this == Other);
+	}
+
+	bool operator<(const TPair& Other) const
+	{
+		return Key < Other.Key || (!(Other.Key < Key) && Value < Other.Value);
+	}
+};
+
+template<typename T>
+class TArray : public std::vector<T>
+{
+	using Super = std::vector<T>;
+
+public:
+	using Super::Super;
+
+	TArray() = default;
+
+	TArray(const T* Data, int64 Count)
+		: Super(Data, Data + Count)
+	{
+	}
+
+	int32 Num() const
+	{
+		return (int32)this->size();
+	}
+
+	bool IsEmpty() const
+	{
+		return this->empty();
+	}
+
+	T* GetData()
+	{
+		return this->data();
+	}
+
+	const T* GetData() const
+	{
+		return this->data();
+	}
+
+	int32 Add(const T& Item)
+	{
+		this->push_back(Item);
+		return Num() - 1;
+	}
+
+	int32 Add(T&& Item)
+	{
+		this->push_back(std::move(Item));
+		return Num() - 1;
+	}
+
+	void Append(const T* Data, int64 Count)
+	{
+		this->insert(this->end(), Data, Data + Count);
+	}
+
+	void Append(const TArray& Other)
+	{
+		this->insert(this->end(), Other.begin(), Other.end());
+	}
+
+	void Insert(const TArray& Items, int32 Index)
+	{
+		this->insert(this->begin() + Index, Items.begin(), Items.end());
+	}
+
+	void RemoveAt(int32 Index)
+	{
+		this->erase(this->begin() + Index);
+	}
+
+	T Pop()
+	{
+		T Item = std::move(this->back());
+		this->pop_back();
+		return Item;
+	}
+
+	bool Contains(const T& Item) const
+	{
+		return std::find(this->begin(), this->end(), Item) != this->end();
+	}
+
+	void Reserve(int64 Count)
+	{
+		this->reserve((size_t)Count);
+	}
+
+	void Reset(int64 Slack = 0)
+	{
+		this->clear();
+		this->reserve((size_t)Slack);
+	}
+
+	void Init(const T& Item, int32 Count)
+	{
+		this->assign((size_t)Count, Item);
+	}
+
+	void SetNum(int32 Count)
+	{
+		this->resize((size_t)Count);
+	}
+
+	void SetNumZeroed(int32 Count)
+	{
+		this->resize((size_t)Count);
+	}
+
+	template<typename PredicateType>
+	void Sort(PredicateType Predicate)
+	{
+		std::sort(this->begin(), this->end(), Predicate);
+	}
+};
+
+template<typename T>
+class TConstArrayView
+{
+public:
+	TConstArrayView() = default;
+
+	TConstArrayView(const T* InData, int64 InNum)
+		: Data(InData)
+		, Size((int32)InNum)
+	{
+	}
+
+	TConstArrayView(const TArray<T>& Array)
+		: Data(Array.GetData())
+		, Size(Array.Num())
+	{
+	}
+
+	int32 Num() const
+	{
+		return Size;
+	}
+
+	bool IsEmpty() const
+	{
+		return Size == 0;
+	}
+
+	const T* GetData() const
+	{
+		return Data;
+	}
+
+	const T& operator[](int64 Index) const
+	{
+		check(Index >= 0 && Index < Size);
+		return Data[Index];
+	}
+
+	const T* begin() const
+	{
+		return Data;
+	}
+
+	const T* end() const
+	{
+		return Data + Size;
+	}
+
+private:
+	const T* Data = nullptr;
+	int32 Size = 0;
+};
+
+// Keeps the pairs in the order they were added, like the engine's TMap does when nothing is removed.
+template<typename KeyType, typename ValueType>
+class TMap
+{
+public:
+	using ElementType = TPair<KeyType, ValueType>;
+
+	ValueType& Add(const KeyType& Key, ValueType Value)
+	{
+		const auto [It, bInserted] = Indices.emplace(Key, Pairs.Num());
+		if (bInserted)
+		{
+			Pairs.Add(ElementType(Key, std::move(Value)));
+		}
+		else
+		{
+			Pairs[It->second].Value = std::move(Value);
+		}
+		return Pairs[It->second].Value;
+	}
+
+	ValueType* Find(const KeyType& Key)
+	{
+		const auto It = Indices.find(Key);
+		return It != Indices.end() ? &Pairs[It->second].Value : nullptr;
+	}
+
+	const ValueType* Find(const KeyType& Key) const
+	{
+		return const_cast<TMap*>(this)->Find(Key);
+	}
+
+	bool Contains(const KeyType& Key) const
+	{
+		return Indices.count(Key) != 0;
+	}
+
+	ValueType& operator[](const KeyType& Key)
+	{
+		ValueType* Value = Find(Key);
+		check(Value != nullptr);
+		return *Value;
+	}
+
+	const ValueType& operator[](const KeyType& Key) const
+	{
+		return const_cast<TMap*>(this)->operator[](Key);
+	}
+
+	int32 Num() const
+	{
+		return Pairs.Num();
+	}
+
+	bool IsEmpty() const
+	{
+		return Pairs.IsEmpty();
+	}
+
+	TArray<ElementType> Array() const
+	{
+		return Pairs;
+	}
+
+	auto begin() const
+	{
+		return Pairs.begin();
+	}
+
+	auto end() const
+	{
+		return Pairs.end();
+	}
+
+private:
+	TArray<ElementType> Pairs;
+	std::map<KeyType, int32> Indices;
+};
+
+template<typename T, typename DeleterType = std::default_delete<T>>
+class TUniquePtr : public std::unique_ptr<T, DeleterType>
+{
+	using Super = std::unique_ptr<T, DeleterType>;
+
+public:
+	using Super::Super;
+
+	T* Get() const
+	{
+		return this->get();
+	}
+};
+
+template<typename T, typename... ArgTypes>
+TUniquePtr<T> MakeUnique(ArgTypes&&... Args)
+{
+	return TUniquePtr<T>(new T(std::forward<ArgTypes>(Args)...));
+}
+
+namespace Algo
+{
+	template<typename InputType, typename OutputType, typename ProjectionType>
+	void Transform(const InputType& Input, OutputType& Output, ProjectionType Projection)
+	{
+		for (const auto& Item : Input)
+		{
+			Output.Add(Projection(Item));
+		}
+	}
+}
+
+using FCriticalSection = std::recursive_mutex;
+
+class FScopeLock
+{
+public:
+	explicit FScopeLock(FCriticalSection* CriticalSection)
+		: Lock(*CriticalSection)
+	{
+	}
+
+private:
+	std::lock_guard<FCriticalSection> Lock;
+};
+
+namespace EngineShim
+{
+	template<typename FuncType>
+	class TScopeGuard
+	{
+	public:
+		explicit TScopeGuard(FuncType&& InFunc)
+			: Func(std::move(InFunc))
+		{
+		}
+		TScopeGuard(const TScopeGuard&) = delete;
+		TScopeGuard& operator=(const TScopeGuard&) = delete;
+
+		~TScopeGuard()
+		{
+			Func();
+		}
+
+	private:
+		FuncType Func;
+	};
+
+	struct FScopeGuardSyntaxSupport
+	{
+		template<typename FuncType>
+		TScopeGuard<FuncType> operator+(FuncType&& InFunc)
+		{
+			return TScopeGuard<FuncType>(std::forward<FuncType>(InFunc));
+		}
+	};
+
+	// Writes a log message to stderr. The engine's "%hs" (a narrow string in a wide format string) is just "%s" here.
+	inline void Log(const char* Category, const char* Verbosity, const char* Format, ...)
+	{
+		std::string NarrowFormat = Format;
+		for (size_t Pos = NarrowFormat.find("%hs"); Pos != std::string::npos; Pos = NarrowFormat.find("%hs", Pos))
+		{
+			NarrowFormat.erase(Pos + 1, 1);
+		}
+
+		std::fprintf(stderr, "%s: %s: ", Category, Verbosity);
+		va_list Args;
+		va_start(Args, Format);
+		std::vfprintf(stderr, NarrowFormat.c_str(), Args);
+		va_end(Args);
+		std::fputc('\n', stderr);
+	}
+}
+
+#define ON_SCOPE_EXIT const auto ENGINE_SHIM_JOIN(ScopeGuard_, __LINE__) = ::EngineShim::FScopeGuardSyntaxSupport() + [&]()
+
+#define DECLARE_LOG_CATEGORY_EXTERN(CategoryName, DefaultVerbosity, CompileTimeVerbosity) \
+	inline constexpr const char* CategoryName = #CategoryName
+#define UE_LOG(CategoryName, Verbosity, Format, ...) ::EngineShim::Log(CategoryName, #Verbosity, Format, ##__VA_ARGS__)
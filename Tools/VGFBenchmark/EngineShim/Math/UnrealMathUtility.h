@@ -0,0 +1,8 @@
+// SPDX-FileCopyrightText: Copyright 2025 Arm Limited and/or its affiliates <open-source-office@arm.com>
+// SPDX-License-Identifier: MIT
+
+// Stands in for the engine header of the same name (see EngineShim.h).
+
+#pragma once
+
+#include "EngineShim.h"
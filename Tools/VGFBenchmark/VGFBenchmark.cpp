@@ -0,0 +1,593 @@
+// SPDX-FileCopyrightText: Copyright 2025 Arm Limited and/or its affiliates <open-source-office@arm.com>
+// SPDX-License-Identifier: MIT
+
+// Standalone benchmark for the CPU-side load path of the plugin: decoding VGFs (as FNNERuntimeRDGMLExtensionsForVulkanModelFormat::Write
+// does when a model is imported/cooked) and shape inference (RunShapeInference, which is run when new input shapes are set). It doesn't
+// depend on the engine or a GPU, so it can be run on ordinary CI machines to track regressions. The results are written as JSON.
+// Shape inference is the plugin's own code, built against EngineShim. The decoding mirrors FNNERuntimeRDGMLExtensionsForVulkanModelFormat::Write,
+// which depends on too much of the engine to build here, so changes to its walk over the VGF should be made to DecodeVgf as well.
+//
+// Usage: VGFBenchmark <directory of .vgf files> [--dims 64,128,256] [--iterations 5] [--output results.json]
+//   --dims        Values to sweep the unspecified input dimensions over (all of them are set to the same value in each step).
+//   --iterations  How many times each measurement is repeated. The first, minimum and median are reported.
+//   --output      Where to write the JSON. Defaults to stdout.
+
+#include <algorithm>
+#include <chrono>
+#include <climits>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "NNERuntimeRDGMLExtensionsForVulkanShapeInference.h" // From the plugin, built with EngineShim (see CMakeLists.txt)
+#include "vgf/decoder.h" // The VGF parser from the ML SDK for Vulkan
+
+namespace
+{
+
+	using FClock = std::chrono::steady_clock;
+
+	double MicrosecondsSince(FClock::time_point Start)
+	{
+		return std::chrono::duration<double, std::micro>(FClock::now() - Start).count();
+	}
+
+	// All the samples of one measurement, from which the first, minimum and median are reported. The first is reported separately as
+	// later iterations are quicker (e.g. the plugin's shape inference reuses the optimizers it creates for the same input shapes).
+	struct FTiming
+	{
+		std::vector<double> Samples;
+
+		double First() const
+		{
+			return Samples.empty() ? 0.0 : Samples[0];
+		}
+
+		double Min() const
+		{
+			return Samples.empty() ? 0.0 : *std::min_element(Samples.begin(), Samples.end());
+		}
+		double Median() const
+		{
+			if (Samples.empty())
+			{
+				return 0.0;
+			}
+			std::vector<double> Sorted = Samples;
+			std::sort(Sorted.begin(), Sorted.end());
+			return Sorted[Sorted.size() / 2];
+		}
+	};
+
+	struct FBinding
+	{
+		uint32_t BindingIdx;
+		uint32_t ResourceIndex; // Into FDecodedVgf::ResourceShapes.
+	};
+
+	struct FSegment
+	{
+		std::string Name;
+		std::vector<FBinding> Inputs;
+		std::vector<FBinding> Outputs;
+		const uint32_t* Code; // Points into the VGF.
+		size_t NumWords;
+	};
+
+	// The parts of the VGF needed to run shape inference through the model.
+	struct FDecodedVgf
+	{
+		std::vector<std::vector<int64_t>> ResourceShapes; // -1 for unspecified dimensions.
+		std::vector<uint32_t> ModelInputs; // Resource index of each model input.
+		std::vector<uint32_t> ModelOutputs; // Resource index of each model output.
+		std::vector<FSegment> Segments;
+	};
+
+	// The timed stages of decoding, in the order that FNNERuntimeRDGMLExtensionsForVulkanModelFormat::Write does them: parsing the header,
+	// creating the section decoders, reading the model resource table, finding the model inputs and outputs, then the walk over the
+	// model sequence (each segment's bindings, constants and SPIR-V code).
+	const char* const DecodeStageNames[] = { "header", "section_decoders", "resource_table", "model_endpoints", "model_sequence" };
+	constexpr size_t NumDecodeStages = sizeof(DecodeStageNames) / sizeof(DecodeStageNames[0]);
+
+	// Does the same walk over the VGF, with the same checks, as FNNERuntimeRDGMLExtensionsForVulkanModelFormat::Write up to the point where
+	// it applies the input shape overrides, timing each stage. The optional rewriting and optimizing of the SPIR-V code when cooking
+	// (SharedConstantMinBytes and bOptimizeCode) isn't included. Returns false (having printed an error) if the VGF is invalid.
+	bool DecodeVgf(const std::vector<uint8_t>& Vgf, FDecodedVgf& OutDecoded, FTiming (&StageTimings)[NumDecodeStages])
+	{
+		OutDecoded = FDecodedVgf();
+
+		// Checks that a pointer returned by the decoder (which points into the VGF data) is within the VGF.
+		auto IsInVgf = [&Vgf](const void* Pointer, uint64_t Size) {
+			const uint8_t* Ptr = reinterpret_cast<const uint8_t*>(Pointer);
+			if (Ptr < Vgf.data() || Ptr > Vgf.data() + Vgf.size() || Size > (uint64_t)(Vgf.data() + Vgf.size() - Ptr))
+			{
+				std::fprintf(stderr, "Corrupt VGF (data out of bounds).\n");
+				return false;
+			}
+			return true;
+		};
+
+		FClock::time_point Start = FClock::now();
+		std::vector<uint8_t> HeaderDecoderMemory(mlsdk_decoder_header_decoder_mem_reqs());
+		mlsdk_decoder_header_decoder* HeaderDecoder = mlsdk_decoder_create_header_decoder(Vgf.data(), HeaderDecoderMemory.data());
+		if (!mlsdk_decoder_is_header_valid(HeaderDecoder))
+		{
+			std::fprintf(stderr, "Invalid VGF header.\n");
+			return false;
+		}
+		if (!mlsdk_decoder_is_header_compatible(HeaderDecoder))
+		{
+			std::fprintf(stderr, "Incompatible VGF header.\n");
+			return false;
+		}
+		StageTimings[0].Samples.push_back(MicrosecondsSince(Start));
+
+		Start = FClock::now();
+		mlsdk_decoder_vgf_section_info SectionInfos[4];
+		for (mlsdk_decoder_section SectionType = mlsdk_decoder_section_modules; SectionType <= mlsdk_decoder_section_constants;
+			SectionType = mlsdk_decoder_section(SectionType + 1))
+		{
+			mlsdk_decoder_get_header_section_info(HeaderDecoder, SectionType, &SectionInfos[SectionType]);
+			if (SectionInfos[SectionType].offset + SectionInfos[SectionType].size > Vgf.size())
+			{
+				std::fprintf(stderr, "Corrupt VGF header (section out of bounds).\n");
+				return false;
+			}
+		}
+		std::vector<uint8_t> ModuleTableDecoderMemory(mlsdk_decoder_module_table_decoder_mem_reqs());
+		std::vector<uint8_t> ModelResourceTableDecoderMemory(mlsdk_decoder_model_resource_table_decoder_mem_reqs());
+		std::vector<uint8_t> ModelSequenceDecoderMemory(mlsdk_decoder_model_sequence_decoder_mem_reqs());
+		std::vector<uint8_t> ConstantTableDecoderMemory(mlsdk_decoder_constant_table_decoder_mem_reqs());
+		mlsdk_decoder_module_table_decoder* ModuleTableDecoder =
+			mlsdk_decoder_create_module_table_decoder(Vgf.data() + SectionInfos[mlsdk_decoder_section_modules].offset, ModuleTableDecoderMemory.data());
+		mlsdk_decoder_model_resource_table_decoder* ModelResourceTableDecoder =
+			mlsdk_decoder_create_model_resource_table_decoder(Vgf.data() + SectionInfos[mlsdk_decoder_section_resources].offset, ModelResourceTableDecoderMemory.data());
+		mlsdk_decoder_model_sequence_decoder* ModelSequenceDecoder =
+			mlsdk_decoder_create_model_sequence_decoder(Vgf.data() + SectionInfos[mlsdk_decoder_section_model_sequence].offset, ModelSequenceDecoderMemory.data());
+		mlsdk_decoder_constant_table_decoder* ConstantTableDecoder =
+			mlsdk_decoder_create_constant_table_decoder(Vgf.data() + SectionInfos[mlsdk_decoder_section_constants].offset, ConstantTableDecoderMemory.data());
+		StageTimings[1].Samples.push_back(MicrosecondsSince(Start));
+
+		// Only inputs, outputs and intermediates become tensors in the plugin; the rest (e.g. constants) can't be bound to segments.
+		Start = FClock::now();
+		const size_t NumResources = mlsdk_decoder_get_model_resource_table_num_entries(ModelResourceTableDecoder);
+		std::vector<bool> IsTensor(NumResources, false);
+		OutDecoded.ResourceShapes.resize(NumResources);
+		for (size_t ResourceIdx = 0; ResourceIdx < NumResources; ++ResourceIdx)
+		{
+			mlsdk_decoder_get_vk_format(ModelResourceTableDecoder, (uint32_t)ResourceIdx);
+
+			mlsdk_decoder_tensor_dimensions DimsRaw;
+			mlsdk_decoder_model_resource_table_get_tensor_shape(ModelResourceTableDecoder, (uint32_t)ResourceIdx, &DimsRaw);
+			for (size_t DimIdx = 0; DimIdx < DimsRaw.size; ++DimIdx)
+			{
+				OutDecoded.ResourceShapes[ResourceIdx].push_back(DimsRaw.data[DimIdx] <= 0 ? -1 : DimsRaw.data[DimIdx]);
+			}
+
+			mlsdk_decoder_tensor_dimensions StridesRaw;
+			mlsdk_decoder_model_resource_table_get_tensor_strides(ModelResourceTableDecoder, (uint32_t)ResourceIdx, &StridesRaw);
+			if (StridesRaw.size > 0)
+			{
+				std::fprintf(stderr, "Strides not supported.\n");
+				return false;
+			}
+
+			const mlsdk_decoder_mrt_category Category = mlsdk_decoder_model_resource_table_get_category(ModelResourceTableDecoder, (uint32_t)ResourceIdx);
+			IsTensor[ResourceIdx] = Category == mlsdk_decoder_mrt_category_input || Category == mlsdk_decoder_mrt_category_output ||
+				Category == mlsdk_decoder_mrt_category_intermediate;
+		}
+		StageTimings[2].Samples.push_back(MicrosecondsSince(Start));
+
+		auto GetBindings = [&](mlsdk_decoder_binding_slots_handle BindingSlots, std::vector<FBinding>& OutBindings) {
+			const size_t NumBindings = mlsdk_decoder_binding_slot_size(ModelSequenceDecoder, BindingSlots);
+			for (size_t Idx = 0; Idx < NumBindings; ++Idx)
+			{
+				const uint32_t ResourceIndex = mlsdk_decoder_binding_slot_mrt_index(ModelSequenceDecoder, BindingSlots, (uint32_t)Idx);
+				if (ResourceIndex >= NumResources)
+				{
+					std::fprintf(stderr, "Corrupt VGF (resource index out of bounds).\n");
+					return false;
+				}
+				if (!IsTensor[ResourceIndex])
+				{
+					std::fprintf(stderr, "Invalid VGF (input or output has incorrect resource type).\n");
+					return false;
+				}
+				OutBindings.push_back({ mlsdk_decoder_binding_slot_binding_id(ModelSequenceDecoder, BindingSlots, (uint32_t)Idx), ResourceIndex });
+			}
+			return true;
+		};
+
+		Start = FClock::now();
+		std::vector<FBinding> ModelInputBindings;
+		std::vector<FBinding> ModelOutputBindings;
+		if (!GetBindings(mlsdk_decoder_model_sequence_get_input_binding_slot(ModelSequenceDecoder), ModelInputBindings) ||
+			!GetBindings(mlsdk_decoder_model_sequence_get_output_binding_slot(ModelSequenceDecoder), ModelOutputBindings))
+		{
+			return false;
+		}
+		for (const FBinding& Binding : ModelInputBindings)
+		{
+			OutDecoded.ModelInputs.push_back(Binding.ResourceIndex);
+		}
+		for (const FBinding& Binding : ModelOutputBindings)
+		{
+			OutDecoded.ModelOutputs.push_back(Binding.ResourceIndex);
+		}
+		StageTimings[3].Samples.push_back(MicrosecondsSince(Start));
+
+		Start = FClock::now();
+		const size_t NumSegments = mlsdk_decoder_get_model_sequence_table_size(ModelSequenceDecoder);
+		for (size_t SegmentIdx = 0; SegmentIdx < NumSegments; ++SegmentIdx)
+		{
+			FSegment& Segment = OutDecoded.Segments.emplace_back();
+			const char* SegmentNameRaw = mlsdk_decoder_model_sequence_get_segment_name(ModelSequenceDecoder, (uint32_t)SegmentIdx);
+			if (!IsInVgf(SegmentNameRaw, 1))
+			{
+				return false;
+			}
+			Segment.Name = SegmentNameRaw;
+
+			const int32_t ModuleIndex = mlsdk_decoder_model_sequence_get_segment_module_index(ModelSequenceDecoder, (uint32_t)SegmentIdx);
+			if (mlsdk_decoder_model_sequence_get_segment_type(ModelSequenceDecoder, (uint32_t)SegmentIdx) != mlsdk_decoder_module_type_graph)
+			{
+				std::fprintf(stderr, "Non-graph segments not supported.\n");
+				return false;
+			}
+
+			if (!GetBindings(mlsdk_decoder_model_sequence_get_segment_input_binding_slot(ModelSequenceDecoder, (uint32_t)SegmentIdx), Segment.Inputs) ||
+				!GetBindings(mlsdk_decoder_model_sequence_get_segment_output_binding_slot(ModelSequenceDecoder, (uint32_t)SegmentIdx), Segment.Outputs))
+			{
+				return false;
+			}
+
+			if (mlsdk_decoder_model_sequence_get_segment_descriptorset_info_size(ModelSequenceDecoder, (uint32_t)SegmentIdx) != 1)
+			{
+				std::fprintf(stderr, "Descriptor sets count unexpected.\n");
+				return false;
+			}
+
+			mlsdk_decoder_push_constant_ranges_handle PushConstantsRanges =
+				mlsdk_decoder_model_sequence_get_segment_push_constant_range(ModelSequenceDecoder, (uint32_t)SegmentIdx);
+			if (mlsdk_decoder_get_push_constant_ranges_size(ModelSequenceDecoder, PushConstantsRanges) != 0)
+			{
+				std::fprintf(stderr, "Push constants not supported.\n");
+				return false;
+			}
+
+			const size_t NumConstants = mlsdk_decoder_get_constant_table_num_entries(ConstantTableDecoder);
+			mlsdk_decoder_constant_indexes ConstantIndexes;
+			mlsdk_decoder_model_sequence_get_segment_constant_indexes(ModelSequenceDecoder, (uint32_t)SegmentIdx, &ConstantIndexes);
+			for (size_t ConstantIdx = 0; ConstantIdx < ConstantIndexes.size; ++ConstantIdx)
+			{
+				const int ModelConstantIdx = ConstantIndexes.data[ConstantIdx];
+				if (ModelConstantIdx < 0 || (size_t)ModelConstantIdx >= NumConstants)
+				{
+					std::fprintf(stderr, "Corrupt VGF (segment constant idx out of bounds).\n");
+					return false;
+				}
+				if (mlsdk_decoder_constant_table_get_mrt_index(ConstantTableDecoder, ModelConstantIdx) >= NumResources)
+				{
+					std::fprintf(stderr, "Corrupt VGF (constant resource idx out of bounds).\n");
+					return false;
+				}
+				mlsdk_decoder_constant_data ConstantData;
+				mlsdk_decoder_constant_table_get_data(ConstantTableDecoder, ModelConstantIdx, &ConstantData);
+				if (!IsInVgf(ConstantData.data, ConstantData.size))
+				{
+					return false;
+				}
+			}
+
+			if (mlsdk_decoder_get_module_type(ModuleTableDecoder, ModuleIndex) != mlsdk_decoder_module_type_graph)
+			{
+				std::fprintf(stderr, "Non-graph modules not supported.\n");
+				return false;
+			}
+
+			mlsdk_decoder_spirv_code SPIRVCode;
+			mlsdk_decoder_get_module_code(ModuleTableDecoder, ModuleIndex, &SPIRVCode);
+			if (SPIRVCode.code == nullptr || SPIRVCode.words == 0)
+			{
+				std::fprintf(stderr, "Missing SPIRV code for module.\n");
+				return false;
+			}
+			if (!IsInVgf(SPIRVCode.code, SPIRVCode.words * sizeof(uint32_t)) || !IsInVgf(mlsdk_decoder_get_module_entry_point(ModuleTableDecoder, ModuleIndex), 1))
+			{
+				return false;
+			}
+			Segment.Code = SPIRVCode.code;
+			Segment.NumWords = SPIRVCode.words;
+		}
+		StageTimings[4].Samples.push_back(MicrosecondsSince(Start));
+
+		return true;
+	}
+
+	std::string EscapeJson(const std::string& String)
+	{
+		std::string Escaped;
+		for (char C : String)
+		{
+			if (C == '"' || C == '\\')
+			{
+				Escaped += '\\';
+				Escaped += C;
+			}
+			else if ((unsigned char)C < 0x20)
+			{
+				char Buffer[8];
+				std::snprintf(Buffer, sizeof(Buffer), "\\u%04x", (unsigned)C);
+				Escaped += Buffer;
+			}
+			else
+			{
+				Escaped += C;
+			}
+		}
+		return Escaped;
+	}
+
+	std::string ShapeToJson(const std::vector<int64_t>& Shape)
+	{
+		std::string Json = "[";
+		for (size_t DimIdx = 0; DimIdx < Shape.size(); ++DimIdx)
+		{
+			Json += (DimIdx > 0 ? ", " : "") + std::to_string(Shape[DimIdx]);
+		}
+		return Json + "]";
+	}
+
+	std::string TimingToJson(const FTiming& Timing)
+	{
+		char Buffer[128];
+		std::snprintf(Buffer, sizeof(Buffer), "{ \"first_us\": %.3f, \"min_us\": %.3f, \"median_us\": %.3f }", Timing.First(), Timing.Min(), Timing.Median());
+		return Buffer;
+	}
+
+	// Benchmarks a single VGF, appending its JSON object to Json. Returns false (having printed an error) if anything fails.
+	bool BenchmarkVgf(const std::filesystem::path& Path, const std::vector<int64_t>& DimValues, int NumIterations, std::string& Json)
+	{
+		std::ifstream File(Path, std::ios::binary);
+		std::vector<uint8_t> Vgf((std::istreambuf_iterator<char>(File)), std::istreambuf_iterator<char>());
+		if (!File.good() && !File.eof())
+		{
+			std::fprintf(stderr, "Failed to read %s.\n", Path.string().c_str());
+			return false;
+		}
+
+		FDecodedVgf Decoded;
+		FTiming DecodeTimings[NumDecodeStages];
+		FTiming TotalDecodeTiming;
+		for (int Iteration = 0; Iteration < NumIterations; ++Iteration)
+		{
+			const FClock::time_point Start = FClock::now();
+			if (!DecodeVgf(Vgf, Decoded, DecodeTimings))
+			{
+				std::fprintf(stderr, "Failed to decode %s.\n", Path.string().c_str());
+				return false;
+			}
+			TotalDecodeTiming.Samples.push_back(MicrosecondsSince(Start));
+		}
+
+		Json += "    {\n      \"file\": \"" + EscapeJson(Path.filename().string()) + "\",\n";
+		Json += "      \"size_bytes\": " + std::to_string(Vgf.size()) + ",\n";
+		Json += "      \"num_segments\": " + std::to_string(Decoded.Segments.size()) + ",\n";
+		Json += "      \"decode\": {\n        \"total\": " + TimingToJson(TotalDecodeTiming);
+		for (size_t StageIdx = 0; StageIdx < NumDecodeStages; ++StageIdx)
+		{
+			Json += ",\n        \"" + std::string(DecodeStageNames[StageIdx]) + "\": " + TimingToJson(DecodeTimings[StageIdx]);
+		}
+		Json += "\n      },\n      \"shape_inference\": [";
+
+		// A model without any unspecified input dimensions only has one set of shapes to run.
+		const bool bIsStatic = std::none_of(Decoded.ModelInputs.begin(), Decoded.ModelInputs.end(), [&](uint32_t ResourceIndex) {
+			const std::vector<int64_t>& Shape = Decoded.ResourceShapes[ResourceIndex];
+			return std::find(Shape.begin(), Shape.end(), -1) != Shape.end();
+		});
+		const std::vector<int64_t> SweepValues = bIsStatic ? std::vector<int64_t>{ -1 } : DimValues;
+
+		for (size_t SweepIdx = 0; SweepIdx < SweepValues.size(); ++SweepIdx)
+		{
+			std::vector<FTiming> ShapeInferenceTimings(Decoded.Segments.size());
+			std::vector<bool> Skipped(Decoded.Segments.size(), false);
+			std::vector<std::vector<int64_t>> TensorShapes;
+			for (int Iteration = 0; Iteration < NumIterations; ++Iteration)
+			{
+				// Resource shapes are filled in as we go through the segments, like the plugin does for its tensors.
+				TensorShapes = Decoded.ResourceShapes;
+				for (uint32_t ResourceIndex : Decoded.ModelInputs)
+				{
+					std::replace(TensorShapes[ResourceIndex].begin(), TensorShapes[ResourceIndex].end(), (int64_t)-1, SweepValues[SweepIdx]);
+				}
+
+				for (size_t SegmentIdx = 0; SegmentIdx < Decoded.Segments.size(); ++SegmentIdx)
+				{
+					const FSegment& Segment = Decoded.Segments[SegmentIdx];
+					FDescriptorSetBindingToShapeMap InputShapes;
+					for (const FBinding& Binding : Segment.Inputs)
+					{
+						const std::vector<int64_t>& Shape = TensorShapes[Binding.ResourceIndex];
+						InputShapes.Add({ 0, Binding.BindingIdx }, TArray<int64_t>(Shape.data(), (int64)Shape.size()));
+					}
+
+					const FClock::time_point Start = FClock::now();
+					const ShapeInferenceResults Results = RunShapeInference(TConstArrayView<uint32_t>(Segment.Code, (int64)Segment.NumWords), MoveTemp(InputShapes));
+					ShapeInferenceTimings[SegmentIdx].Samples.push_back(MicrosecondsSince(Start));
+					if (!Results.Success)
+					{
+						std::fprintf(stderr, "Shape inference failed for segment %s of %s.\n", Segment.Name.c_str(), Path.string().c_str());
+						return false;
+					}
+					// RunShapeInference returns fully shaped code as it is, without running the shape pass.
+					Skipped[SegmentIdx] = Results.NewCode.size() == Segment.NumWords && std::equal(Results.NewCode.begin(), Results.NewCode.end(), Segment.Code);
+
+					for (const FBinding& Binding : Segment.Outputs)
+					{
+						const TArray<int64_t>* Shape = Results.OutputShapes.Find({ 0, Binding.BindingIdx });
+						if (Shape == nullptr)
+						{
+							std::fprintf(stderr, "No shape for output binding %u of segment %s of %s.\n", Binding.BindingIdx, Segment.Name.c_str(), Path.string().c_str());
+							return false;
+						}
+						TensorShapes[Binding.ResourceIndex].assign(Shape->begin(), Shape->end());
+					}
+				}
+			}
+
+			Json += SweepIdx > 0 ? ",\n" : "\n";
+			Json += "        {\n          \"dim_value\": " + (bIsStatic ? std::string("null") : std::to_string(SweepValues[SweepIdx])) + ",\n";
+			Json += "          \"segments\": [";
+			for (size_t SegmentIdx = 0; SegmentIdx < Decoded.Segments.size(); ++SegmentIdx)
+			{
+				const FSegment& Segment = Decoded.Segments[SegmentIdx];
+				Json += SegmentIdx > 0 ? ",\n" : "\n";
+				Json += "            { \"name\": \"" + EscapeJson(Segment.Name) + "\", \"spirv_words\": " + std::to_string(Segment.NumWords);
+				Json += ", \"skipped\": " + std::string(Skipped[SegmentIdx] ? "true" : "false");
+				Json += ", \"shape_inference\": " + TimingToJson(ShapeInferenceTimings[SegmentIdx]);
+				Json += ", \"output_shapes\": [";
+				for (size_t OutputIdx = 0; OutputIdx < Segment.Outputs.size(); ++OutputIdx)
+				{
+					Json += (OutputIdx > 0 ? ", " : "") + ShapeToJson(TensorShapes[Segment.Outputs[OutputIdx].ResourceIndex]);
+				}
+				Json += "] }";
+			}
+			Json += "\n          ]\n        }";
+		}
+		Json += "\n      ]\n    }";
+		return true;
+	}
+
+	// Parses the whole of the given string as an integer between 1 and MaxValue. Returns false if it isn't one.
+	bool ParsePositiveInteger(const std::string& String, int64_t MaxValue, int64_t& OutValue)
+	{
+		size_t NumParsed = 0;
+		try
+		{
+			OutValue = std::stoll(String, &NumParsed);
+		}
+		catch (const std::logic_error&) // std::invalid_argument if it isn't a number, std::out_of_range if it's too big.
+		{
+			return false;
+		}
+		return NumParsed == String.size() && OutValue >= 1 && OutValue <= MaxValue;
+	}
+
+} // namespace
+
+int main(int Argc, char** Argv)
+{
+	const char* const Usage = "Usage: %s <directory of .vgf files> [--dims 64,128,256] [--iterations 5] [--output results.json]\n";
+	if (Argc < 2)
+	{
+		std::fprintf(stderr, Usage, Argv[0]);
+		return 2;
+	}
+
+	const std::filesystem::path Directory = Argv[1];
+	std::vector<int64_t> DimValues = { 64, 128, 256 };
+	int NumIterations = 5;
+	std::string OutputPath;
+	for (int ArgIdx = 2; ArgIdx < Argc; ArgIdx += 2)
+	{
+		const std::string Arg = Argv[ArgIdx];
+		if (Arg != "--dims" && Arg != "--iterations" && Arg != "--output")
+		{
+			std::fprintf(stderr, "Unknown argument %s.\n", Arg.c_str());
+			std::fprintf(stderr, Usage, Argv[0]);
+			return 2;
+		}
+		if (ArgIdx + 1 >= Argc)
+		{
+			std::fprintf(stderr, "Missing value for %s.\n", Arg.c_str());
+			std::fprintf(stderr, Usage, Argv[0]);
+			return 2;
+		}
+
+		const std::string Value = Argv[ArgIdx + 1];
+		if (Arg == "--dims")
+		{
+			DimValues.clear();
+			for (size_t Start = 0; Start <= Value.size(); )
+			{
+				const size_t End = std::min(Value.find(',', Start), Value.size());
+				int64_t DimValue = 0;
+				if (!ParsePositiveInteger(Value.substr(Start, End - Start), INT32_MAX, DimValue))
+				{
+					std::fprintf(stderr, "Invalid value for --dims: %s (expected a comma-separated list of positive integers).\n", Value.c_str());
+					return 2;
+				}
+				DimValues.push_back(DimValue);
+				Start = End + 1;
+			}
+		}
+		else if (Arg == "--iterations")
+		{
+			int64_t Iterations = 0;
+			if (!ParsePositiveInteger(Value, INT32_MAX, Iterations))
+			{
+				std::fprintf(stderr, "Invalid value for --iterations: %s (expected a positive integer).\n", Value.c_str());
+				return 2;
+			}
+			NumIterations = (int)Iterations;
+		}
+		else
+		{
+			OutputPath = Value;
+		}
+	}
+
+	// Sorted, so that the output is in the same order on every machine.
+	std::vector<std::filesystem::path> Paths;
+	std::error_code Error;
+	for (std::filesystem::directory_iterator It(Directory, Error), End; !Error && It != End; It.increment(Error))
+	{
+		if (It->is_regular_file() && It->path().extension() == ".vgf")
+		{
+			Paths.push_back(It->path());
+		}
+	}
+	if (Error)
+	{
+		std::fprintf(stderr, "Failed to list %s: %s.\n", Directory.string().c_str(), Error.message().c_str());
+		return 2;
+	}
+	std::sort(Paths.begin(), Paths.end());
+
+	std::string Json = "{\n  \"iterations\": " + std::to_string(NumIterations) + ",\n  \"models\": [\n";
+	bool bAllSucceeded = true;
+	bool bFirst = true;
+	for (const std::filesystem::path& Path : Paths)
+	{
+		std::string ModelJson;
+		if (!BenchmarkVgf(Path, DimValues, NumIterations, ModelJson))
+		{
+			bAllSucceeded = false;
+			continue;
+		}
+		Json += (bFirst ? "" : ",\n") + ModelJson;
+		bFirst = false;
+	}
+	Json += "\n  ]\n}\n";
+
+	if (OutputPath.empty())
+	{
+		std::fputs(Json.c_str(), stdout);
+	}
+	else
+	{
+		std::ofstream OutputFile(OutputPath, std::ios::binary);
+		OutputFile << Json;
+		if (!OutputFile.good())
+		{
+			std::fprintf(stderr, "Failed to write %s.\n", OutputPath.c_str());
+			return 1;
+		}
+	}
+	return bAllSucceeded ? 0 : 1;
+}